@@ -0,0 +1,68 @@
+/**
+ * Copyright 2007-2022 IMP Inventors. All rights reserved.
+ */
+#include <IMP/atom/BrownianDynamics.h>
+#include <IMP/atom/Diffusion.h>
+#include <IMP/core/XYZR.h>
+#include <IMP/core/DistanceToSingletonScore.h>
+#include <IMP/core/Harmonic.h>
+#include <IMP/container/ListSingletonContainer.h>
+#include <IMP/container/SingletonsRestraint.h>
+#include <IMP/algebra/vector_generators.h>
+#include <IMP/benchmark/utility.h>
+#include <IMP/benchmark/benchmark_macros.h>
+#include <IMP/flags.h>
+#include <boost/lexical_cast.hpp>
+
+using namespace IMP;
+
+namespace {
+
+/* Free beads loosely held near the origin, so that integrating the
+   particles rather than scoring them dominates the cost of a step. */
+atom::BrownianDynamics *create_bd(Model *m, unsigned int n) {
+  algebra::BoundingBox3D bb(algebra::Vector3D(-100, -100, -100),
+                            algebra::Vector3D(100, 100, 100));
+  ParticleIndexes pis;
+  for (unsigned int i = 0; i < n; ++i) {
+    ParticleIndex pi = m->add_particle("bead");
+    core::XYZR d = core::XYZR::setup_particle(
+        m, pi, algebra::Sphere3D(algebra::get_random_vector_in(bb), 2));
+    d.set_coordinates_are_optimized(true);
+    atom::Diffusion::setup_particle(m, pi);
+    pis.push_back(pi);
+  }
+  IMP_NEW(container::ListSingletonContainer, lsc, (m, pis));
+  IMP_NEW(core::DistanceToSingletonScore, ss,
+          (new core::Harmonic(0, .001), algebra::Vector3D(0, 0, 0)));
+  IMP_NEW(container::SingletonsRestraint, r, (ss, lsc));
+  IMP_NEW(atom::BrownianDynamics, bd, (m));
+  bd->set_scoring_function(RestraintsTemp(1, r));
+  bd->set_maximum_time_step(100);
+  return bd.release();
+}
+
+void test_one(std::string name, atom::BrownianDynamics *bd, bool fused,
+              unsigned int steps) {
+  bd->set_use_fused_kernel(fused);
+  // set up and warm up the caches
+  bd->optimize(1);
+  double runtime, score = 0;
+  IMP_TIME({ score += bd->optimize(steps); }, runtime);
+  IMP::benchmark::report("bd " + name, fused ? "fused" : "decorator",
+                         runtime, score);
+}
+}
+
+int main(int argc, char **argv) {
+  IMP::setup_from_argv(argc, argv, "Benchmark Brownian dynamics");
+  IMP::set_log_level(IMP::SILENT);
+  unsigned int n = IMP::run_quick_test ? 1000 : 200000;
+  unsigned int steps = IMP::run_quick_test ? 2 : 20;
+  IMP_NEW(Model, m, ());
+  Pointer<atom::BrownianDynamics> bd = create_bd(m, n);
+  std::string name = boost::lexical_cast<std::string>(n);
+  test_one(name, bd, false, steps);
+  test_one(name, bd, true, steps);
+  return 0;
+}
@@ -18,7 +18,10 @@ using namespace IMP::container;
 using namespace IMP::display;
 
 namespace {
-int do_benchmark() {
+/* Run the same simulation with the nonbonded term scored either by a
+   LennardJonesPairScore or by a LennardJonesCoulombPairScore (the atoms
+   have no charges, so both give the same energy) */
+int do_benchmark(bool combined) {
   try {
     IMP_NEW(Model, m, ());
     atom::Hierarchy prot =
@@ -85,8 +88,14 @@ int do_benchmark() {
     nbl->add_pair_filter(r->get_pair_filter());
 
     IMP_NEW(ForceSwitch, sf, (6.0, 7.0));
-    IMP_NEW(LennardJonesPairScore, ps, (sf));
-    rs->add_restraint(new PairsRestraint(ps, nbl));
+    if (combined) {
+      IMP_NEW(LennardJonesCoulombPairScore, ps, (sf));
+      ps->set_particles(m, IMP::internal::get_index(atoms));
+      rs->add_restraint(new PairsRestraint(ps, nbl));
+    } else {
+      IMP_NEW(LennardJonesPairScore, ps, (sf));
+      rs->add_restraint(new PairsRestraint(ps, nbl));
+    }
 
     // Finally, evaluate the score of the whole system (without derivatives)
     IMP_NEW(ConjugateGradients, cg, (m));
@@ -130,7 +139,9 @@ int do_benchmark() {
     } else {
       IMP_TIME({ score += md->optimize(100); }, time);
     }
-    IMP::benchmark::report("md charmm", time, score);
+    IMP::benchmark::report("md charmm",
+                           combined ? "combined" : "lennard jones", time,
+                           score);
     return 0;
   }
   catch (const Exception &e) {
@@ -143,5 +154,9 @@ int do_benchmark() {
 int main(int argc, char **argv) {
   IMP::setup_from_argv(argc, argv, "Benchmark md");
   IMP::set_log_level(IMP::SILENT);
-  return do_benchmark();
+  int ret = do_benchmark(false);
+  if (ret == 0) {
+    ret = do_benchmark(true);
+  }
+  return ret;
 }
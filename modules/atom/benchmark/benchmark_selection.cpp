@@ -0,0 +1,78 @@
+/**
+ * Copyright 2007-2022 IMP Inventors. All rights reserved.
+ */
+#include <IMP/atom/Copy.h>
+#include <IMP/atom/Residue.h>
+#include <IMP/atom/Selection.h>
+#include <IMP/atom/pdb.h>
+#include <IMP/benchmark/utility.h>
+#include <IMP/benchmark/benchmark_macros.h>
+#include <IMP/flags.h>
+
+using namespace IMP;
+
+namespace {
+
+/* Several copies of a couple of molecules, each read from the same file,
+   as a PMI system with many components would have. */
+atom::Hierarchy create_system(Model *m, std::string fname,
+                              unsigned int copies) {
+  atom::Hierarchy root =
+      atom::Hierarchy::setup_particle(m, m->add_particle("root"));
+  const char *names[] = {"prot0", "prot1"};
+  for (const char *name : names) {
+    for (unsigned int i = 0; i < copies; ++i) {
+      atom::Hierarchy h = atom::read_pdb(fname, m);
+      atom::Copy mol =
+          atom::Copy::setup_particle(m, m->add_particle(name), i);
+      atom::Hierarchies chains = h.get_children();
+      h.clear_children();
+      for (atom::Hierarchy chain : chains) {
+        mol.add_child(chain);
+      }
+      root.add_child(mol);
+      m->remove_particle(h.get_particle_index());
+    }
+  }
+  return root;
+}
+
+void test_one(atom::Hierarchy root, unsigned int copies, bool use_index) {
+  Ints indexes;
+  for (atom::Hierarchy r :
+       atom::get_by_type(root.get_child(0), atom::RESIDUE_TYPE)) {
+    indexes.push_back(atom::Residue(r).get_index());
+  }
+  const char *names[] = {"prot0", "prot1"};
+  double runtime, total = 0;
+  IMP_TIME({
+             for (const char *name : names) {
+               for (unsigned int i = 0; i < copies; ++i) {
+                 for (unsigned int j = 0; j < indexes.size(); j += 10) {
+                   atom::Selection s(root);
+                   s.set_use_index(use_index);
+                   s.set_molecule(name);
+                   s.set_copy_index(i);
+                   s.set_residue_index(indexes[j]);
+                   total += s.get_selected_particle_indexes().size();
+                 }
+               }
+             }
+           },
+           runtime);
+  IMP::benchmark::report("selection", use_index ? "index" : "search",
+                         runtime, total);
+}
+}
+
+int main(int argc, char **argv) {
+  IMP::setup_from_argv(argc, argv, "Benchmark hierarchy selection");
+  IMP::set_log_level(IMP::SILENT);
+  unsigned int copies = IMP::run_quick_test ? 1 : 4;
+  IMP_NEW(Model, m, ());
+  atom::Hierarchy root = create_system(
+      m, IMP::benchmark::get_data_path("large_protein.pdb"), copies);
+  test_one(root, copies, false);
+  test_one(root, copies, true);
+  return IMP::benchmark::get_return_value();
+}
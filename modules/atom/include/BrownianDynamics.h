@@ -85,6 +85,15 @@ class IMPATOMEXPORT BrownianDynamics : public Simulator {
   IMP::Vector<algebra::Vector3D> forces_;
   IMP::Vector<double> random_pool_; // pool of random doubles ~N(0.0,1.0)
   unsigned int i_random_pool_; // position in pool of random numbers
+  bool fused_;
+  // gathered by setup() for the fused kernel, in the order of fused_ps_
+  ParticleIndexes fused_ps_;
+  IMP::Vector<double> diffusion_; // [A^2/fs]
+  IMP::Vector<char> is_rigid_body_;
+  // samples ~N(0.0,1.0) for a step: 3 per particle, 4 more per rigid body
+  IMP::Vector<double> step_random_;
+  // start of each particle's samples in step_random_, plus the total
+  IMP::Vector<unsigned int> random_offset_;
 
  public:
 
@@ -113,6 +122,29 @@ class IMPATOMEXPORT BrownianDynamics : public Simulator {
   //! Set whether to use the stochastic Runge Kutta scheme
   void set_use_stochastic_runge_kutta(bool tf) { srk_ = tf; }
 
+  /** \name Fused kernel
+      When turned on, particles are advanced by a kernel that uses the
+      diffusion coefficients gathered when the simulation is set up,
+      reads forces and writes coordinates directly in the model's
+      tables, and draws the random displacements and rotations for a
+      whole step in one batch. By default it is off and
+      do_advance_chunk() is called instead, which looks everything up
+      through decorators. Subclasses that override do_advance_chunk()
+      should leave it off.
+
+      The fused kernel draws its random numbers in a different order,
+      so trajectories differ from those of the default kernel even with
+      the same random seed; they follow the same distribution.
+
+      As the diffusion coefficients are only gathered by setup(),
+      changes to them only take effect at the next call to
+      Simulator::simulate() or Optimizer::optimize().
+      @{
+  */
+  void set_use_fused_kernel(bool tf) { fused_ = tf; }
+  bool get_use_fused_kernel() const { return fused_; }
+  /** @} */
+
   IMP_OBJECT_METHODS(BrownianDynamics);
 
  protected:
@@ -190,6 +222,12 @@ private:
   void advance_coordinates_0(ParticleIndex pi, unsigned int i,
                              double dtfs, double ikT);
   void advance_orientation_0(ParticleIndex pi, double dtfs, double ikT);
+  void advance_orientation(ParticleIndex pi, double dtfs, double ikT,
+                           double angle, const algebra::Vector3D &axis);
+  void gather_particle_data(const ParticleIndexes &ps);
+  void advance_chunk_fused(double dtfs, double ikT,
+                           const ParticleIndexes &ps,
+                           unsigned int begin, unsigned int end);
 
 };
 
@@ -58,10 +58,20 @@ class IMPATOMEXPORT CHARMMStereochemistryRestraint : public Restraint {
                                  ParticlesTemp limit_to_these_particles);
 
   //! Get a PairFilter that excludes all stereochemical pairs.
-  /** \return a StereochemistryPairFilter that excludes all 1-2 (bond),
+  /** \param[in] exclude_dihedrals if false, 1-4 (dihedral) pairs are
+              not excluded, so that they can be scored with scaled
+              nonbonded terms (see get_14_pairs()).
+      \return a StereochemistryPairFilter that excludes all 1-2 (bond),
               1-3 (angle) and 1-4 (dihedral) pairs.
    */
-  StereochemistryPairFilter *get_pair_filter();
+  StereochemistryPairFilter *get_pair_filter(bool exclude_dihedrals = true);
+
+  //! Get the 1-4 pairs, the ends of each dihedral.
+  /** Pairs that are also 1-2 or 1-3 pairs (as in small rings) are not
+      included, and each pair is only listed once.
+      \see LennardJonesCoulombPairScore::set_14_pairs()
+   */
+  ParticleIndexPairs get_14_pairs() const;
 
   //! Get a PairFilter including everything from original topology
   /** \return a StereochemistryPairFilter that excludes all 1-2 (bond),
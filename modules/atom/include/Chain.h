@@ -71,6 +71,7 @@ class IMPATOMEXPORT Chain : public Hierarchy {
     if (!Hierarchy::get_is_setup(m, pi)) {
       Hierarchy::setup_particle(m, pi);
     }
+    core::internal::add_hierarchy_edit();
   }
   static void do_setup_particle(Model *m, ParticleIndex pi, char c) {
     do_setup_particle(m, pi, std::string(1, c));
@@ -32,6 +32,7 @@ class IMPATOMEXPORT Copy : public Molecule {
     if (!Molecule::get_is_setup(m, pi)) {
       Molecule::setup_particle(m, pi);
     }
+    core::internal::add_hierarchy_edit();
   }
 
  public:
@@ -31,6 +31,7 @@ class IMPATOMEXPORT Domain : public Hierarchy {
     if (!Hierarchy::get_is_setup(m, pi)) {
       Hierarchy::setup_particle(m, pi);
     }
+    core::internal::add_hierarchy_edit();
   }
   static void do_setup_particle(Model *m, ParticleIndex pi,
                                 Domain o) {
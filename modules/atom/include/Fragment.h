@@ -33,6 +33,7 @@ class IMPATOMEXPORT Fragment : public Hierarchy {
     }
     m->add_attribute(get_marker_key(), pi, 1);
     set_residue_indexes(m, pi, ris);
+    core::internal::add_hierarchy_edit();
   }
 
   static void do_setup_particle(Model *m, ParticleIndex pi,
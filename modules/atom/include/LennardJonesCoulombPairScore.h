@@ -0,0 +1,121 @@
+/**
+ *  \file IMP/atom/LennardJonesCoulombPairScore.h
+ *  \brief Combined Lennard-Jones and Coulomb score with a force switch.
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ */
+
+#ifndef IMPATOM_LENNARD_JONES_COULOMB_PAIR_SCORE_H
+#define IMPATOM_LENNARD_JONES_COULOMB_PAIR_SCORE_H
+
+#include <IMP/atom/atom_config.h>
+#include <IMP/generic.h>
+#include <IMP/PairScore.h>
+#include <IMP/Pointer.h>
+#include <IMP/atom/smoothing_functions.h>
+#include <IMP/pair_macros.h>
+
+IMPATOM_BEGIN_NAMESPACE
+
+//! Combined Lennard-Jones and Coulomb score between a pair of particles.
+/** The score is the sum of what a LennardJonesPairScore and a
+    CoulombPairScore would give for the pair, both smoothed with the
+    same ForceSwitch, but computed in one pass over the pairs from
+    parameter tables rather than from the particles' decorators.
+
+    The well depth and radius (from the LennardJones decorator) and the
+    charge (from the Charged decorator; zero if the particle is not Charged)
+    of every particle the score will see must be gathered first, by
+    passing them to set_particles(). Particles with the same well depth and
+    radius share a type, and the Lennard-Jones factors for each pair of
+    types are precomputed. Call update_parameters() after changing any of
+    those attributes.
+
+    Pairs further apart than ForceSwitch::get_max_distance() score zero.
+
+    To apply CHARMM-style 1-4 scaling, use a pair filter that only
+    excludes 1-2 and 1-3 pairs (such as
+    CHARMMStereochemistryRestraint::get_pair_filter(false)) and pass the
+    1-4 pairs (CHARMMStereochemistryRestraint::get_14_pairs()) to
+    set_14_pairs(); the Lennard-Jones and Coulomb terms of those pairs are
+    multiplied by the 1-4 scale factors.
+
+    \see LennardJonesPairScore
+    \see CoulombPairScore
+ */
+class IMPATOMEXPORT LennardJonesCoulombPairScore : public PairScore {
+  IMP::PointerMember<ForceSwitch> smoothing_function_;
+  double repulsive_weight_, attractive_weight_;
+  double relative_dielectric_, coulomb_factor_;
+  double lj_14_scale_, coulomb_14_scale_;
+  ParticleIndexes particles_;
+  // per type well depth and radius, and the A, B factors per type pair
+  Floats type_well_depths_, type_radii_;
+  Floats a_, b_;
+  // by particle index; a type of -1 marks particles that were not set
+  Ints types_;
+  Floats charges_;
+  // 1-4 partners of each particle index, in CSR form
+  Vector<unsigned int> partner_offsets_;
+  ParticleIndexes partners_;
+
+  void update_factors();
+  bool get_is_14_pair(ParticleIndex p0, ParticleIndex p1) const;
+
+ public:
+  LennardJonesCoulombPairScore(ForceSwitch *f);
+
+  //! Gather the parameters of the particles to be scored
+  void set_particles(Model *m, ParticleIndexesAdaptor ps);
+
+  //! Reread the parameters of the particles passed to set_particles()
+  void update_parameters(Model *m);
+
+  //! Scale the interactions of the given pairs by the 1-4 factors
+  void set_14_pairs(const ParticleIndexPairs &pairs);
+
+  void set_14_scale_factors(double lennard_jones, double coulomb) {
+    lj_14_scale_ = lennard_jones;
+    coulomb_14_scale_ = coulomb;
+  }
+  double get_lennard_jones_14_scale_factor() const { return lj_14_scale_; }
+  double get_coulomb_14_scale_factor() const { return coulomb_14_scale_; }
+
+  void set_repulsive_weight(double repulsive_weight) {
+    repulsive_weight_ = repulsive_weight;
+    update_factors();
+  }
+  double get_repulsive_weight() const { return repulsive_weight_; }
+
+  void set_attractive_weight(double attractive_weight) {
+    attractive_weight_ = attractive_weight;
+    update_factors();
+  }
+  double get_attractive_weight() const { return attractive_weight_; }
+
+  void set_relative_dielectric(double relative_dielectric);
+  double get_relative_dielectric() const { return relative_dielectric_; }
+
+  //! Return the number of distinct Lennard-Jones types found
+  unsigned int get_number_of_types() const {
+    return type_well_depths_.size();
+  }
+
+  virtual double evaluate_index(Model *m,
+                                const ParticleIndexPair &p,
+                                DerivativeAccumulator *da) const override;
+  virtual double evaluate_indexes(Model *m, const ParticleIndexPairs &p,
+                                  DerivativeAccumulator *da,
+                                  unsigned int lower_bound,
+                                  unsigned int upper_bound) const override;
+  virtual ModelObjectsTemp do_get_inputs(
+      Model *m, const ParticleIndexes &pis) const override;
+  IMP_PAIR_SCORE_METHODS(LennardJonesCoulombPairScore);
+  IMP_OBJECT_METHODS(LennardJonesCoulombPairScore);
+};
+
+IMP_OBJECTS(LennardJonesCoulombPairScore, LennardJonesCoulombPairScores);
+
+IMPATOM_END_NAMESPACE
+
+#endif /* IMPATOM_LENNARD_JONES_COULOMB_PAIR_SCORE_H */
@@ -29,6 +29,8 @@ class IMPATOMEXPORT Molecule : public Hierarchy {
       Hierarchy::setup_particle(m, pi);
     }
     m->add_attribute(key(), pi, 1);
+    // Selection indexes which nodes are molecules
+    core::internal::add_hierarchy_edit();
   }
 
  public:
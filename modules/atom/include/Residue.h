@@ -147,6 +147,7 @@ class IMPATOMEXPORT Residue : public Hierarchy {
     }
     Residue ret(m, pi);
     ret.set_residue_type(t);
+    core::internal::add_hierarchy_edit();
   }
   static void do_setup_particle(Model *m, ParticleIndex pi,
                                 const Residue &o) {
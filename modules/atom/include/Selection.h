@@ -10,6 +10,7 @@
 
 #include <IMP/atom/atom_config.h>
 #include <IMP/atom/internal/SelectionPredicate.h>
+#include <IMP/atom/internal/SelectionIndex.h>
 #include "Atom.h"
 #include "Hierarchy.h"
 #include "Residue.h"
@@ -66,6 +67,20 @@ IMPATOM_BEGIN_NAMESPACE
     that fits is returned. If you want lower resolution, use the
     resolution parameter to select the desired resolution (pass a very large
     number to get the coarsest representation).
+
+    Selections by molecule, chain, copy, state, domain, residue index or
+    residue type only walk the parts of the hierarchy that contain a match.
+    To find those, an index of the hierarchy is built when it is first
+    queried twice without a structural change. The index records which
+    nodes are Molecules, Chains, Residues etc., not their names or
+    indexes. It is kept until any hierarchy is edited: a child is added or
+    removed, a representation is added, or a particle is set up as a
+    Molecule, Chain, Copy, State, Residue, Fragment or Domain. Decorators
+    may therefore be set up before or after a particle is added to the
+    hierarchy. The edits are counted for all hierarchies together, so an
+    edit to any hierarchy drops the index of every hierarchy, and models
+    that are being built while others are queried gain little from it.
+    See set_use_index().
 */
 class IMPATOMEXPORT Selection :
 #ifdef SWIG
@@ -86,6 +101,7 @@ class IMPATOMEXPORT Selection :
   double resolution_;
   RepresentationType representation_type_;
   Pointer<internal::ListSelectionPredicate> predicate_, and_predicate_;
+  bool use_index_;
 
   ParticleIndexes h_;
   IMP_NAMED_TUPLE_2(SearchResult, SearchResults, bool, match,
@@ -93,7 +109,9 @@ class IMPATOMEXPORT Selection :
   SearchResult search(Model *m, ParticleIndex pi,
                       boost::dynamic_bitset<> parent,
                       bool include_children,
-                      bool found_rep_node=false) const;
+                      bool found_rep_node=false,
+                      const internal::SelectionIndex *index=nullptr,
+                      const IntRanges *ranges=nullptr) const;
   void set_hierarchies(Model *m, const ParticleIndexes &pis);
   void add_predicate(internal::SelectionPredicate *p);
   void init_predicate();
@@ -151,6 +169,13 @@ class IMPATOMEXPORT Selection :
   //! Try to find this representation type
   void set_representation_type(RepresentationType t)
   { representation_type_ = t; }
+  //! Set whether the hierarchy index may be used to skip subtrees
+  /** The index is used by default, and the results are the same either
+      way. Turning it off avoids building an index that would only be
+      dropped again, for example if hierarchies are edited between most
+      queries. */
+  void set_use_index(bool tf) { use_index_ = tf; }
+  bool get_use_index() const { return use_index_; }
   //! Select State with the passed index.
   void set_state_index(int state) { set_state_indexes(Ints(1, state)); }
   //! Select State with the passed indexes.
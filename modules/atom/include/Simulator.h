@@ -13,6 +13,7 @@
 
 #include <IMP/Particle.h>
 #include <IMP/Optimizer.h>
+#include <IMP/ScoringFunction.h>
 #include <IMP/internal/units.h>
 #include <IMP/algebra/Vector3D.h>
 
@@ -30,6 +31,16 @@ class SimulationParameters;
    The simulation can be invoked directly by calling simulate(fs) for
    a given time in femtoseconds, or by calling Optimizer::optimize(nf)
    for a given number of frames.
+
+   _Multiple time steps_
+
+   Restraints that vary slowly (e.g. EM, SAXS or cross-link restraints)
+   can be put in a separate, slow, scoring function with
+   set_slow_scoring_function(). It is only evaluated every few steps,
+   while the optimizer's scoring function is evaluated every step. In
+   between, the forces from the last slow evaluation are either held and
+   added to every step, or applied as an impulse, scaled by the period,
+   on the steps where they are evaluated (as in the RESPA scheme).
  */
 class IMPATOMEXPORT Simulator : public Optimizer {
  public:
@@ -128,6 +139,41 @@ class IMPATOMEXPORT Simulator : public Optimizer {
   //! Sets the current simulation time in femtoseconds to ct.
   void set_current_time(double ct) { current_time_ = ct; }
 
+  /** \name Multiple time steps
+      @{
+  */
+  //! Evaluate sf every period steps, in addition to the scoring function
+  void set_slow_scoring_function(ScoringFunctionAdaptor sf,
+                                 unsigned int period);
+  //! Go back to evaluating only the optimizer's scoring function
+  void clear_slow_scoring_function() { slow_scoring_function_ = nullptr; }
+  //! Get the slow scoring function, or nullptr if there is none
+  ScoringFunction *get_slow_scoring_function() const {
+    return slow_scoring_function_;
+  }
+  //! Get how many steps are taken per slow evaluation
+  unsigned int get_slow_period() const { return slow_period_; }
+  //! Set whether slow forces are applied as impulses rather than held
+  void set_use_slow_force_impulses(bool tf) { slow_impulses_ = tf; }
+  bool get_use_slow_force_impulses() const { return slow_impulses_; }
+  /** @} */
+
+  /** \name Evaluation timings
+      The time in seconds spent in, and the number of, evaluations of the
+      optimizer's (fast) and the slow scoring functions by do_step().
+      @{
+  */
+  double get_fast_evaluation_time() const { return fast_time_; }
+  double get_slow_evaluation_time() const { return slow_time_; }
+  unsigned int get_number_of_fast_evaluations() const {
+    return number_of_fast_evaluations_;
+  }
+  unsigned int get_number_of_slow_evaluations() const {
+    return number_of_slow_evaluations_;
+  }
+  void reset_evaluation_timings();
+  /** @} */
+
   //! Returns the set of particles used in the simulation.
   /** If a non-empty
       set of particles was provided explicitly by earlier calls to the
@@ -207,12 +253,49 @@ class IMPATOMEXPORT Simulator : public Optimizer {
   virtual double do_simulate_wave(double time_in_fs, double max_time_step_factor = 10.0,
                           double base = 1.5);
 
+  //! Evaluate the score and derivatives for the current step
+  /** This evaluates the optimizer's scoring function with derivatives
+      and, if there is a slow scoring function, adds the slow forces on
+      the particles in ps, evaluating them again if they are due this
+      step. Subclasses should call it rather than evaluating the
+      scoring function themselves.
+
+      Each call counts as a new step, including the one made by setup(),
+      unless same_step is true. That is for a second evaluation within
+      a step whose forces are averaged with the first one, such as the
+      corrector of a stochastic Runge Kutta step. It does not evaluate
+      the slow scoring function, and adds the same slow forces, or
+      impulse, as the first evaluation of the step.
+
+      @return the score (including the last slow score)
+   */
+  double evaluate_forces(const ParticleIndexes &ps, bool same_step = false);
+
  private:
   double temperature_;
   double max_time_step_;
   double current_time_;
   double last_time_step_;
   double wave_factor_;  // if >1.0, use simulate_wave() from do_optimize()
+  PointerMember<ScoringFunction> slow_scoring_function_;
+  unsigned int slow_period_;
+  bool slow_impulses_;
+  // new steps evaluated by evaluate_forces() in the current simulation
+  unsigned int force_step_;
+  // whether the slow forces were due at the last new step
+  bool slow_step_;
+  bool have_slow_forces_;
+  double slow_score_;
+  ParticleIndexes slow_pis_;
+  algebra::Vector3Ds slow_derivatives_;
+  ParticleIndexes slow_rigid_bodies_;
+  algebra::Vector3Ds slow_torques_;
+  double fast_time_, slow_time_;
+  unsigned int number_of_fast_evaluations_, number_of_slow_evaluations_;
+
+  void update_slow_forces(const ParticleIndexes &ps);
+  void start_steps();
+  double get_final_score() const;
 };
 
 IMP_OBJECTS(Simulator, Simulators);
@@ -0,0 +1,96 @@
+/**
+ *  \file IMP/atom/internal/SelectionIndex.h
+ *  \brief An index of a hierarchy used to speed up Selection.
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ */
+
+#ifndef IMPATOM_SELECTION_INDEX_H
+#define IMPATOM_SELECTION_INDEX_H
+
+#include <IMP/atom/atom_config.h>
+#include <IMP/Object.h>
+#include <IMP/Model.h>
+#include <IMP/Pointer.h>
+#include <IMP/types.h>
+
+IMPATOM_BEGIN_INTERNAL_NAMESPACE
+
+//! A preorder index of every node a Selection search can reach
+/** Nodes are numbered in depth first order, with the alternative
+    representations of a Representation node placed where the node itself
+    sits, so the subtree of the node at position p is the position range
+    [p, get_end(p)). The positions of nodes of the types Selection predicates
+    look at (molecules, chains, copies, states, and residues, fragments and
+    domains) are kept in sorted lists, so a predicate can be turned into
+    the ranges of the subtrees it could match in by filtering one list.
+
+    Only the structure and decorator types are cached; names, indexes and
+    other values are read from the Model whenever a Selection uses the index.
+    \see get_selection_index()
+ */
+class IMPATOMEXPORT SelectionIndex : public Object {
+  Vector<int> positions_;
+  ParticleIndexes nodes_;
+  Ints ends_;
+  Ints molecules_, chains_, copies_, states_, residues_, domains_;
+  bool usable_;
+
+  void add_node(Model *m, ParticleIndex pi);
+  void add_subtree(Model *m, ParticleIndex pi);
+  void add_expanded(Model *m, ParticleIndex pi);
+
+ public:
+  SelectionIndex(Model *m, ParticleIndex root);
+
+  //! Return false if some node can be reached by more than one path
+  bool get_is_usable() const { return usable_; }
+
+  //! Return the position of the node, or -1 if it is not indexed
+  int get_position(ParticleIndex pi) const {
+    unsigned int i = pi.get_index();
+    return i < positions_.size() ? positions_[i] : -1;
+  }
+  //! Return one past the position of the last descendant of pos
+  int get_end(int pos) const { return ends_[pos]; }
+  ParticleIndex get_node(int pos) const { return nodes_[pos]; }
+
+  const Ints &get_molecules() const { return molecules_; }
+  const Ints &get_chains() const { return chains_; }
+  const Ints &get_copies() const { return copies_; }
+  const Ints &get_states() const { return states_; }
+  //! Residue, Fragment and Domain nodes
+  const Ints &get_residues() const { return residues_; }
+  const Ints &get_domains() const { return domains_; }
+
+  //! Return the merged subtree ranges of the given sorted positions
+  IntRanges get_ranges(const Ints &positions) const;
+
+  //! Return true if the subtree of pi overlaps one of the sorted ranges
+  /** Nodes that are not in the index always overlap. */
+  bool get_overlaps(ParticleIndex pi, const IntRanges &ranges) const;
+
+  IMP_OBJECT_METHODS(SelectionIndex);
+};
+
+IMP_OBJECTS(SelectionIndex, SelectionIndexes);
+
+//! Return the ranges common to two sorted lists of disjoint ranges
+IMPATOMEXPORT IntRanges get_intersection(const IntRanges &a,
+                                         const IntRanges &b);
+
+//! Return the index of the hierarchy rooted at root, or nullptr
+/** Indexes are cached per hierarchy and dropped whenever any hierarchy is
+    edited (a child added or removed, a representation added, or a node
+    set up as a Molecule, Chain, Copy, State, Residue, Fragment or Domain; see
+    core::internal::get_hierarchy_edit_count()). So that hierarchies under
+    construction do not pay for an index on every query, an index is only
+    built the second time it is asked for without an edit in between;
+    nullptr is returned until then, and if the hierarchy cannot be indexed.
+ */
+IMPATOMEXPORT Pointer<SelectionIndex> get_selection_index(Model *m,
+                                                          ParticleIndex root);
+
+IMPATOM_END_INTERNAL_NAMESPACE
+
+#endif /* IMPATOM_SELECTION_INDEX_H */
@@ -0,0 +1,29 @@
+/**
+ *  \file IMP/atom/internal/coulomb.h
+ *  \brief Constants for Coulomb (electrostatic) scores.
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ */
+
+#ifndef IMPATOM_INTERNAL_COULOMB_H
+#define IMPATOM_INTERNAL_COULOMB_H
+
+#include <IMP/atom/atom_config.h>
+#include <IMP/constants.h>
+
+IMPATOM_BEGIN_INTERNAL_NAMESPACE
+
+//! Return 1 / (4pi * epsilon) in kcal/mol Angstrom per squared electron charge
+inline double get_coulomb_factor(double relative_dielectric) {
+  static const double avogadro = 6.02214179e23;               // /mole
+  static const double electron_charge = 1.6021892e-19;        // Coulomb
+  static const double permittivity_vacuum = 8.854187818e-12;  // C/V/m
+  static const double kcal2joule = 4186.8;
+
+  return avogadro * electron_charge * electron_charge * 1.0e10 /
+         permittivity_vacuum / kcal2joule / (4.0 * PI * relative_dielectric);
+}
+
+IMPATOM_END_INTERNAL_NAMESPACE
+
+#endif /* IMPATOM_INTERNAL_COULOMB_H */
@@ -593,6 +593,86 @@ IMPATOMEXPORT Hierarchies
 #endif
                         );
 
+//! Read many models from a multimodel PDB file
+/** The whole file is read into memory once and split on MODEL records.
+    The ATOM/HETATM serial numbers and coordinates of all models are
+    parsed, in parallel if threads are available, into one flat table.
+
+    A hierarchy for any model can then be built with read_hierarchy(),
+    which parses that model's text again as read_pdb() does, so is no
+    faster than it. Much more cheaply, the coordinates of a hierarchy that
+    was read from one model can be replaced with those of another by
+    set_coordinates(), without creating any particles. As with
+    read_pdb(TextInput, int, Hierarchy), atoms are matched on their
+    serial numbers and rigid bodies are moved to fit their members.
+
+    A file without MODEL records is treated as a single model.
+*/
+class IMPATOMEXPORT PDBModelsReader : public IMP::Object {
+  std::string input_name_;
+  std::string buffer_;
+  // [begin, end) offsets in buffer_ of each model, and its MODEL number
+  Vector<std::pair<std::size_t, std::size_t> > model_ranges_;
+  Ints model_indexes_;
+  // atom records of model i are [atom_offsets_[i], atom_offsets_[i + 1])
+  Vector<std::size_t> atom_offsets_;
+  Ints serials_;
+  algebra::Vector3Ds coordinates_;
+  // atoms of the last hierarchy passed to set_coordinates(), by serial
+  WeakPointer<Model> mapped_model_;
+  ParticleIndex mapped_root_;
+  unsigned int mapped_edit_count_;
+  ParticleIndexes atoms_by_serial_;
+  ParticleIndexes mapped_atoms_;
+  Vector<std::pair<ParticleIndex, ParticleIndexes> > rigid_bodies_;
+
+  void split_models();
+  void parse_models();
+  void parse_model_atoms(unsigned int i, bool fill);
+  void update_atom_map(Hierarchy h);
+
+ public:
+  PDBModelsReader(TextInput input);
+
+  unsigned int get_number_of_models() const { return model_ranges_.size(); }
+
+  //! Get the number in the MODEL record of the ith model
+  int get_model_index(unsigned int i) const {
+    IMP_USAGE_CHECK(i < model_indexes_.size(), "No model " << i);
+    return model_indexes_[i];
+  }
+
+  //! Get the number of ATOM/HETATM records in the ith model
+  unsigned int get_number_of_atoms(unsigned int i) const {
+    IMP_USAGE_CHECK(i < model_ranges_.size(), "No model " << i);
+    return atom_offsets_[i + 1] - atom_offsets_[i];
+  }
+
+  //! Get the coordinates of all ATOM/HETATM records of the ith model
+  /** They are in the order they appear in the file. */
+  algebra::Vector3Ds get_coordinates(unsigned int i) const;
+
+  //! Build a hierarchy for the ith model, as read_pdb() would
+  Hierarchy read_hierarchy(unsigned int i, Model *model,
+                           PDBSelector *selector = get_default_pdb_selector(),
+                           bool no_radii = false) const;
+
+  //! Set the coordinates of the atoms in h to those in the ith model
+  /** The mapping from serial numbers to atoms is kept for the last
+      hierarchy passed, so repeatedly loading models into the same
+      hierarchy only costs a pass over the model's atoms. The mapping is
+      rebuilt after any hierarchy is edited (as atoms may have been added
+      to or removed from h); call clear_caches() if atom serial numbers
+      are changed.
+  */
+  void set_coordinates(unsigned int i, Hierarchy h);
+
+  //! Forget the atoms of the last hierarchy passed to set_coordinates()
+  void clear_caches();
+
+  IMP_OBJECT_METHODS(PDBModelsReader);
+};
+
 /** @name PDB Writing
     \anchor pdb_out
     The methods to write a PDB expects a Hierarchy that looks as follows:
@@ -13,6 +13,7 @@
 #include <IMP/base_types.h>
 #include <IMP/Object.h>
 #include <IMP/object_macros.h>
+#include <algorithm>
 
 IMPATOM_BEGIN_NAMESPACE
 
@@ -104,6 +105,27 @@ class IMPATOMEXPORT ForceSwitch : public SmoothingFunction {
     deriv_prefactor_ = 6.0 * value_prefactor_;
   }
 
+  double get_min_distance() const { return min_distance_; }
+  double get_max_distance() const { return max_distance_; }
+
+#ifndef SWIG
+  //! Get the switch factor and its derivative at a distance within the switch
+  /** The distance must be no greater than get_max_distance(). Shorter
+      distances are clamped to get_min_distance(), where the factor is one
+      and its derivative zero, rather than tested. So this has no branches,
+      and kernels that have already dropped pairs beyond the maximum
+      distance can inline it.
+   */
+  inline void get_value_and_deriv_within_max(double distance, double &value,
+                                             double &deriv) const {
+    double clamped = std::max(distance, min_distance_);
+    double d = max_distance_ - clamped;
+    value = value_prefactor_ * d * d *
+            (max_distance_ + 2.0 * clamped - 3.0 * min_distance_);
+    deriv = deriv_prefactor_ * d * (min_distance_ - clamped);
+  }
+#endif
+
   double operator()(double score, double distance) const override {
     double factor = get_value(distance);
     return score * factor;
@@ -43,7 +43,8 @@ BrownianDynamics::BrownianDynamics(Model *m, std::string name,
       max_step_in_A_(std::numeric_limits<double>::max()),
       srk_(false),
       random_pool_(random_pool_size),
-      i_random_pool_(0)
+      i_random_pool_(0),
+      fused_(false)
 {
   reset_random_pool();
 }
@@ -145,6 +146,27 @@ void BrownianDynamics::setup(const ParticleIndexes &ips) {
     IMP_LOG_TERSE("Maximum force is " << mf << std::endl);
   }
   forces_.resize(ips.size());
+  if (fused_) {
+    gather_particle_data(ips);
+  } else {
+    // so that turning the fused kernel on later gathers the data again
+    random_offset_.clear();
+  }
+}
+
+void BrownianDynamics::gather_particle_data(const ParticleIndexes &ps) {
+  Model *m = get_model();
+  fused_ps_ = ps;
+  diffusion_.resize(ps.size());
+  is_rigid_body_.resize(ps.size());
+  random_offset_.resize(ps.size() + 1);
+  random_offset_[0] = 0;
+  for (unsigned int i = 0; i < ps.size(); ++i) {
+    diffusion_[i] = Diffusion(m, ps[i]).get_diffusion_coefficient();
+    is_rigid_body_[i] = RigidBodyDiffusion::get_is_setup(m, ps[i]);
+    // a displacement, plus an angle and an axis for rigid bodies
+    random_offset_[i + 1] = random_offset_[i] + (is_rigid_body_[i] ? 7 : 3);
+  }
 }
 IMP_GCC_DISABLE_WARNING(-Wuninitialized)
 
@@ -211,15 +233,22 @@ void BrownianDynamics::advance_coordinates_0(ParticleIndex pi,
 
 void BrownianDynamics::advance_orientation_0(ParticleIndex pi,
                                              double dtfs, double ikT) {
-  core::RigidBody rb(get_model(), pi);
   // Note - 6*dr*dtfs*N(0,1) for sigma is an approximation. the real angle should be 2*X where
   // X is a random variable drawn from the Chi2 distribution with 3 dofs
   // (corresponding to each of the 3 rotational dofs)
   double sigma = get_rotational_sigma_total(get_model(), pi, dtfs);
   double angle = get_sample(sigma);
+  advance_orientation(pi, dtfs, ikT, angle,
+                      algebra::get_random_vector_on_unit_sphere());
+}
+
+//! rotate rigid body pi by angle about axis, and then by the torque
+void BrownianDynamics::advance_orientation(ParticleIndex pi, double dtfs,
+                                           double ikT, double angle,
+                                           const algebra::Vector3D &axis) {
+  core::RigidBody rb(get_model(), pi);
   algebra::Transformation3D nt =
       rb.get_reference_frame().get_transformation_to();
-  algebra::Vector3D axis = algebra::get_random_vector_on_unit_sphere();
   algebra::Rotation3D rrot = algebra::get_rotation_about_axis(axis, angle);
   nt = nt * rrot;
   algebra::Vector3D torque(get_torque(get_model(), pi, 0, dtfs, ikT),
@@ -266,6 +295,47 @@ BrownianDynamics::do_advance_chunk
   }
 }
 
+void BrownianDynamics::advance_chunk_fused(double dtfs, double ikT,
+                                           const ParticleIndexes &ps,
+                                           unsigned int begin,
+                                           unsigned int end) {
+  IMP_LOG_TERSE("Advancing particles " << begin << " to " << end << std::endl);
+  Model *m = get_model();
+  const double sqrt_2dt = std::sqrt(2.0 * dtfs);
+  const double force_scale = -dtfs * ikT;
+  algebra::Sphere3D *spheres = m->access_spheres_data();
+  const algebra::Sphere3D *sphere_derivatives =
+      m->access_sphere_derivatives_data();
+  for (unsigned int i = begin; i < end; ++i) {
+    ParticleIndex pi = ps[i];
+    // only this particle's slice of the step's samples is used, so
+    // chunks running in parallel never share a random number source
+    const double *random = &step_random_[random_offset_[i]];
+    if (is_rigid_body_[i]) {
+      double sigma = get_rotational_sigma_total(m, pi, dtfs);
+      // normalized Gaussian vectors are uniform on the unit sphere
+      algebra::Vector3D axis(random[4], random[5], random[6]);
+      double mag = axis.get_magnitude();
+      axis = mag > 0 ? axis / mag : algebra::Vector3D(1, 0, 0);
+      advance_orientation(pi, dtfs, ikT, sigma * random[3], axis);
+    }
+    algebra::Sphere3D &xyzr = spheres[pi.get_index()];
+    const algebra::Sphere3D &dxyzr = sphere_derivatives[pi.get_index()];
+    double sigma = sqrt_2dt * std::sqrt(diffusion_[i]);
+    algebra::Vector3D force_dX =
+        (force_scale * diffusion_[i]) * dxyzr.get_center();
+    algebra::Vector3D dX(sigma * random[0], sigma * random[1],
+                         sigma * random[2]);
+    dX += force_dX;
+    if (srk_) {
+      forces_[i] = force_dX;
+    } else {
+      check_dX(dX, max_step_in_A_);
+    }
+    xyzr = algebra::Sphere3D(xyzr.get_center() + dX, xyzr.get_radius());
+  }
+}
+
 //! regenerate pool of random numbers
 void
 BrownianDynamics::reset_random_pool()
@@ -284,13 +354,41 @@ BrownianDynamics::do_step
 (const ParticleIndexes &ps, double dt_fs)
 {
   double ikT = 1.0 / get_kt();
-  get_scoring_function()->evaluate(true);
+  evaluate_forces(ps);
   //  Ek = 0.0; // DEBUG: monitor kinetic energy
   //  M = 0.0; // DEBUG: monitor kinetic energy
   /* Modern clang requires that we explicitly share constants, but older
      clang reports an error if we try to do so */
   const unsigned int chunk_size = 5000;
+  if (fused_) {
+    // setup() gathers the data for the particles passed to do_step();
+    // only regather if the kernel was turned on after setup()
+    if (random_offset_.size() != ps.size() + 1) {
+      gather_particle_data(ps);
+    }
+    IMP_INTERNAL_CHECK(ps == fused_ps_,
+                       "Particles changed since setup() was called");
+    get_random_numbers_normal(step_random_, random_offset_.back(), 0.0, 1.0);
+  }
   for (unsigned int b = 0; b < ps.size(); b += chunk_size) {
+    if (fused_) {
+#if defined(__clang__) && __clang_major__ >= 10
+      IMP_TASK_SHARED(
+          (dt_fs, ikT, b), (ps, chunk_size),
+          advance_chunk_fused(dt_fs, ikT, ps, b,
+                              std::min<unsigned int>(b + chunk_size,
+                                                     ps.size()));
+          , "brownian");
+#else
+      IMP_TASK_SHARED(
+          (dt_fs, ikT, b), (ps),
+          advance_chunk_fused(dt_fs, ikT, ps, b,
+                              std::min<unsigned int>(b + chunk_size,
+                                                     ps.size()));
+          , "brownian");
+#endif
+      continue;
+    }
 #if defined(__clang__) && __clang_major__ >= 10
     IMP_TASK_SHARED(
         (dt_fs, ikT, b), (ps, chunk_size),
@@ -305,7 +403,7 @@ BrownianDynamics::do_step
         , "brownian");
 #endif
   }
-  IMP_OMP_PRAGMA(taskwait)
+  IMP_TASKWAIT
   IMP_OMP_PRAGMA(flush)
 
     // DEBUG: monitor kinetic energy
@@ -314,7 +412,7 @@ BrownianDynamics::do_step
     //            << std::endl;
 
   if (srk_) {
-    get_scoring_function()->evaluate(true);
+    evaluate_forces(ps, true);
     for (unsigned int i = 0; i < ps.size(); ++i) {
       advance_coordinates_1(ps[i], i, dt_fs, ikT);
     }
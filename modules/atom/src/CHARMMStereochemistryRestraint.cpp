@@ -146,14 +146,50 @@ ModelObjectsTemp CHARMMStereochemistryRestraint::do_get_inputs() const {
   return ps;
 }
 
-StereochemistryPairFilter *CHARMMStereochemistryRestraint::get_pair_filter() {
+StereochemistryPairFilter *CHARMMStereochemistryRestraint::get_pair_filter(
+    bool exclude_dihedrals) {
   IMP_NEW(StereochemistryPairFilter, pf, ());
   pf->set_bonds(bonds_);
   pf->set_angles(angles_);
-  pf->set_dihedrals(dihedrals_);
+  if (exclude_dihedrals) {
+    pf->set_dihedrals(dihedrals_);
+  }
   return pf.release();
 }
 
+namespace {
+ParticleIndexPair get_ordered_pair(Particle *p0, Particle *p1) {
+  ParticleIndex i0 = p0->get_index(), i1 = p1->get_index();
+  return i0 < i1 ? ParticleIndexPair(i0, i1) : ParticleIndexPair(i1, i0);
+}
+}
+
+ParticleIndexPairs CHARMMStereochemistryRestraint::get_14_pairs() const {
+  std::set<ParticleIndexPair> excluded;
+  for (Particles::const_iterator tb = bonds_.begin(); tb != bonds_.end();
+       ++tb) {
+    Bond b(*tb);
+    excluded.insert(get_ordered_pair(b.get_bonded(0).get_particle(),
+                                     b.get_bonded(1).get_particle()));
+  }
+  for (Particles::const_iterator ta = angles_.begin();
+       ta != angles_.end(); ++ta) {
+    Angle a(*ta);
+    excluded.insert(get_ordered_pair(a.get_particle(0), a.get_particle(2)));
+  }
+  ParticleIndexPairs ret;
+  for (Particles::const_iterator td = dihedrals_.begin();
+       td != dihedrals_.end(); ++td) {
+    Dihedral d(*td);
+    ParticleIndexPair pp = get_ordered_pair(d.get_particle(0),
+                                            d.get_particle(3));
+    if (excluded.insert(pp).second) {
+      ret.push_back(pp);
+    }
+  }
+  return ret;
+}
+
 StereochemistryPairFilter *CHARMMStereochemistryRestraint::get_full_pair_filter() {
   IMP_NEW(StereochemistryPairFilter, pf, ());
   pf->set_bonds(full_bonds_);
@@ -8,6 +8,7 @@
 #include <IMP/atom/CoulombPairScore.h>
 #include <IMP/atom/smoothing_functions.h>
 #include <IMP/atom/Charged.h>
+#include <IMP/atom/internal/coulomb.h>
 #include <IMP/constants.h>
 
 IMPATOM_BEGIN_NAMESPACE
@@ -15,14 +16,7 @@ IMPATOM_BEGIN_NAMESPACE
 void CoulombPairScore::calculate_multiplication_factor() {
   // 1 / (4pi * epsilon) * conversion factor to get score in kcal/mol if
   // distances are in angstroms
-  static const double avogadro = 6.02214179e23;               // /mole
-  static const double electron_charge = 1.6021892e-19;        // Coulomb
-  static const double permittivity_vacuum = 8.854187818e-12;  // C/V/m
-  static const double kcal2joule = 4186.8;
-
-  multiplication_factor_ = avogadro * electron_charge * electron_charge *
-                           1.0e10 / permittivity_vacuum / kcal2joule /
-                           (4.0 * PI * relative_dielectric_);
+  multiplication_factor_ = internal::get_coulomb_factor(relative_dielectric_);
 }
 
 double CoulombPairScore::evaluate_index(Model *m,
@@ -0,0 +1,271 @@
+/**
+ *  \file LennardJonesCoulombPairScore.cpp
+ *  \brief Combined Lennard-Jones and Coulomb score with a force switch.
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ */
+
+#include <IMP/atom/LennardJonesCoulombPairScore.h>
+#include <IMP/atom/LennardJones.h>
+#include <IMP/atom/Charged.h>
+#include <IMP/atom/internal/coulomb.h>
+#include <IMP/core/XYZR.h>
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+IMPATOM_BEGIN_NAMESPACE
+
+namespace {
+// number of pairs gathered before the arithmetic is done
+const unsigned int block_size = 64;
+
+/* The switched score of one pair, and its derivative divided by the
+   distance (so that multiplying by the delta vector gives the force).
+   Callers only pass pairs within the maximum distance of the switch. */
+inline void get_switched_score(const ForceSwitch *sf, double dist2, double a,
+                               double b, double qq, double &score,
+                               double &deriv_over_dist) {
+  double dist = std::sqrt(dist2);
+  double inv_dist = 1.0 / dist;
+  double inv_dist2 = inv_dist * inv_dist;
+  double inv_dist6 = inv_dist2 * inv_dist2 * inv_dist2;
+  double repulsive = a * inv_dist6 * inv_dist6;
+  double attractive = b * inv_dist6;
+  double coulomb = qq * inv_dist;
+  double unswitched = repulsive - attractive + coulomb;
+  double deriv =
+      (6.0 * attractive - 12.0 * repulsive - coulomb) * inv_dist;
+  double factor, deriv_factor;
+  sf->get_value_and_deriv_within_max(dist, factor, deriv_factor);
+  score = unswitched * factor;
+  deriv_over_dist = (unswitched * deriv_factor + deriv * factor) * inv_dist;
+}
+}
+
+LennardJonesCoulombPairScore::LennardJonesCoulombPairScore(ForceSwitch *f)
+    : PairScore("LennardJonesCoulombPairScore%1%"),
+      smoothing_function_(f),
+      repulsive_weight_(1.0),
+      attractive_weight_(1.0),
+      lj_14_scale_(1.0),
+      coulomb_14_scale_(1.0) {
+  set_relative_dielectric(1.0);
+}
+
+void LennardJonesCoulombPairScore::set_relative_dielectric(
+    double relative_dielectric) {
+  relative_dielectric_ = relative_dielectric;
+  coulomb_factor_ = internal::get_coulomb_factor(relative_dielectric);
+}
+
+void LennardJonesCoulombPairScore::set_particles(Model *m,
+                                                 ParticleIndexesAdaptor ps) {
+  particles_ = ps;
+  update_parameters(m);
+}
+
+void LennardJonesCoulombPairScore::update_parameters(Model *m) {
+  int max_index = 0;
+  for (ParticleIndex pi : particles_) {
+    max_index = std::max(max_index, pi.get_index());
+  }
+  types_ = Ints(particles_.empty() ? 0 : max_index + 1, -1);
+  charges_ = Floats(types_.size(), 0.);
+  type_well_depths_.clear();
+  type_radii_.clear();
+  std::map<std::pair<double, double>, int> type_map;
+  for (ParticleIndex pi : particles_) {
+    IMP_USAGE_CHECK(core::XYZR::get_is_setup(m, pi),
+                    "Particle " << m->get_particle_name(pi)
+                                << " is not an XYZR particle");
+    double well_depth = LennardJones::get_is_setup(m, pi)
+                            ? LennardJones(m, pi).get_well_depth() : 0.;
+    double radius = core::XYZR(m, pi).get_radius();
+    std::pair<double, double> key(well_depth, radius);
+    std::map<std::pair<double, double>, int>::const_iterator it =
+        type_map.find(key);
+    if (it == type_map.end()) {
+      it = type_map.insert(std::make_pair(key, type_well_depths_.size()))
+               .first;
+      type_well_depths_.push_back(well_depth);
+      type_radii_.push_back(radius);
+    }
+    types_[pi.get_index()] = it->second;
+    if (Charged::get_is_setup(m, pi)) {
+      charges_[pi.get_index()] = Charged(m, pi).get_charge();
+    }
+  }
+  IMP_LOG_TERSE("Found " << type_well_depths_.size()
+                << " Lennard-Jones types for " << particles_.size()
+                << " particles" << std::endl);
+  update_factors();
+}
+
+void LennardJonesCoulombPairScore::update_factors() {
+  // the same combination rules as LennardJonesPairScore, once per type pair
+  unsigned int ntypes = type_well_depths_.size();
+  a_.resize(ntypes * ntypes);
+  b_.resize(ntypes * ntypes);
+  for (unsigned int i = 0; i < ntypes; ++i) {
+    for (unsigned int j = 0; j < ntypes; ++j) {
+      double well_depth =
+          std::sqrt(type_well_depths_[i] * type_well_depths_[j]);
+      double rmin = type_radii_[i] + type_radii_[j];
+      double rmin6 = rmin * rmin * rmin * rmin * rmin * rmin;
+      double rmin12 = rmin6 * rmin6;
+      a_[i * ntypes + j] = well_depth * rmin12 * repulsive_weight_;
+      b_[i * ntypes + j] = 2.0 * well_depth * rmin6 * attractive_weight_;
+    }
+  }
+}
+
+void LennardJonesCoulombPairScore::set_14_pairs(
+    const ParticleIndexPairs &pairs) {
+  int max_index = -1;
+  for (const ParticleIndexPair &pp : pairs) {
+    max_index = std::max(max_index, std::get<0>(pp).get_index());
+    max_index = std::max(max_index, std::get<1>(pp).get_index());
+  }
+  partner_offsets_ = Vector<unsigned int>(max_index + 2, 0);
+  for (const ParticleIndexPair &pp : pairs) {
+    ++partner_offsets_[std::get<0>(pp).get_index() + 1];
+    ++partner_offsets_[std::get<1>(pp).get_index() + 1];
+  }
+  for (unsigned int i = 1; i < partner_offsets_.size(); ++i) {
+    partner_offsets_[i] += partner_offsets_[i - 1];
+  }
+  partners_.resize(2 * pairs.size());
+  Vector<unsigned int> next(partner_offsets_.begin(),
+                            partner_offsets_.end() - 1);
+  for (const ParticleIndexPair &pp : pairs) {
+    partners_[next[std::get<0>(pp).get_index()]++] = std::get<1>(pp);
+    partners_[next[std::get<1>(pp).get_index()]++] = std::get<0>(pp);
+  }
+}
+
+bool LennardJonesCoulombPairScore::get_is_14_pair(ParticleIndex p0,
+                                                  ParticleIndex p1) const {
+  unsigned int i = p0.get_index();
+  if (i + 1 >= partner_offsets_.size()) return false;
+  // each atom has only a handful of 1-4 partners
+  for (unsigned int j = partner_offsets_[i]; j < partner_offsets_[i + 1];
+       ++j) {
+    if (partners_[j] == p1) return true;
+  }
+  return false;
+}
+
+double LennardJonesCoulombPairScore::evaluate_index(
+    Model *m, const ParticleIndexPair &p, DerivativeAccumulator *da) const {
+  ParticleIndex p0 = std::get<0>(p), p1 = std::get<1>(p);
+  IMP_USAGE_CHECK(static_cast<unsigned int>(p0.get_index()) < types_.size()
+                  && types_[p0.get_index()] >= 0
+                  && static_cast<unsigned int>(p1.get_index()) < types_.size()
+                  && types_[p1.get_index()] >= 0,
+                  "Parameters were not gathered for the pair " << p
+                  << "; call set_particles() first");
+  const Model *cm = m;
+  algebra::Vector3D delta = cm->get_sphere(p0).get_center()
+                            - cm->get_sphere(p1).get_center();
+  double dist2 = delta.get_squared_magnitude();
+  double max_distance = smoothing_function_->get_max_distance();
+  if (dist2 > max_distance * max_distance) return 0.;
+  unsigned int t = types_[p0.get_index()] * type_well_depths_.size()
+                   + types_[p1.get_index()];
+  double lj_scale = 1.0, qq = coulomb_factor_ * charges_[p0.get_index()]
+                              * charges_[p1.get_index()];
+  if (get_is_14_pair(p0, p1)) {
+    lj_scale = lj_14_scale_;
+    qq *= coulomb_14_scale_;
+  }
+  double score, deriv_over_dist;
+  get_switched_score(smoothing_function_, dist2, a_[t] * lj_scale,
+                     b_[t] * lj_scale, qq, score, deriv_over_dist);
+  if (da) {
+    algebra::Vector3D deriv = deriv_over_dist * delta;
+    m->add_to_coordinate_derivatives(p0, deriv, *da);
+    m->add_to_coordinate_derivatives(p1, -deriv, *da);
+  }
+  return score;
+}
+
+double LennardJonesCoulombPairScore::evaluate_indexes(
+    Model *m, const ParticleIndexPairs &p, DerivativeAccumulator *da,
+    unsigned int lower_bound, unsigned int upper_bound) const {
+  const algebra::Sphere3D *spheres =
+      static_cast<const Model *>(m)->access_spheres_data();
+  const ForceSwitch *sf = smoothing_function_;
+  const double max_distance = sf->get_max_distance();
+  const double cutoff2 = max_distance * max_distance;
+  const unsigned int ntypes = type_well_depths_.size();
+  const bool have_14 = !partners_.empty();
+  double ret = 0.;
+  unsigned int pair_index[block_size];
+  double dx[block_size], dy[block_size], dz[block_size];
+  double dist2[block_size], a[block_size], b[block_size], qq[block_size];
+  double score[block_size], deriv[block_size];
+  for (unsigned int begin = lower_bound; begin < upper_bound;
+       begin += block_size) {
+    unsigned int end = std::min(begin + block_size, upper_bound);
+    // gather the pairs inside the cutoff and their parameters
+    unsigned int n = 0;
+    for (unsigned int i = begin; i < end; ++i) {
+      ParticleIndex p0 = std::get<0>(p[i]), p1 = std::get<1>(p[i]);
+      IMP_USAGE_CHECK(
+          static_cast<unsigned int>(p0.get_index()) < types_.size()
+          && types_[p0.get_index()] >= 0
+          && static_cast<unsigned int>(p1.get_index()) < types_.size()
+          && types_[p1.get_index()] >= 0,
+          "Parameters were not gathered for the pair " << p[i]
+          << "; call set_particles() first");
+      algebra::Vector3D delta = spheres[p0.get_index()].get_center()
+                                - spheres[p1.get_index()].get_center();
+      double d2 = delta.get_squared_magnitude();
+      if (d2 > cutoff2) continue;
+      unsigned int t = types_[p0.get_index()] * ntypes
+                       + types_[p1.get_index()];
+      double lj_scale = 1.0, coulomb_scale = coulomb_factor_;
+      if (have_14 && get_is_14_pair(p0, p1)) {
+        lj_scale = lj_14_scale_;
+        coulomb_scale *= coulomb_14_scale_;
+      }
+      pair_index[n] = i;
+      dx[n] = delta[0];
+      dy[n] = delta[1];
+      dz[n] = delta[2];
+      dist2[n] = d2;
+      a[n] = a_[t] * lj_scale;
+      b[n] = b_[t] * lj_scale;
+      qq[n] = coulomb_scale * charges_[p0.get_index()]
+              * charges_[p1.get_index()];
+      ++n;
+    }
+    // the arithmetic, with no lookups or branches, over contiguous arrays
+    for (unsigned int k = 0; k < n; ++k) {
+      get_switched_score(sf, dist2[k], a[k], b[k], qq[k], score[k],
+                         deriv[k]);
+    }
+    for (unsigned int k = 0; k < n; ++k) {
+      ret += score[k];
+    }
+    if (da) {
+      for (unsigned int k = 0; k < n; ++k) {
+        algebra::Vector3D d(deriv[k] * dx[k], deriv[k] * dy[k],
+                            deriv[k] * dz[k]);
+        m->add_to_coordinate_derivatives(std::get<0>(p[pair_index[k]]), d,
+                                         *da);
+        m->add_to_coordinate_derivatives(std::get<1>(p[pair_index[k]]), -d,
+                                         *da);
+      }
+    }
+  }
+  return ret;
+}
+
+ModelObjectsTemp LennardJonesCoulombPairScore::do_get_inputs(
+    Model *m, const ParticleIndexes &pis) const {
+  return IMP::get_particles(m, pis);
+}
+
+IMPATOM_END_NAMESPACE
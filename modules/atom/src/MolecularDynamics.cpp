@@ -61,7 +61,7 @@ bool MolecularDynamics::get_is_simulation_particle(ParticleIndex pi)
 
 void MolecularDynamics::setup(const ParticleIndexes &ps) {
   // Get starting score and derivatives, for first dynamics step velocities
-  get_scoring_function()->evaluate(true);
+  evaluate_forces(ps);
 
   setup_degrees_of_freedom(ps);
 }
@@ -90,7 +90,7 @@ double MolecularDynamics::do_step(const ParticleIndexes &ps,
   propagate_coordinates(ps, ts);
 
   // Get derivatives at t+(delta t)
-  get_scoring_function()->evaluate(true);
+  evaluate_forces(ps);
 
   // Get velocities at t+(delta t)
   propagate_velocities(ps, ts);
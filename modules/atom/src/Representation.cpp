@@ -9,6 +9,7 @@
 #include <IMP/atom/Atom.h>
 #include <IMP/atom/Mass.h>
 #include <IMP/core/Gaussian.h>
+#include <IMP/core/internal/hierarchy_helpers.h>
 #include <IMP/log.h>
 
 #include <boost/unordered_map.hpp>
@@ -183,6 +184,8 @@ void Representation::add_representation(ParticleIndexAdaptor rep,
     get_model()->add_attribute(get_resolutions_key(), get_particle_index(),
                                Floats(1, resolution));
   }
+  // the new representation is part of the hierarchy as seen by Selection
+  core::internal::add_hierarchy_edit();
 }
 
 Floats Representation::get_resolutions(RepresentationType type) const {
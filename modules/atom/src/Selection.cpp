@@ -254,7 +254,8 @@ void Selection::init_predicate() {
   predicate_ = and_predicate_;
 }
 
-Selection::Selection() : resolution_(0),representation_type_(BALLS) {
+Selection::Selection()
+    : resolution_(0), representation_type_(BALLS), use_index_(true) {
   init_predicate();
   m_ = nullptr;
 }
@@ -265,6 +266,7 @@ Selection Selection::create_clone() {
   s.h_ = h_;
   s.resolution_ = resolution_;
   s.representation_type_ = representation_type_;
+  s.use_index_ = use_index_;
   s.predicate_ = dynamic_cast<internal::ListSelectionPredicate*>
                          (predicate_->clone(true));
   IMP_INTERNAL_CHECK(s.predicate_, "Clone failed");
@@ -272,22 +274,24 @@ Selection Selection::create_clone() {
   return s;
 }
 
-Selection::Selection(Particle *h) : resolution_(0),representation_type_(BALLS) {
+Selection::Selection(Particle *h)
+    : resolution_(0), representation_type_(BALLS), use_index_(true) {
   init_predicate();
   set_hierarchies(h->get_model(), ParticleIndexes(1, h->get_index()));
 }
-Selection::Selection(Hierarchy h) : resolution_(0),representation_type_(BALLS) {
+Selection::Selection(Hierarchy h)
+    : resolution_(0), representation_type_(BALLS), use_index_(true) {
   init_predicate();
   set_hierarchies(h.get_model(),
                   ParticleIndexes(1, h.get_particle_index()));
 }
 Selection::Selection(Model *m, const ParticleIndexes &pis)
-    : resolution_(0),representation_type_(BALLS) {
+    : resolution_(0), representation_type_(BALLS), use_index_(true) {
   init_predicate();
   set_hierarchies(m, pis);
 }
-Selection::Selection(const Hierarchies &h) :
-  resolution_(0),representation_type_(BALLS) {
+Selection::Selection(const Hierarchies &h)
+    : resolution_(0), representation_type_(BALLS), use_index_(true) {
   init_predicate();
   if (h.empty()) {
     m_ = nullptr;
@@ -296,8 +300,8 @@ Selection::Selection(const Hierarchies &h) :
     set_hierarchies(h[0].get_model(), IMP::internal::get_index(h));
   }
 }
-Selection::Selection(const ParticlesTemp &h) :
-  resolution_(0),representation_type_(BALLS) {
+Selection::Selection(const ParticlesTemp &h)
+    : resolution_(0), representation_type_(BALLS), use_index_(true) {
   init_predicate();
   if (h.empty()) {
     m_ = nullptr;
@@ -308,7 +312,7 @@ Selection::Selection(const ParticlesTemp &h) :
 }
 // for C++
 Selection::Selection(Hierarchy h, std::string molname, int residue_index)
-    : resolution_(0),representation_type_(BALLS) {
+    : resolution_(0), representation_type_(BALLS), use_index_(true) {
   init_predicate();
   set_hierarchies(h.get_model(),
                   ParticleIndexes(1, h.get_particle_index()));
@@ -338,6 +342,7 @@ namespace {
     Name##SelectionPredicate(const DataType &data,                             \
                              std::string name = #Name "SelectionPredicate%1%") \
         : internal::SelectionPredicate(name), data_(data) {}                   \
+    const DataType &get_data() const { return data_; }                         \
     virtual MatchType do_get_value_index(Model *m,                             \
                                    ParticleIndex pi,                           \
                                    boost::dynamic_bitset<> &)                  \
@@ -532,12 +537,130 @@ void expand_search_representation(
   }
 }
 
+// Return the positions in list of the nodes that pass check
+template <class Check>
+Ints get_matching_positions(const internal::SelectionIndex *index,
+                            const Ints &list, Check check) {
+  Ints ret;
+  for (int pos : list) {
+    if (check(index->get_node(pos))) ret.push_back(pos);
+  }
+  return ret;
+}
+
+// Get the positions of the nodes that p can first match at, from the
+// current values in the model; return false if p is not indexed
+bool get_index_positions(Model *m, const internal::SelectionIndex *index,
+                         internal::SelectionPredicate *p, Ints &positions) {
+  if (MoleculeNameSelectionPredicate *mp
+          = dynamic_cast<MoleculeNameSelectionPredicate *>(p)) {
+    const Strings &data = mp->get_data();
+    positions = get_matching_positions(index, index->get_molecules(),
+                                       [&](ParticleIndex pi) {
+      return std::binary_search(data.begin(), data.end(),
+                                m->get_particle_name(pi));
+    });
+  } else if (ChainIDSelectionPredicate *cp
+                 = dynamic_cast<ChainIDSelectionPredicate *>(p)) {
+    const Strings &data = cp->get_data();
+    positions = get_matching_positions(index, index->get_chains(),
+                                       [&](ParticleIndex pi) {
+      return std::binary_search(data.begin(), data.end(),
+                                Chain(m, pi).get_id());
+    });
+  } else if (CopyIndexSelectionPredicate *cp
+                 = dynamic_cast<CopyIndexSelectionPredicate *>(p)) {
+    const Ints &data = cp->get_data();
+    positions = get_matching_positions(index, index->get_copies(),
+                                       [&](ParticleIndex pi) {
+      return std::binary_search(data.begin(), data.end(),
+                                Copy(m, pi).get_copy_index());
+    });
+  } else if (StateIndexSelectionPredicate *sp
+                 = dynamic_cast<StateIndexSelectionPredicate *>(p)) {
+    const Ints &data = sp->get_data();
+    positions = get_matching_positions(index, index->get_states(),
+                                       [&](ParticleIndex pi) {
+      return std::binary_search(data.begin(), data.end(),
+                                State(m, pi).get_state_index());
+    });
+  } else if (DomainNameSelectionPredicate *dp
+                 = dynamic_cast<DomainNameSelectionPredicate *>(p)) {
+    const Strings &data = dp->get_data();
+    positions = get_matching_positions(index, index->get_domains(),
+                                       [&](ParticleIndex pi) {
+      return std::binary_search(data.begin(), data.end(),
+                                m->get_particle_name(pi));
+    });
+  } else if (ResidueIndexSelectionPredicate *rp
+                 = dynamic_cast<ResidueIndexSelectionPredicate *>(p)) {
+    const Ints &data = rp->get_data();
+    positions = get_matching_positions(index, index->get_residues(),
+                                       [&](ParticleIndex pi) {
+      return get_is_residue_index_match(data, m, pi);
+    });
+  } else if (ResidueTypeSelectionPredicate *rp
+                 = dynamic_cast<ResidueTypeSelectionPredicate *>(p)) {
+    const ResidueTypes &data = rp->get_data();
+    positions = get_matching_positions(index, index->get_residues(),
+                                       [&](ParticleIndex pi) {
+      return Residue::get_is_setup(m, pi)
+             && std::binary_search(data.begin(), data.end(),
+                                   Residue(m, pi).get_residue_type());
+    });
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// A node can only match an And predicate if it is in the subtree of a node
+// matching each of its indexed children, so intersect those subtree ranges.
+// Return false if no child is indexed.
+bool get_index_ranges(Model *m, const internal::SelectionIndex *index,
+                      internal::SelectionPredicate *p, IntRanges &ranges) {
+  if (!dynamic_cast<AndSelectionPredicate *>(p)) return false;
+  bool constrained = false;
+  for (unsigned int i = 0; i < p->get_number_of_children(); ++i) {
+    internal::SelectionPredicate *c = p->get_child(i);
+    IntRanges cur;
+    if (!get_index_ranges(m, index, c, cur)) {
+      Ints positions;
+      if (!get_index_positions(m, index, c, positions)) continue;
+      cur = index->get_ranges(positions);
+    }
+    ranges = constrained ? internal::get_intersection(ranges, cur) : cur;
+    constrained = true;
+  }
+  return constrained;
+}
+
+// Return true if get_index_ranges() would use the index for p
+bool get_has_indexed_predicate(internal::SelectionPredicate *p) {
+  if (!dynamic_cast<AndSelectionPredicate *>(p)) return false;
+  for (unsigned int i = 0; i < p->get_number_of_children(); ++i) {
+    internal::SelectionPredicate *c = p->get_child(i);
+    if (get_has_indexed_predicate(c)
+        || dynamic_cast<MoleculeNameSelectionPredicate *>(c)
+        || dynamic_cast<ChainIDSelectionPredicate *>(c)
+        || dynamic_cast<CopyIndexSelectionPredicate *>(c)
+        || dynamic_cast<StateIndexSelectionPredicate *>(c)
+        || dynamic_cast<DomainNameSelectionPredicate *>(c)
+        || dynamic_cast<ResidueIndexSelectionPredicate *>(c)
+        || dynamic_cast<ResidueTypeSelectionPredicate *>(c)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 }
 
 Selection::SearchResult Selection::search(
     Model *m, ParticleIndex pi,
     boost::dynamic_bitset<> parent, bool with_representation,
-    bool found_rep_node) const {
+    bool found_rep_node, const internal::SelectionIndex *index,
+    const IntRanges *ranges) const {
   IMP_FUNCTION_LOG;
   IMP_LOG_VERBOSE("Searching " << m->get_particle_name(pi) << std::endl);
   internal::SelectionPredicate::MatchType val
@@ -567,8 +690,10 @@ Selection::SearchResult Selection::search(
     if (rep_pis.size() > 0) {
       found_rep_node |= from_rep;
       for (ParticleIndex ch : rep_pis) {
+        // nothing in a subtree outside the ranges can match
+        if (index && !index->get_overlaps(ch, *ranges)) continue;
         SearchResult curr = search(m, ch, parent, with_representation,
-                                   found_rep_node);
+                                   found_rep_node, index, ranges);
         matched |= curr.get_match();
         if (curr.get_match()) {
           if (curr.get_indexes().empty()) {
@@ -618,11 +743,22 @@ Selection::get_selected_particle_indexes(bool with_representation) const {
   IMP_LOG_WRITE(VERBOSE, show_predicate(predicate_, IMP_STREAM));
   ParticleIndexes rep_pis;
   bool from_rep;
+  bool indexed = use_index_ && get_has_indexed_predicate(predicate_);
   for(ParticleIndex pi : h_) {
+    Pointer<internal::SelectionIndex> index;
+    IntRanges ranges;
+    if (indexed) {
+      index = internal::get_selection_index(m_, pi);
+      if (index && !get_index_ranges(m_, index, predicate_, ranges)) {
+        index = nullptr;
+      }
+    }
     expand_search_representation(
             m_, pi, resolution_, representation_type_, from_rep, rep_pis);
     for (ParticleIndex rpi : rep_pis) {
-      ret += search(m_, rpi, base, with_representation, from_rep).get_indexes();
+      if (index && !index->get_overlaps(rpi, ranges)) continue;
+      ret += search(m_, rpi, base, with_representation, from_rep,
+                    index, &ranges).get_indexes();
     }
   }
   return ret;
@@ -11,17 +11,112 @@
 #include <IMP/internal/container_helpers.h>
 #include <IMP/internal/units.h>
 #include <IMP/internal/BoostProgressDisplay.h>
+#include <IMP/internal/SimpleTimer.h>
 #include <boost/scoped_ptr.hpp>
 #include <IMP/atom/constants.h>
+#include <IMP/core/rigid_bodies.h>
 
 IMPATOM_BEGIN_NAMESPACE
 
 Simulator::Simulator(Model *m, std::string name, double wave_factor)
-    : Optimizer(m, name), wave_factor_(wave_factor) {
+    : Optimizer(m, name), wave_factor_(wave_factor),
+      slow_period_(1), slow_impulses_(false), force_step_(0),
+      slow_step_(false), have_slow_forces_(false), slow_score_(0) {
   temperature_ = strip_units(IMP::internal::DEFAULT_TEMPERATURE);
   max_time_step_ = 2;
   current_time_ = 0;
   last_time_step_ = -1;
+  reset_evaluation_timings();
+}
+
+void Simulator::set_slow_scoring_function(ScoringFunctionAdaptor sf,
+                                          unsigned int period) {
+  IMP_USAGE_CHECK(period > 0, "The slow period must be at least one step");
+  slow_scoring_function_ = sf;
+  slow_period_ = period;
+  have_slow_forces_ = false;
+}
+
+void Simulator::reset_evaluation_timings() {
+  fast_time_ = slow_time_ = 0;
+  number_of_fast_evaluations_ = number_of_slow_evaluations_ = 0;
+}
+
+void Simulator::start_steps() {
+  force_step_ = 0;
+  slow_step_ = false;
+  have_slow_forces_ = false;
+}
+
+void Simulator::update_slow_forces(const ParticleIndexes &ps) {
+  Model *m = get_model();
+  IMP::internal::SimpleTimer timer;
+  slow_score_ = slow_scoring_function_->evaluate(true);
+  slow_pis_ = ps;
+  slow_derivatives_.resize(ps.size());
+  slow_rigid_bodies_.clear();
+  slow_torques_.clear();
+  const algebra::Sphere3D *derivatives = m->access_sphere_derivatives_data();
+  for (unsigned int i = 0; i < ps.size(); ++i) {
+    slow_derivatives_[i] = derivatives[ps[i].get_index()].get_center();
+    if (core::RigidBody::get_is_setup(m, ps[i])) {
+      slow_rigid_bodies_.push_back(ps[i]);
+      slow_torques_.push_back(core::RigidBody(m, ps[i]).get_torque());
+    }
+  }
+  have_slow_forces_ = true;
+  slow_time_ += timer.elapsed();
+  ++number_of_slow_evaluations_;
+}
+
+double Simulator::evaluate_forces(const ParticleIndexes &ps,
+                                  bool same_step) {
+  // the counter is advanced here rather than by the simulation loop, so
+  // that evaluations by setup() and by the first step are told apart
+  if (!same_step) {
+    slow_step_ = slow_scoring_function_ && force_step_ % slow_period_ == 0;
+    ++force_step_;
+    if (slow_step_) {
+      update_slow_forces(ps);
+    }
+  }
+  IMP::internal::SimpleTimer timer;
+  double score = get_scoring_function()->evaluate(true);
+  fast_time_ += timer.elapsed();
+  ++number_of_fast_evaluations_;
+  if (!slow_scoring_function_ || !have_slow_forces_) {
+    return score;
+  }
+  double scale = 1.0;
+  if (slow_impulses_) {
+    if (!slow_step_) return score + slow_score_;
+    scale = slow_period_;
+  }
+  Model *m = get_model();
+  algebra::Sphere3D *derivatives = m->access_sphere_derivatives_data();
+  for (unsigned int i = 0; i < slow_pis_.size(); ++i) {
+    algebra::Sphere3D &d = derivatives[slow_pis_[i].get_index()];
+    d = algebra::Sphere3D(d.get_center() + scale * slow_derivatives_[i],
+                          d.get_radius());
+  }
+  DerivativeAccumulator da(scale);
+  for (unsigned int i = 0; i < slow_rigid_bodies_.size(); ++i) {
+    core::RigidBody(m, slow_rigid_bodies_[i]).add_to_torque(slow_torques_[i],
+                                                             da);
+  }
+  return score + slow_score_;
+}
+
+double Simulator::get_final_score() const {
+  double score = Optimizer::get_scoring_function()->evaluate(false);
+  if (slow_scoring_function_) {
+    score += slow_scoring_function_->evaluate(false);
+    IMP_LOG_TERSE("Fast evaluations: " << number_of_fast_evaluations_
+                  << " taking " << fast_time_ << "s, slow evaluations: "
+                  << number_of_slow_evaluations_ << " taking " << slow_time_
+                  << "s" << std::endl);
+  }
+  return score;
 }
 
 double Simulator::simulate(double time) {
@@ -46,6 +141,7 @@ double Simulator::do_simulate(double time) {
   set_was_used(true);
   ParticleIndexes ps = get_simulation_particle_indexes();
 
+  start_steps();
   setup(ps);
   double target = current_time_ + time;
   boost::scoped_ptr<IMP::internal::BoostProgressDisplay> pgs;
@@ -60,7 +156,7 @@ double Simulator::do_simulate(double time) {
       ++(*pgs);
     }
   }
-  return Optimizer::get_scoring_function()->evaluate(false);
+  return get_final_score();
 }
 
 double Simulator::do_simulate_wave(double time, double max_time_step_factor,
@@ -69,6 +165,7 @@ double Simulator::do_simulate_wave(double time, double max_time_step_factor,
   set_was_used(true);
   ParticleIndexes ps = get_simulation_particle_indexes();
 
+  start_steps();
   setup(ps);
   double target = current_time_ + time;
   IMP_USAGE_CHECK(max_time_step_factor > 1.0,
@@ -138,7 +235,7 @@ double Simulator::do_simulate_wave(double time, double max_time_step_factor,
                                      << k << " frames each" << std::endl);
   IMP_USAGE_CHECK(current_time_ >= target - 0.001 * max_time_step_,
                   "simulations did not advance to target time for some reason");
-  return Optimizer::get_scoring_function()->evaluate(false);
+  return get_final_score();
 }
 
 ParticleIndexes Simulator::get_simulation_particle_indexes() const {
@@ -17,6 +17,7 @@ IntKey State::get_index_key() {
 void State::do_setup_particle(Model *m, ParticleIndex pi,
                               unsigned int state) {
   m->add_attribute(get_index_key(), pi, state);
+  core::internal::add_hierarchy_edit();
 }
 
 void State::show(std::ostream &out) const { out << "State: " << get_state_index(); }
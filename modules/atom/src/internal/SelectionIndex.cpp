@@ -0,0 +1,161 @@
+/**
+ *  \file SelectionIndex.cpp
+ *  \brief An index of a hierarchy used to speed up Selection.
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ *
+ */
+
+#include <IMP/atom/internal/SelectionIndex.h>
+#include <IMP/atom/Chain.h>
+#include <IMP/atom/Copy.h>
+#include <IMP/atom/Domain.h>
+#include <IMP/atom/Fragment.h>
+#include <IMP/atom/Molecule.h>
+#include <IMP/atom/Representation.h>
+#include <IMP/atom/Residue.h>
+#include <IMP/atom/State.h>
+#include <IMP/core/internal/hierarchy_helpers.h>
+#include <boost/unordered_map.hpp>
+#include <algorithm>
+#include <mutex>
+
+IMPATOM_BEGIN_INTERNAL_NAMESPACE
+
+SelectionIndex::SelectionIndex(Model *m, ParticleIndex root)
+    : Object("SelectionIndex%1%"), usable_(true) {
+  add_expanded(m, root);
+}
+
+void SelectionIndex::add_node(Model *m, ParticleIndex pi) {
+  int pos = nodes_.size();
+  if (positions_.size() <= static_cast<unsigned int>(pi.get_index())) {
+    positions_.resize(pi.get_index() + 1, -1);
+  }
+  positions_[pi.get_index()] = pos;
+  nodes_.push_back(pi);
+  ends_.push_back(pos + 1);
+  if (Molecule::get_is_setup(m, pi)) molecules_.push_back(pos);
+  if (Chain::get_is_setup(m, pi)) chains_.push_back(pos);
+  if (Copy::get_is_setup(m, pi)) copies_.push_back(pos);
+  if (State::get_is_setup(m, pi)) states_.push_back(pos);
+  if (Domain::get_is_setup(m, pi)) domains_.push_back(pos);
+  if (Residue::get_is_setup(m, pi) || Fragment::get_is_setup(m, pi) ||
+      Domain::get_is_setup(m, pi)) {
+    residues_.push_back(pos);
+  }
+}
+
+void SelectionIndex::add_subtree(Model *m, ParticleIndex pi) {
+  if (get_position(pi) >= 0) {
+    // shared between two parents or representations; the ranges of the
+    // two copies would not nest, so give up on this hierarchy
+    usable_ = false;
+    return;
+  }
+  int pos = nodes_.size();
+  add_node(m, pi);
+  Hierarchy cur(m, pi);
+  for (ParticleIndex childpi : cur.get_children_indexes()) {
+    add_expanded(m, childpi);
+  }
+  ends_[pos] = nodes_.size();
+}
+
+void SelectionIndex::add_expanded(Model *m, ParticleIndex pi) {
+  // Selection replaces a Representation node with one of its
+  // representations, so index all of them in its place
+  if (Representation::get_is_setup(m, pi)) {
+    Representation rep(m, pi);
+    Hierarchies reps = rep.get_representations(BALLS);
+    reps += rep.get_representations(DENSITIES);
+    for (unsigned int i = 0; i < reps.size(); ++i) {
+      ParticleIndex rpi = reps[i].get_particle_index();
+      // a node can be its own BALLS and DENSITIES representation
+      if (std::find(reps.begin(), reps.begin() + i, reps[i]) ==
+          reps.begin() + i) {
+        add_subtree(m, rpi);
+      }
+    }
+  } else {
+    add_subtree(m, pi);
+  }
+}
+
+IntRanges SelectionIndex::get_ranges(const Ints &positions) const {
+  IntRanges ret;
+  for (int pos : positions) {
+    // positions are in preorder, so a position before the current end is
+    // a descendant of a node already covered
+    if (ret.empty() || pos >= ret.back().second) {
+      ret.push_back(IntRange(pos, ends_[pos]));
+    }
+  }
+  return ret;
+}
+
+bool SelectionIndex::get_overlaps(ParticleIndex pi,
+                                  const IntRanges &ranges) const {
+  int pos = get_position(pi);
+  if (pos < 0) return true;
+  int end = ends_[pos];
+  IntRanges::const_iterator it = std::lower_bound(
+      ranges.begin(), ranges.end(), pos,
+      [](const IntRange &r, int p) { return r.second <= p; });
+  return it != ranges.end() && it->first < end;
+}
+
+IntRanges get_intersection(const IntRanges &a, const IntRanges &b) {
+  IntRanges ret;
+  unsigned int i = 0, j = 0;
+  while (i < a.size() && j < b.size()) {
+    int first = std::max(a[i].first, b[j].first);
+    int second = std::min(a[i].second, b[j].second);
+    if (first < second) ret.push_back(IntRange(first, second));
+    if (a[i].second < b[j].second) {
+      ++i;
+    } else {
+      ++j;
+    }
+  }
+  return ret;
+}
+
+namespace {
+struct SelectionIndexCache {
+  uint32_t model_id;
+  unsigned int edit_count;
+  // a null entry marks a hierarchy that was asked for once
+  boost::unordered_map<ParticleIndex, Pointer<SelectionIndex> > indexes;
+  SelectionIndexCache() : model_id(0), edit_count(0) {}
+};
+}
+
+Pointer<SelectionIndex> get_selection_index(Model *m, ParticleIndex root) {
+  static std::mutex mutex;
+  static SelectionIndexCache cache;
+  std::lock_guard<std::mutex> lock(mutex);
+  unsigned int edit_count = core::internal::get_hierarchy_edit_count();
+  // only the most recently used Model is cached
+  if (cache.model_id != m->get_unique_id() || cache.edit_count != edit_count) {
+    cache.indexes.clear();
+    cache.model_id = m->get_unique_id();
+    cache.edit_count = edit_count;
+  }
+  boost::unordered_map<ParticleIndex, Pointer<SelectionIndex> >::iterator it
+      = cache.indexes.find(root);
+  if (it == cache.indexes.end()) {
+    cache.indexes[root] = nullptr;
+    return nullptr;
+  } else if (!it->second) {
+    it->second = new SelectionIndex(m, root);
+    it->second->set_was_used(true);
+  }
+  if (it->second->get_is_usable()) {
+    return it->second;
+  } else {
+    return nullptr;
+  }
+}
+
+IMPATOM_END_INTERNAL_NAMESPACE
@@ -19,9 +19,12 @@
 #include <IMP/core/provenance.h>
 #include <IMP/core/Hierarchy.h>
 #include <IMP/core/rigid_bodies.h>
+#include <IMP/core/internal/hierarchy_helpers.h>
 #include <boost/algorithm/string.hpp>
 #include <boost/format.hpp>
 #include <boost/unordered_map.hpp>
+#include <IMP/internal/executor.h>
+#include <cstring>
 #include <locale>
 #include <fstream>
 
@@ -456,6 +459,214 @@ Hierarchies read_multimodel_pdb(TextInput in, Model* model,
   return ret;
 }
 
+namespace {
+// length of the line starting at b, not including the newline
+std::size_t get_line_length(const char *b, const char *e) {
+  const char *nl = static_cast<const char *>(std::memchr(b, '\n', e - b));
+  return nl ? nl - b : e - b;
+}
+
+bool get_is_atom_record(const char *line, std::size_t length) {
+  if (length < internal::atom_zcoord_field_ + 8) return false;
+  return std::strncmp(line, "ATOM", 4) == 0 ||
+         std::strncmp(line, "HETATM", 6) == 0;
+}
+
+bool get_is_model_record(const char *line, std::size_t length) {
+  return length >= 5 && std::strncmp(line, "MODEL", 5) == 0;
+}
+
+// parse a fixed width field as atoi()/atof() would, without allocating
+template <class T, class F>
+T parse_field(const char *line, std::size_t length, std::size_t field,
+              std::size_t width, F parse) {
+  char buf[16];
+  width = std::min(width, length > field ? length - field : 0);
+  std::memcpy(buf, line + field, width);
+  buf[width] = '\0';
+  return static_cast<T>(parse(buf));
+}
+
+int parse_int(const char *s) { return std::atoi(s); }
+double parse_double(const char *s) { return std::atof(s); }
+}
+
+PDBModelsReader::PDBModelsReader(TextInput in)
+    : Object("PDBModelsReader%1%"), input_name_(in.get_name()),
+      mapped_edit_count_(0) {
+  std::istream &is = in.get_stream();
+  char block[1 << 16];
+  while (is.read(block, sizeof(block)) || is.gcount() > 0) {
+    buffer_.append(block, is.gcount());
+  }
+  if (is.bad()) {
+    IMP_THROW("Error reading from PDB file " << input_name_, IOException);
+  }
+  split_models();
+  parse_models();
+}
+
+void PDBModelsReader::split_models() {
+  const char *b = buffer_.data(), *e = b + buffer_.size();
+  for (const char *line = b; line < e;) {
+    std::size_t length = get_line_length(line, e);
+    if (get_is_model_record(line, length)) {
+      if (!model_ranges_.empty()) {
+        model_ranges_.back().second = line - b;
+      }
+      model_ranges_.push_back(std::make_pair(line - b, buffer_.size()));
+      model_indexes_.push_back(
+          parse_field<int>(line, length, internal::model_index_field_, 9,
+                           parse_int));
+    }
+    line += length + 1;
+  }
+  if (model_ranges_.empty()) {
+    model_ranges_.push_back(std::make_pair(0, buffer_.size()));
+    model_indexes_.push_back(0);
+  }
+}
+
+void PDBModelsReader::parse_model_atoms(unsigned int i, bool fill) {
+  const char *b = buffer_.data() + model_ranges_[i].first;
+  const char *e = buffer_.data() + model_ranges_[i].second;
+  std::size_t n = 0, out = fill ? atom_offsets_[i] : 0;
+  for (const char *line = b; line < e;) {
+    std::size_t length = get_line_length(line, e);
+    if (get_is_atom_record(line, length)) {
+      if (fill) {
+        serials_[out] = parse_field<int>(line, length,
+                                         internal::atom_number_field_, 5,
+                                         parse_int);
+        coordinates_[out] = algebra::Vector3D(
+            parse_field<double>(line, length, internal::atom_xcoord_field_,
+                                8, parse_double),
+            parse_field<double>(line, length, internal::atom_ycoord_field_,
+                                8, parse_double),
+            parse_field<double>(line, length, internal::atom_zcoord_field_,
+                                8, parse_double));
+        ++out;
+      } else {
+        ++n;
+      }
+    }
+    line += length + 1;
+  }
+  if (!fill) {
+    atom_offsets_[i + 1] = n;
+  }
+}
+
+void PDBModelsReader::parse_models() {
+  unsigned int n = model_ranges_.size();
+  atom_offsets_.assign(n + 1, 0);
+  // count the atoms of each model, then parse them into their slots
+  for (int fill = 0; fill < 2; ++fill) {
+    IMP::internal::run_tasks(n, IMP::get_number_of_threads(),
+                             [this, fill](unsigned int i) {
+                               parse_model_atoms(i, fill);
+                             },
+                             "pdb models");
+    if (!fill) {
+      for (unsigned int i = 0; i < n; ++i) {
+        atom_offsets_[i + 1] += atom_offsets_[i];
+      }
+      serials_.resize(atom_offsets_[n]);
+      coordinates_.resize(atom_offsets_[n]);
+    }
+  }
+  IMP_LOG_TERSE("Read " << n << " models with " << atom_offsets_[n]
+                << " atoms from " << input_name_ << std::endl);
+}
+
+algebra::Vector3Ds PDBModelsReader::get_coordinates(unsigned int i) const {
+  IMP_USAGE_CHECK(i < model_ranges_.size(), "No model " << i);
+  return algebra::Vector3Ds(coordinates_.begin() + atom_offsets_[i],
+                            coordinates_.begin() + atom_offsets_[i + 1]);
+}
+
+Hierarchy PDBModelsReader::read_hierarchy(unsigned int i, Model *model,
+                                          PDBSelector *selector,
+                                          bool no_radii) const {
+  IMP::PointerMember<PDBSelector> sp(selector);
+  IMP_USAGE_CHECK(i < model_ranges_.size(), "No model " << i);
+  std::istringstream in(buffer_.substr(
+      model_ranges_[i].first,
+      model_ranges_[i].second - model_ranges_[i].first));
+  Hierarchies ret = read_pdb(in, nicename(input_name_), input_name_, model,
+                             selector, true, false, no_radii);
+  if (ret.empty()) {
+    IMP_THROW("No molecule read from model " << i << " of file "
+              << input_name_, ValueException);
+  }
+  return ret[0];
+}
+
+void PDBModelsReader::clear_caches() {
+  mapped_model_ = nullptr;
+  atoms_by_serial_.clear();
+  mapped_atoms_.clear();
+  rigid_bodies_.clear();
+}
+
+void PDBModelsReader::update_atom_map(Hierarchy h) {
+  // any hierarchy edit may have added or removed atoms of h
+  if (mapped_model_ == h.get_model() &&
+      mapped_root_ == h.get_particle_index() &&
+      mapped_edit_count_ == core::internal::get_hierarchy_edit_count()) {
+    return;
+  }
+  clear_caches();
+  mapped_model_ = h.get_model();
+  mapped_root_ = h.get_particle_index();
+  mapped_edit_count_ = core::internal::get_hierarchy_edit_count();
+  IntKey k = internal::get_pdb_index_key();
+  boost::unordered_map<ParticleIndex, unsigned int> rigid_body_slots;
+  Hierarchies atoms = get_by_type(h, ATOM_TYPE);
+  for (unsigned int i = 0; i < atoms.size(); ++i) {
+    int serial = atoms[i]->get_value(k);
+    if (serial < 0) continue;
+    if (static_cast<unsigned int>(serial) >= atoms_by_serial_.size()) {
+      atoms_by_serial_.resize(serial + 1);
+    }
+    ParticleIndex pi = atoms[i].get_particle_index();
+    atoms_by_serial_[serial] = pi;
+    mapped_atoms_.push_back(pi);
+    if (core::RigidMember::get_is_setup(atoms[i])) {
+      ParticleIndex rb = core::RigidMember(atoms[i]).get_rigid_body()
+                             .get_particle_index();
+      if (rigid_body_slots.find(rb) == rigid_body_slots.end()) {
+        rigid_body_slots[rb] = rigid_bodies_.size();
+        rigid_bodies_.push_back(std::make_pair(rb, ParticleIndexes()));
+      }
+      rigid_bodies_[rigid_body_slots[rb]].second.push_back(pi);
+    }
+  }
+}
+
+void PDBModelsReader::set_coordinates(unsigned int i, Hierarchy h) {
+  IMP_USAGE_CHECK(i < model_ranges_.size(), "No model " << i);
+  update_atom_map(h);
+  Model *m = h.get_model();
+  algebra::Sphere3D *spheres = m->access_spheres_data(mapped_atoms_);
+  for (std::size_t j = atom_offsets_[i]; j < atom_offsets_[i + 1]; ++j) {
+    int serial = serials_[j];
+    if (serial < 0 ||
+        static_cast<unsigned int>(serial) >= atoms_by_serial_.size()) {
+      continue;
+    }
+    ParticleIndex pi = atoms_by_serial_[serial];
+    if (pi != ParticleIndex()) {
+      algebra::Sphere3D &s = spheres[pi.get_index()];
+      s = algebra::Sphere3D(coordinates_[j], s.get_radius());
+    }
+  }
+  for (unsigned int j = 0; j < rigid_bodies_.size(); ++j) {
+    core::RigidBody(m, rigid_bodies_[j].first)
+        .set_reference_frame_from_members(rigid_bodies_[j].second);
+  }
+}
+
 void write_pdb(const Selection& mhd, TextOutput out, unsigned int model) {
   out.get_stream() << boost::format("MODEL%1$9d") % model << std::endl;
   internal::write_pdb(mhd.get_selected_particles(), out);
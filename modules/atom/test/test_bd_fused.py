@@ -0,0 +1,98 @@
+import IMP
+import IMP.test
+import IMP.algebra
+import IMP.core
+import IMP.atom
+import IMP.container
+
+
+def setup_system(n, D, k):
+    m = IMP.Model()
+    ps = []
+    for i in range(n):
+        p = IMP.Particle(m)
+        d = IMP.core.XYZR.setup_particle(
+            p, IMP.algebra.Sphere3D(IMP.algebra.Vector3D(0, 0, 0), 1))
+        d.set_coordinates_are_optimized(True)
+        IMP.atom.Diffusion.setup_particle(p, D)
+        ps.append(p)
+    ss = IMP.core.DistanceToSingletonScore(IMP.core.Harmonic(0, k),
+                                           IMP.algebra.Vector3D(0, 0, 0))
+    r = IMP.container.SingletonsRestraint(
+        ss, IMP.container.ListSingletonContainer(m, ps))
+    bd = IMP.atom.BrownianDynamics(m)
+    bd.set_scoring_function([r])
+    return m, ps, bd
+
+
+class Tests(IMP.test.TestCase):
+
+    def get_msd(self, fused):
+        D = 1e-4
+        dt = 100.
+        nsteps = 10
+        m, ps, bd = setup_system(1000, D, 0.)
+        bd.set_use_fused_kernel(fused)
+        bd.set_maximum_time_step(dt)
+        bd.optimize(nsteps)
+        msd = sum(IMP.core.XYZ(p).get_coordinates().get_squared_magnitude()
+                  for p in ps) / len(ps)
+        return msd, 6. * D * dt * nsteps
+
+    def test_free_diffusion(self):
+        """Test mean squared displacement with and without fused kernel"""
+        for fused in (True, False):
+            msd, expected = self.get_msd(fused)
+            self.assertAlmostEqual(msd, expected, delta=.15 * expected)
+
+    def test_force(self):
+        """Test that the fused kernel follows the force"""
+        m, ps, bd = setup_system(100, 1e-4, 10.)
+        self.assertFalse(bd.get_use_fused_kernel())
+        bd.set_use_fused_kernel(True)
+        for p in ps:
+            IMP.core.XYZ(p).set_coordinates(IMP.algebra.Vector3D(10, 0, 0))
+        bd.set_maximum_time_step(100.)
+        start = bd.get_scoring_function().evaluate(False)
+        bd.optimize(100)
+        self.assertLess(bd.get_scoring_function().evaluate(False),
+                        .1 * start)
+
+    def get_msd_angle(self, fused):
+        Dr = 1e-4
+        dt = 10.
+        m = IMP.Model()
+        rbs = []
+        for i in range(1000):
+            p = IMP.Particle(m)
+            IMP.core.XYZR.setup_particle(p).set_radius(10)
+            rb = IMP.core.RigidBody.setup_particle(
+                p, IMP.algebra.ReferenceFrame3D())
+            rb.set_coordinates_are_optimized(True)
+            IMP.atom.RigidBodyDiffusion.setup_particle(
+                p).set_rotational_diffusion_coefficient(Dr)
+            rbs.append(rb)
+        bd = IMP.atom.BrownianDynamics(m)
+        bd.set_scoring_function([])
+        bd.set_use_fused_kernel(fused)
+        bd.set_maximum_time_step(dt)
+        bd.optimize(1)
+        msd = sum(IMP.algebra.get_axis_and_angle(rb.get_rotation())[1] ** 2
+                  for rb in rbs) / len(rbs)
+        return msd, 6. * Dr * dt
+
+    def test_rotational_diffusion(self):
+        """Test rigid body rotation with and without fused kernel"""
+        for fused in (True, False):
+            msd, expected = self.get_msd_angle(fused)
+            self.assertAlmostEqual(msd, expected, delta=.15 * expected)
+
+    def test_tamd_not_fused(self):
+        """Test that TAMD does not use the fused kernel"""
+        m = IMP.Model()
+        bd = IMP.atom.BrownianDynamicsTAMD(m)
+        self.assertFalse(bd.get_use_fused_kernel())
+
+
+if __name__ == '__main__':
+    IMP.test.main()
@@ -0,0 +1,154 @@
+import random
+import IMP
+import IMP.test
+import IMP.algebra
+import IMP.atom
+import IMP.container
+import IMP.core
+
+
+def make_system(charged=True):
+    """Atoms on a jittered grid, with a mixture of radii, well depths and
+       charges"""
+    m = IMP.Model()
+    ps = []
+    for i in range(3):
+        for j in range(3):
+            for k in range(3):
+                v = IMP.algebra.Vector3D(i * 3., j * 3., k * 3.)
+                v += IMP.algebra.get_random_vector_in(
+                    IMP.algebra.get_unit_sphere_3d()) * 0.5
+                p = m.add_particle("p")
+                IMP.core.XYZR.setup_particle(
+                    m, p, IMP.algebra.Sphere3D(v, random.choice((0.5, 1.))))
+                IMP.atom.LennardJones.setup_particle(
+                    m, p, random.choice((0., 0.1, 0.2)))
+                if charged:
+                    IMP.atom.Charged.setup_particle(
+                        m, p, random.uniform(-1., 1.))
+                ps.append(p)
+    return m, ps
+
+
+def get_score_and_derivatives(m, ps, restraints):
+    sf = IMP.core.RestraintsScoringFunction(restraints)
+    score = sf.evaluate(True)
+    return score, [IMP.core.XYZ(m, p).get_derivatives() for p in ps]
+
+
+class Tests(IMP.test.TestCase):
+
+    """Test the LennardJonesCoulombPairScore"""
+
+    def assert_same(self, first, second):
+        self.assertAlmostEqual(first[0], second[0], delta=1e-6)
+        for d1, d2 in zip(first[1], second[1]):
+            self.assertLess(IMP.algebra.get_distance(d1, d2), 1e-6)
+
+    def test_get_set(self):
+        """Check LennardJonesCoulombPairScore get/set methods"""
+        sm = IMP.atom.ForceSwitch(4.0, 6.0)
+        c = IMP.atom.LennardJonesCoulombPairScore(sm)
+        self.assertEqual(c.get_repulsive_weight(), 1.0)
+        c.set_repulsive_weight(5.0)
+        self.assertEqual(c.get_repulsive_weight(), 5.0)
+        self.assertEqual(c.get_attractive_weight(), 1.0)
+        c.set_attractive_weight(10.0)
+        self.assertEqual(c.get_attractive_weight(), 10.0)
+        self.assertEqual(c.get_relative_dielectric(), 1.0)
+        c.set_relative_dielectric(4.0)
+        self.assertEqual(c.get_relative_dielectric(), 4.0)
+        c.set_14_scale_factors(0.5, 0.25)
+        self.assertEqual(c.get_lennard_jones_14_scale_factor(), 0.5)
+        self.assertEqual(c.get_coulomb_14_scale_factor(), 0.25)
+
+    def test_types(self):
+        """Check that particles with the same parameters share a type"""
+        m, ps = make_system()
+        c = IMP.atom.LennardJonesCoulombPairScore(
+            IMP.atom.ForceSwitch(4.0, 6.0))
+        c.set_particles(m, ps)
+        self.assertLessEqual(c.get_number_of_types(), 6)
+
+    def test_same_as_separate(self):
+        """Check LennardJonesCoulombPairScore against separate scores"""
+        for charged in (True, False):
+            m, ps = make_system(charged)
+            pairs = IMP.container.ListPairContainer(
+                m, [(ps[i], ps[j]) for i in range(len(ps))
+                    for j in range(i + 1, len(ps))])
+            sm = IMP.atom.ForceSwitch(4.0, 6.0)
+            lj = IMP.atom.LennardJonesPairScore(sm)
+            lj.set_attractive_weight(0.5)
+            rs = [IMP.container.PairsRestraint(lj, pairs)]
+            if charged:
+                coulomb = IMP.atom.CoulombPairScore(sm)
+                coulomb.set_relative_dielectric(2.0)
+                rs.append(IMP.container.PairsRestraint(coulomb, pairs))
+            expected = get_score_and_derivatives(m, ps, rs)
+            c = IMP.atom.LennardJonesCoulombPairScore(sm)
+            c.set_particles(m, ps)
+            c.set_attractive_weight(0.5)
+            c.set_relative_dielectric(2.0)
+            self.assertNotAlmostEqual(expected[0], 0., delta=1e-6)
+            self.assert_same(
+                get_score_and_derivatives(
+                    m, ps, [IMP.container.PairsRestraint(c, pairs)]),
+                expected)
+            # one pair at a time
+            self.assert_same(
+                get_score_and_derivatives(
+                    m, ps, [IMP.core.PairRestraint(m, c, pp)
+                            for pp in pairs.get_contents()]),
+                expected)
+
+    def test_14_scaling(self):
+        """Check 1-4 scaling of LennardJonesCoulombPairScore"""
+        m, ps = make_system()
+        sm = IMP.atom.ForceSwitch(4.0, 6.0)
+        scaled = [(ps[0], ps[1]), (ps[4], ps[3])]
+        other = [(ps[1], ps[2]), (ps[3], ps[5])]
+        lj = IMP.atom.LennardJonesPairScore(sm)
+        coulomb = IMP.atom.CoulombPairScore(sm)
+        rs = []
+        for pp in scaled:
+            rs.append(IMP.core.PairRestraint(m, lj, pp))
+            rs[-1].set_weight(0.5)
+            rs.append(IMP.core.PairRestraint(m, coulomb, pp))
+            rs[-1].set_weight(0.25)
+        for pp in other:
+            rs.append(IMP.core.PairRestraint(m, lj, pp))
+            rs.append(IMP.core.PairRestraint(m, coulomb, pp))
+        expected = get_score_and_derivatives(m, ps, rs)
+        c = IMP.atom.LennardJonesCoulombPairScore(sm)
+        c.set_particles(m, ps)
+        c.set_14_pairs(scaled)
+        c.set_14_scale_factors(0.5, 0.25)
+        pairs = IMP.container.ListPairContainer(m, scaled + other)
+        self.assert_same(
+            get_score_and_derivatives(
+                m, ps, [IMP.container.PairsRestraint(c, pairs)]),
+            expected)
+
+    def test_charmm_14_pairs(self):
+        """Check 1-4 pairs from CHARMMStereochemistryRestraint"""
+        m = IMP.Model()
+        pdb = IMP.atom.read_pdb(self.get_input_file_name('mini.pdb'), m)
+        ff = IMP.atom.get_heavy_atom_CHARMM_parameters()
+        topology = ff.create_topology(pdb)
+        topology.apply_default_patches()
+        topology.setup_hierarchy(pdb)
+        r = IMP.atom.CHARMMStereochemistryRestraint(pdb, topology)
+        pairs = r.get_14_pairs()
+        self.assertGreater(len(pairs), 0)
+        self.assertEqual(len(pairs), len(set(pairs)))
+        full = r.get_pair_filter()
+        partial = r.get_pair_filter(False)
+        for pp in pairs:
+            self.assertLess(pp[0], pp[1])
+            self.assertTrue(full.get_value_index(m, pp))
+            self.assertFalse(partial.get_value_index(m, pp))
+
+
+if __name__ == '__main__':
+    IMP.test.main()
@@ -0,0 +1,96 @@
+import IMP
+import IMP.test
+import IMP.algebra
+import IMP.core
+import IMP.atom
+
+
+class Tests(IMP.test.TestCase):
+
+    def get_coordinates(self, h):
+        return [IMP.core.XYZ(a).get_coordinates()
+                for a in IMP.atom.get_leaves(h)]
+
+    def assert_same_coordinates(self, c1, c2):
+        self.assertEqual(len(c1), len(c2))
+        for a, b in zip(c1, c2):
+            self.assertLess(IMP.algebra.get_distance(a, b), 1e-4)
+
+    def test_models(self):
+        """Test splitting of a multimodel PDB file"""
+        r = IMP.atom.PDBModelsReader(
+            self.get_input_file_name("multimodel.pdb"))
+        self.assertEqual(r.get_number_of_models(), 20)
+        self.assertEqual(r.get_model_index(0), 1)
+        self.assertEqual(r.get_model_index(19), 20)
+        self.assertEqual(sum(r.get_number_of_atoms(i) for i in range(20)),
+                         19740)
+        self.assertEqual(len(r.get_coordinates(3)), r.get_number_of_atoms(3))
+
+    def test_single_model(self):
+        """Test reading a PDB file without MODEL records"""
+        m = IMP.Model()
+        r = IMP.atom.PDBModelsReader(self.get_input_file_name("input.pdb"))
+        self.assertEqual(r.get_number_of_models(), 1)
+        h = r.read_hierarchy(0, m)
+        ref = IMP.atom.read_pdb(self.get_input_file_name("input.pdb"), m)
+        self.assert_same_coordinates(self.get_coordinates(h),
+                                     self.get_coordinates(ref))
+
+    def test_read_hierarchy(self):
+        """Test building hierarchies from a PDBModelsReader"""
+        m = IMP.Model()
+        fname = self.get_input_file_name("multimodel.pdb")
+        r = IMP.atom.PDBModelsReader(fname)
+        refs = IMP.atom.read_multimodel_pdb(fname, m)
+        self.assertEqual(len(refs), r.get_number_of_models())
+        for i in (0, 5, 19):
+            h = r.read_hierarchy(i, m)
+            self.assert_same_coordinates(self.get_coordinates(h),
+                                         self.get_coordinates(refs[i]))
+
+    def test_set_coordinates(self):
+        """Test loading model coordinates into an existing hierarchy"""
+        m = IMP.Model()
+        fname = self.get_input_file_name("multimodel.pdb")
+        r = IMP.atom.PDBModelsReader(fname)
+        refs = IMP.atom.read_multimodel_pdb(fname, m)
+        h = r.read_hierarchy(0, m)
+        for i in (3, 7, 0, 19):
+            r.set_coordinates(i, h)
+            self.assert_same_coordinates(self.get_coordinates(h),
+                                         self.get_coordinates(refs[i]))
+
+    def test_set_coordinates_edited(self):
+        """Test loading model coordinates after editing the hierarchy"""
+        m = IMP.Model()
+        fname = self.get_input_file_name("multimodel.pdb")
+        r = IMP.atom.PDBModelsReader(fname)
+        refs = IMP.atom.read_multimodel_pdb(fname, m)
+        h = r.read_hierarchy(0, m)
+        r.set_coordinates(3, h)
+        # remove an atom; it must no longer be updated
+        removed = IMP.atom.get_leaves(h)[0]
+        old = IMP.core.XYZ(removed).get_coordinates()
+        IMP.atom.Hierarchy(removed.get_parent()).remove_child(removed)
+        r.set_coordinates(7, h)
+        self.assertLess(IMP.algebra.get_distance(
+            IMP.core.XYZ(removed).get_coordinates(), old), 1e-6)
+        self.assert_same_coordinates(self.get_coordinates(h),
+                                     self.get_coordinates(refs[7])[1:])
+
+    def test_set_coordinates_rigid(self):
+        """Test loading model coordinates into a rigid body"""
+        m = IMP.Model()
+        fname = self.get_input_file_name("multimodel.pdb")
+        r = IMP.atom.PDBModelsReader(fname)
+        h = r.read_hierarchy(0, m)
+        rb = IMP.atom.create_rigid_body(h)
+        r.set_coordinates(0, h)
+        self.assert_same_coordinates(
+            self.get_coordinates(h),
+            self.get_coordinates(r.read_hierarchy(0, m)))
+
+
+if __name__ == '__main__':
+    IMP.test.main()
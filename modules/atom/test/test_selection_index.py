@@ -0,0 +1,144 @@
+import IMP
+import IMP.test
+import IMP.core
+import IMP.atom
+
+
+def make_system(m):
+    """Two copies each of two molecules, with residues, a bead and
+       a coarser representation"""
+    root = IMP.atom.Hierarchy.setup_particle(IMP.Particle(m, "root"))
+    for name, chain_id in (("A", "A"), ("B", "B")):
+        for copy in range(2):
+            mol = IMP.atom.Copy.setup_particle(IMP.Particle(m, name), copy)
+            chain = IMP.atom.Chain.setup_particle(IMP.Particle(m), chain_id)
+            mol.add_child(chain)
+            rep = IMP.atom.Representation.setup_particle(
+                IMP.Particle(m), 1.)
+            chain.add_child(rep)
+            for i in range(1, 11):
+                r = IMP.atom.Residue.setup_particle(
+                    IMP.Particle(m), IMP.atom.ALA, i)
+                for at in (IMP.atom.AT_N, IMP.atom.AT_CA, IMP.atom.AT_C):
+                    a = IMP.atom.Atom.setup_particle(IMP.Particle(m), at)
+                    IMP.core.XYZR.setup_particle(a)
+                    r.add_child(a)
+                rep.add_child(r)
+            coarse = IMP.atom.Fragment.setup_particle(IMP.Particle(m),
+                                                      list(range(1, 11)))
+            IMP.core.XYZR.setup_particle(coarse)
+            rep.add_representation(coarse, IMP.atom.BALLS, 10.)
+            bead = IMP.atom.Fragment.setup_particle(IMP.Particle(m),
+                                                    list(range(11, 21)))
+            IMP.core.XYZR.setup_particle(bead)
+            chain.add_child(bead)
+            root.add_child(mol)
+    return root
+
+
+def get_selections(h):
+    yield dict(molecule="A")
+    yield dict(molecule="B", residue_index=3)
+    yield dict(molecule="A", copy_index=1, residue_indexes=[2, 5, 15])
+    yield dict(chain_id="B", residue_index=15)
+    yield dict(molecule="A", residue_index=4, resolution=10.)
+    yield dict(molecule="B", residue_index=4, atom_type=IMP.atom.AT_CA)
+    yield dict(molecule="A", residue_type=IMP.atom.ALA, copy_index=0)
+    yield dict(molecule="C")
+    yield dict(residue_index=25)
+
+
+class Tests(IMP.test.TestCase):
+
+    def assert_same(self, h, **kwargs):
+        plain = IMP.atom.Selection(h, use_index=False, **kwargs)
+        expected = plain.get_selected_particle_indexes()
+        # the index is built on the second query
+        for i in range(2):
+            s = IMP.atom.Selection(h, **kwargs)
+            self.assertTrue(s.get_use_index())
+            for rep in (True, False):
+                self.assertEqual(
+                    s.get_selected_particle_indexes(rep),
+                    plain.get_selected_particle_indexes(rep))
+        return expected
+
+    def test_same_as_search(self):
+        """Indexed Selection should match the plain search"""
+        m = IMP.Model()
+        h = make_system(m)
+        for kwargs in get_selections(h):
+            self.assert_same(h, **kwargs)
+        self.assertEqual(len(self.assert_same(h, molecule="A",
+                                              copy_index=1,
+                                              residue_indexes=[2, 15])), 4)
+
+    def test_set_operations(self):
+        """Indexed Selection should handle set operations"""
+        m = IMP.Model()
+        h = make_system(m)
+        for use_index in (False, True, True):
+            s1 = IMP.atom.Selection(h, molecule="A", use_index=use_index)
+            s2 = IMP.atom.Selection(h, residue_index=3)
+            s3 = IMP.atom.Selection(h, copy_index=0)
+            inter = (s1 & s2).get_selected_particle_indexes()
+            diff = (s1 - s3).get_selected_particle_indexes()
+            union = (s1 | s2).get_selected_particle_indexes()
+            if not use_index:
+                expected = (inter, diff, union)
+            else:
+                self.assertEqual((inter, diff, union), expected)
+        self.assertEqual(len(inter), 6)
+
+    def test_invalidation(self):
+        """Indexed Selection should see hierarchy and value edits"""
+        m = IMP.Model()
+        h = make_system(m)
+        for i in range(2):
+            self.assert_same(h, molecule="A", residue_index=12)
+        # add a new molecule "A" after the index was built
+        mol = IMP.atom.Molecule.setup_particle(IMP.Particle(m, "A"))
+        r = IMP.atom.Residue.setup_particle(IMP.Particle(m),
+                                            IMP.atom.GLY, 12)
+        IMP.core.XYZR.setup_particle(r)
+        mol.add_child(r)
+        h.add_child(mol)
+        ps = self.assert_same(h, molecule="A", residue_index=12)
+        self.assertIn(r.get_particle_index(), ps)
+        # rename it, and change the residue index, without structural edits
+        mol.get_particle().set_name("C")
+        self.assertEqual(self.assert_same(h, molecule="C"),
+                         [r.get_particle_index()])
+        IMP.atom.Residue(r).set_index(13)
+        self.assertEqual(self.assert_same(h, molecule="C", residue_index=13),
+                         [r.get_particle_index()])
+        self.assertEqual(self.assert_same(h, molecule="C", residue_index=12),
+                         [])
+        # remove it again
+        h.remove_child(mol)
+        self.assertEqual(self.assert_same(h, molecule="C"), [])
+
+    def test_decorate_existing(self):
+        """Indexed Selection should see existing nodes being decorated"""
+        m = IMP.Model()
+        h = make_system(m)
+        for i in range(2):
+            self.assert_same(h, molecule="D")
+        chain = IMP.atom.Hierarchy(h.get_child(0).get_child(0))
+        chain.get_particle().set_name("D")
+        IMP.atom.Molecule.setup_particle(chain)
+        self.assertEqual(len(self.assert_same(h, molecule="D")), 31)
+        for i in range(2):
+            self.assert_same(h, copy_index=5)
+        IMP.atom.Copy.setup_particle(chain, 5)
+        self.assertEqual(len(self.assert_same(h, copy_index=5)), 31)
+        bead = chain.get_child(1)
+        for i in range(2):
+            self.assert_same(h, chain_id="Z")
+        IMP.atom.Chain.setup_particle(bead, "Z")
+        self.assertEqual(self.assert_same(h, chain_id="Z"),
+                         [bead.get_particle_index()])
+
+
+if __name__ == '__main__':
+    IMP.test.main()
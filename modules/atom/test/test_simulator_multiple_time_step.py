@@ -0,0 +1,114 @@
+import IMP
+import IMP.test
+import IMP.algebra
+import IMP.core
+import IMP.atom
+
+
+def setup_system():
+    m = IMP.Model()
+    ps = []
+    for i in range(4):
+        p = IMP.Particle(m)
+        d = IMP.core.XYZ.setup_particle(
+            p, IMP.algebra.Vector3D(3. * i, 0.5 * (i % 2), 0))
+        d.set_coordinates_are_optimized(True)
+        IMP.atom.Mass.setup_particle(p, 12.)
+        ps.append(p)
+    fast = [IMP.core.PairRestraint(
+        m, IMP.core.HarmonicDistancePairScore(1.5, 10.), (ps[i], ps[i + 1]))
+        for i in range(3)]
+    slow = [IMP.core.PairRestraint(
+        m, IMP.core.HarmonicDistancePairScore(5., .1), (ps[0], ps[3]))]
+    md = IMP.atom.MolecularDynamics(m)
+    md.set_maximum_time_step(1.)
+    return m, ps, md, fast, slow
+
+
+class Tests(IMP.test.TestCase):
+
+    def get_coordinates(self, ps):
+        return [IMP.core.XYZ(p).get_coordinates() for p in ps]
+
+    def test_period_one(self):
+        """Test that a slow period of one matches a single scoring function"""
+        m, ps, md, fast, slow = setup_system()
+        md.set_scoring_function(fast + slow)
+        score = md.optimize(50)
+        expected = self.get_coordinates(ps)
+        for impulses in (False, True):
+            m, ps, md, fast, slow = setup_system()
+            md.set_scoring_function(fast)
+            md.set_slow_scoring_function(slow, 1)
+            md.set_use_slow_force_impulses(impulses)
+            self.assertAlmostEqual(md.optimize(50), score, delta=1e-6)
+            for c, e in zip(self.get_coordinates(ps), expected):
+                self.assertLess(IMP.algebra.get_distance(c, e), 1e-6)
+
+    def test_evaluation_counts(self):
+        """Test that the slow scoring function is evaluated less often"""
+        for impulses in (False, True):
+            m, ps, md, fast, slow = setup_system()
+            md.set_scoring_function(fast)
+            md.set_slow_scoring_function(slow, 5)
+            md.set_use_slow_force_impulses(impulses)
+            self.assertEqual(md.get_slow_period(), 5)
+            md.optimize(20)
+            # setup() evaluates both functions, then each step evaluates
+            # the fast function and every fifth step (5, 10, 15 and 20)
+            # the slow one
+            self.assertEqual(md.get_number_of_fast_evaluations(), 21)
+            self.assertEqual(md.get_number_of_slow_evaluations(), 5)
+            self.assertGreaterEqual(md.get_fast_evaluation_time(), 0.)
+            self.assertGreaterEqual(md.get_slow_evaluation_time(), 0.)
+            md.reset_evaluation_timings()
+            self.assertEqual(md.get_number_of_slow_evaluations(), 0)
+            md.clear_slow_scoring_function()
+            self.assertIsNone(md.get_slow_scoring_function())
+            md.optimize(5)
+            self.assertEqual(md.get_number_of_slow_evaluations(), 0)
+
+    def get_first_step_velocity(self, impulses):
+        m = IMP.Model()
+        p = IMP.Particle(m)
+        d = IMP.core.XYZ.setup_particle(p, IMP.algebra.Vector3D(3, 0, 0))
+        d.set_coordinates_are_optimized(True)
+        IMP.atom.Mass.setup_particle(p, 12.)
+        slow = IMP.core.SingletonRestraint(
+            m, IMP.core.DistanceToSingletonScore(
+                IMP.core.Harmonic(0, 1.), IMP.algebra.Vector3D(0, 0, 0)), p)
+        md = IMP.atom.MolecularDynamics(m)
+        md.set_maximum_time_step(1.)
+        md.set_scoring_function([])
+        md.set_slow_scoring_function([slow], 4)
+        md.set_use_slow_force_impulses(impulses)
+        md.optimize(1)
+        self.assertEqual(md.get_number_of_slow_evaluations(), 1)
+        return IMP.atom.LinearVelocity(p).get_velocity()[0]
+
+    def test_first_step_impulse(self):
+        """Test that the first step applies the slow impulse once"""
+        # held forces are added at both ends of the step, while the impulse
+        # of four times the force is added only at the start, so gives half
+        # of its velocity change in this step
+        held = self.get_first_step_velocity(False)
+        impulse = self.get_first_step_velocity(True)
+        self.assertLess(held, 0.)
+        self.assertAlmostEqual(impulse / held, 2., delta=1e-6)
+
+    def test_brownian_dynamics(self):
+        """Test multiple time steps with Brownian dynamics"""
+        m, ps, md, fast, slow = setup_system()
+        for p in ps:
+            IMP.atom.Diffusion.setup_particle(p, 1e-4)
+        bd = IMP.atom.BrownianDynamics(m)
+        bd.set_maximum_time_step(10.)
+        bd.set_scoring_function(fast)
+        bd.set_slow_scoring_function(slow, 10)
+        bd.optimize(100)
+        self.assertEqual(bd.get_number_of_fast_evaluations(), 100)
+        self.assertEqual(bd.get_number_of_slow_evaluations(), 10)
+
+
+if __name__ == '__main__':
+    IMP.test.main()
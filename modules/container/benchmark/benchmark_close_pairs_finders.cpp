@@ -66,6 +66,33 @@ void test_one(std::string name, ClosePairsFinder *cpf, unsigned int n,
     report(oss.str(), runtime, result);
   }
 }
+
+// time the same search with increasing numbers of threads
+void test_scaling(std::string name, ClosePairsFinder *cpf, unsigned int n,
+                  float rmax) {
+  BoundingBox3D bb(Vector3D(0, 0, 0), Vector3D(100, 100, 100));
+  IMP_NEW(Model, m, ());
+  ParticlesTemp ps = create_xyzr_particles(m, n, 0);
+  ParticleIndexes psi = IMP::internal::get_index(ps);
+  ::boost::random::uniform_real_distribution<> rand(0, rmax);
+  for (unsigned int i = 0; i < ps.size(); ++i) {
+    XYZ(ps[i]).set_coordinates(get_random_vector_in(bb));
+    XYZR(ps[i]).set_radius(rand(random_number_generator));
+  }
+  cpf->set_distance(0);
+  unsigned int max_threads = IMP::get_number_of_threads();
+  for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+    cpf->set_number_of_threads(threads);
+    double result = 0;
+    double runtime;
+    IMP_TIME({ result += cpf->get_close_pairs(m, psi).size(); }, runtime);
+    std::ostringstream oss;
+    oss << "cpf scaling " << name << " " << n << " " << rmax << " "
+        << threads << " threads";
+    report(oss.str(), runtime, result);
+  }
+  cpf->set_number_of_threads(0);
+}
 }
 
 int main(int argc, char **argv) {
@@ -83,6 +110,7 @@ int main(int argc, char **argv) {
       test_one(name, cpf, 10000, 0, .5, true);
       test_one(name, cpf, 10000, 0, 5, true);
     }
+    test_scaling(name, cpf, IMP::run_quick_test ? 10000 : 100000, 1);
     // test_one(name, cpf, 100000, 0, .01, 18.648000, true);
     // test_one(name, cpf, 100000, 0, .1, 23.217500, true);
     // test_one(name, cpf, 100000, 0, .3, 51.800000, true);
@@ -115,6 +143,7 @@ int main(int argc, char **argv) {
       test_one(name, cpf, 10000, 0, .5);
       test_one(name, cpf, 10000, 0, 5);
     }
+    test_scaling(name, cpf, IMP::run_quick_test ? 10000 : 100000, 1);
     // test_one(name, cpf, 100000, 0, .01, 44.696000);
     // test_one(name, cpf, 100000, 0, .1, 95.830000);
     // test_one(name, cpf, 100000, 0, .3, 198.320000);
@@ -10,6 +10,14 @@
 #include <IMP/flags.h>
 #include <IMP/container/PairContainerSet.h>
 #include <IMP/container/ListPairContainer.h>
+#include <IMP/container/ListSingletonContainer.h>
+#include <IMP/container/ClosePairContainer.h>
+#include <IMP/container/PairsRestraint.h>
+#include <IMP/internal/ArenaAllocator.h>
+#include <IMP/particle_index.h>
+#include <IMP/algebra/vector_generators.h>
+#include <atomic>
+#include <cstdlib>
 
 #if BOOST_VERSION >= 107300
 using namespace boost::placeholders;
@@ -20,6 +28,21 @@ using namespace IMP::core;
 using namespace IMP::algebra;
 using namespace IMP::container;
 
+// Count all heap allocations, so that the number made during each
+// evaluation can be reported
+std::atomic<unsigned long> num_heap_allocations(0);
+
+void *operator new(std::size_t size) {
+  ++num_heap_allocations;
+  void *p = std::malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
 namespace {
 
 #define IMP_GET_EVALUATE(Class)                           \
@@ -178,11 +201,52 @@ void test_set(int n) {
   IMP_NEW(SoftSpherePairScore, dps, (1));
   time_both(pcs, dps, "set");
 }
+
+void test_allocations(unsigned int n) {
+  set_log_level(SILENT);
+  IMP_NEW(Model, m, ());
+  ParticlesTemp ps = create_xyzr_particles(m, n, .1);
+  ParticleIndexes pis = IMP::get_indexes(ps);
+  IMP_NEW(ListSingletonContainer, lsc, (m, pis));
+  IMP_NEW(ClosePairContainer, cpc, (lsc, 0., .1));
+  IMP_NEW(SoftSpherePairScore, dps, (1));
+  IMP_NEW(PairsRestraint, pr, (dps, cpc));
+  Pointer<ScoringFunction> sf = pr->create_scoring_function();
+  sf->evaluate(true);
+  BoundingBox3D move(Vector3D(-.5, -.5, -.5), Vector3D(.5, .5, .5));
+  IMP::internal::reset_arena_statistics();
+  unsigned long heap_allocations = 0, evaluations = 0;
+  double runtime = 0, total = 0;
+  IMP_TIME({
+             // move a few particles by more than the slack, so that the
+             // close pairs are updated incrementally
+             for (unsigned int i = 0; i < 5; ++i) {
+               XYZ d(m, pis[(5 * evaluations + i) % pis.size()]);
+               d.set_coordinates(d.get_coordinates()
+                                 + get_random_vector_in(move));
+             }
+             unsigned long start = num_heap_allocations;
+             total += sf->evaluate(true);
+             heap_allocations += num_heap_allocations - start;
+             ++evaluations;
+           },
+           runtime);
+  IMP::internal::ArenaStatistics stats = IMP::internal::get_arena_statistics();
+  std::ostringstream oss;
+  oss << "allocations " << n;
+  IMP::benchmark::report(oss.str(), "evaluate", runtime, total);
+  IMP::benchmark::report(oss.str(), "heap allocations per evaluate", runtime,
+                         static_cast<double>(heap_allocations) / evaluations);
+  IMP::benchmark::report(
+      oss.str(), "arena allocations per evaluate", runtime,
+      static_cast<double>(stats.arena_allocations) / evaluations);
+}
 }
 
 int main(int argc, char **argv) {
   IMP::setup_from_argv(argc, argv, "Benchmark evaluation");
   { test(100); }
   { test_set(100); }
+  { test_allocations(IMP::run_quick_test ? 100 : 1000); }
   return IMP::benchmark::get_return_value();
 }
@@ -89,6 +89,44 @@ void test_one(std::string name, ClosePairsFinder *cpf, unsigned int n,
       << " " << n << " " << rmax;
   report(oss.str(), name, runtime - setuptime, result);
 }
+
+// move a small fraction of the particles a short distance each step, as
+// in Brownian dynamics, so that the container can update incrementally
+void test_diffusion(std::string name, ClosePairsFinder *cpf, unsigned int n,
+                    double moved_fraction) {
+  BoundingBox3D bb(Vector3D(0, 0, 0), Vector3D(100, 100, 100));
+  IMP_NEW(Model, m, ());
+  ParticlesTemp ps = create_xyzr_particles(m, n, .5);
+  ParticleIndexes pis = IMP::internal::get_index(ps);
+  for (unsigned int i = 0; i < pis.size(); ++i) {
+    XYZ(m, pis[i]).set_coordinates(get_random_vector_in(bb));
+  }
+  IMP_NEW(ListSingletonContainer, lsc, (m, pis));
+  IMP_NEW(ClosePairContainer, cpc, (lsc, 1.0, cpf, 1.0));
+  IMP_NEW(ConstPairScore, cps, ());
+  IMP_NEW(PairsRestraint, pr, (cps, cpc));
+  pr->evaluate(false);
+  Sphere3D step(get_zero_vector_d<3>(), 1.0);
+  unsigned int nmoved = std::max(1U, static_cast<unsigned int>(
+                                         moved_fraction * pis.size()));
+  unsigned int offset = 0;
+  double runtime;
+  double result = 0;
+  IMP_TIME({
+             for (unsigned int i = 0; i < nmoved; ++i) {
+               XYZ d(m, pis[(offset + i) % pis.size()]);
+               d.set_coordinates(d.get_coordinates() +
+                                 get_random_vector_in(step));
+             }
+             offset += nmoved;
+             result += pr->evaluate(false);
+           },
+           runtime);
+  std::ostringstream oss;
+  oss << "diffusion"
+      << " " << n << " " << moved_fraction;
+  report(oss.str(), name, runtime, result);
+}
 }
 
 int main(int argc, char **argv) {
@@ -125,5 +163,21 @@ int main(int argc, char **argv) {
       test_one("grid", cpf, 10000, 0, .5, 1145.327934);
     }
   }
+  {
+    IMP_NEW(SpatialHashClosePairsFinder, cpf, ());
+    if (IMP::run_quick_test) {
+      test_one("spatial hash", cpf, 100, 0, .1, 23.649063);
+    } else {
+      test_one("spatial hash", cpf, 10000, 0, .1, 23.649063);
+      test_one("spatial hash", cpf, 10000, 0, .5, 1145.327934);
+    }
+  }
+  {
+    unsigned int n = IMP::run_quick_test ? 1000 : 100000;
+    IMP_NEW(GridClosePairsFinder, gcpf, ());
+    test_diffusion("grid", gcpf, n, .01);
+    IMP_NEW(SpatialHashClosePairsFinder, shcpf, ());
+    test_diffusion("spatial hash", shcpf, n, .01);
+  }
   return IMP::benchmark::get_return_value();
 }
@@ -49,7 +49,8 @@ void test_one(std::string name, Restraint *r, RigidBodies rbs,
   IMP::benchmark::report(oss.str(), name, runtime - inittime, value);
 }
 
-Restraint *setup(Model *m, bool rpcpf, RigidBodies &rbs) {
+Restraint *setup(Model *m, bool rpcpf, RigidBodies &rbs,
+                 unsigned int num_threads = 1) {
   set_log_level(SILENT);
   set_check_level(NONE);
   Particles atoms;
@@ -78,6 +79,7 @@ Restraint *setup(Model *m, bool rpcpf, RigidBodies &rbs) {
     }
     lsc->set(rbsp);
     IMP_NEW(RigidClosePairsFinder, rcps, ());
+    rcps->set_number_of_threads(num_threads);
     cpc = new container::internal::ClosePairContainer(lsc, 0.0, rcps);
   } else {
     IMP_NEW(GridClosePairsFinder, cpf, ());
@@ -86,6 +88,40 @@ Restraint *setup(Model *m, bool rpcpf, RigidBodies &rbs) {
   }
   return IMP::create_restraint(new DistancePairScore(new Linear(1, 0)), cpc);
 }
+
+RigidBody create_cloud(Model *m, unsigned int n, double side,
+                       ParticleIndexes &members) {
+  BoundingBox3D bb(Vector3D(0, 0, 0), Vector3D(side, side, side));
+  ParticlesTemp ps;
+  for (unsigned int i = 0; i < n; ++i) {
+    IMP_NEW(Particle, p, (m));
+    XYZR::setup_particle(p, Sphere3D(get_random_vector_in(bb), 1.0));
+    ps.push_back(p);
+    members.push_back(p->get_index());
+  }
+  IMP_NEW(Particle, rbp, (m));
+  return RigidBody::setup_particle(rbp, ps);
+}
+
+/* Time the tree-tree search between two large overlapping rigid bodies
+   with different numbers of threads. */
+void test_threads(unsigned int num_threads) {
+  IMP_NEW(Model, m, ());
+  ParticleIndexes ma, mb;
+  ParticleIndex a = create_cloud(m, 5000, 60, ma).get_particle_index();
+  ParticleIndex b = create_cloud(m, 5000, 60, mb).get_particle_index();
+  IMP_NEW(RigidClosePairsFinder, rcps, ());
+  rcps->set_distance(2.0);
+  rcps->set_number_of_threads(num_threads);
+  // build the trees outside of the timed region
+  double value = rcps->get_close_pairs(m, a, b, ma, mb).size();
+  double runtime;
+  IMP_TIME({ value += rcps->get_close_pairs(m, a, b, ma, mb).size(); },
+           runtime);
+  std::ostringstream oss;
+  oss << "tree pairs " << num_threads << " threads";
+  IMP::benchmark::report(oss.str(), "hierarchy", runtime, value);
+}
 }
 
 int main(int argc, char **argv) {
@@ -106,5 +142,14 @@ int main(int argc, char **argv) {
     test_one("hierarchy", r, rbs, 10, 11.549620);
     test_one("hierarchy", r, rbs, 30, 5.830277);
   }
+  {
+    RigidBodies rbs;
+    IMP::PointerMember<Model> m(new IMP::Model());
+    IMP::PointerMember<Restraint> r = setup(m, true, rbs, 4);
+    test_one("hierarchy 4 threads", r, rbs, 10, 11.549620);
+  }
+  for (unsigned int t = 1; t <= 8; t *= 2) {
+    test_threads(t);
+  }
   return IMP::benchmark::get_return_value();
 }
@@ -10,6 +10,7 @@
 
 #include <IMP/container/container_config.h>
 #include <IMP/core/ClosePairsFinder.h>
+#include <IMP/core/SpatialHashClosePairsFinder.h>
 #include <IMP/core/internal/MovedSingletonContainer.h>
 #include <IMP/core/PairRestraint.h>
 #include <IMP/PairContainer.h>
@@ -19,6 +20,7 @@
 #include <IMP/SingletonContainer.h>
 #include <IMP/internal/ContainerScoreState.h>
 #include <IMP/internal/ListLikeContainer.h>
+#include <boost/unordered_map.hpp>
 #include <cereal/access.hpp>
 #include <cereal/types/base_class.hpp>
 
@@ -35,6 +37,11 @@ class IMPCONTAINEREXPORT ClosePairContainer
   unsigned int updates_, rebuilds_, partial_rebuilds_;
   typedef IMP::internal::ContainerScoreState<ClosePairContainer> SS;
   PointerMember<SS> score_state_;
+  // when using a SpatialHashClosePairsFinder, the sorted neighbors of each
+  // particle and the position of each pair in the list, so that the list
+  // can be updated from only the particles that moved
+  IndexVector<ParticleIndexTag, ParticleIndexes> neighbors_;
+  boost::unordered_map<ParticleIndexPair, unsigned int> pair_positions_;
 
   friend class cereal::access;
 
@@ -57,7 +64,12 @@ class IMPCONTAINEREXPORT ClosePairContainer
   void check_list(bool include_slack) const;
   void do_first_call();
   void do_incremental();
+  void do_incremental(core::SpatialHashClosePairsFinder *cpf);
   void do_rebuild();
+  core::SpatialHashClosePairsFinder *get_spatial_hash_finder() const;
+  void set_neighbors(const ParticleIndexPairs &pairs);
+  void add_pair(ParticleIndex a, ParticleIndex b, ParticleIndexPairs &cur);
+  void remove_pair(ParticleIndex a, ParticleIndex b, ParticleIndexPairs &cur);
 
  public:
   ModelObjectsTemp get_score_state_inputs() const;
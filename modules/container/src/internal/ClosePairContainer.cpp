@@ -15,7 +15,9 @@
 #include <IMP/PairModifier.h>
 #include <boost/unordered_set.hpp>
 #include <IMP/utility.h>
+#include <IMP/internal/ArenaAllocator.h>
 #include <algorithm>
+#include <iterator>
 
 #include <IMP/core/RigidClosePairsFinder.h>
 #include <IMP/core/rigid_bodies.h>
@@ -172,18 +174,23 @@ void ClosePairContainer::do_incremental() {
   pf.back()->set_was_used(true);
   cpf_->set_pair_filters(pf);
   cpf_->set_distance(distance_ + 2 * slack_);
-  ParticleIndexPairs ret;
+  ParticleIndexPairs ret, ret1;
   // Go over particles that moved
   IMP_CONTAINER_ACCESS(SingletonContainer, moved_, {
     const ParticleIndexes &moved = imp_indexes;
     IMP_CONTAINER_ACCESS(
         SingletonContainer, c_,
         ret = cpf_->get_close_pairs(get_model(), imp_indexes, moved));
-    ParticleIndexPairs ret1 = cpf_->get_close_pairs(get_model(), moved);
-    ret.insert(ret.begin(), ret1.begin(), ret1.end());
+    ret1 = cpf_->get_close_pairs(get_model(), moved);
     core::internal::fix_order(ret);
+    core::internal::fix_order(ret1);
     moved_count_ += moved.size();
     });
+  // scratch space for the new pairs, freed at the end of evaluation
+  IMP::internal::ArenaVector<ParticleIndexPair> found;
+  found.reserve(ret.size() + ret1.size());
+  found.insert(found.end(), ret1.begin(), ret1.end());
+  found.insert(found.end(), ret.begin(), ret.end());
   {
     /*InList il= InList::create(moved);
       remove_from_list_if(il);
@@ -196,34 +203,131 @@ void ClosePairContainer::do_incremental() {
     swap(cur);
     moved_count_ = 0;
   }
-  IMP_LOG_TERSE("Found " << ret.size() << " pairs." << std::endl);
+  IMP_LOG_TERSE("Found " << found.size() << " pairs." << std::endl);
   {
-    // now insert
-    std::sort(ret.begin(), ret.end());
+    // now insert; merge into scratch space rather than using
+    // inplace_merge, which allocates its own buffer
+    std::sort(found.begin(), found.end());
     ParticleIndexPairs all;
     swap(all);
-    unsigned int osz = all.size();
-    all.insert(all.end(), ret.begin(), ret.end());
-    std::inplace_merge(all.begin(), all.begin() + osz, all.end());
-    all.erase(std::unique(all.begin(), all.end()), all.end());
+    IMP::internal::ArenaVector<ParticleIndexPair> merged;
+    merged.reserve(all.size() + found.size());
+    std::merge(all.begin(), all.end(), found.begin(), found.end(),
+               std::back_inserter(merged));
+    merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+    all.assign(merged.begin(), merged.end());
     swap(all);
   }
   moved_->reset_moved();
   IMP_LOG_TERSE("Count is now " << get_access().size() << std::endl);
 }
 
+void ClosePairContainer::do_incremental(
+    core::SpatialHashClosePairsFinder *cpf) {
+  IMP_LOG_TERSE("Handling incremental update of ClosePairContainer"
+                << " from the spatial hash" << std::endl);
+  ++partial_rebuilds_;
+  using IMP::operator<<;
+  cpf->set_pair_filters(access_pair_filters());
+  ParticleIndexPairs cur;
+  swap(cur);
+  const ParticleIndexes &moved = moved_->get_access();
+  IMP_LOG_VERBOSE("Moved " << moved << std::endl);
+  // the hash positions must match the ones moved_ uses as reference
+  cpf->update_particles(moved);
+  for (ParticleIndex pi : moved) {
+    ParticleIndexes nbs = cpf->get_stored_neighbors(pi);
+    std::sort(nbs.begin(), nbs.end());
+    resize_to_fit(neighbors_, pi, ParticleIndexes());
+    // compare the sorted old and new neighbor lists
+    const ParticleIndexes &old = neighbors_[pi];
+    ParticleIndexes removed, added;
+    std::set_difference(old.begin(), old.end(), nbs.begin(), nbs.end(),
+                        std::back_inserter(removed));
+    std::set_difference(nbs.begin(), nbs.end(), old.begin(), old.end(),
+                        std::back_inserter(added));
+    for (ParticleIndex nb : removed) remove_pair(pi, nb, cur);
+    for (ParticleIndex nb : added) add_pair(pi, nb, cur);
+  }
+  swap(cur);
+  moved_->reset_moved();
+  IMP_LOG_TERSE("Count is now " << get_access().size() << std::endl);
+}
+
+void ClosePairContainer::add_pair(ParticleIndex a, ParticleIndex b,
+                                  ParticleIndexPairs &cur) {
+  ParticleIndexPair pp = a < b ? ParticleIndexPair(a, b)
+                               : ParticleIndexPair(b, a);
+  pair_positions_[pp] = cur.size();
+  cur.push_back(pp);
+  resize_to_fit(neighbors_, b, ParticleIndexes());
+  ParticleIndexes &na = neighbors_[a], &nb = neighbors_[b];
+  na.insert(std::lower_bound(na.begin(), na.end(), b), b);
+  nb.insert(std::lower_bound(nb.begin(), nb.end(), a), a);
+}
+
+void ClosePairContainer::remove_pair(ParticleIndex a, ParticleIndex b,
+                                     ParticleIndexPairs &cur) {
+  ParticleIndexPair pp = a < b ? ParticleIndexPair(a, b)
+                               : ParticleIndexPair(b, a);
+  boost::unordered_map<ParticleIndexPair, unsigned int>::iterator it =
+      pair_positions_.find(pp);
+  IMP_INTERNAL_CHECK(it != pair_positions_.end(),
+                     "Pair " << pp << " is not in the list");
+  // move the last pair into the hole
+  unsigned int pos = it->second;
+  pair_positions_.erase(it);
+  if (pos + 1 != cur.size()) {
+    cur[pos] = cur.back();
+    pair_positions_[cur[pos]] = pos;
+  }
+  cur.pop_back();
+  ParticleIndexes &na = neighbors_[a], &nb = neighbors_[b];
+  na.erase(std::lower_bound(na.begin(), na.end(), b));
+  nb.erase(std::lower_bound(nb.begin(), nb.end(), a));
+}
+
+void ClosePairContainer::set_neighbors(const ParticleIndexPairs &pairs) {
+  neighbors_.clear();
+  pair_positions_.clear();
+  for (unsigned int i = 0; i < pairs.size(); ++i) {
+    ParticleIndex a = std::get<0>(pairs[i]), b = std::get<1>(pairs[i]);
+    resize_to_fit(neighbors_, std::max(a, b), ParticleIndexes());
+    neighbors_[a].push_back(b);
+    neighbors_[b].push_back(a);
+    pair_positions_[pairs[i]] = i;
+  }
+  for (ParticleIndexes &nbs : neighbors_) {
+    std::sort(nbs.begin(), nbs.end());
+  }
+}
+
+core::SpatialHashClosePairsFinder *
+ClosePairContainer::get_spatial_hash_finder() const {
+  return dynamic_cast<core::SpatialHashClosePairsFinder *>(cpf_.get());
+}
+
 void ClosePairContainer::do_rebuild() {
   IMP_LOG_TERSE("Handling full update of ClosePairContainer." << std::endl);
   ++rebuilds_;
   cpf_->set_pair_filters(access_pair_filters());
   cpf_->set_distance(distance_ + 2 * slack_);
-  ParticleIndexPairs ret =
-      cpf_->get_close_pairs(get_model(), c_->get_indexes());
+  core::SpatialHashClosePairsFinder *shcpf = get_spatial_hash_finder();
+  ParticleIndexPairs ret;
+  if (shcpf) {
+    // keep the hash for later incremental updates
+    shcpf->set_particles(get_model(), c_->get_indexes(), this,
+                         c_->get_contents_hash());
+    ret = shcpf->get_stored_close_pairs();
+  } else {
+    ret = cpf_->get_close_pairs(get_model(), c_->get_indexes());
+  }
   core::internal::fix_order(ret);
   IMP_LOG_TERSE("Found before filtering " << ret << " pairs." << std::endl);
   core::internal::filter_close_pairs(this, ret);
   IMP_LOG_TERSE("Found " << ret << " pairs." << std::endl);
   std::sort(ret.begin(), ret.end());
+  if (shcpf) set_neighbors(ret);
   swap(ret);
   moved_->reset();
 }
@@ -241,7 +345,22 @@ void ClosePairContainer::do_score_state_before_evaluate() {
       do_first_call();
       check_list(true);
     } else if (moved_->get_access().size() != 0) {
-      if (moved_->get_access().size() < 1000) {
+      unsigned int nmoved = moved_->get_access().size();
+      core::SpatialHashClosePairsFinder *shcpf = get_spatial_hash_finder();
+      if (shcpf) {
+        // updates are proportional to the number moved, so only rebuild
+        // if most particles moved or the hash is not for this container
+        // (the finder may be shared, or the contents may have changed)
+        unsigned int n = c_->get_contents().size();
+        if (2 * nmoved < n
+            && shcpf->get_is_stored(this, c_->get_contents_hash())) {
+          do_incremental(shcpf);
+          check_list(false);
+        } else {
+          do_rebuild();
+          check_list(true);
+        }
+      } else if (nmoved < 1000) {
         do_incremental();
         check_list(false);
       } else {
@@ -0,0 +1,109 @@
+#include <IMP/Model.h>
+#include <IMP/flags.h>
+#include <IMP/core/XYZR.h>
+#include <IMP/core/SpatialHashClosePairsFinder.h>
+#include <IMP/algebra/vector_generators.h>
+#include <IMP/internal/StaticListContainer.h>
+#include <IMP/test/test_macros.h>
+#include <IMP/container/internal/ClosePairContainer.h>
+#include <boost/unordered_set.hpp>
+
+namespace {
+std::string get_module_name() { return "anon"; }
+std::string get_module_version() { return "anon"; }
+
+void check_close_pairs(IMP::Model *m, const IMP::ParticleIndexes &pis,
+                       double distance, IMP::ParticleIndexPairs found) {
+  boost::unordered_set<IMP::ParticleIndexPair> fs(found.begin(), found.end());
+  IMP_TEST_EQUAL(fs.size(), found.size());
+  for (unsigned int i = 0; i < pis.size(); ++i) {
+    for (unsigned int j = 0; j < i; ++j) {
+      double d = IMP::core::get_distance(IMP::core::XYZR(m, pis[i]),
+                                         IMP::core::XYZR(m, pis[j]));
+      if (d < distance) {
+        IMP::ParticleIndexPair pp(std::min(pis[i], pis[j]),
+                                  std::max(pis[i], pis[j]));
+        IMP_TEST_TRUE(fs.find(pp) != fs.end());
+      }
+    }
+  }
+}
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    IMP::setup_from_argv(argc, argv,
+                         "Test incremental updates with a spatial hash.");
+    IMP_NEW(IMP::Model, m, ());
+    IMP::algebra::BoundingBox3D bb(IMP::algebra::Vector3D(0, 0, 0),
+                                   IMP::algebra::Vector3D(15, 15, 15));
+    IMP::ParticleIndexes pis;
+    for (unsigned int i = 0; i < 400; ++i) {
+      IMP::ParticleIndex pi = m->add_particle("p");
+      IMP::core::XYZR::setup_particle(
+          m, pi, IMP::algebra::Sphere3D(IMP::algebra::get_random_vector_in(bb),
+                                        .5));
+      pis.push_back(pi);
+    }
+    IMP_NEW(IMP::internal::StaticListContainer<IMP::SingletonContainer>, lsc,
+            (m, "lsc"));
+    lsc->set(pis);
+    const double distance = 1.;
+    IMP_NEW(IMP::container::internal::ClosePairContainer, cpc,
+            (lsc, distance, new IMP::core::SpatialHashClosePairsFinder(), .5));
+    IMP::algebra::Sphere3D step(IMP::algebra::get_zero_vector_d<3>(), 1.5);
+    for (unsigned int i = 0; i < 50; ++i) {
+      m->update();
+      check_close_pairs(m, pis, distance, cpc->get_indexes());
+      // move a few particles, some far enough to change their cell
+      for (unsigned int j = i % 10; j < pis.size(); j += 10) {
+        IMP::core::XYZR d(m, pis[j]);
+        d.set_coordinates(d.get_coordinates() +
+                          IMP::algebra::get_random_vector_in(step));
+      }
+      // and occasionally grow one, forcing the hash to be rebinned
+      if (i % 20 == 19) {
+        IMP::core::XYZR(m, pis[i]).set_radius(1. + .1 * i);
+      }
+    }
+    IMP_TEST_EQUAL(cpc->get_number_of_full_rebuilds(), 1U);
+    IMP_TEST_GREATER_THAN(cpc->get_number_of_partial_rebuilds(), 0U);
+
+    // two containers of the same size sharing one finder must each
+    // get their own pairs, not those of the other's stored hash
+    IMP::ParticleIndexes other_pis;
+    for (unsigned int i = 0; i < pis.size(); ++i) {
+      IMP::ParticleIndex pi = m->add_particle("q");
+      IMP::core::XYZR::setup_particle(
+          m, pi, IMP::algebra::Sphere3D(IMP::algebra::get_random_vector_in(bb),
+                                        .5));
+      other_pis.push_back(pi);
+    }
+    IMP_NEW(IMP::internal::StaticListContainer<IMP::SingletonContainer>,
+            other_lsc, (m, "other lsc"));
+    other_lsc->set(other_pis);
+    IMP_NEW(IMP::core::SpatialHashClosePairsFinder, shared, ());
+    IMP_NEW(IMP::container::internal::ClosePairContainer, cpc0,
+            (lsc, distance, shared, .5));
+    IMP_NEW(IMP::container::internal::ClosePairContainer, cpc1,
+            (other_lsc, distance, shared, .5));
+    for (unsigned int i = 0; i < 10; ++i) {
+      m->update();
+      check_close_pairs(m, pis, distance, cpc0->get_indexes());
+      check_close_pairs(m, other_pis, distance, cpc1->get_indexes());
+      for (unsigned int j = i % 10; j < pis.size(); j += 10) {
+        IMP::core::XYZR d(m, pis[j]);
+        d.set_coordinates(d.get_coordinates() +
+                          IMP::algebra::get_random_vector_in(step));
+        IMP::core::XYZR od(m, other_pis[j]);
+        od.set_coordinates(od.get_coordinates() +
+                           IMP::algebra::get_random_vector_in(step));
+      }
+    }
+  }
+  catch (const IMP::Exception &e) {
+    std::cerr << "Failed with exception " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
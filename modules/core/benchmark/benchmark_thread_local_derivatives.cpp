@@ -0,0 +1,93 @@
+/**
+ * Copyright 2007-2022 IMP Inventors. All rights reserved.
+ */
+#include <IMP.h>
+#include <IMP/core.h>
+#include <IMP/algebra.h>
+#include <IMP/benchmark/utility.h>
+#include <IMP/benchmark/benchmark_macros.h>
+#include <IMP/flags.h>
+#include <IMP/thread_macros.h>
+
+IMP_COMPILER_ENABLE_WARNINGS
+namespace {
+std::string get_module_name() { return "benchmark derivatives"; }
+std::string get_module_version() { return IMP::core::get_module_version(); }
+
+// Cheap to score, but writes a derivative for every particle, so that
+// evaluation time is dominated by derivative accumulation
+class DerivativeHeavyRestraint : public IMP::Restraint {
+  IMP::ParticleIndexes pis_;
+
+ public:
+  DerivativeHeavyRestraint(IMP::Model *m, const IMP::ParticleIndexes &pis)
+      : Restraint(m, "DerivativeHeavyRestraint%1%"), pis_(pis) {}
+  void do_add_score_and_derivatives(IMP::ScoreAccumulator sa) const
+      override;
+  IMP::ModelObjectsTemp do_get_inputs() const override;
+  IMP_OBJECT_METHODS(DerivativeHeavyRestraint);
+};
+
+void DerivativeHeavyRestraint::do_add_score_and_derivatives(
+    IMP::ScoreAccumulator sa) const {
+  double score = 0;
+  IMP::Model *m = get_model();
+  for (unsigned int i = 0; i < pis_.size(); ++i) {
+    IMP::core::XYZ d(m, pis_[i]);
+    IMP::algebra::Vector3D v = d.get_coordinates();
+    score += v.get_squared_magnitude();
+    if (sa.get_derivative_accumulator()) {
+      d.add_to_derivatives(2. * v, *sa.get_derivative_accumulator());
+    }
+  }
+  sa.add_score(score);
+}
+
+IMP::ModelObjectsTemp DerivativeHeavyRestraint::do_get_inputs() const {
+  return IMP::get_particles(get_model(), pis_);
+}
+
+void benchmark_mode(IMP::Model *m, IMP::core::RestraintsScoringFunction *sf,
+                    bool thread_local_derivs) {
+  m->set_use_thread_local_derivatives(thread_local_derivs);
+  std::ostringstream oss;
+  oss << (thread_local_derivs ? "thread-local" : "atomic") << " "
+      << IMP::get_number_of_threads();
+  IMP_THREADS((oss, sf), {
+    double time;
+    double score = 0.0;
+    IMP_WALLTIME({ score = sf->evaluate(true); }, time);
+    IMP::benchmark::report(std::string("derivatives ") + oss.str(), time,
+                           score);
+  });
+}
+}
+
+int main(int argc, char **argv) {
+  IMP::setup_from_argv(argc, argv,
+                       "Benchmark atomic vs thread-local derivatives");
+  IMP::algebra::BoundingBox3D bb = IMP::algebra::get_unit_bounding_box_d<3>();
+  IMP_NEW(IMP::Model, m, ());
+  const unsigned int num_restraints =
+      (IMP::run_quick_test || IMP_BUILD == IMP_DEBUG) ? 4 : 64;
+  const unsigned int num_particles =
+      (IMP::run_quick_test || IMP_BUILD == IMP_DEBUG) ? 10 : 20000;
+  // All restraints act on the same particles, to maximize contention
+  IMP::ParticleIndexes pis;
+  for (unsigned int j = 0; j < num_particles; ++j) {
+    IMP_NEW(IMP::Particle, p, (m));
+    IMP::core::XYZ::setup_particle(p, IMP::algebra::get_random_vector_in(bb));
+    pis.push_back(p->get_index());
+  }
+  IMP::Restraints rs;
+  for (unsigned int i = 0; i < num_restraints; ++i) {
+    IMP_NEW(DerivativeHeavyRestraint, r, (m, pis));
+    rs.push_back(r);
+  }
+  IMP_NEW(IMP::core::RestraintsScoringFunction, sf, (rs));
+  // to update dependency graph and all
+  sf->evaluate(false);
+  benchmark_mode(m, sf, false);
+  benchmark_mode(m, sf, true);
+  return IMP::benchmark::get_return_value();
+}
@@ -16,7 +16,8 @@ IMPCORE_BEGIN_NAMESPACE
 #if defined(IMP_DOXYGEN) || defined(IMP_CORE_USE_IMP_CGAL)
 //! Find all nearby pairs by sweeping the bounding boxes
 /** This method is much faster than the quadratic one when
-    there are are large sets of points.
+    there are are large sets of points. Large sets are split into slabs
+    along the x axis that are swept using get_number_of_threads() threads.
 
     \requires{class BoxSweepClosePairsFinder, CGAL}
     \see IMP::container::ClosePairsScoreState
@@ -12,6 +12,7 @@
 #include <IMP/PairPredicate.h>
 
 #include <IMP/Object.h>
+#include <IMP/threads.h>
 #include <IMP/SingletonContainer.h>
 #include <IMP/internal/container_helpers.h>
 #include <IMP/model_object_helpers.h>
@@ -37,6 +38,7 @@ class MovedSingletonContainer;
 class IMPCOREEXPORT ClosePairsFinder : public ParticleInputs,
                                        public IMP::Object {
   double distance_;
+  unsigned int number_of_threads_;
 
   friend class cereal::access;
   template<class Archive> void serialize(Archive &ar) {
@@ -46,7 +48,7 @@ class IMPCOREEXPORT ClosePairsFinder : public ParticleInputs,
 
  public:
   ClosePairsFinder(std::string name);
-  ClosePairsFinder() : IMP::Object("") {}
+  ClosePairsFinder() : IMP::Object(""), number_of_threads_(1) {}
   ~ClosePairsFinder();
 
   //! return all close pairs among pc in model m
@@ -72,6 +74,21 @@ class IMPCOREEXPORT ClosePairsFinder : public ParticleInputs,
   double get_distance() const { return distance_; }
   /** @} */
 
+  /** \name Threads
+      Finders that support it split the search into tasks that are run
+      on this many threads. Results do not depend on the number of threads.
+      By default only one thread is used; pass 0 to use
+      IMP::get_number_of_threads(). The setting is ignored if the search
+      is already running inside a parallel region.
+      @{
+  */
+  void set_number_of_threads(unsigned int n) { number_of_threads_ = n; }
+  unsigned int get_number_of_threads() const {
+    return number_of_threads_ ? number_of_threads_
+                              : IMP::get_number_of_threads();
+  }
+  /** @} */
+
  public:
   /** @name Methods to control the set of filters
 
@@ -12,6 +12,7 @@
 #include <IMP/core/core_config.h>
 
 #include <IMP/AttributeOptimizer.h>
+#include <IMP/internal/optimized_attributes.h>
 #include <cereal/access.hpp>
 #include <cereal/types/base_class.hpp>
 
@@ -54,15 +55,16 @@ class IMPCOREEXPORT ConjugateGradients : public AttributeOptimizer {
   // Handle optimization failing badly
   void failure();
 
-  NT get_score(Vector<FloatIndex> float_indices, Vector<NT> &x,
-               Vector<NT> &dscore);
-  bool line_search(Vector<NT> &x, Vector<NT> &dx, NT &alpha,
-                   const Vector<FloatIndex> &float_indices, int &ifun,
+  NT get_score(Vector<NT> &x, Vector<NT> &dscore);
+  bool line_search(Vector<NT> &x, Vector<NT> &dx, NT &alpha, int &ifun,
                    NT &f, NT &dg, NT &dg1, int max_steps,
                    const Vector<NT> &search,
                    const Vector<NT> &estimate);
   Float threshold_;
   Float max_change_;
+  // the optimized attributes, and work vectors kept between calls
+  IMP::internal::OptimizedAttributes attributes_;
+  Vector<NT> x_, dx_, search_, estimate_, destimate_, resy_, ressearch_, v_;
 
   friend class cereal::access;
 
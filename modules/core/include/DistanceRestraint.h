@@ -61,6 +61,16 @@ class IMPCOREEXPORT DistanceRestraint :
                     std::string name = "DistanceRestraint %1%");
   DistanceRestraint() {}
 
+#ifndef SWIG
+  bool get_has_batch_evaluation() const override { return true; }
+
+ protected:
+  void do_evaluate_batch(const ParticleIndexes &pis,
+                         const FloatsList &coordinates_batch,
+                         unsigned int begin, unsigned int end,
+                         Floats &scores) const override;
+#endif
+
 #ifdef SWIG
  protected:
   double unprotected_evaluate(IMP::DerivativeAccumulator *accum) const;
@@ -18,8 +18,10 @@
 #include <IMP/UnaryFunction.h>
 #include <IMP/Refiner.h>
 #include "RigidClosePairsFinder.h"
+#include "SpatialHashClosePairsFinder.h"
 #include <IMP/core/SphereDistancePairScore.h>
 #include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
 
 IMPCORE_BEGIN_NAMESPACE
 
@@ -53,12 +55,37 @@ class IMPCOREEXPORT ExcludedVolumeRestraint : public Restraint {
   mutable algebra::Sphere3Ds rbs_backup_sphere_;
   mutable algebra::Rotation3Ds rbs_backup_rot_;
   mutable algebra::Sphere3Ds xyzrs_backup_;
+  // incremental evaluation
+  bool incremental_;
+  mutable bool cache_valid_;
+  // the rigid body or free particle each particle belongs to
+  mutable boost::unordered_map<ParticleIndex, ParticleIndex> units_;
+  // score of each pair of units, stored under both units
+  mutable boost::unordered_map<
+      ParticleIndex, boost::unordered_map<ParticleIndex, double> >
+      unit_scores_;
+  // running total of unit_scores_, and updates since it was last summed
+  mutable double cached_score_;
+  mutable unsigned int updates_since_sum_;
+  // the bounding spheres of all units, kept up to date as units move
+  mutable PointerMember<SpatialHashClosePairsFinder> units_hash_;
+  // the sphere tree of each rigid body when the scores were cached
+  mutable Vector<Pointer<Object> > rbs_trees_;
 
   void reset_moved() const;
   void initialize() const;
   bool get_if_moved() const;
   void fill_list() const;
   double fill_list_if_good(double max) const;
+  void add_unit_scores(const ParticleIndexPairs &pairs) const;
+  double get_cached_score() const;
+  bool get_tree_changed(unsigned int i) const;
+  void update_trees() const;
+  void add_moved_unit(ParticleIndex pi,
+                      boost::unordered_set<ParticleIndex> &moved) const;
+  double fill_unit_scores() const;
+  double update_unit_scores(const ParticleIndexes &moved_pis,
+                            const ParticleIndexes &reset_pis) const;
   ExcludedVolumeRestraint(SingletonContainerAdaptor sc,
                           SoftSpherePairScore *ssps, ObjectKey ok,
                           double slack = 10);
@@ -87,6 +114,32 @@ class IMPCOREEXPORT ExcludedVolumeRestraint : public Restraint {
 
   void clear_caches() override;
 
+  //! Set whether scores are updated incrementally for moved particles
+  /** In incremental mode, the score of each pair of rigid bodies (or
+      free particles) is cached. evaluate_moved(), as used by MonteCarlo,
+      then only rescores the pairs that involve the moved rigid bodies
+      and particles. The bounding spheres of all units are kept in a
+      spatial hash, so the moved units are only compared with their
+      neighbors and the cost scales with the number of moved bodies
+      rather than the size of the system. The moved particles must be
+      the rigid bodies or particles in the container, or rigid bodies
+      containing them, and must include everything that moved since the
+      last evaluation.
+
+      The cache is rebuilt by any other evaluation and is discarded
+      when derivatives are requested. A rigid body whose sphere tree was
+      rebuilt, for example because RigidBody::on_change() was called
+      after its members or their radii changed, is always rescored.
+      The total score is updated as
+      pairs are rescored, and summed afresh every few hundred updates so
+      that rounding errors do not build up.
+  */
+  void set_use_incremental_evaluation(bool tf) {
+    incremental_ = tf;
+    cache_valid_ = false;
+  }
+  bool get_use_incremental_evaluation() const { return incremental_; }
+
 #if !defined(IMP_DOXYGEN) && !defined(SWIG)
   double unprotected_evaluate_if_good(DerivativeAccumulator *da,
                                       double max) const override;
@@ -94,6 +147,9 @@ class IMPCOREEXPORT ExcludedVolumeRestraint : public Restraint {
  public:
   double unprotected_evaluate(IMP::DerivativeAccumulator *accum) const
       override;
+  double unprotected_evaluate_moved(
+      DerivativeAccumulator *da, const ParticleIndexes &moved_pis,
+      const ParticleIndexes &reset_pis) const override;
   IMP::ModelObjectsTemp do_get_inputs() const override;
   IMP_OBJECT_METHODS(ExcludedVolumeRestraint);
   ;
@@ -17,7 +17,8 @@
 IMPCORE_BEGIN_NAMESPACE
 
 //! Find all nearby pairs by testing all pairs
-/**
+/** Large grids are searched using get_number_of_threads() threads.
+
    \see ClosePairsScoreState
  */
 class IMPCOREEXPORT GridClosePairsFinder : public ClosePairsFinder {
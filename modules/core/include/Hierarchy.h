@@ -108,6 +108,7 @@ class IMPCOREEXPORT Hierarchy : public Decorator {
   //! Signal to the Model that this Hierarchy has changed
   void update_changed_trigger() const {
     get_model()->set_trigger_updated(get_changed_key());
+    internal::add_hierarchy_edit();
   }
 
  public:
@@ -0,0 +1,69 @@
+/**
+ *  \file IMP/core/LBFGS.h
+ *  \brief Limited-memory BFGS optimizer.
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ *
+ */
+
+#ifndef IMPCORE_LBFGS_H
+#define IMPCORE_LBFGS_H
+
+#include <IMP/core/core_config.h>
+
+#include <IMP/AttributeOptimizer.h>
+#include <IMP/internal/optimized_attributes.h>
+
+IMPCORE_BEGIN_NAMESPACE
+
+//! Limited-memory BFGS optimizer.
+/** The inverse Hessian is approximated from the last few steps and
+    gradient changes (see Nocedal, Mathematics of Computation 35 (1980),
+    773-782), and a backtracking line search is done along the resulting
+    direction. Like ConjugateGradients, the optimized attributes are
+    scaled by the ranges from Model::get_range().
+
+    The number of steps passed to optimize() is the maximum number of
+    score evaluations.
+
+    \note Rigid bodies are not handled (and will not be moved by this
+          optimizer).
+*/
+class IMPCOREEXPORT LBFGS : public AttributeOptimizer {
+ public:
+  LBFGS(Model *m, std::string name = "LBFGS%1%");
+
+  //! Set the threshold for the minimum gradient
+  void set_gradient_threshold(Float t) { threshold_ = t; }
+
+  //! Limit how far any attribute can change in one step
+  void set_max_change(Float t) { max_change_ = t; }
+
+  //! Set how many previous steps are used to estimate the Hessian
+  void set_number_of_corrections(unsigned int n) {
+    IMP_USAGE_CHECK(n > 0, "Need at least one correction");
+    num_corrections_ = n;
+  }
+  unsigned int get_number_of_corrections() const { return num_corrections_; }
+
+  virtual Float do_optimize(unsigned int max_steps) override;
+  IMP_OBJECT_METHODS(LBFGS);
+
+ private:
+  double get_score(const Floats &x, Floats &dx);
+  void get_direction(const Floats &g, Floats &d);
+
+  Float threshold_;
+  Float max_change_;
+  unsigned int num_corrections_;
+  IMP::internal::OptimizedAttributes attributes_;
+  // work vectors kept between calls
+  Floats x_, dx_, xn_, dxn_, d_, alpha_, rho_;
+  // the last steps and gradient changes, oldest first from first_
+  Vector<Floats> s_, y_;
+  unsigned int first_, count_;
+};
+
+IMPCORE_END_NAMESPACE
+
+#endif /* IMPCORE_LBFGS_H */
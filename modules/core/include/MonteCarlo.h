@@ -136,6 +136,32 @@ class IMPCOREEXPORT MonteCarlo : public Optimizer {
   void set_maximum_difference(double d) { max_difference_ = d; }
 
   double get_maximum_difference() const { return max_difference_; }
+
+  //! Set the number of moves tried at each step
+  /** If n is greater than one (the default is one), each step uses
+      multiple-try Metropolis: n moves are proposed from the current
+      state, and one of them is picked with probability proportional to
+      its Boltzmann weight. Then n-1 reference moves are proposed from the
+      picked state, and the picked move is accepted with probability given
+      by the ratio of the summed weights of the trial moves to those of
+      the reference moves plus the current state. This takes 2n-1 score
+      evaluations per step, but lets larger moves be accepted.
+
+      The movers must be symmetric (have a proposal ratio of one) and kT
+      must be positive. The trial moves, and then the reference moves,
+      are each scored with one ScoringFunction::evaluate_batch() call, so
+      scores are always computed exactly, ignoring
+      set_maximum_difference(). Each trial and reference move is rolled
+      back with MonteCarloMover::reject(), so movers count all of them as
+      rejected; accepted steps are counted by
+      get_number_of_accepted_steps(). Subclasses that override do_step()
+      ignore this.
+  */
+  void set_number_of_trials(unsigned int n) {
+    IMP_USAGE_CHECK(n > 0, "Need at least one trial");
+    num_trials_ = n;
+  }
+  unsigned int get_number_of_trials() const { return num_trials_; }
   /** @name Movers
 
        The following methods are used to manipulate the list of Movers.
@@ -164,6 +190,8 @@ class IMPCOREEXPORT MonteCarlo : public Optimizer {
   }
 
   MonteCarloMoverResult do_move();
+  //! Take one multiple-try Metropolis step; see set_number_of_trials()
+  void do_multiple_try_step();
   //! a class that inherits from this should override this method
   virtual void do_step();
   //! Get the current energy
@@ -199,6 +227,11 @@ class IMPCOREEXPORT MonteCarlo : public Optimizer {
   }
 
  private:
+  // Count an accepted step with the given score and make it current
+  void accept_step(double score, double last);
+  // Count a step that was rejected
+  void reject_step(double score, double last);
+
   double temp_;
   double last_energy_;
   double best_energy_;
@@ -208,11 +241,14 @@ class IMPCOREEXPORT MonteCarlo : public Optimizer {
   unsigned int stat_num_failures_;
   bool return_best_;
   bool score_moved_;
+  unsigned int num_trials_;
   double min_score_;
   IMP::PointerMember<Configuration> best_;
   ::boost::random::uniform_real_distribution<> rand_;
 };
 
+IMP_OBJECTS(MonteCarlo, MonteCarlos);
+
 //! This variant of Monte Carlo that relaxes after each move
 class IMPCOREEXPORT MonteCarloWithLocalOptimization : public MonteCarlo {
   IMP::PointerMember<Optimizer> opt_;
@@ -10,10 +10,12 @@
 #define IMPCORE_NEIGHBORS_TABLE_H
 
 #include <IMP/core/core_config.h>
+#include "ClosePairsFinder.h"
 #include <IMP/SingletonContainer.h>
+#include <IMP/PairContainer.h>
 #include <IMP/ScoreState.h>
 #include <IMP/Pointer.h>
-#include <boost/unordered_map.hpp>
+#include <IMP/algebra/Vector3D.h>
 
 IMPCORE_BEGIN_NAMESPACE
 
@@ -24,16 +26,36 @@ IMPCORE_BEGIN_NAMESPACE
     As with the container::ClosePairContainer, there may be some
     neighbors returned that are not close neighbors, but all close
     neighbors will be returned.
+
+    The table is either filled from the pairs in a PairContainer, and
+    rebuilt whenever its contents change, or kept as a Verlet list
+    over the particles in a SingletonContainer: all pairs closer than
+    the distance plus a skin are found, and they are only searched for
+    again once some particle has moved more than half the skin.
+
+    The neighbors of each particle are stored contiguously, so they can
+    be iterated over with get_neighbors_begin() and get_neighbors_end().
 */
 class IMPCOREEXPORT NeighborsTable : public ScoreState {
   PointerMember<PairContainer> input_;
+  PointerMember<SingletonContainer> particles_;
+  PointerMember<ClosePairsFinder> cpf_;
+  double skin_;
   std::size_t input_version_;
-  boost::unordered_map<ParticleIndex, ParticleIndexes> data_;
+  bool built_;
+  unsigned int number_of_rebuilds_;
+  // neighbors of particle i are neighbors_[offsets_[i]...offsets_[i+1]]
+  Vector<unsigned int> offsets_;
+  ParticleIndexes neighbors_;
+  // particles and their positions at the last Verlet list rebuild
+  ParticleIndexes verlet_pis_;
+  Vector<algebra::Vector3D> verlet_positions_;
+
+  void build(const ParticleIndexPairs &pairs);
+  bool get_has_moved_too_far() const;
 
  protected:
-  virtual ModelObjectsTemp do_get_inputs() const override {
-    return ModelObjectsTemp(1, input_);
-  }
+  virtual ModelObjectsTemp do_get_inputs() const override;
   virtual ModelObjectsTemp do_get_outputs() const override {
     return ModelObjectsTemp();
   }
@@ -43,12 +65,48 @@ class IMPCOREEXPORT NeighborsTable : public ScoreState {
  public:
   NeighborsTable(PairContainer *input,
                  std::string name = "CloseNeighborsTable%1%");
+
+  //! Keep a Verlet list of the particles in input
+  /** Pairs closer than distance + skin are found with cpf (by default,
+      a GridClosePairsFinder). */
+  NeighborsTable(SingletonContainer *input, double distance, double skin,
+                 ClosePairsFinder *cpf = nullptr,
+                 std::string name = "VerletNeighborsTable%1%");
+
   /** Return all ParticleIndexes that are within the distance threshold
       of this one (plus some that are aren't, for efficiency). */
-  const ParticleIndexes &get_neighbors(ParticleIndex pi) const {
+  ParticleIndexes get_neighbors(ParticleIndex pi) const {
+    return ParticleIndexes(get_neighbors_begin(pi), get_neighbors_end(pi));
+  }
+
+#ifndef SWIG
+  /** \name Neighbor iteration
+      The neighbors of a particle without copying them; the pointers are
+      valid until the table is next updated.
+      @{
+  */
+  const ParticleIndex *get_neighbors_begin(ParticleIndex pi) const {
     set_was_used(true);
-    return data_.find(pi)->second;
+    unsigned int i = pi.get_index();
+    if (i + 1 >= offsets_.size()) return nullptr;
+    return neighbors_.data() + offsets_[i];
+  }
+  const ParticleIndex *get_neighbors_end(ParticleIndex pi) const {
+    unsigned int i = pi.get_index();
+    if (i + 1 >= offsets_.size()) return nullptr;
+    return neighbors_.data() + offsets_[i + 1];
+  }
+  /** @} */
+#endif
+
+  //! Get the number of neighbors of a particle
+  unsigned int get_number_of_neighbors(ParticleIndex pi) const {
+    return get_neighbors_end(pi) - get_neighbors_begin(pi);
   }
+
+  //! Get how many times the table has been rebuilt
+  unsigned int get_number_of_rebuilds() const { return number_of_rebuilds_; }
+
   IMP_OBJECT_METHODS(NeighborsTable);
 };
 
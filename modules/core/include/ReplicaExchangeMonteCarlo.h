@@ -0,0 +1,120 @@
+/**
+ *  \file IMP/core/ReplicaExchangeMonteCarlo.h
+ *  \brief Replica exchange of several MonteCarlo chains in one process.
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ *
+ */
+
+#ifndef IMPCORE_REPLICA_EXCHANGE_MONTE_CARLO_H
+#define IMPCORE_REPLICA_EXCHANGE_MONTE_CARLO_H
+
+#include <IMP/core/core_config.h>
+#include "MonteCarlo.h"
+#include <IMP/Object.h>
+#include <IMP/random.h>
+
+IMPCORE_BEGIN_NAMESPACE
+
+//! Run several MonteCarlo chains at different temperatures and exchange them
+/** Each replica is a MonteCarlo optimizer acting on its own Model; the
+    models should describe the same system, for example by calling the same
+    setup function once per replica. Unlike IMP::mpi::ReplicaExchange, all
+    replicas live in the current process, so no MPI launcher is needed.
+
+    optimize() alternates between running every replica for a number of
+    Monte Carlo steps and attempting exchanges. The replicas are run as
+    separate tasks, on up to get_number_of_threads() threads. Exchanges are
+    tried between neighboring temperatures (alternating between even and
+    odd pairs) using the last accepted energy of each replica, and an
+    accepted exchange swaps the kT of the two replicas.
+
+    Each replica draws its random numbers from its own generator, seeded
+    from set_seed() and the replica's index, so the result does not depend
+    on the number of threads.
+
+    \note The replicas are set to not return the best state, since that
+           would break the chains at each exchange.
+ */
+class IMPCOREEXPORT ReplicaExchangeMonteCarlo : public Object {
+  Vector<PointerMember<MonteCarlo> > replicas_;
+  Floats temperatures_;
+  // temperature index of each replica, and replica at each temperature
+  Ints temperature_index_, replica_index_;
+  Floats energies_;
+  Vector<RandomNumberGenerator> generators_;
+  RandomNumberGenerator exchange_generator_;
+  unsigned int num_threads_;
+  Vector<unsigned int> proposed_, accepted_;
+  Vector<unsigned int> exchanges_tried_, exchanges_accepted_;
+
+  void run_replicas(unsigned int steps);
+  void do_exchanges(unsigned int first);
+
+ public:
+  /** Replica i starts at temperatures[i]; the temperatures must be
+      positive and sorted in increasing order. */
+  ReplicaExchangeMonteCarlo(const MonteCarlos &replicas,
+                            const Floats &temperatures,
+                            std::string name = "ReplicaExchangeMonteCarlo%1%");
+
+  //! Seed the generators of the replicas and of the exchanges
+  /** By default the seed is IMP::get_random_seed(). */
+  void set_seed(boost::uint64_t seed);
+
+  //! Set the maximum number of threads used to run the replicas
+  /** The default is one thread per replica. */
+  void set_number_of_threads(unsigned int n) { num_threads_ = n; }
+  unsigned int get_number_of_threads() const { return num_threads_; }
+
+  //! Run number_of_exchanges rounds of steps_per_exchange steps then exchange
+  /** \return the last accepted energy of the replica at the lowest
+              temperature. */
+  double optimize(unsigned int number_of_exchanges,
+                  unsigned int steps_per_exchange);
+
+  unsigned int get_number_of_replicas() const { return replicas_.size(); }
+  MonteCarlo *get_replica(unsigned int i) const { return replicas_[i]; }
+
+  //! Get the index of the temperature replica i is currently at
+  unsigned int get_temperature_index(unsigned int i) const {
+    return temperature_index_[i];
+  }
+  //! Get the index of the replica currently at temperature t
+  unsigned int get_replica_at_temperature(unsigned int t) const {
+    return replica_index_[t];
+  }
+  double get_temperature(unsigned int t) const { return temperatures_[t]; }
+
+  /** \name Statistics
+      The counts are accumulated over all calls to optimize() until
+      reset_statistics() is called.
+      @{
+   */
+  //! Get the number of Monte Carlo steps proposed by replica i
+  unsigned int get_number_of_proposed_steps(unsigned int i) const {
+    return proposed_[i];
+  }
+  //! Get the number of Monte Carlo steps accepted by replica i
+  unsigned int get_number_of_accepted_steps(unsigned int i) const {
+    return accepted_[i];
+  }
+  //! Get the number of exchanges tried between temperatures t and t+1
+  unsigned int get_number_of_exchanges_tried(unsigned int t) const {
+    return exchanges_tried_[t];
+  }
+  //! Get the number of exchanges accepted between temperatures t and t+1
+  unsigned int get_number_of_exchanges_accepted(unsigned int t) const {
+    return exchanges_accepted_[t];
+  }
+  void reset_statistics();
+  /** @} */
+
+  IMP_OBJECT_METHODS(ReplicaExchangeMonteCarlo);
+};
+
+IMP_OBJECTS(ReplicaExchangeMonteCarlo, ReplicaExchangeMonteCarlos);
+
+IMPCORE_END_NAMESPACE
+
+#endif /* IMPCORE_REPLICA_EXCHANGE_MONTE_CARLO_H */
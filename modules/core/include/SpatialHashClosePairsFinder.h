@@ -0,0 +1,130 @@
+/**
+ *  \file IMP/core/SpatialHashClosePairsFinder.h
+ *  \brief Find close pairs using a spatial hash that can be kept between calls.
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ */
+
+#ifndef IMPCORE_SPATIAL_HASH_CLOSE_PAIRS_FINDER_H
+#define IMPCORE_SPATIAL_HASH_CLOSE_PAIRS_FINDER_H
+
+#include "ClosePairsFinder.h"
+#include <IMP/object_macros.h>
+#include <IMP/core/core_config.h>
+#include <IMP/algebra/grid_indexes.h>
+#include <IMP/algebra/Sphere3D.h>
+#include <IMP/Index.h>
+#include <boost/unordered_map.hpp>
+#include <cereal/access.hpp>
+#include <cereal/types/base_class.hpp>
+
+IMPCORE_BEGIN_NAMESPACE
+
+//! Find all nearby pairs by binning particles into a spatial hash
+/** Particles are put into cubic cells at least as large as the distance
+    plus the largest diameter, so that only the 27 cells around each
+    particle need to be searched.
+
+    In addition to the usual stateless ClosePairsFinder interface, the
+    hash can be kept between calls. set_particles() bins a set of
+    particles, after which update_particles() moves only those particles
+    whose coordinates have changed, and get_stored_neighbors() returns the
+    neighbors of a single particle using the stored positions. This is used
+    by container::ClosePairContainer to update its list in time
+    proportional to the number of particles that moved, rather than to the
+    number of particles in the system. When most particles move between
+    calls, GridClosePairsFinder is usually faster.
+
+    Only one set of particles is stored at a time, so a finder shared by
+    several users should be given an owner and contents hash in
+    set_particles(); each user can then check with get_is_stored()
+    that the stored set is still its own, and rebuild it if not.
+
+    \see ClosePairsScoreState
+ */
+class IMPCOREEXPORT SpatialHashClosePairsFinder : public ClosePairsFinder {
+  typedef algebra::ExtendedGridIndex3D Cell;
+  typedef boost::unordered_map<Cell, ParticleIndexes> Cells;
+
+  // stored state, rebuilt by set_particles()
+  WeakPointer<Model> m_;
+  double stored_distance_, cell_size_, max_radius_;
+  Cells cells_;
+  // position of each stored particle when it was last binned
+  IndexVector<ParticleIndexTag, algebra::Sphere3D> spheres_;
+  IndexVector<ParticleIndexTag, int> is_stored_;
+  unsigned int number_stored_;
+  // who stored the particles, and the hash of what they stored
+  const Object *owner_;
+  std::size_t contents_hash_;
+
+  friend class cereal::access;
+  template<class Archive> void serialize(Archive &ar) {
+    ar(cereal::base_class<ClosePairsFinder>(this));
+  }
+  IMP_OBJECT_SERIALIZE_DECL(SpatialHashClosePairsFinder);
+
+  Cell get_cell(const algebra::Vector3D &v) const;
+  void add_to_cell(ParticleIndex pi);
+  void remove_from_cell(ParticleIndex pi);
+  void rebin();
+
+ public:
+  SpatialHashClosePairsFinder();
+  virtual IntPairs get_close_pairs(const algebra::BoundingBox3Ds &bbs) const
+      override;
+  virtual IntPairs get_close_pairs(const algebra::BoundingBox3Ds &bas,
+                                   const algebra::BoundingBox3Ds &bbs) const
+      override;
+  virtual ParticleIndexPairs get_close_pairs(
+      Model *m, const ParticleIndexes &pc) const override;
+  virtual ParticleIndexPairs get_close_pairs(
+      Model *m, const ParticleIndexes &pca,
+      const ParticleIndexes &pcb) const override;
+  virtual ModelObjectsTemp do_get_inputs(
+      Model *m, const ParticleIndexes &pis) const override;
+
+  /** \name Persistent hash
+      These methods maintain a hash of a set of particles between calls.
+      Neighbors are found using the distance at the time of the last
+      set_particles() call, the current pair filters, and the positions of
+      the particles when they were last passed to set_particles() or
+      update_particles().
+      @{
+  */
+  //! Bin the given particles, replacing any that were stored before
+  /** The current distance is stored and used for all later queries,
+      so call set_distance() first. The owner and contents_hash are
+      only stored, for get_is_stored(). */
+  void set_particles(Model *m, const ParticleIndexes &pis,
+                     const Object *owner = nullptr,
+                     std::size_t contents_hash = 0);
+  //! Return true if the stored particles were set by owner
+  /** The contents_hash must also match the one passed to
+      set_particles(). */
+  bool get_is_stored(const Object *owner, std::size_t contents_hash) const {
+    return owner_ == owner && contents_hash_ == contents_hash
+           && number_stored_ > 0;
+  }
+  //! Re-read the positions of the given stored particles
+  /** If any particle's radius has grown past the largest radius used to
+      choose the cell size, everything is rebinned. */
+  void update_particles(const ParticleIndexes &pis);
+  //! Get the stored particles close to the given stored particle
+  /** The particle itself is not included. */
+  ParticleIndexes get_stored_neighbors(ParticleIndex pi) const;
+  //! Get all close pairs among the stored particles
+  ParticleIndexPairs get_stored_close_pairs() const;
+  unsigned int get_number_of_stored_particles() const {
+    return number_stored_;
+  }
+  //! Forget all stored particles
+  void clear_stored_particles();
+  /** @} */
+
+  IMP_OBJECT_METHODS(SpatialHashClosePairsFinder);
+};
+
+IMPCORE_END_NAMESPACE
+
+#endif /* IMPCORE_SPATIAL_HASH_CLOSE_PAIRS_FINDER_H */
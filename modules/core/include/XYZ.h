@@ -67,7 +67,8 @@ class IMPCOREEXPORT XYZ : public Decorator {
 
   //! Get the ith coordinate
   Float get_coordinate(int i) const {
-    return get_model()->get_sphere(get_particle_index())[i];
+    const Model *m = get_model();
+    return m->get_sphere(get_particle_index())[i];
   }
   //! Get the derivative of the ith coordinate, as accumulated by
   //! add_to_derivative()
@@ -107,7 +108,9 @@ class IMPCOREEXPORT XYZ : public Decorator {
   /** Somewhat suspect based on wanting a Point/Vector differentiation
       but we don't have points */
   const algebra::Vector3D &get_coordinates() const {
-    return get_model()->get_sphere(get_particle_index()).get_center();
+    // read through the const model so the particle is not marked changed
+    const Model *m = get_model();
+    return m->get_sphere(get_particle_index()).get_center();
   }
 
   //! Get the vector of derivatives accumulated by add_to_derivatives().
@@ -65,7 +65,8 @@ class IMPCOREEXPORT XYZR : public XYZ {
 
   //! Return a sphere object
   const algebra::Sphere3D &get_sphere() const {
-    return get_model()->get_sphere(get_particle_index());
+    const Model *m = get_model();
+    return m->get_sphere(get_particle_index());
   }
 
   //! Set the attributes from a sphere
@@ -112,7 +112,7 @@ FarParticle
 (Model *m, double d)
 : d_(d),
     m_(m),
-    model_spheres_table_( m->access_spheres_data() )
+    model_spheres_table_( static_cast<const Model *>(m)->access_spheres_data() )
   {}
 
   bool operator()(const ParticleIndexPair &pp) const {
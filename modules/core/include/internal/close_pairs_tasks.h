@@ -0,0 +1,31 @@
+/**
+ *  \file internal/close_pairs_tasks.h
+ *  \brief Run parts of a close pairs search on several threads.
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ *
+ */
+
+#ifndef IMPCORE_INTERNAL_CLOSE_PAIRS_TASKS_H
+#define IMPCORE_INTERNAL_CLOSE_PAIRS_TASKS_H
+
+#include <IMP/core/core_config.h>
+#include <IMP/internal/executor.h>
+
+IMPCORE_BEGIN_INTERNAL_NAMESPACE
+
+//! Whether a sink can be split into independent per-task sinks
+/** Sinks that only append pairs to an output list (and so always return
+    true) can be filled from several threads: each task gets a copy of the
+    sink writing to its own list with create(), and the lists are
+    appended to the original sink in task order with append(), so the
+    result is the same as a serial search. Specialize this for such sinks.
+*/
+template <class Out>
+struct SplitSink {
+  static const bool value = false;
+};
+
+IMPCORE_END_INTERNAL_NAMESPACE
+
+#endif /* IMPCORE_INTERNAL_CLOSE_PAIRS_TASKS_H */
@@ -12,10 +12,14 @@
 #include <IMP/core/core_config.h>
 #include "../GridClosePairsFinder.h"
 #include "sinks.h"
+#include "close_pairs_tasks.h"
 #include "../QuadraticClosePairsFinder.h"
 #include "../XYZR.h"
 #include <IMP/algebra/standard_grids.h>
 #include <IMP/core/utility.h>
+#include <IMP/internal/ArenaAllocator.h>
+#include <boost/unordered_map.hpp>
+#include <type_traits>
 
 IMPCORE_BEGIN_INTERNAL_NAMESPACE
 
@@ -54,7 +58,7 @@ struct ParticleTraits {
   mutable algebra::Sphere3D const* model_spheres_table_; // faster access to spheres data - this assumes model spheres table remains the same within the lifetime of object
 
   ParticleTraits(Model *m, double d) : m_(m), d_(d),
-    model_spheres_table_( m->access_spheres_data() )
+    model_spheres_table_( static_cast<const Model *>(m)->access_spheres_data() )
   { }
   ParticleIndex get_id(Particle *p, int) const {
     return p->get_index();
@@ -130,21 +134,46 @@ struct BBPairSink {
   bool check_contains(unsigned int, unsigned int) const { return true; }
 };
 
+template <>
+struct SplitSink<BBPairSink> {
+  static const bool value = true;
+  typedef IntPairs Output;
+  static BBPairSink create(const BBPairSink &, Output &out) {
+    return BBPairSink(out);
+  }
+  static void append(BBPairSink &s, const Output &out) {
+    s.out_.insert(s.out_.end(), out.begin(), out.end());
+  }
+};
+
 template <class Traits>
 struct Helper {
   typedef typename Traits::ID ID;
   //! an extension of vector, containing a (template) vector of
   //! Traits::ID, with an integer identifier which_
-  struct IDs : public Vector<ID> {
+  /** These only live as long as a single search, so are allocated from
+      the evaluation arena (one is created for every occupied voxel). */
+  struct IDs : public IMP::internal::ArenaVector<ID> {
     int which_;
     //! an empty ids vector identified by which
     IDs(int which) : which_(which) {}
     //! an ids vector of one element with value id, identified by which
-    IDs(ID id, int which) : Vector<ID>(1, id), which_(which) {}
+    IDs(ID id, int which)
+        : IMP::internal::ArenaVector<ID>(1, id), which_(which) {}
     IDs() : which_(-1) {}
   };
 
-  typedef typename algebra::SparseGrid3D<IDs> Grid;
+  // the voxel map is rebuilt for every search, so allocate it from the
+  // arena too
+  typedef boost::unordered_map<
+      algebra::GridIndexD<3>, IDs, boost::hash<algebra::GridIndexD<3> >,
+      std::equal_to<algebra::GridIndexD<3> >,
+      IMP::internal::ArenaAllocator<
+          std::pair<const algebra::GridIndexD<3>, IDs> > > VoxelMap;
+  typedef algebra::GridD<
+      3, algebra::SparseGridStorageD<3, IDs, algebra::BoundedGridRangeD<3>,
+                                     VoxelMap>,
+      IDs, algebra::DefaultEmbeddingD<3> > Grid;
   typedef Vector<Grid> Grids;
 
   template <class It>
@@ -201,8 +230,8 @@ struct Helper {
 
   template <class It>
   static void partition_points(const ParticleSet<It> &ps, const Traits &tr,
-                               Vector<IDs> &bin_contents,
-                               Floats &bin_ubs) {
+                               IMP::internal::ArenaVector<IDs> &bin_contents,
+                               IMP::internal::ArenaVector<double> &bin_ubs) {
     bin_contents.push_back(IDs(ps.which_));
     for (It c = ps.b_; c != ps.e_; ++c) {
       double cr = tr.get_radius(tr.get_id(*c, ps.which_), ps.which_) + 0;
@@ -373,13 +402,113 @@ struct Helper {
     return true;
   }
 
+  //! number of tasks per thread when searching a grid using several threads
+  static const unsigned int tasks_per_thread = 4;
+  //! least number of voxels searched by each task
+  static const unsigned int min_voxels_per_task = 16;
+
+  //! Search the neighborhood in gg of each voxel of qg
+  /** If half is true, qg must be gg, and each pair of voxels is only
+      searched once. */
+  template <class Out>
+  static bool do_fill_close_pairs_from_grid(const Grid &gg, const Grid &qg,
+                                            bool half, const Traits &tr,
+                                            Out &out, unsigned int,
+                                            std::false_type) {
+    for (typename Grid::AllConstIterator it = qg.all_begin();
+         it != qg.all_end(); ++it) {
+      if (!do_fill_close_pairs(gg, it->first, it->second, half, tr, out)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /* Split the voxels of qg into chunks, each searched by a task writing to
+     its own list. The lists are appended in voxel order, so the output is
+     the same as that of the serial search. */
+  template <class Out>
+  static bool do_fill_close_pairs_from_grid(const Grid &gg, const Grid &qg,
+                                            bool half, const Traits &tr,
+                                            Out &out, unsigned int num_threads,
+                                            std::true_type) {
+    typedef SplitSink<Out> Split;
+    IMP::internal::ArenaVector<std::pair<typename Grid::Index, const IDs *> >
+        voxels;
+    if (num_threads > 1) {
+      for (typename Grid::AllConstIterator it = qg.all_begin();
+           it != qg.all_end(); ++it) {
+        voxels.push_back(std::make_pair(it->first, &it->second));
+      }
+    }
+    unsigned int ntasks = std::min<std::size_t>(
+        num_threads * tasks_per_thread, voxels.size() / min_voxels_per_task);
+    if (ntasks < 2) {
+      return do_fill_close_pairs_from_grid(gg, qg, half, tr, out, num_threads,
+                                           std::false_type());
+    }
+    unsigned int voxels_per_task = (voxels.size() + ntasks - 1) / ntasks;
+    Vector<typename Split::Output> outs(ntasks);
+    auto search = [&](unsigned int t) {
+      Out tout = Split::create(out, outs[t]);
+      unsigned int end = std::min<unsigned int>(voxels.size(),
+                                                (t + 1) * voxels_per_task);
+      for (unsigned int i = t * voxels_per_task; i < end; ++i) {
+        do_fill_close_pairs(gg, voxels[i].first, *voxels[i].second, half, tr,
+                            tout);
+      }
+    };
+    IMP::internal::run_tasks(ntasks, num_threads, search, "close pairs");
+    for (unsigned int t = 0; t < ntasks; ++t) {
+      Split::append(out, outs[t]);
+    }
+    return true;
+  }
+
+  template <class Out>
+  static bool do_fill_close_pairs_from_grid(const Grid &gg, const Grid &qg,
+                                            bool half, const Traits &tr,
+                                            Out &out,
+                                            unsigned int num_threads) {
+    return do_fill_close_pairs_from_grid(
+        gg, qg, half, tr, out, num_threads,
+        std::integral_constant<bool, SplitSink<Out>::value>());
+  }
+
+  /* Call f() in a single parallel region if out can be filled from
+     several threads and there are enough points to need a grid, so that
+     the grids of all bins share it */
+  template <class Out, class F>
+  static bool run_fill_close_pairs(Out &out, std::size_t num_points,
+                                   unsigned int num_threads, const F &f) {
+    if (!SplitSink<Out>::value || num_threads < 2 || num_points < 100) {
+      return f();
+    }
+    bool ret = true;
+    IMP::internal::run_in_parallel_region(num_threads,
+                                          [&]() { ret = f(); });
+    return ret;
+  }
+
+  //! Find close pairs among ps, writing them to out
+  /** If out supports it (see SplitSink), large grids are searched using
+      up to num_threads threads. */
   template <class It, class Out>
   static bool fill_close_pairs(const ParticleSet<It> &ps, const Traits &tr,
-                               Out out) {
+                               Out out, unsigned int num_threads = 1) {
     if (ps.size() == 0) return true;
+    return run_fill_close_pairs(out, ps.size(), num_threads, [&]() {
+      return do_fill_close_pairs_from_bins(ps, tr, out, num_threads);
+    });
+  }
+
+  template <class It, class Out>
+  static bool do_fill_close_pairs_from_bins(const ParticleSet<It> &ps,
+                                            const Traits &tr, Out &out,
+                                            unsigned int num_threads) {
     double maxr = get_max_radius(ps, tr);
-    Vector<IDs> bin_contents_g;
-    Floats bin_ubs;
+    IMP::internal::ArenaVector<IDs> bin_contents_g;
+    IMP::internal::ArenaVector<double> bin_ubs;
     bin_ubs.push_back(maxr);
 
     partition_points(ps, tr, bin_contents_g, bin_ubs);
@@ -394,7 +523,7 @@ struct Helper {
                           << bin_contents_g[i].size() << std::endl);
       }
     }
-    Vector<algebra::BoundingBox3D> bbs(bin_contents_g.size());
+    IMP::internal::ArenaVector<algebra::BoundingBox3D> bbs(bin_contents_g.size());
     for (unsigned int i = 0; i < bin_contents_g.size(); ++i) {
       bbs[i] = get_bb(bin_contents_g[i], tr);
     }
@@ -411,11 +540,9 @@ struct Helper {
                              .01 * (bbs[i].get_corner(1) - bbs[i].get_corner(0))
                                        .get_magnitude()));
         fill_grid(bin_contents_g[i], tr, gg);
-        for (typename Grid::AllConstIterator it = gg.all_begin();
-             it != gg.all_end(); ++it) {
-          if (!do_fill_close_pairs(gg, it->first, it->second, true, tr, out)) {
-            return false;
-          }
+        if (!do_fill_close_pairs_from_grid(gg, gg, true, tr, out,
+                                           num_threads)) {
+          return false;
         }
       }
 #ifdef IMP_GRID_CPF_CHECKS
@@ -449,12 +576,9 @@ struct Helper {
           Grid ggj = ggi;
           fill_grid(bin_contents_g[i], tr, ggi);
           fill_grid(bin_contents_g[j], tr, ggj);
-          for (typename Grid::AllConstIterator it = ggj.all_begin();
-               it != ggj.all_end(); ++it) {
-            if (!do_fill_close_pairs(ggi, it->first, it->second, false, tr,
-                                     out)) {
-              return false;
-            }
+          if (!do_fill_close_pairs_from_grid(ggi, ggj, false, tr, out,
+                                             num_threads)) {
+            return false;
           }
         }
 #ifdef IMP_GRID_CPF_CHECKS
@@ -484,14 +608,26 @@ struct Helper {
     return true;
   }
 
+  //! Find close pairs between psg and psq, writing them to out
   template <class ItG, class ItQ, class Out>
   static bool fill_close_pairs(const ParticleSet<ItG> &psg,
                                const ParticleSet<ItQ> &psq, const Traits &tr,
-                               Out out) {
+                               Out out, unsigned int num_threads = 1) {
     if (psg.size() == 0 || psq.size() == 0) return true;
+    return run_fill_close_pairs(out, psg.size() + psq.size(), num_threads,
+                                [&]() {
+      return do_fill_close_pairs_from_bins(psg, psq, tr, out, num_threads);
+    });
+  }
+
+  template <class ItG, class ItQ, class Out>
+  static bool do_fill_close_pairs_from_bins(const ParticleSet<ItG> &psg,
+                                            const ParticleSet<ItQ> &psq,
+                                            const Traits &tr, Out &out,
+                                            unsigned int num_threads) {
     double maxr = std::max(get_max_radius(psg, tr), get_max_radius(psq, tr));
-    Vector<IDs> bin_contents_g, bin_contents_q;
-    Floats bin_ubs;
+    IMP::internal::ArenaVector<IDs> bin_contents_g, bin_contents_q;
+    IMP::internal::ArenaVector<double> bin_ubs;
     bin_ubs.push_back(maxr);
 
     partition_points(psg, tr, bin_contents_g, bin_ubs);
@@ -512,11 +648,11 @@ struct Helper {
                           << bin_contents_q[i].size() << std::endl);
       }
     }
-    Vector<algebra::BoundingBox3D> bbs_g(bin_contents_g.size());
+    IMP::internal::ArenaVector<algebra::BoundingBox3D> bbs_g(bin_contents_g.size());
     for (unsigned int i = 0; i < bin_contents_g.size(); ++i) {
       bbs_g[i] = get_bb(bin_contents_g[i], tr);
     }
-    Vector<algebra::BoundingBox3D> bbs_q(bin_contents_q.size());
+    IMP::internal::ArenaVector<algebra::BoundingBox3D> bbs_q(bin_contents_q.size());
     for (unsigned int i = 0; i < bin_contents_q.size(); ++i) {
       bbs_q[i] = get_bb(bin_contents_q[i], tr);
     }
@@ -551,12 +687,9 @@ struct Helper {
                   << gq.get_number_of_voxels(ic));
             }
           }
-          for (typename Grid::AllConstIterator it = gq.all_begin();
-               it != gq.all_end(); ++it) {
-            if (!do_fill_close_pairs(gg, it->first, it->second, false, tr,
-                                     out)) {
-              return false;
-            }
+          if (!do_fill_close_pairs_from_grid(gg, gq, false, tr, out,
+                                             num_threads)) {
+            return false;
           }
         }
 #ifdef IMP_GRID_CPF_CHECKS
@@ -60,6 +60,18 @@ struct HierarchyData {
   ObjectKey cache_key_;
 };
 
+//! Record a structural edit to any Hierarchy
+/** Edits are children being added or removed, and nodes being set up as
+    one of the atom decorators that Selection searches by (such as Molecule).
+    The changed trigger only records the Model age of the last edit, so
+    caches built from a hierarchy (such as the atom::Selection index) compare
+    get_hierarchy_edit_count() with the count they were built at instead.
+ */
+IMPCOREEXPORT void add_hierarchy_edit();
+
+//! Return the number of structural Hierarchy edits made so far
+IMPCOREEXPORT unsigned int get_hierarchy_edit_count();
+
 IMPCORE_END_INTERNAL_NAMESPACE
 
 #endif /* IMPCORE_INTERNAL_HIERARCHY_HELPERS_H */
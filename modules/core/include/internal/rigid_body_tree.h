@@ -11,8 +11,11 @@
 #include <IMP/core/core_config.h>
 #include "../XYZ.h"
 #include "../rigid_bodies.h"
+#include "close_pairs_tasks.h"
 #include <IMP/algebra/Sphere3D.h>
+#include <IMP/internal/ArenaAllocator.h>
 #include <queue>
+#include <type_traits>
 #include <cereal/access.hpp>
 #include <cereal/types/base_class.hpp>
 
@@ -95,6 +98,12 @@ class IMPCOREEXPORT RigidBodyHierarchy : public IMP::Object {
     return index;
   }
   algebra::Sphere3Ds get_all_spheres() const;
+  unsigned int get_number_of_nodes() const { return tree_.size(); }
+  //! Get the sphere of node ni in the rigid body's local coordinates
+  const algebra::Sphere3D &get_local_sphere(unsigned int ni) const {
+    IMP_INTERNAL_CHECK(ni < tree_.size(), "Out of spheres vector");
+    return tree_[ni].s_;
+  }
 
   RigidBodyHierarchy(RigidBody rb, const ParticleIndexes &constituents);
 
@@ -174,76 +183,190 @@ inline double distance_bound(Model *, const RigidBodyHierarchy *da,
   return rd;
 }
 
-template <class Sink>
-inline void fill_close_pairs(Model *m, const RigidBodyHierarchy *da,
-                             const RigidBodyHierarchy *db, double dist,
-                             Sink sink) {
-  IMP_IF_CHECK(USAGE_AND_INTERNAL) {
-    da->validate(m);
-    db->validate(m);
-  }
-  typedef std::pair<int, int> IP;
-  typedef std::pair<double, IP> QP;
-  std::priority_queue<QP, Vector<QP>, LessFirst> queue;
-  {
-    double d = distance_bound(m, da, 0, db, 0);
-    if (d < dist) {
-      queue.push(QP(d, IP(0, 0)));
+//! The global spheres of the nodes of a RigidBodyHierarchy
+/** The rigid body's reference frame is read once, and each node is only
+    transformed the first time it is needed. Call fill() before reading
+    the spheres from several threads. */
+class TreeSpheres {
+  const RigidBodyHierarchy *h_;
+  algebra::Transformation3D tr_;
+  IMP::internal::ArenaVector<algebra::Sphere3D> spheres_;
+  IMP::internal::ArenaVector<char> done_;
+
+ public:
+  TreeSpheres(const RigidBodyHierarchy *h)
+      : h_(h),
+        tr_(h->get_rigid_body().get_reference_frame().get_transformation_to()),
+        spheres_(h->get_number_of_nodes()),
+        done_(h->get_number_of_nodes(), 0) {}
+  const algebra::Sphere3D &operator[](unsigned int i) {
+    if (!done_[i]) {
+      const algebra::Sphere3D &s = h_->get_local_sphere(i);
+      spheres_[i] =
+          algebra::Sphere3D(tr_.get_transformed(s.get_center()),
+                            s.get_radius());
+      done_[i] = 1;
     }
+    return spheres_[i];
   }
-  while (!queue.empty()) {
-    QP v = queue.top();
-    queue.pop();
-    /*IMP_LOG_TERSE( "Trying pair " << v.second.first << " " << v.second.second
-      << std::endl);*/
-    if (da->get_is_leaf(v.second.first) && db->get_is_leaf(v.second.second)) {
-      for (unsigned int i = 0; i < da->get_number_of_particles(v.second.first);
-           ++i) {
-        ParticleIndex deca(da->get_particle(v.second.first, i));
-        for (unsigned int j = 0;
-             j < db->get_number_of_particles(v.second.second); ++j) {
-          ParticleIndex decb(db->get_particle(v.second.second, j));
-          double d =
-              algebra::get_distance(m->get_sphere(deca), m->get_sphere(decb));
-          if (d < dist) {
-            if (!sink(deca, decb)) {
-              return;
+  void fill() {
+    for (unsigned int i = 0; i < spheres_.size(); ++i) operator[](i);
+  }
+};
+
+typedef std::pair<int, int> TreeNodePair;
+typedef IMP::internal::ArenaVector<TreeNodePair> TreeNodePairs;
+
+//! Gather the spheres of the children of node ni
+/** A leaf stands in for its own child. The spheres are stored as separate
+    coordinate arrays so that the bound tests are a simple loop. */
+inline void gather_child_spheres(const RigidBodyHierarchy *d, TreeSpheres &ts,
+                                 unsigned int ni,
+                                 IMP::internal::ArenaVector<int> &nodes,
+                                 IMP::internal::ArenaVector<double> xyzr[4]) {
+  unsigned int n = d->get_number_of_children(ni);
+  nodes.resize(n);
+  for (unsigned int k = 0; k < 4; ++k) xyzr[k].resize(n);
+  for (unsigned int i = 0; i < n; ++i) {
+    nodes[i] = d->get_child(ni, i);
+    const algebra::Sphere3D &s = ts[nodes[i]];
+    xyzr[0][i] = s.get_center()[0];
+    xyzr[1][i] = s.get_center()[1];
+    xyzr[2][i] = s.get_center()[2];
+    xyzr[3][i] = s.get_radius();
+  }
+}
+
+//! Walk the trees breadth first from the node pairs in frontier
+/** Pairs of leaves are passed to the sink, and pairs of nodes are
+    replaced by the pairs of their children whose spheres are closer
+    than dist. If levels is not 0, stop after that many levels, leaving
+    the remaining node pairs in frontier.
+    \return false if the sink asked to stop. */
+template <class Sink>
+inline bool fill_close_pairs_breadth_first(
+    Model *m, const RigidBodyHierarchy *da, TreeSpheres &sa,
+    const RigidBodyHierarchy *db, TreeSpheres &sb, double dist,
+    TreeNodePairs &frontier, Sink &sink, unsigned int levels = 0) {
+  const algebra::Sphere3D *spheres =
+      static_cast<const Model *>(m)->access_spheres_data();
+  TreeNodePairs next;
+  IMP::internal::ArenaVector<int> na, nb;
+  IMP::internal::ArenaVector<double> a[4], b[4];
+  IMP::internal::ArenaVector<char> close;
+  for (unsigned int level = 0; !frontier.empty() && (!levels || level < levels);
+       ++level) {
+    next.clear();
+    for (unsigned int p = 0; p < frontier.size(); ++p) {
+      int ia = frontier[p].first, ib = frontier[p].second;
+      if (da->get_is_leaf(ia) && db->get_is_leaf(ib)) {
+        for (unsigned int i = 0; i < da->get_number_of_particles(ia); ++i) {
+          ParticleIndex deca(da->get_particle(ia, i));
+          for (unsigned int j = 0; j < db->get_number_of_particles(ib); ++j) {
+            ParticleIndex decb(db->get_particle(ib, j));
+            double d = algebra::get_distance(spheres[deca.get_index()],
+                                             spheres[decb.get_index()]);
+            if (d < dist) {
+              if (!sink(deca, decb)) {
+                return false;
+              }
             }
           }
         }
+        continue;
       }
-    } else if (da->get_is_leaf(v.second.first)) {
-      for (unsigned int j = 0; j < db->get_number_of_children(v.second.second);
-           ++j) {
-        unsigned int child = db->get_child(v.second.second, j);
-        double d = distance_bound(m, da, v.second.first, db, child);
-        if (d < dist) {
-          queue.push(QP(d, IP(v.second.first, child)));
+      gather_child_spheres(da, sa, ia, na, a);
+      gather_child_spheres(db, sb, ib, nb, b);
+      close.resize(nb.size());
+      for (unsigned int i = 0; i < na.size(); ++i) {
+        // test child i of the first node against all children of the second
+        double x = a[0][i], y = a[1][i], z = a[2][i], r = a[3][i] + dist;
+        for (unsigned int j = 0; j < nb.size(); ++j) {
+          double dx = x - b[0][j], dy = y - b[1][j], dz = z - b[2][j];
+          double lim = r + b[3][j];
+          close[j] = lim > 0 && dx * dx + dy * dy + dz * dz < lim * lim;
         }
-      }
-    } else if (db->get_is_leaf(v.second.second)) {
-      for (unsigned int i = 0; i < da->get_number_of_children(v.second.first);
-           ++i) {
-        unsigned int child = da->get_child(v.second.first, i);
-        double d = distance_bound(m, da, child, db, v.second.second);
-        if (d < dist) {
-          queue.push(QP(d, IP(child, v.second.second)));
-        }
-      }
-    } else {
-      for (unsigned int i = 0; i < da->get_number_of_children(v.second.first);
-           ++i) {
-        unsigned int childa = da->get_child(v.second.first, i);
-        for (unsigned int j = 0;
-             j < db->get_number_of_children(v.second.second); ++j) {
-          unsigned int childb = db->get_child(v.second.second, j);
-          double d = distance_bound(m, da, childa, db, childb);
-          if (d < dist) {
-            queue.push(QP(d, IP(childa, childb)));
-          }
+        for (unsigned int j = 0; j < nb.size(); ++j) {
+          if (close[j]) next.push_back(TreeNodePair(na[i], nb[j]));
         }
       }
     }
+    std::swap(frontier, next);
+  }
+  return true;
+}
+
+//! Number of levels walked before the traversal is split into tasks
+const unsigned int tree_split_levels = 2;
+
+/* Walk the subtrees below each node pair in order, writing to sink. */
+template <class Sink>
+inline void fill_close_pairs_from_frontier(
+    Model *m, const RigidBodyHierarchy *da, TreeSpheres &sa,
+    const RigidBodyHierarchy *db, TreeSpheres &sb, double dist,
+    const TreeNodePairs &frontier, Sink &sink, unsigned int,
+    std::false_type) {
+  for (unsigned int p = 0; p < frontier.size(); ++p) {
+    TreeNodePairs cur(1, frontier[p]);
+    if (!fill_close_pairs_breadth_first(m, da, sa, db, sb, dist, cur, sink)) {
+      return;
+    }
+  }
+}
+
+/* Walk the subtree below each node pair as a task writing to its own
+   list, and append the lists in order, so the output is the same as
+   that of the serial walk. */
+template <class Sink>
+inline void fill_close_pairs_from_frontier(
+    Model *m, const RigidBodyHierarchy *da, TreeSpheres &sa,
+    const RigidBodyHierarchy *db, TreeSpheres &sb, double dist,
+    const TreeNodePairs &frontier, Sink &sink, unsigned int num_threads,
+    std::true_type) {
+  if (num_threads < 2 || frontier.size() < 2) {
+    fill_close_pairs_from_frontier(m, da, sa, db, sb, dist, frontier, sink,
+                                   num_threads, std::false_type());
+    return;
+  }
+  typedef SplitSink<Sink> Split;
+  // the spheres cannot be computed lazily once shared between threads
+  sa.fill();
+  sb.fill();
+  Vector<typename Split::Output> outs(frontier.size());
+  auto walk = [&](unsigned int t) {
+    Sink tsink = Split::create(sink, outs[t]);
+    TreeNodePairs cur(1, frontier[t]);
+    fill_close_pairs_breadth_first(m, da, sa, db, sb, dist, cur, tsink);
+  };
+  IMP::internal::run_tasks(frontier.size(), num_threads, walk, "close pairs");
+  for (unsigned int t = 0; t < frontier.size(); ++t) {
+    Split::append(sink, outs[t]);
+  }
+}
+
+//! Pass the pairs of particles from da and db closer than dist to sink
+/** The trees are walked breadth first. After the top levels, the walk
+    below each remaining pair of nodes can be run as a separate task,
+    using up to num_threads threads if the sink supports it (see
+    SplitSink). The pairs are found in the same order in either case. */
+template <class Sink>
+inline void fill_close_pairs(Model *m, const RigidBodyHierarchy *da,
+                             const RigidBodyHierarchy *db, double dist,
+                             Sink sink, unsigned int num_threads = 1) {
+  IMP_IF_CHECK(USAGE_AND_INTERNAL) {
+    da->validate(m);
+    db->validate(m);
+  }
+  TreeSpheres sa(da), sb(db);
+  TreeNodePairs frontier;
+  if (algebra::get_distance(sa[0], sb[0]) < dist) {
+    frontier.push_back(TreeNodePair(0, 0));
+  }
+  if (fill_close_pairs_breadth_first(m, da, sa, db, sb, dist, frontier, sink,
+                                     tree_split_levels)) {
+    fill_close_pairs_from_frontier(
+        m, da, sa, db, sb, dist, frontier, sink, num_threads,
+        std::integral_constant<bool, SplitSink<Sink>::value>());
   }
 
   IMP_IF_CHECK(USAGE_AND_INTERNAL) {
@@ -264,7 +387,7 @@ inline void fill_close_pairs(Model *m, const RigidBodyHierarchy *da,
 
 IMPCOREEXPORT ParticlePairsTemp close_pairs(
     Model *m, const RigidBodyHierarchy *da,
-    const RigidBodyHierarchy *db, double dist);
+    const RigidBodyHierarchy *db, double dist, unsigned int num_threads = 1);
 
 template <class Sink>
 inline void fill_close_particles(Model *m, const RigidBodyHierarchy *da,
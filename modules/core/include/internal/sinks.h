@@ -13,6 +13,7 @@
 #include "IMP/Particle.h"
 #include "IMP/PairPredicate.h"
 #include "rigid_body_tree.h"
+#include "close_pairs_tasks.h"
 #include <boost/unordered_map.hpp>
 
 IMPCORE_BEGIN_INTERNAL_NAMESPACE
@@ -137,6 +138,31 @@ struct ParticleIndexPairSink {
   }
 };
 
+template <>
+struct SplitSink<ParticlePairSink> {
+  static const bool value = true;
+  typedef ParticlePairsTemp Output;
+  static ParticlePairSink create(const ParticlePairSink &s, Output &out) {
+    return ParticlePairSink(s.m_, s.filters_, out);
+  }
+  static void append(ParticlePairSink &s, const Output &out) {
+    s.out_.insert(s.out_.end(), out.begin(), out.end());
+  }
+};
+
+template <>
+struct SplitSink<ParticleIndexPairSink> {
+  static const bool value = true;
+  typedef ParticleIndexPairs Output;
+  static ParticleIndexPairSink create(const ParticleIndexPairSink &s,
+                                      Output &out) {
+    return ParticleIndexPairSink(s.m_, s.filters_, out);
+  }
+  static void append(ParticleIndexPairSink &s, const Output &out) {
+    s.out_.insert(s.out_.end(), out.begin(), out.end());
+  }
+};
+
 template <class PS>
 struct ParticlePairSinkWithMax : public ParticlePairSink {
   double &score_;
@@ -98,6 +98,10 @@ class IMPCOREEXPORT RigidBody : public XYZ {
 
   static void teardown_constraints(Particle *p);
 
+  // pull back the adjoints of all point members at once
+  void pull_back_points_adjoints(const algebra::Transformation3D &T,
+                                 DerivativeAccumulator &da);
+
   static ObjectKey get_constraint_key_0();
 
   static ObjectKey get_constraint_key_1();
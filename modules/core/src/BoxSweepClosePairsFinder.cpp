@@ -23,7 +23,10 @@ IMP_CLANG_PRAGMA(diagnostic ignored "-Wc++11-extensions")
 #include <CGAL/box_intersection_d.h>
 IMP_CLANG_PRAGMA(diagnostic pop)
 #include <vector>
+#include <algorithm>
+#include <limits>
 #include <IMP/macros.h>
+#include <IMP/internal/executor.h>
 
 IMPCORE_BEGIN_NAMESPACE
 
@@ -103,6 +106,118 @@ struct BoxAddToList {
     }
   }
 };
+
+// number of boxes in each slab when sweeping large sets
+const unsigned int boxes_per_slab = 2048;
+
+template <class Box>
+struct LessMinX {
+  bool operator()(const Box &a, const Box &b) const {
+    return a.min_coord(0) < b.min_coord(0);
+  }
+};
+
+template <class Box>
+struct MinXLess {
+  bool operator()(const Box &a, double x) const { return a.min_coord(0) < x; }
+};
+
+template <class Box>
+double get_max_x(typename Vector<Box>::const_iterator b,
+                 typename Vector<Box>::const_iterator e) {
+  double ret = -std::numeric_limits<double>::max();
+  for (; b != e; ++b) ret = std::max<double>(ret, b->max_coord(0));
+  return ret;
+}
+
+/* Sort the boxes by their lower x bound and split them into slabs of
+   consecutive boxes. Each slab is swept against itself, and against the
+   boxes of later slabs that start before it ends, so that each pair is
+   found exactly once. Slabs are swept as tasks and their pairs appended
+   in slab order, so the result does not depend on the number of
+   threads. Small sets, or a single thread, use one plain sweep. */
+template <class Callback, class Box, class Output>
+void box_self_intersection(Vector<Box> &boxes, unsigned int num_threads,
+                           Output &out) {
+  if (num_threads < 2 || boxes.size() < 2 * boxes_per_slab) {
+    CGAL::box_self_intersection_d(boxes.begin(), boxes.end(), Callback(out));
+    return;
+  }
+  std::sort(boxes.begin(), boxes.end(), LessMinX<Box>());
+  const Vector<Box> &sorted = boxes;
+  unsigned int nslabs = (boxes.size() + boxes_per_slab - 1) / boxes_per_slab;
+  Vector<Output> outs(nslabs);
+  auto sweep = [&](unsigned int t) {
+    typename Vector<Box>::const_iterator b = sorted.begin() +
+                                             t * boxes_per_slab;
+    typename Vector<Box>::const_iterator e =
+        sorted.begin() + std::min<std::size_t>(sorted.size(),
+                                               (t + 1) * boxes_per_slab);
+    double max_x = get_max_x<Box>(b, e);
+    typename Vector<Box>::const_iterator h = e;
+    while (h != sorted.end() && h->min_coord(0) <= max_x) ++h;
+    // CGAL reorders the boxes, so work on copies
+    Vector<Box> slab(b, e), later(e, h);
+    CGAL::box_self_intersection_d(slab.begin(), slab.end(),
+                                  Callback(outs[t]));
+    if (!later.empty()) {
+      CGAL::box_intersection_d(slab.begin(), slab.end(), later.begin(),
+                               later.end(), Callback(outs[t]));
+    }
+  };
+  IMP::internal::run_tasks(nslabs, num_threads, sweep, "close pairs");
+  for (unsigned int t = 0; t < nslabs; ++t) {
+    out.insert(out.end(), outs[t].begin(), outs[t].end());
+  }
+}
+
+/* Split the first set into slabs as above. Each slab is swept against the
+   boxes of the second set that overlap it along x; no box of the second
+   set is wider than max_width, so the first of these is found by binary
+   search. */
+template <class Callback, class Box, class Output>
+void box_intersection(Vector<Box> &boxes0, Vector<Box> &boxes1,
+                      unsigned int num_threads, Output &out) {
+  if (num_threads < 2 || boxes0.size() < 2 * boxes_per_slab) {
+    CGAL::box_intersection_d(boxes0.begin(), boxes0.end(), boxes1.begin(),
+                             boxes1.end(), Callback(out));
+    return;
+  }
+  std::sort(boxes0.begin(), boxes0.end(), LessMinX<Box>());
+  std::sort(boxes1.begin(), boxes1.end(), LessMinX<Box>());
+  const Vector<Box> &sorted0 = boxes0, &sorted1 = boxes1;
+  double max_width = 0.;
+  for (const Box &box : sorted1) {
+    max_width = std::max<double>(max_width,
+                                 box.max_coord(0) - box.min_coord(0));
+  }
+  unsigned int nslabs = (boxes0.size() + boxes_per_slab - 1) / boxes_per_slab;
+  Vector<Output> outs(nslabs);
+  auto sweep = [&](unsigned int t) {
+    typename Vector<Box>::const_iterator b = sorted0.begin() +
+                                             t * boxes_per_slab;
+    typename Vector<Box>::const_iterator e =
+        sorted0.begin() + std::min<std::size_t>(sorted0.size(),
+                                                (t + 1) * boxes_per_slab);
+    double min_x = b->min_coord(0);
+    double max_x = get_max_x<Box>(b, e);
+    Vector<Box> slab(b, e), other;
+    for (typename Vector<Box>::const_iterator it =
+             std::lower_bound(sorted1.begin(), sorted1.end(),
+                              min_x - max_width, MinXLess<Box>());
+         it != sorted1.end() && it->min_coord(0) <= max_x; ++it) {
+      if (it->max_coord(0) >= min_x) other.push_back(*it);
+    }
+    if (!other.empty()) {
+      CGAL::box_intersection_d(slab.begin(), slab.end(), other.begin(),
+                               other.end(), Callback(outs[t]));
+    }
+  };
+  IMP::internal::run_tasks(nslabs, num_threads, sweep, "close pairs");
+  for (unsigned int t = 0; t < nslabs; ++t) {
+    out.insert(out.end(), outs[t].begin(), outs[t].end());
+  }
+}
 }
 
 BoxSweepClosePairsFinder::BoxSweepClosePairsFinder()
@@ -118,8 +233,7 @@ ParticleIndexPairs BoxSweepClosePairsFinder::get_close_pairs(
 
   ParticleIndexPairs out;
 
-  CGAL::box_intersection_d(boxes0.begin(), boxes0.end(), boxes1.begin(),
-                           boxes1.end(), AddToList(out));
+  box_intersection<AddToList>(boxes0, boxes1, get_number_of_threads(), out);
   return out;
 }
 
@@ -130,7 +244,7 @@ ParticleIndexPairs BoxSweepClosePairsFinder::get_close_pairs(
   Vector<NBLBbox> boxes;
   copy_particles_to_boxes(m, ca, get_distance(), boxes);
 
-  CGAL::box_self_intersection_d(boxes.begin(), boxes.end(), AddToList(out));
+  box_self_intersection<AddToList>(boxes, get_number_of_threads(), out);
   return out;
 }
 
@@ -144,8 +258,8 @@ IntPairs BoxSweepClosePairsFinder::get_close_pairs(
 
   IntPairs out;
 
-  CGAL::box_intersection_d(boxes0.begin(), boxes0.end(), boxes1.begin(),
-                           boxes1.end(), BoxAddToList(out));
+  box_intersection<BoxAddToList>(boxes0, boxes1, get_number_of_threads(),
+                                 out);
   return out;
 }
 
@@ -156,7 +270,7 @@ IntPairs BoxSweepClosePairsFinder::get_close_pairs(
   Vector<BoxNBLBbox> boxes;
   box_copy_particles_to_boxes(bbs, get_distance(), boxes);
 
-  CGAL::box_self_intersection_d(boxes.begin(), boxes.end(), BoxAddToList(out));
+  box_self_intersection<BoxAddToList>(boxes, get_number_of_threads(), out);
   return out;
 }
 
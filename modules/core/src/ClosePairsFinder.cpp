@@ -13,7 +13,8 @@
 IMPCORE_BEGIN_NAMESPACE
 
 ClosePairsFinder::ClosePairsFinder(std::string name)
-    : Object(name), distance_(std::numeric_limits<double>::quiet_NaN()) {
+    : Object(name), distance_(std::numeric_limits<double>::quiet_NaN()),
+      number_of_threads_(1) {
   set_was_used(true);
 }
 
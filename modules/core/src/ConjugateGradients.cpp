@@ -46,38 +46,26 @@ void ConjugateGradients::failure() {
 }
 
 //! Get the score for a given model state.
-/** \param[in] model The model to score.
-    \param[in] model_data The corresponding ModelData.
-    \param[in] float_indices Indices of optimizable variables.
-    \param[in] x Current value of optimizable variables.
+/** \param[in] x Current value of optimizable variables.
     \param[out] dscore First derivatives for current state.
     \return The model score.
  */
-ConjugateGradients::NT ConjugateGradients::get_score(
-    Vector<FloatIndex> float_indices, Vector<NT> &x,
-    Vector<NT> &dscore) {
-  int i, opt_var_cnt = float_indices.size();
+ConjugateGradients::NT ConjugateGradients::get_score(Vector<NT> &x,
+                                                     Vector<NT> &dscore) {
+  int i, opt_var_cnt = x.size();
   /* set model state */
+  attributes_.get_values(v_);
   for (i = 0; i < opt_var_cnt; i++) {
     IMP_CHECK_VALUE(x[i]);
-#ifdef IMP_CG_SCALE
-    double v = get_scaled_value(float_indices[i]);  // scaled
-#else
-    double v = get_value(float_indices[i]);  // scaled
-#endif
-    if (std::abs(x[i] - v) > max_change_) {
-      if (x[i] < v) {
-        x[i] = v - max_change_;
+    if (std::abs(x[i] - v_[i]) > max_change_) {
+      if (x[i] < v_[i]) {
+        x[i] = v_[i] - max_change_;
       } else {
-        x[i] = v + max_change_;
+        x[i] = v_[i] + max_change_;
       }
     }
-#ifdef IMP_CG_SCALE
-    set_scaled_value(float_indices[i], x[i]);
-#else
-    set_value(float_indices[i], x[i]);
-#endif
   }
+  attributes_.set_values(x);
 
   NT score;
   /* get score */
@@ -89,13 +77,11 @@ ConjugateGradients::NT ConjugateGradients::get_score(
     return std::numeric_limits<NT>::infinity();
   }
   /* get derivatives */
-  for (i = 0; i < opt_var_cnt; i++) {
-#ifdef IMP_CG_SCALE
-    dscore[i] = get_scaled_derivative(float_indices[i]);  // scaled
-#else
-    dscore[i] = get_derivative(float_indices[i]);  // scaled
-#endif
-    IMP_USAGE_CHECK(is_good_value(dscore[i]), "Bad input to CG");
+  attributes_.get_derivatives(dscore);
+  IMP_IF_CHECK(USAGE) {
+    for (i = 0; i < opt_var_cnt; i++) {
+      IMP_USAGE_CHECK(is_good_value(dscore[i]), "Bad input to CG");
+    }
   }
   return score;
 }
@@ -115,14 +101,13 @@ ConjugateGradients::NT ConjugateGradients::get_score(
             or a minimum could not be found.
  */
 bool ConjugateGradients::line_search(
-    Vector<NT> &x, Vector<NT> &dx, NT &alpha,
-    const Vector<FloatIndex> &float_indices, int &ifun, NT &f, NT &dg,
+    Vector<NT> &x, Vector<NT> &dx, NT &alpha, int &ifun, NT &f, NT &dg,
     NT &dg1, int max_steps, const Vector<NT> &search,
     const Vector<NT> &estimate) {
   NT ap, fp, dp, step, minf, u1, u2;
   int i, n, ncalls = ifun;
 
-  n = float_indices.size();
+  n = x.size();
   /* THE LINEAR SEARCH FITS A CUBIC TO F AND DAL, THE FUNCTION AND ITS
      DERIVATIVE AT ALPHA, AND TO FP AND DP,THE FUNCTION
      AND DERIVATIVE AT THE PREVIOUS TRIAL POINT AP.
@@ -156,7 +141,7 @@ bool ConjugateGradients::line_search(
     }
 
     /* EVALUATE THE FUNCTION AT THE TRIAL POINT. */
-    f = get_score(float_indices, x, dx);
+    f = get_score(x, dx);
 
     /* TEST IF THE MAXIMUM NUMBER OF FUNCTION CALLS HAVE BEEN USED. */
     if (++ifun > max_steps) {
@@ -256,9 +241,10 @@ Float ConjugateGradients::do_optimize(unsigned int max_steps) {
   IMP_USAGE_CHECK(get_model(),
                   "Must set the model on the optimizer before optimizing");
   clear_range_cache();
-  Vector<NT> x, dx;
+  // work on references to the member vectors, so that their storage is
+  // reused by later calls
+  Vector<NT> &x = x_, &dx = dx_;
   int i;
-  // ModelData* model_data = get_model()->get_model_data();
 
   FloatIndexes float_indices = get_optimized_attributes();
 
@@ -266,16 +252,20 @@ Float ConjugateGradients::do_optimize(unsigned int max_steps) {
   if (n == 0) {
     IMP_THROW("There are no optimizable degrees of freedom.", ModelException);
   }
-
-  x.resize(n);
-  dx.resize(n);
-  // get initial state in x(n):
+  Floats widths(n);
   for (i = 0; i < n; i++) {
 #ifdef IMP_CG_SCALE
-    x[i] = get_scaled_value(float_indices[i]);  // scaled
+    widths[i] = get_width(float_indices[i].get_key());
 #else
-    x[i] = get_value(float_indices[i]);            // scaled
+    widths[i] = 1.0;
 #endif
+  }
+  attributes_.set(get_model(), float_indices, widths);
+
+  // get initial state in x(n):
+  attributes_.get_values(x);
+  dx.resize(n);
+  for (i = 0; i < n; i++) {
     IMP_USAGE_CHECK(
         !IMP::isnan(x[i]) && std::abs(x[i]) < std::numeric_limits<NT>::max(),
         "Bad input to CG");
@@ -294,7 +284,8 @@ Float ConjugateGradients::do_optimize(unsigned int max_steps) {
   // destimate holds the gradient at the best current estimate
   // resy holds the restart Y vector
   // ressearch holds the restart search vector
-  Vector<NT> search, estimate, destimate, resy, ressearch;
+  Vector<NT> &search = search_, &estimate = estimate_,
+             &destimate = destimate_, &resy = resy_, &ressearch = ressearch_;
   search.resize(n);
   estimate.resize(n);
   destimate.resize(n);
@@ -306,7 +297,7 @@ Float ConjugateGradients::do_optimize(unsigned int max_steps) {
    whether a Beale restart is being done. nrst=n means that this
    iteration is a restart iteration. */
 g20:
-  f = get_score(float_indices, x, dx);
+  f = get_score(x, dx);
   if (get_stop_on_good_score() &&
       get_scoring_function()->get_had_good_score()) {
     estimate = x;
@@ -355,8 +346,8 @@ g40:
   destimate = dx;
 
   /* Try to find a better score by linear search */
-  if (!line_search(x, dx, alpha, float_indices, ifun, f, dg, dg1, max_steps,
-                   search, estimate)) {
+  if (!line_search(x, dx, alpha, ifun, f, dg, dg1, max_steps, search,
+                   estimate)) {
     /* If the line search failed, it was either because the maximum number
        of iterations was exceeded, or the minimum could not be found */
     if (static_cast<unsigned int>(ifun) > max_steps) {
@@ -475,14 +466,14 @@ g40:
 end:
   // If the 'best current estimate' is better than the current state, return
   // that:
-  bestf = get_score(float_indices, estimate, destimate);
+  bestf = get_score(estimate, destimate);
   if (bestf < f) {
     f = bestf;
   } else {
     // Otherwise, restore the current state x (note that we already have the
     // state x and its derivatives dx, so it's rather inefficient to
     // recalculate the score here, but it's cleaner)
-    f = get_score(float_indices, x, dx);
+    f = get_score(x, dx);
   }
   update_states();
   return f;
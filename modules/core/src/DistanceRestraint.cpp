@@ -12,6 +12,7 @@
 #include <IMP/Particle.h>
 #include <IMP/Model.h>
 #include <IMP/log.h>
+#include <algorithm>
 
 IMPCORE_BEGIN_NAMESPACE
 
@@ -23,6 +24,44 @@ DistanceRestraint::DistanceRestraint(Model *m, UnaryFunction* score_func,
           new DistancePairScore(score_func), m,
           ParticleIndexPair(p1, p2), name) {}
 
+void DistanceRestraint::do_evaluate_batch(const ParticleIndexes &pis,
+                                          const FloatsList &coordinates_batch,
+                                          unsigned int begin, unsigned int end,
+                                          Floats &scores) const {
+  Model *m = get_model();
+  ParticlePair pp = get_argument();
+  ParticleIndexPair pip(pp[0]->get_index(), pp[1]->get_index());
+  const DistancePairScore::DistanceScore &ds =
+      get_score()->get_score_functor();
+  // offset of each particle's coordinates in a configuration, or -1 if
+  // it is not in the batch and so stays where it is in the model
+  int offsets[2];
+  algebra::Vector3D fixed[2];
+  for (unsigned int i = 0; i < 2; ++i) {
+    ParticleIndexes::const_iterator it =
+        std::find(pis.begin(), pis.end(), pip[i]);
+    offsets[i] = it == pis.end() ? -1 : 3 * (it - pis.begin());
+    fixed[i] =
+        static_cast<const Model *>(m)->get_sphere(pip[i]).get_center();
+  }
+  for (unsigned int k = begin; k < end; ++k) {
+    const Floats &c = coordinates_batch[k];
+    algebra::Vector3D v[2];
+    for (unsigned int i = 0; i < 2; ++i) {
+      v[i] = offsets[i] < 0 ? fixed[i]
+                            : algebra::Vector3D(c[offsets[i]],
+                                                c[offsets[i] + 1],
+                                                c[offsets[i] + 2]);
+    }
+    double sq = algebra::get_squared_distance(v[0], v[1]);
+    if (ds.get_is_trivially_zero(m, pip, sq)) {
+      scores[k] = 0.;
+    } else {
+      scores[k] = ds.get_score(m, pip, std::sqrt(sq));
+    }
+  }
+}
+
 IMP_OBJECT_SERIALIZE_IMPL(IMP::core::DistanceRestraint);
 
 IMPCORE_END_NAMESPACE
@@ -23,16 +23,27 @@
 #include <IMP/core/internal/close_pairs_helpers.h>
 #include <IMP/generic.h>
 #include <IMP/algebra/eigen_analysis.h>
+#include <algorithm>
+#include <cmath>
 
 IMPCORE_BEGIN_NAMESPACE
 
+namespace {
+// number of incremental updates between full sums of the cached scores
+const unsigned int updates_per_sum = 500;
+}
+
 ExcludedVolumeRestraint::ExcludedVolumeRestraint(SingletonContainerAdaptor sc,
                                                  double k, double s,
                                                  std::string name)
     : Restraint(sc->get_model(), name),
       sc_(sc),
       initialized_(false),
-      ssps_(new SoftSpherePairScore(k)) {
+      ssps_(new SoftSpherePairScore(k)),
+      incremental_(false),
+      cache_valid_(false),
+      cached_score_(0),
+      updates_since_sum_(0) {
   sc.set_name_if_default("EVRInput%1%");
   slack_ = s;
   std::ostringstream oss;
@@ -46,13 +57,20 @@ ExcludedVolumeRestraint::ExcludedVolumeRestraint(SingletonContainerAdaptor sc,
     : Restraint(sc->get_model(), "ExcludedVolumeRestraint %1%"),
       sc_(sc),
       initialized_(false),
-      ssps_(ssps) {
+      ssps_(ssps),
+      incremental_(false),
+      cache_valid_(false),
+      cached_score_(0),
+      updates_since_sum_(0) {
   sc.set_name_if_default("EVRInput%1%");
   slack_ = s;
   key_ = ok;
 }
 
-void ExcludedVolumeRestraint::clear_caches() { was_bad_ = true; }
+void ExcludedVolumeRestraint::clear_caches() {
+  was_bad_ = true;
+  cache_valid_ = false;
+}
 
 void ExcludedVolumeRestraint::initialize() const {
   IMP_OBJECT_LOG;
@@ -61,10 +79,178 @@ void ExcludedVolumeRestraint::initialize() const {
   internal::initialize_particles(sc_, key_, xyzrs_, rbs_, constituents_,
                                  rbs_backup_sphere_, rbs_backup_rot_,
                                  xyzrs_backup_);
+  units_.clear();
+  for (unsigned int i = 0; i < xyzrs_.size(); ++i) {
+    units_[xyzrs_[i]] = xyzrs_[i];
+  }
+  for (unsigned int i = 0; i < rbs_.size(); ++i) {
+    units_[rbs_[i]] = rbs_[i];
+    const ParticleIndexes &members = constituents_[rbs_[i]];
+    for (unsigned int j = 0; j < members.size(); ++j) {
+      units_[members[j]] = rbs_[i];
+    }
+  }
   was_bad_ = true;
+  cache_valid_ = false;
   initialized_ = true;
 }
 
+void ExcludedVolumeRestraint::add_unit_scores(
+    const ParticleIndexPairs &pairs) const {
+  for (unsigned int i = 0; i < pairs.size(); ++i) {
+    double score = ssps_->evaluate_index(get_model(), pairs[i], nullptr);
+    if (score == 0) continue;
+    ParticleIndex ua = units_.find(std::get<0>(pairs[i]))->second;
+    ParticleIndex ub = units_.find(std::get<1>(pairs[i]))->second;
+    unit_scores_[ua][ub] += score;
+    unit_scores_[ub][ua] += score;
+    cached_score_ += score;
+  }
+}
+
+double ExcludedVolumeRestraint::get_cached_score() const {
+  double ret = 0;
+  for (boost::unordered_map<ParticleIndex, boost::unordered_map<
+           ParticleIndex, double> >::const_iterator it = unit_scores_.begin();
+       it != unit_scores_.end(); ++it) {
+    for (boost::unordered_map<ParticleIndex, double>::const_iterator jt =
+             it->second.begin();
+         jt != it->second.end(); ++jt) {
+      if (it->first < jt->first) ret += jt->second;
+    }
+  }
+  return ret;
+}
+
+bool ExcludedVolumeRestraint::get_tree_changed(unsigned int i) const {
+  Model *m = get_model();
+  Object *tree = m->get_has_attribute(key_, rbs_[i])
+                     ? m->get_attribute(key_, rbs_[i])
+                     : nullptr;
+  return tree != rbs_trees_[i].get();
+}
+
+void ExcludedVolumeRestraint::update_trees() const {
+  Model *m = get_model();
+  rbs_trees_.resize(rbs_.size());
+  for (unsigned int i = 0; i < rbs_.size(); ++i) {
+    rbs_trees_[i] = m->get_has_attribute(key_, rbs_[i])
+                        ? m->get_attribute(key_, rbs_[i])
+                        : nullptr;
+  }
+}
+
+void ExcludedVolumeRestraint::add_moved_unit(
+    ParticleIndex pi, boost::unordered_set<ParticleIndex> &moved) const {
+  boost::unordered_map<ParticleIndex, ParticleIndex>::const_iterator it =
+      units_.find(pi);
+  if (it != units_.end()) {
+    moved.insert(it->second);
+  } else if (RigidBody::get_is_setup(get_model(), pi)) {
+    // a body containing some of our particles or bodies
+    RigidBody rb(get_model(), pi);
+    ParticleIndexes members = rb.get_member_indexes();
+    for (unsigned int i = 0; i < members.size(); ++i) {
+      add_moved_unit(members[i], moved);
+    }
+  }
+}
+
+double ExcludedVolumeRestraint::fill_unit_scores() const {
+  IMP_OBJECT_LOG;
+  ParticleIndexPairs pairs;
+  internal::fill_list(get_model(), access_pair_filters(), key_, 0, xyzrs_,
+                      rbs_, constituents_, pairs);
+  unit_scores_.clear();
+  cached_score_ = 0;
+  updates_since_sum_ = 0;
+  add_unit_scores(pairs);
+  // rigid bodies are binned using their own spheres, which enclose
+  // all of their members
+  if (!units_hash_) {
+    units_hash_ = new SpatialHashClosePairsFinder();
+    units_hash_->set_distance(0);
+  }
+  ParticleIndexes units(xyzrs_);
+  units.insert(units.end(), rbs_.begin(), rbs_.end());
+  units_hash_->set_particles(get_model(), units, this);
+  update_trees();
+  cache_valid_ = true;
+  return cached_score_;
+}
+
+double ExcludedVolumeRestraint::update_unit_scores(
+    const ParticleIndexes &moved_pis, const ParticleIndexes &reset_pis) const {
+  IMP_OBJECT_LOG;
+  boost::unordered_set<ParticleIndex> moved;
+  for (unsigned int i = 0; i < moved_pis.size(); ++i) {
+    add_moved_unit(moved_pis[i], moved);
+  }
+  for (unsigned int i = 0; i < reset_pis.size(); ++i) {
+    add_moved_unit(reset_pis[i], moved);
+  }
+  // a rebuilt tree means the members or their radii may have changed
+  // even though the body was not reported as moved
+  for (unsigned int i = 0; i < rbs_.size(); ++i) {
+    if (get_tree_changed(i)) moved.insert(rbs_[i]);
+  }
+  if (moved.empty()) return cached_score_;
+  ParticleIndexes moved_units(moved.begin(), moved.end());
+  std::sort(moved_units.begin(), moved_units.end());
+  units_hash_->update_particles(moved_units);
+
+  // forget all pairs involving a moved unit; a pair of moved units is
+  // removed from both when the first is reached, so is only counted once
+  for (unsigned int i = 0; i < moved_units.size(); ++i) {
+    boost::unordered_map<ParticleIndex, boost::unordered_map<
+        ParticleIndex, double> >::iterator us =
+        unit_scores_.find(moved_units[i]);
+    if (us == unit_scores_.end()) continue;
+    for (boost::unordered_map<ParticleIndex, double>::const_iterator jt =
+             us->second.begin();
+         jt != us->second.end(); ++jt) {
+      cached_score_ -= jt->second;
+      unit_scores_[jt->first].erase(moved_units[i]);
+    }
+    unit_scores_.erase(us);
+  }
+
+  // rescore moved units against their unmoved neighbors, and among
+  // themselves
+  boost::unordered_set<ParticleIndex> near;
+  for (unsigned int i = 0; i < moved_units.size(); ++i) {
+    ParticleIndexes cur = units_hash_->get_stored_neighbors(moved_units[i]);
+    for (unsigned int j = 0; j < cur.size(); ++j) {
+      if (moved.find(cur[j]) == moved.end()) near.insert(cur[j]);
+    }
+  }
+  ParticleIndexes near_units(near.begin(), near.end());
+  std::sort(near_units.begin(), near_units.end());
+  ParticleIndexes xyzrs[2], rbs[2];
+  for (unsigned int i = 0; i < moved_units.size(); ++i) {
+    bool is_rb = constituents_.find(moved_units[i]) != constituents_.end();
+    (is_rb ? rbs : xyzrs)[0].push_back(moved_units[i]);
+  }
+  for (unsigned int i = 0; i < near_units.size(); ++i) {
+    bool is_rb = constituents_.find(near_units[i]) != constituents_.end();
+    (is_rb ? rbs : xyzrs)[1].push_back(near_units[i]);
+  }
+  ParticleIndexPairs pairs;
+  internal::fill_list(get_model(), access_pair_filters(), key_, 0, xyzrs,
+                      rbs, constituents_, pairs);
+  add_unit_scores(pairs);
+  internal::fill_list(get_model(), access_pair_filters(), key_, 0, xyzrs[0],
+                      rbs[0], constituents_, pairs);
+  add_unit_scores(pairs);
+  update_trees();
+  if (++updates_since_sum_ >= updates_per_sum) {
+    // sum afresh so that rounding errors do not build up over many moves
+    cached_score_ = get_cached_score();
+    updates_since_sum_ = 0;
+  }
+  return cached_score_;
+}
+
 double ExcludedVolumeRestraint::fill_list_if_good(double max) const {
   xyzrs_backup_.clear();
   rbs_backup_sphere_.clear();
@@ -157,6 +343,11 @@ double ExcludedVolumeRestraint::unprotected_evaluate(DerivativeAccumulator *da)
       });
     }
   }
+  if (incremental_) {
+    if (!da) return fill_unit_scores();
+    // derivatives are not cached
+    cache_valid_ = false;
+  }
   bool recomputed = false;
   if (was_bad_ || get_if_moved()) {
     cur_list_.clear();
@@ -219,10 +410,35 @@ double ExcludedVolumeRestraint::unprotected_evaluate(DerivativeAccumulator *da)
   return ret;
 }
 
+double ExcludedVolumeRestraint::unprotected_evaluate_moved(
+    DerivativeAccumulator *da, const ParticleIndexes &moved_pis,
+    const ParticleIndexes &reset_pis) const {
+  if (!incremental_ || da || !initialized_ || !cache_valid_) {
+    return unprotected_evaluate(da);
+  }
+  double ret = update_unit_scores(moved_pis, reset_pis);
+#if IMP_HAS_CHECKS >= IMP_INTERNAL
+  {
+    ParticleIndexPairs pairs;
+    internal::fill_list(get_model(), access_pair_filters(), key_, 0, xyzrs_,
+                        rbs_, constituents_, pairs);
+    double check = 0;
+    for (unsigned int i = 0; i < pairs.size(); ++i) {
+      check += ssps_->evaluate_index(get_model(), pairs[i], nullptr);
+    }
+    IMP_INTERNAL_CHECK(std::abs(check - ret) < .1 * (check + ret) + .1,
+                       "Bad incremental score: " << ret << " vs " << check);
+  }
+#endif
+  return ret;
+}
+
 double ExcludedVolumeRestraint::unprotected_evaluate_if_good(
     DerivativeAccumulator *da, double max) const {
   IMP_OBJECT_LOG;
   if (!initialized_) initialize();
+  // the unit scores are not kept up to date here
+  cache_valid_ = false;
   IMP_USAGE_CHECK(!da, "Can't do derivatives");
   IMP_CHECK_CODE(double check = 0);
   IMP_CHECK_CODE(ParticleIndexes all = sc_->get_indexes());
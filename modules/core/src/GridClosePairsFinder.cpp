@@ -23,7 +23,7 @@ IntPairs GridClosePairsFinder::get_close_pairs(
       internal::BBHelper::get_particle_set(bas.begin(), bas.end(), 0),
       internal::BBHelper::get_particle_set(bbs.begin(), bbs.end(), 1),
       internal::BoundingBoxTraits(bas.begin(), bbs.begin(), get_distance()),
-      internal::BBPairSink(out));
+      internal::BBPairSink(out), get_number_of_threads());
   return out;
 }
 
@@ -35,7 +35,7 @@ IntPairs GridClosePairsFinder::get_close_pairs(
   internal::BBHelper::fill_close_pairs(
       internal::BBHelper::get_particle_set(bas.begin(), bas.end(), 0),
       internal::BoundingBoxTraits(bas.begin(), bas.begin(), get_distance()),
-      internal::BBPairSink(out));
+      internal::BBPairSink(out), get_number_of_threads());
   return out;
 }
 
@@ -49,7 +49,8 @@ ParticleIndexPairs GridClosePairsFinder::get_close_pairs(
   internal::ParticleIndexHelper::fill_close_pairs(
       internal::ParticleIndexHelper::get_particle_set(c.begin(), c.end(), 0),
       internal::ParticleIndexTraits(m, get_distance()),
-      internal::ParticleIndexPairSink(m, access_pair_filters(), out));
+      internal::ParticleIndexPairSink(m, access_pair_filters(), out),
+      get_number_of_threads());
   return out;
 }
 ParticleIndexPairs GridClosePairsFinder::get_close_pairs(
@@ -62,7 +63,8 @@ ParticleIndexPairs GridClosePairsFinder::get_close_pairs(
       internal::ParticleIndexHelper::get_particle_set(ca.begin(), ca.end(), 0),
       internal::ParticleIndexHelper::get_particle_set(cb.begin(), cb.end(), 1),
       internal::ParticleIndexTraits(m, get_distance()),
-      internal::ParticleIndexPairSink(m, access_pair_filters(), out));
+      internal::ParticleIndexPairSink(m, access_pair_filters(), out),
+      get_number_of_threads());
   return out;
 }
 
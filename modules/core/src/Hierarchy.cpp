@@ -8,6 +8,7 @@
 
 #include <IMP/core/Hierarchy.h>
 
+#include <atomic>
 #include <sstream>
 
 IMPCORE_BEGIN_NAMESPACE
@@ -101,3 +102,15 @@ GenericHierarchies get_all_descendants(Hierarchy mhd) {
 }
 
 IMPCORE_END_NAMESPACE
+
+IMPCORE_BEGIN_INTERNAL_NAMESPACE
+
+namespace {
+std::atomic<unsigned int> hierarchy_edit_count(0);
+}
+
+void add_hierarchy_edit() { ++hierarchy_edit_count; }
+
+unsigned int get_hierarchy_edit_count() { return hierarchy_edit_count; }
+
+IMPCORE_END_INTERNAL_NAMESPACE
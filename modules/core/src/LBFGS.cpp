@@ -0,0 +1,195 @@
+/**
+ *  \file LBFGS.cpp  \brief Limited-memory BFGS optimizer.
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ *
+ */
+
+#include <IMP/core/LBFGS.h>
+#include <IMP/log.h>
+#include <IMP/Model.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+IMPCORE_BEGIN_NAMESPACE
+
+namespace {
+double get_dot(const Floats &a, const Floats &b) {
+  double ret = 0;
+  for (unsigned int i = 0; i < a.size(); ++i) {
+    ret += a[i] * b[i];
+  }
+  return ret;
+}
+
+//! Sufficient decrease constant for the line search
+const double lbfgs_armijo = 1e-4;
+//! Smallest step tried by the line search
+const double lbfgs_eps = 1.2e-7;
+}
+
+LBFGS::LBFGS(Model *m, std::string name)
+    : AttributeOptimizer(m, name),
+      threshold_(std::numeric_limits<Float>::epsilon()),
+      max_change_(std::numeric_limits<Float>::max() / 100.0),
+      num_corrections_(7),
+      first_(0),
+      count_(0) {}
+
+double LBFGS::get_score(const Floats &x, Floats &dx) {
+  attributes_.set_values(x);
+  double score;
+  try {
+    score = get_scoring_function()->evaluate(true);
+  }
+  catch (const ModelException &) {
+    // treat a bad step as a very bad score so the line search backs off
+    return std::numeric_limits<double>::infinity();
+  }
+  attributes_.get_derivatives(dx);
+  return score;
+}
+
+// Two-loop recursion: d = -H g, with H the current inverse Hessian estimate
+void LBFGS::get_direction(const Floats &g, Floats &d) {
+  unsigned int n = g.size(), m = s_.size();
+  d = g;
+  for (unsigned int j = count_; j > 0; --j) {
+    unsigned int k = (first_ + j - 1) % m;
+    alpha_[k] = rho_[k] * get_dot(s_[k], d);
+    for (unsigned int i = 0; i < n; ++i) {
+      d[i] -= alpha_[k] * y_[k][i];
+    }
+  }
+  if (count_ > 0) {
+    unsigned int k = (first_ + count_ - 1) % m;
+    double gamma = 1.0 / (rho_[k] * get_dot(y_[k], y_[k]));
+    for (unsigned int i = 0; i < n; ++i) {
+      d[i] *= gamma;
+    }
+  }
+  for (unsigned int j = 0; j < count_; ++j) {
+    unsigned int k = (first_ + j) % m;
+    double beta = rho_[k] * get_dot(y_[k], d);
+    for (unsigned int i = 0; i < n; ++i) {
+      d[i] += (alpha_[k] - beta) * s_[k][i];
+    }
+  }
+  for (unsigned int i = 0; i < n; ++i) {
+    d[i] = -d[i];
+  }
+}
+
+Float LBFGS::do_optimize(unsigned int max_steps) {
+  IMP_OBJECT_LOG;
+  clear_range_cache();
+  FloatIndexes float_indices = get_optimized_attributes();
+  unsigned int n = float_indices.size();
+  if (n == 0) {
+    IMP_THROW("There are no optimizable degrees of freedom.", ModelException);
+  }
+  Floats widths(n);
+  for (unsigned int i = 0; i < n; ++i) {
+    widths[i] = get_width(float_indices[i].get_key());
+  }
+  attributes_.set(get_model(), float_indices, widths);
+
+  // resize rather than reallocate, so repeated calls reuse the storage
+  s_.resize(num_corrections_);
+  y_.resize(num_corrections_);
+  for (unsigned int k = 0; k < num_corrections_; ++k) {
+    s_[k].resize(n);
+    y_[k].resize(n);
+  }
+  alpha_.resize(num_corrections_);
+  rho_.resize(num_corrections_);
+  first_ = count_ = 0;
+  xn_.resize(n);
+  d_.resize(n);
+
+  attributes_.get_values(x_);
+  double f = get_score(x_, dx_);
+  unsigned int evaluations = 1;
+  // whether the model holds x_ (and not a rejected trial point)
+  bool at_x = true;
+  while (evaluations < max_steps) {
+    if (get_stop_on_good_score() &&
+        get_scoring_function()->get_had_good_score()) {
+      break;
+    }
+    double gsq = get_dot(dx_, dx_);
+    if (gsq < threshold_) break;
+
+    get_direction(dx_, d_);
+    double dg = get_dot(d_, dx_);
+    if (!(dg < 0)) {
+      // not a descent direction; forget the history and go downhill
+      count_ = 0;
+      for (unsigned int i = 0; i < n; ++i) d_[i] = -dx_[i];
+      dg = -gsq;
+    }
+    // without any history, take a unit-length first step
+    double alpha = count_ == 0 ? 1.0 / std::sqrt(gsq) : 1.0;
+    double dmax = 0;
+    for (unsigned int i = 0; i < n; ++i) {
+      dmax = std::max(dmax, std::abs(d_[i]));
+    }
+    if (alpha * dmax > max_change_) alpha = max_change_ / dmax;
+
+    // backtrack until the score decreases enough
+    double fn = f;
+    bool found = false;
+    while (evaluations < max_steps && alpha * dmax > lbfgs_eps) {
+      for (unsigned int i = 0; i < n; ++i) {
+        xn_[i] = x_[i] + alpha * d_[i];
+      }
+      fn = get_score(xn_, dxn_);
+      ++evaluations;
+      at_x = false;
+      if (fn <= f + lbfgs_armijo * alpha * dg) {
+        found = true;
+        break;
+      }
+      alpha *= .5;
+    }
+    if (!found) break;
+
+    // store the step and gradient change, if they keep H positive definite
+    unsigned int m = num_corrections_;
+    unsigned int k = (first_ + count_) % m;
+    for (unsigned int i = 0; i < n; ++i) {
+      s_[k][i] = xn_[i] - x_[i];
+      y_[k][i] = dxn_[i] - dx_[i];
+    }
+    double sy = get_dot(s_[k], y_[k]);
+    if (sy > lbfgs_eps * get_dot(y_[k], y_[k])) {
+      rho_[k] = 1.0 / sy;
+      if (count_ < m) {
+        ++count_;
+      } else {
+        first_ = (first_ + 1) % m;
+      }
+    } else if (count_ == m) {
+      // the oldest pair was overwritten, so drop it
+      first_ = (first_ + 1) % m;
+      --count_;
+    }
+    std::swap(x_, xn_);
+    std::swap(dx_, dxn_);
+    f = fn;
+    at_x = true;
+    update_states();
+  }
+  if (!at_x) {
+    // put back the last accepted state
+    f = get_score(x_, dx_);
+  }
+  IMP_LOG_TERSE("LBFGS final score is " << f << " after " << evaluations
+                                        << " evaluations" << std::endl);
+  update_states();
+  return f;
+}
+
+IMPCORE_END_NAMESPACE
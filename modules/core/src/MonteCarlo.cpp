@@ -11,11 +11,14 @@
 #include <IMP/Model.h>
 #include <IMP/ConfigurationSet.h>
 #include <IMP/core/GridClosePairsFinder.h>
+#include <IMP/core/XYZ.h>
 #include <IMP/dependency_graph.h>
 
+#include <algorithm>
 #include <limits>
 #include <cmath>
 #include <boost/scoped_ptr.hpp>
+#include <boost/unordered_map.hpp>
 
 IMPCORE_BEGIN_NAMESPACE
 
@@ -30,42 +33,50 @@ MonteCarlo::MonteCarlo(Model *m)
       stat_num_failures_(0),
       return_best_(true),
       score_moved_(false),
+      num_trials_(1),
       rand_(0, 1) {
   min_score_ = -std::numeric_limits<double>::max();
 }
 
+void MonteCarlo::accept_step(double score, double last) {
+  IMP_LOG_TERSE("Accept: " << score << " previous score was " << last
+                           << std::endl);
+  if (score + 1e-9 < last) {
+    ++stat_downward_steps_taken_;
+  } else {
+    ++stat_upward_steps_taken_;
+  }
+  if (score < best_energy_ && return_best_) {
+    best_ = new Configuration(get_model());
+    best_energy_ = score;
+  }
+  last_energy_ = score;
+  update_states();
+}
+
+void MonteCarlo::reject_step(double score, double last) {
+  IMP_LOG_TERSE("Reject: " << score << " current score stays " << last
+                           << std::endl);
+  ++stat_num_failures_;
+}
+
 bool MonteCarlo::do_accept_or_reject_move(double score, double last,
                                           const MonteCarloMoverResult &moved) {
-  bool ok = false;
   double proposal_ratio = moved.get_proposal_ratio();
   // If score is exactly the same as last (e.g. no-op mover) add a small delta
   // to always treat as an uphill move, so we get consistent trajectories
   // for score_moved=True vs False (depending on machine floating point
   // precision, x<y may return true when x==y).
-  if (score + 1e-9 < last) {
-    ++stat_downward_steps_taken_;
-    ok = true;
-    if (score < best_energy_ && return_best_) {
-      best_ = new Configuration(get_model());
-      best_energy_ = score;
-    }
-  } else {
+  bool ok = score + 1e-9 < last;
+  if (!ok) {
     double diff = score - last;
     double e = std::exp(-diff / temp_);
     double r = rand_(random_number_generator);
     IMP_LOG_VERBOSE(diff << " " << temp_ << " " << e << " " << r << std::endl);
-    if (e * proposal_ratio > r) {
-      ++stat_upward_steps_taken_;
-      ok = true;
-    } else {
-      ok = false;
-    }
+    ok = e * proposal_ratio > r;
   }
   if (ok) {
-    IMP_LOG_TERSE("Accept: " << score << " previous score was " << last
-                             << std::endl);
-    last_energy_ = score;
-    update_states();
+    accept_step(score, last);
     for (int i = get_number_of_movers() - 1; i >= 0; --i) {
       get_mover(i)->accept();
     }
@@ -74,12 +85,10 @@ bool MonteCarlo::do_accept_or_reject_move(double score, double last,
     }
     return true;
   } else {
-    IMP_LOG_TERSE("Reject: " << score << " current score stays " << last
-                             << std::endl);
+    reject_step(score, last);
     for (int i = get_number_of_movers() - 1; i >= 0; --i) {
       get_mover(i)->reject();
     }
-    ++stat_num_failures_;
     if (score_moved_) {
       // Need to return the moved particles' restraints to their previous
       // values at the next scoring function evaluation
@@ -124,7 +133,181 @@ struct MoverCleanup {
 };
 }
 
+namespace {
+// The float attributes of some particles, used to jump between states
+// without going through the movers
+struct SavedAttributes {
+  Vector<std::pair<FloatKey, ParticleIndex> > keys_;
+  Floats values_;
+  SavedAttributes() {}
+  SavedAttributes(Model *m, const ParticleIndexes &pis) {
+    for (unsigned int i = 0; i < pis.size(); ++i) {
+      FloatKeys ks = m->get_particle(pis[i])->get_float_keys();
+      for (unsigned int j = 0; j < ks.size(); ++j) {
+        keys_.push_back(std::make_pair(ks[j], pis[i]));
+        values_.push_back(m->get_attribute(ks[j], pis[i]));
+      }
+    }
+  }
+  void apply(Model *m) const {
+    for (unsigned int i = 0; i < keys_.size(); ++i) {
+      m->set_attribute(keys_[i].first, keys_[i].second, values_[i]);
+    }
+  }
+  // Write the saved coordinates into coordinates, laid out as for
+  // ScoringFunction::evaluate_batch(). Return false if any other
+  // attribute differs from its current value in the model.
+  bool get_coordinates(Model *m,
+                       const boost::unordered_map<ParticleIndex, unsigned int>
+                           &index,
+                       Floats &coordinates) const {
+    for (unsigned int i = 0; i < keys_.size(); ++i) {
+      unsigned int k = keys_[i].first.get_index();
+      if (k < 3) {
+        coordinates[3 * index.find(keys_[i].second)->second + k] = values_[i];
+      } else if (values_[i] != m->get_attribute(keys_[i].first,
+                                                keys_[i].second)) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+// Score each of the states, starting from the current one. If the states
+// only differ from it in particle coordinates, they are all scored with
+// one ScoringFunction::evaluate_batch() call; otherwise each is set in
+// turn. The model is left in the current state.
+Floats get_state_scores(ScoringFunction *sf,
+                        const Vector<SavedAttributes> &states,
+                        const ParticleIndexes &pis) {
+  Model *m = sf->get_model();
+  bool only_coordinates = true;
+  boost::unordered_map<ParticleIndex, unsigned int> index;
+  Floats current(3 * pis.size());
+  for (unsigned int i = 0; i < pis.size() && only_coordinates; ++i) {
+    only_coordinates = XYZ::get_is_setup(m, pis[i]);
+    if (!only_coordinates) break;
+    index[pis[i]] = i;
+    for (unsigned int j = 0; j < 3; ++j) {
+      current[3 * i + j] = m->get_attribute(FloatKey(j), pis[i]);
+    }
+  }
+  FloatsList coordinates(states.size(), current);
+  for (unsigned int k = 0; k < states.size() && only_coordinates; ++k) {
+    only_coordinates = states[k].get_coordinates(m, index, coordinates[k]);
+  }
+  if (only_coordinates) {
+    return sf->evaluate_batch(pis, coordinates);
+  }
+  // other attributes changed, e.g. rigid body orientations, so set each
+  // state in turn; the configuration also restores what score states
+  // computed from them
+  Pointer<Configuration> saved = new Configuration(m);
+  SavedAttributes start(m, pis);
+  Floats ret(states.size());
+  for (unsigned int k = 0; k < states.size(); ++k) {
+    states[k].apply(m);
+    ret[k] = sf->evaluate(false);
+    start.apply(m);
+  }
+  saved->load_configuration();
+  return ret;
+}
+
+// Sum of exp(-(e - emin)/kt) over the energies
+double get_boltzmann_sum(const Floats &energies, double emin, double kt) {
+  double ret = 0;
+  for (unsigned int i = 0; i < energies.size(); ++i) {
+    ret += std::exp(-(energies[i] - emin) / kt);
+  }
+  return ret;
+}
+}
+
+void MonteCarlo::do_multiple_try_step() {
+  IMP_USAGE_CHECK(temp_ > 0, "Multiple-try moves need a positive kT");
+  Model *m = get_model();
+  ScoringFunction *sf = get_scoring_function();
+  unsigned int n = num_trials_;
+  // every particle moved by a trial or reference move
+  ParticleIndexes changed;
+  // Propose num moves from the current state, rolling each back with
+  // reject() before the next is proposed (a mover only holds one move),
+  // then score them all
+  auto propose = [&](unsigned int num, Vector<ParticleIndexes> &moved,
+                     Vector<SavedAttributes> &states) {
+    moved.resize(num);
+    states.resize(num);
+    ParticleIndexes all;
+    for (unsigned int i = 0; i < num; ++i) {
+      MonteCarloMoverResult cur = do_move();
+      MoverCleanup cleanup(this);
+      IMP_USAGE_CHECK(cur.get_proposal_ratio() == 1.,
+                      "Multiple-try moves need symmetric movers");
+      moved[i] = cur.get_moved_particles();
+      states[i] = SavedAttributes(m, moved[i]);
+      cleanup.reset();
+      for (int j = get_number_of_movers() - 1; j >= 0; --j) {
+        get_mover(j)->reject();
+      }
+      all += moved[i];
+    }
+    std::sort(all.begin(), all.end());
+    all.erase(std::unique(all.begin(), all.end()), all.end());
+    changed += all;
+    return get_state_scores(sf, states, all);
+  };
+
+  Vector<ParticleIndexes> trial_moved;
+  Vector<SavedAttributes> trial_states;
+  Floats trial_energies = propose(n, trial_moved, trial_states);
+
+  // pick a trial with probability proportional to its Boltzmann weight
+  double emin = *std::min_element(trial_energies.begin(),
+                                   trial_energies.end());
+  double r = rand_(random_number_generator) *
+             get_boltzmann_sum(trial_energies, emin, temp_);
+  unsigned int picked = 0;
+  for (; picked + 1 < n; ++picked) {
+    r -= std::exp(-(trial_energies[picked] - emin) / temp_);
+    if (r < 0) break;
+  }
+  double score = trial_energies[picked];
+
+  // propose the reference moves from the picked state; the current state
+  // is the last reference
+  SavedAttributes start(m, trial_moved[picked]);
+  trial_states[picked].apply(m);
+  Vector<ParticleIndexes> reference_moved;
+  Vector<SavedAttributes> reference_states;
+  Floats reference_energies =
+      propose(n - 1, reference_moved, reference_states);
+  reference_energies.push_back(last_energy_);
+
+  double low = std::min(emin, *std::min_element(reference_energies.begin(),
+                                                 reference_energies.end()));
+  double trial_sum = get_boltzmann_sum(trial_energies, low, temp_);
+  double reference_sum = get_boltzmann_sum(reference_energies, low, temp_);
+  if (rand_(random_number_generator) * reference_sum < trial_sum) {
+    accept_step(score, last_energy_);
+  } else {
+    start.apply(m);
+    reject_step(score, last_energy_);
+  }
+  if (score_moved_) {
+    // the scores cached for evaluate_moved() are from the last batch
+    // configuration, so bring them back in line with the model
+    reset_pis_.clear();
+    sf->evaluate_moved(false, changed, ParticleIndexes());
+  }
+}
+
 void MonteCarlo::do_step() {
+  if (num_trials_ > 1) {
+    do_multiple_try_step();
+    return;
+  }
   MonteCarloMoverResult moved = do_move();
   MoverCleanup cleanup(this);
   double energy = do_evaluate(moved.get_moved_particles(), false);
@@ -7,28 +7,109 @@
  */
 
 #include <IMP/core/NeighborsTable.h>
+#include <IMP/core/GridClosePairsFinder.h>
 #include <IMP/PairModifier.h>
 #include <IMP/container_macros.h>
 #include <IMP/PairContainer.h>
 
 IMPCORE_BEGIN_NAMESPACE
 
-void NeighborsTable::do_before_evaluate() {
-  std::size_t new_hash = input_->get_contents_hash();
-  if (new_hash == input_version_) return;
-  input_version_ = new_hash;
+void NeighborsTable::build(const ParticleIndexPairs &pairs) {
+  ++number_of_rebuilds_;
+  unsigned int size = 0;
+  for (unsigned int i = 0; i < pairs.size(); ++i) {
+    size = std::max(size, std::max(pairs[i][0].get_index(),
+                                   pairs[i][1].get_index()) + 1U);
+  }
+  // count the neighbors of each particle, turn the counts into offsets,
+  // then fill in the neighbors
+  offsets_.assign(size + 1, 0);
+  for (unsigned int i = 0; i < pairs.size(); ++i) {
+    ++offsets_[pairs[i][0].get_index() + 1];
+    ++offsets_[pairs[i][1].get_index() + 1];
+  }
+  for (unsigned int i = 0; i < size; ++i) {
+    offsets_[i + 1] += offsets_[i];
+  }
+  neighbors_.resize(offsets_[size]);
+  Vector<unsigned int> next(offsets_.begin(), offsets_.end() - 1);
+  for (unsigned int i = 0; i < pairs.size(); ++i) {
+    unsigned int a = pairs[i][0].get_index(), b = pairs[i][1].get_index();
+    neighbors_[next[a]++] = pairs[i][1];
+    neighbors_[next[b]++] = pairs[i][0];
+  }
+}
 
-  data_.clear();
+bool NeighborsTable::get_has_moved_too_far() const {
+  const Model *m = get_model();
+  const algebra::Sphere3D *spheres = m->access_spheres_data();
+  double max2 = .25 * skin_ * skin_;
+  for (unsigned int i = 0; i < verlet_pis_.size(); ++i) {
+    if ((spheres[verlet_pis_[i].get_index()].get_center() -
+         verlet_positions_[i]).get_squared_magnitude() > max2) {
+      return true;
+    }
+  }
+  return false;
+}
 
-  IMP_CONTAINER_FOREACH(PairContainer, input_, {
-    data_[std::get<0>(_1)].push_back(std::get<1>(_1));
-    data_[std::get<1>(_1)].push_back(std::get<0>(_1));
-  });
+void NeighborsTable::do_before_evaluate() {
+  if (input_) {
+    std::size_t new_hash = input_->get_contents_hash();
+    if (built_ && new_hash == input_version_) return;
+    input_version_ = new_hash;
+    built_ = true;
+    build(input_->get_indexes());
+  } else {
+    std::size_t new_hash = particles_->get_contents_hash();
+    if (built_ && new_hash == input_version_ && !get_has_moved_too_far()) {
+      return;
+    }
+    input_version_ = new_hash;
+    built_ = true;
+    Model *m = get_model();
+    verlet_pis_ = particles_->get_indexes();
+    verlet_positions_.resize(verlet_pis_.size());
+    const algebra::Sphere3D *spheres =
+        static_cast<const Model *>(m)->access_spheres_data();
+    for (unsigned int i = 0; i < verlet_pis_.size(); ++i) {
+      verlet_positions_[i] = spheres[verlet_pis_[i].get_index()].get_center();
+    }
+    build(cpf_->get_close_pairs(m, verlet_pis_));
+  }
+}
+
+ModelObjectsTemp NeighborsTable::do_get_inputs() const {
+  if (input_) {
+    return ModelObjectsTemp(1, input_);
+  } else {
+    ModelObjectsTemp ret =
+        cpf_->get_inputs(get_model(), particles_->get_indexes());
+    ret.push_back(particles_);
+    return ret;
+  }
 }
 
 NeighborsTable::NeighborsTable(PairContainer *input, std::string name)
     : ScoreState(input->get_model(), name),
       input_(input),
-      input_version_(input->get_contents_hash()) {}
+      skin_(0),
+      input_version_(0),
+      built_(false),
+      number_of_rebuilds_(0) {}
+
+NeighborsTable::NeighborsTable(SingletonContainer *input, double distance,
+                               double skin, ClosePairsFinder *cpf,
+                               std::string name)
+    : ScoreState(input->get_model(), name),
+      particles_(input),
+      cpf_(cpf ? cpf : new GridClosePairsFinder()),
+      skin_(skin),
+      input_version_(0),
+      built_(false),
+      number_of_rebuilds_(0) {
+  IMP_USAGE_CHECK(skin >= 0, "The skin must not be negative");
+  cpf_->set_distance(distance + skin);
+}
 
 IMPCORE_END_NAMESPACE
@@ -0,0 +1,112 @@
+/**
+ *  \file ReplicaExchangeMonteCarlo.cpp
+ *  \brief Replica exchange of several MonteCarlo chains in one process.
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ *
+ */
+
+#include <IMP/core/ReplicaExchangeMonteCarlo.h>
+#include <IMP/internal/executor.h>
+#include <boost/random/uniform_real_distribution.hpp>
+#include <cmath>
+#include <random>
+
+IMPCORE_BEGIN_NAMESPACE
+
+ReplicaExchangeMonteCarlo::ReplicaExchangeMonteCarlo(
+    const MonteCarlos &replicas, const Floats &temperatures, std::string name)
+    : Object(name),
+      replicas_(replicas.begin(), replicas.end()),
+      temperatures_(temperatures),
+      temperature_index_(replicas.size()),
+      replica_index_(replicas.size()),
+      energies_(replicas.size(), 0.),
+      num_threads_(replicas.size()) {
+  IMP_USAGE_CHECK(replicas.size() == temperatures.size(),
+                  "Need one temperature per replica");
+  IMP_USAGE_CHECK(!replicas.empty(), "Need at least one replica");
+  for (unsigned int i = 0; i < replicas.size(); ++i) {
+    IMP_USAGE_CHECK(temperatures[i] > 0, "Temperatures must be positive");
+    IMP_USAGE_CHECK(i == 0 || temperatures[i] > temperatures[i - 1],
+                    "Temperatures must be in increasing order");
+    for (unsigned int j = 0; j < i; ++j) {
+      IMP_USAGE_CHECK(replicas[i]->get_model() != replicas[j]->get_model(),
+                      "Each replica needs its own Model");
+    }
+    temperature_index_[i] = i;
+    replica_index_[i] = i;
+    replicas_[i]->set_kt(temperatures[i]);
+    replicas_[i]->set_return_best(false);
+  }
+  set_seed(get_random_seed());
+  reset_statistics();
+}
+
+void ReplicaExchangeMonteCarlo::set_seed(boost::uint64_t seed) {
+  generators_.clear();
+  // one generator per replica plus one for the exchanges, from a seed
+  // sequence so that nearby seeds still give unrelated streams
+  std::seed_seq seq{static_cast<std::uint32_t>(seed),
+                    static_cast<std::uint32_t>(seed >> 32)};
+  std::vector<std::uint32_t> seeds(replicas_.size() + 1);
+  seq.generate(seeds.begin(), seeds.end());
+  for (unsigned int i = 0; i < replicas_.size(); ++i) {
+    generators_.push_back(RandomNumberGenerator(seeds[i]));
+  }
+  exchange_generator_.seed(seeds.back());
+}
+
+void ReplicaExchangeMonteCarlo::reset_statistics() {
+  proposed_ = Vector<unsigned int>(replicas_.size(), 0);
+  accepted_ = Vector<unsigned int>(replicas_.size(), 0);
+  exchanges_tried_ = Vector<unsigned int>(temperatures_.size() - 1, 0);
+  exchanges_accepted_ = Vector<unsigned int>(temperatures_.size() - 1, 0);
+}
+
+void ReplicaExchangeMonteCarlo::run_replicas(unsigned int steps) {
+  auto run = [this, steps](unsigned int i) {
+    RandomNumberGeneratorScope scope(generators_[i]);
+    MonteCarlo *mc = replicas_[i];
+    energies_[i] = mc->optimize(steps);
+    // MonteCarlo resets its statistics on each call to optimize()
+    proposed_[i] += mc->get_number_of_proposed_steps();
+    accepted_[i] += mc->get_number_of_accepted_steps();
+  };
+  IMP::internal::run_tasks(replicas_.size(), num_threads_, run, "replica");
+}
+
+void ReplicaExchangeMonteCarlo::do_exchanges(unsigned int first) {
+  ::boost::random::uniform_real_distribution<> rand(0, 1);
+  for (unsigned int t = first; t + 1 < temperatures_.size(); t += 2) {
+    unsigned int a = replica_index_[t], b = replica_index_[t + 1];
+    double delta = (1. / temperatures_[t] - 1. / temperatures_[t + 1]) *
+                   (energies_[a] - energies_[b]);
+    ++exchanges_tried_[t];
+    if (delta >= 0 || rand(exchange_generator_) < std::exp(delta)) {
+      IMP_LOG_TERSE("Exchanging replicas " << a << " and " << b
+                    << " at temperatures " << temperatures_[t] << " and "
+                    << temperatures_[t + 1] << std::endl);
+      ++exchanges_accepted_[t];
+      replica_index_[t] = b;
+      replica_index_[t + 1] = a;
+      temperature_index_[a] = t + 1;
+      temperature_index_[b] = t;
+      replicas_[a]->set_kt(temperatures_[t + 1]);
+      replicas_[b]->set_kt(temperatures_[t]);
+    }
+  }
+}
+
+double ReplicaExchangeMonteCarlo::optimize(unsigned int number_of_exchanges,
+                                           unsigned int steps_per_exchange) {
+  IMP_OBJECT_LOG;
+  set_was_used(true);
+  for (unsigned int i = 0; i < number_of_exchanges; ++i) {
+    run_replicas(steps_per_exchange);
+    do_exchanges(i % 2);
+  }
+  return energies_[replica_index_[0]];
+}
+
+IMPCORE_END_NAMESPACE
@@ -15,6 +15,7 @@
 #include <IMP/algebra/Vector3D.h>
 #include <IMP/SingletonContainer.h>
 #include <IMP/macros.h>
+#include <IMP/internal/executor.h>
 #include <boost/unordered_map.hpp>
 #include <IMP/algebra/eigen_analysis.h>
 #include <boost/unordered_set.hpp>
@@ -126,23 +127,26 @@ ParticleIndexPairs RigidClosePairsFinder::get_close_pairs(
   divvy_up_particles(m, pib, fb, mb);
   ParticleIndexPairs ppt = cpf_->get_close_pairs(m, fa, fb);
   ParticleIndexPairs ret;
-  for (ParticleIndexPairs::const_iterator it = ppt.begin();
-       it != ppt.end(); ++it) {
-    // skip within one rigid body
-    if (it->get(0) == it->get(1)) continue;
-    ParticleIndexes ps0, ps1;
-    if (ma.find(it->get(0)) != ma.end()) {
-      ps0 = ma.find(it->get(0))->second;
-    }
-    if (mb.find(it->get(1)) != mb.end()) {
-      ps1 = mb.find(it->get(1))->second;
-    }
-    if (ps0.empty() && ps1.empty()) {
-      ret.push_back(*it);
-    } else {
-      ret += get_close_pairs(m, it->get(0), it->get(1), ps0, ps1);
+  // the searches of each pair of rigid bodies share one parallel region
+  IMP::internal::run_in_parallel_region(get_number_of_threads(), [&]() {
+    for (ParticleIndexPairs::const_iterator it = ppt.begin();
+         it != ppt.end(); ++it) {
+      // skip within one rigid body
+      if (it->get(0) == it->get(1)) continue;
+      ParticleIndexes ps0, ps1;
+      if (ma.find(it->get(0)) != ma.end()) {
+        ps0 = ma.find(it->get(0))->second;
+      }
+      if (mb.find(it->get(1)) != mb.end()) {
+        ps1 = mb.find(it->get(1))->second;
+      }
+      if (ps0.empty() && ps1.empty()) {
+        ret.push_back(*it);
+      } else {
+        ret += get_close_pairs(m, it->get(0), it->get(1), ps0, ps1);
+      }
     }
-  }
+  });
   return ret;
 }
 
@@ -163,22 +167,24 @@ ParticleIndexPairs RigidClosePairsFinder::get_close_pairs(
     }
   }
   ParticleIndexPairs ret;
-  for (ParticleIndexPairs::const_iterator it = ppt.begin();
-       it != ppt.end(); ++it) {
-    ParticleIndexes ps0, ps1;
-    IMP_LOG_VERBOSE("Processing close pair " << *it << std::endl);
-    if (map.find(it->get(0)) != map.end()) {
-      ps0 = map.find(it->get(0))->second;
-    }
-    if (map.find(it->get(1)) != map.end()) {
-      ps1 = map.find(it->get(1))->second;
-    }
-    if (ps0.empty() && ps1.empty()) {
-      ret.push_back(*it);
-    } else {
-      ret += get_close_pairs(m, it->get(0), it->get(1), ps0, ps1);
+  IMP::internal::run_in_parallel_region(get_number_of_threads(), [&]() {
+    for (ParticleIndexPairs::const_iterator it = ppt.begin();
+         it != ppt.end(); ++it) {
+      ParticleIndexes ps0, ps1;
+      IMP_LOG_VERBOSE("Processing close pair " << *it << std::endl);
+      if (map.find(it->get(0)) != map.end()) {
+        ps0 = map.find(it->get(0))->second;
+      }
+      if (map.find(it->get(1)) != map.end()) {
+        ps1 = map.find(it->get(1))->second;
+      }
+      if (ps0.empty() && ps1.empty()) {
+        ret.push_back(*it);
+      } else {
+        ret += get_close_pairs(m, it->get(0), it->get(1), ps0, ps1);
+      }
     }
-  }
+  });
   return ret;
 }
 
@@ -202,7 +208,8 @@ ParticleIndexPairs RigidClosePairsFinder::get_close_pairs(
   IMP_INTERNAL_CHECK(RigidBody::get_is_setup(b)==(db!=nullptr),
   "Rigid body does not imply hierarchy");*/
   if (da && db) {
-    out = IMP::get_indexes(internal::close_pairs(m, da, db, get_distance()));
+    out = IMP::get_indexes(internal::close_pairs(m, da, db, get_distance(),
+                                                 get_number_of_threads()));
   } else if (da) {
     ParticlesTemp pt =
         internal::close_particles(m, da, XYZR(m, b), get_distance());
@@ -0,0 +1,307 @@
+/**
+ *  \file SpatialHashClosePairsFinder.cpp
+ *  \brief Find close pairs using a spatial hash.
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ *
+ */
+
+#include "IMP/core/SpatialHashClosePairsFinder.h"
+#include "IMP/core/internal/grid_close_pairs_impl.h"
+#include "IMP/core/internal/close_pairs_helpers.h"
+#include "IMP/core/internal/sinks.h"
+#include <algorithm>
+#include <cmath>
+
+IMPCORE_BEGIN_NAMESPACE
+
+namespace {
+typedef algebra::ExtendedGridIndex3D HashCell;
+typedef boost::unordered_map<HashCell, ParticleIndexes> HashCells;
+
+// avoid overflowing the cell indexes for zero distances and radii
+const double min_hash_cell_size = 1e-3;
+
+double get_hash_cell_size(double distance, double max_radius) {
+  return std::max(distance + 2 * max_radius, min_hash_cell_size);
+}
+
+HashCell get_hash_cell(const algebra::Vector3D &v, double cell_size) {
+  return HashCell(static_cast<int>(std::floor(v[0] / cell_size)),
+                  static_cast<int>(std::floor(v[1] / cell_size)),
+                  static_cast<int>(std::floor(v[2] / cell_size)));
+}
+
+double get_hash_max_radius(const Model *m, const ParticleIndexes &pis) {
+  double ret = 0;
+  for (ParticleIndex pi : pis) {
+    ret = std::max(ret, m->get_sphere(pi).get_radius());
+  }
+  return ret;
+}
+
+void fill_hash_cells(const Model *m, const ParticleIndexes &pis,
+                     double cell_size, HashCells &cells) {
+  for (ParticleIndex pi : pis) {
+    HashCell c = get_hash_cell(m->get_sphere(pi).get_center(), cell_size);
+    cells[c].push_back(pi);
+  }
+}
+
+// call f on each particle in the 27 cells around c
+template <class F>
+void apply_to_hash_neighborhood(const HashCells &cells, const HashCell &c,
+                                F &f) {
+  for (int i = -1; i <= 1; ++i) {
+    for (int j = -1; j <= 1; ++j) {
+      for (int k = -1; k <= 1; ++k) {
+        HashCells::const_iterator it = cells.find(c.get_offset(i, j, k));
+        if (it == cells.end()) continue;
+        for (ParticleIndex pi : it->second) f(pi);
+      }
+    }
+  }
+}
+
+// collect pairs (a, b) with b close to a, optionally only with a < b
+struct AddHashClose {
+  Model *m_;
+  const PairPredicates &filters_;
+  double distance_;
+  ParticleIndex a_;
+  algebra::Sphere3D sa_;
+  bool ordered_;
+  ParticleIndexPairs &out_;
+  AddHashClose(Model *m, const PairPredicates &filters, double distance,
+               bool ordered, ParticleIndexPairs &out)
+      : m_(m), filters_(filters), distance_(distance), ordered_(ordered),
+        out_(out) {}
+  void set_particle(ParticleIndex a, const algebra::Sphere3D &sa) {
+    a_ = a;
+    sa_ = sa;
+  }
+  void operator()(ParticleIndex b) {
+    if (b == a_ || (ordered_ && b < a_)) return;
+    const Model *cm = m_;
+    if (!internal::get_are_close(sa_, cm->get_sphere(b), distance_)) return;
+    ParticleIndexPair pp(a_, b);
+    if (internal::get_filters_contains(m_, filters_, pp)) return;
+    out_.push_back(pp);
+  }
+};
+}  // namespace
+
+SpatialHashClosePairsFinder::SpatialHashClosePairsFinder()
+    : ClosePairsFinder("SpatialHashCPF"), stored_distance_(0),
+      cell_size_(min_hash_cell_size), max_radius_(0), number_stored_(0),
+      owner_(nullptr), contents_hash_(0) {}
+
+IntPairs SpatialHashClosePairsFinder::get_close_pairs(
+    const algebra::BoundingBox3Ds &bas,
+    const algebra::BoundingBox3Ds &bbs) const {
+  IMP_OBJECT_LOG;
+  set_was_used(true);
+  IntPairs out;
+  internal::BBHelper::fill_close_pairs(
+      internal::BBHelper::get_particle_set(bas.begin(), bas.end(), 0),
+      internal::BBHelper::get_particle_set(bbs.begin(), bbs.end(), 1),
+      internal::BoundingBoxTraits(bas.begin(), bbs.begin(), get_distance()),
+      internal::BBPairSink(out));
+  return out;
+}
+
+IntPairs SpatialHashClosePairsFinder::get_close_pairs(
+    const algebra::BoundingBox3Ds &bas) const {
+  IMP_OBJECT_LOG;
+  set_was_used(true);
+  IntPairs out;
+  internal::BBHelper::fill_close_pairs(
+      internal::BBHelper::get_particle_set(bas.begin(), bas.end(), 0),
+      internal::BoundingBoxTraits(bas.begin(), bas.begin(), get_distance()),
+      internal::BBPairSink(out));
+  return out;
+}
+
+ParticleIndexPairs SpatialHashClosePairsFinder::get_close_pairs(
+    Model *m, const ParticleIndexes &c) const {
+  IMP_OBJECT_LOG;
+  set_was_used(true);
+  IMP_LOG_TERSE("Finding close pairs with a spatial hash and cutoff "
+                << get_distance() << std::endl);
+  double cell_size =
+      get_hash_cell_size(get_distance(), get_hash_max_radius(m, c));
+  HashCells cells;
+  fill_hash_cells(m, c, cell_size, cells);
+  ParticleIndexPairs out;
+  AddHashClose add(m, access_pair_filters(), get_distance(), true, out);
+  for (ParticleIndex pi : c) {
+    const algebra::Sphere3D &s =
+        static_cast<const Model *>(m)->get_sphere(pi);
+    add.set_particle(pi, s);
+    apply_to_hash_neighborhood(cells, get_hash_cell(s.get_center(), cell_size),
+                               add);
+  }
+  return out;
+}
+
+ParticleIndexPairs SpatialHashClosePairsFinder::get_close_pairs(
+    Model *m, const ParticleIndexes &ca,
+    const ParticleIndexes &cb) const {
+  IMP_OBJECT_LOG;
+  set_was_used(true);
+  double cell_size = get_hash_cell_size(
+      get_distance(),
+      std::max(get_hash_max_radius(m, ca), get_hash_max_radius(m, cb)));
+  HashCells cells;
+  fill_hash_cells(m, cb, cell_size, cells);
+  ParticleIndexPairs out;
+  AddHashClose add(m, access_pair_filters(), get_distance(), false, out);
+  for (ParticleIndex pi : ca) {
+    const algebra::Sphere3D &s =
+        static_cast<const Model *>(m)->get_sphere(pi);
+    add.set_particle(pi, s);
+    apply_to_hash_neighborhood(cells, get_hash_cell(s.get_center(), cell_size),
+                               add);
+  }
+  return out;
+}
+
+ModelObjectsTemp SpatialHashClosePairsFinder::do_get_inputs(
+    Model *m, const ParticleIndexes &pis) const {
+  ModelObjectsTemp ret;
+  ret += IMP::get_particles(m, pis);
+  for (PairFilterConstIterator it = pair_filters_begin();
+       it != pair_filters_end(); ++it) {
+    ret += (*it)->get_inputs(m, pis);
+  }
+  return ret;
+}
+
+SpatialHashClosePairsFinder::Cell SpatialHashClosePairsFinder::get_cell(
+    const algebra::Vector3D &v) const {
+  return get_hash_cell(v, cell_size_);
+}
+
+void SpatialHashClosePairsFinder::add_to_cell(ParticleIndex pi) {
+  cells_[get_cell(spheres_[pi].get_center())].push_back(pi);
+}
+
+void SpatialHashClosePairsFinder::remove_from_cell(ParticleIndex pi) {
+  Cells::iterator it = cells_.find(get_cell(spheres_[pi].get_center()));
+  IMP_INTERNAL_CHECK(it != cells_.end(), "Particle " << pi << " not binned");
+  ParticleIndexes &cell = it->second;
+  ParticleIndexes::iterator pit = std::find(cell.begin(), cell.end(), pi);
+  IMP_INTERNAL_CHECK(pit != cell.end(), "Particle " << pi << " not in cell");
+  *pit = cell.back();
+  cell.pop_back();
+  if (cell.empty()) cells_.erase(it);
+}
+
+void SpatialHashClosePairsFinder::rebin() {
+  IMP_LOG_TERSE("Rebinning spatial hash" << std::endl);
+  cells_.clear();
+  max_radius_ = 0;
+  for (unsigned int i = 0; i < is_stored_.size(); ++i) {
+    if (is_stored_[ParticleIndex(i)]) {
+      max_radius_ = std::max(max_radius_,
+                             spheres_[ParticleIndex(i)].get_radius());
+    }
+  }
+  cell_size_ = get_hash_cell_size(stored_distance_, max_radius_);
+  for (unsigned int i = 0; i < is_stored_.size(); ++i) {
+    if (is_stored_[ParticleIndex(i)]) add_to_cell(ParticleIndex(i));
+  }
+}
+
+void SpatialHashClosePairsFinder::set_particles(Model *m,
+                                                const ParticleIndexes &pis,
+                                                const Object *owner,
+                                                std::size_t contents_hash) {
+  IMP_OBJECT_LOG;
+  set_was_used(true);
+  clear_stored_particles();
+  m_ = m;
+  owner_ = owner;
+  contents_hash_ = contents_hash;
+  stored_distance_ = get_distance();
+  max_radius_ = get_hash_max_radius(m, pis);
+  cell_size_ = get_hash_cell_size(stored_distance_, max_radius_);
+  for (ParticleIndex pi : pis) {
+    resize_to_fit(spheres_, pi, algebra::Sphere3D());
+    resize_to_fit(is_stored_, pi, 0);
+    IMP_USAGE_CHECK(!is_stored_[pi], "Particle " << pi << " passed twice");
+    is_stored_[pi] = 1;
+    spheres_[pi] = static_cast<const Model *>(m)->get_sphere(pi);
+    add_to_cell(pi);
+  }
+  number_stored_ = pis.size();
+}
+
+void SpatialHashClosePairsFinder::update_particles(
+    const ParticleIndexes &pis) {
+  IMP_OBJECT_LOG;
+  bool grown = false;
+  for (ParticleIndex pi : pis) {
+    IMP_USAGE_CHECK(pi.get_index() < static_cast<int>(is_stored_.size())
+                    && is_stored_[pi],
+                    "Particle " << pi << " was not passed to set_particles()");
+    remove_from_cell(pi);
+    spheres_[pi] = static_cast<const Model *>(m_.get())->get_sphere(pi);
+    if (spheres_[pi].get_radius() > max_radius_) {
+      grown = true;
+    } else if (!grown) {
+      add_to_cell(pi);
+    }
+  }
+  if (grown) rebin();
+}
+
+ParticleIndexes SpatialHashClosePairsFinder::get_stored_neighbors(
+    ParticleIndex pi) const {
+  IMP_USAGE_CHECK(pi.get_index() < static_cast<int>(is_stored_.size())
+                  && is_stored_[pi],
+                  "Particle " << pi << " was not passed to set_particles()");
+  struct AddStored {
+    const SpatialHashClosePairsFinder *cpf_;
+    ParticleIndex a_;
+    ParticleIndexes out_;
+    void operator()(ParticleIndex b) {
+      if (b == a_) return;
+      if (!internal::get_are_close(cpf_->spheres_[a_], cpf_->spheres_[b],
+                                   cpf_->stored_distance_)) return;
+      if (internal::get_filters_contains(cpf_->m_, cpf_->access_pair_filters(),
+                                         ParticleIndexPair(a_, b))) return;
+      out_.push_back(b);
+    }
+  } add = {this, pi, ParticleIndexes()};
+  apply_to_hash_neighborhood(cells_, get_cell(spheres_[pi].get_center()),
+                             add);
+  return add.out_;
+}
+
+ParticleIndexPairs SpatialHashClosePairsFinder::get_stored_close_pairs()
+    const {
+  ParticleIndexPairs ret;
+  for (Cells::const_iterator it = cells_.begin(); it != cells_.end(); ++it) {
+    for (ParticleIndex pi : it->second) {
+      ParticleIndexes nbs = get_stored_neighbors(pi);
+      for (ParticleIndex nb : nbs) {
+        if (pi < nb) ret.push_back(ParticleIndexPair(pi, nb));
+      }
+    }
+  }
+  return ret;
+}
+
+void SpatialHashClosePairsFinder::clear_stored_particles() {
+  cells_.clear();
+  spheres_.clear();
+  is_stored_.clear();
+  number_stored_ = 0;
+  owner_ = nullptr;
+  contents_hash_ = 0;
+}
+
+IMP_OBJECT_SERIALIZE_IMPL(IMP::core::SpatialHashClosePairsFinder);
+
+IMPCORE_END_NAMESPACE
@@ -508,9 +508,11 @@ RigidBodyHierarchy *get_rigid_body_hierarchy(
 }
 
 ParticlePairsTemp close_pairs(Model *m, const RigidBodyHierarchy *da,
-                              const RigidBodyHierarchy *db, double dist) {
+                              const RigidBodyHierarchy *db, double dist,
+                              unsigned int num_threads) {
   ParticlePairsTemp ret;
-  fill_close_pairs(m, da, db, dist, ParticlePairSink(m, PairPredicates(), ret));
+  fill_close_pairs(m, da, db, dist, ParticlePairSink(m, PairPredicates(), ret),
+                   num_threads);
   IMP_IF_CHECK(USAGE_AND_INTERNAL) {
     std::sort(ret.begin(), ret.end());
     ParticleIndexes psa = da->get_constituents();
@@ -17,6 +17,7 @@
 #include <IMP/internal/ContainerConstraint.h>
 #include <IMP/internal/StaticListContainer.h>
 #include <IMP/internal/utility.h>
+#include <algorithm>
 #include <cereal/access.hpp>
 #include <cereal/types/base_class.hpp>
 
@@ -652,16 +653,116 @@ void RigidBody::set_reference_frame_from_members(
   // must reset collision detection tree when we do that
 }
 
+namespace {
+// number of members transformed or reduced together
+const unsigned int member_block_size = 64;
+
+/* Apply the transformation with rotation matrix R and translation t to
+   the internal coordinates of the members and store the results in the
+   member coordinates. Members are processed in blocks which are gathered
+   into structure-of-arrays form, so that the transformation itself is a
+   simple loop the compiler can vectorize. */
+void transform_members(const double R[3][3], const algebra::Vector3D &t,
+                       const ParticleIndexes &members,
+                       const algebra::Vector3D *ic, algebra::Sphere3D *xyzr) {
+  double x[member_block_size], y[member_block_size], z[member_block_size];
+  double gx[member_block_size], gy[member_block_size], gz[member_block_size];
+  for (unsigned int b = 0; b < members.size(); b += member_block_size) {
+    unsigned int n = std::min<unsigned int>(member_block_size,
+                                            members.size() - b);
+    for (unsigned int i = 0; i < n; ++i) {
+      const algebra::Vector3D &v = ic[members[b + i].get_index()];
+      x[i] = v[0];
+      y[i] = v[1];
+      z[i] = v[2];
+    }
+    for (unsigned int i = 0; i < n; ++i) {
+      gx[i] = R[0][0] * x[i] + R[0][1] * y[i] + R[0][2] * z[i] + t[0];
+      gy[i] = R[1][0] * x[i] + R[1][1] * y[i] + R[1][2] * z[i] + t[1];
+      gz[i] = R[2][0] * x[i] + R[2][1] * y[i] + R[2][2] * z[i] + t[2];
+    }
+    for (unsigned int i = 0; i < n; ++i) {
+      algebra::Sphere3D &s = xyzr[members[b + i].get_index()];
+      s[0] = gx[i];
+      s[1] = gy[i];
+      s[2] = gz[i];
+    }
+  }
+}
+
+/* Compute M = sum_i x_i Dy_i^T and sum_i Dy_i over the members, where x_i
+   are the internal coordinates and Dy_i the adjoints of the global
+   coordinates. All adjoints of the transformation and the torque are
+   linear in these sums (see pull_back_points_adjoints()). */
+void reduce_member_adjoints(const ParticleIndexes &members,
+                            const algebra::Vector3D *ic,
+                            const algebra::Sphere3D *dxyzr, double M[3][3],
+                            double Dt[3]) {
+  double x[member_block_size], y[member_block_size], z[member_block_size];
+  double dx[member_block_size], dy[member_block_size], dz[member_block_size];
+  double s[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  for (unsigned int b = 0; b < members.size(); b += member_block_size) {
+    unsigned int n = std::min<unsigned int>(member_block_size,
+                                            members.size() - b);
+    for (unsigned int i = 0; i < n; ++i) {
+      int pi = members[b + i].get_index();
+      x[i] = ic[pi][0];
+      y[i] = ic[pi][1];
+      z[i] = ic[pi][2];
+      dx[i] = dxyzr[pi][0];
+      dy[i] = dxyzr[pi][1];
+      dz[i] = dxyzr[pi][2];
+    }
+    double s0 = 0, s1 = 0, s2 = 0, s3 = 0, s4 = 0, s5 = 0, s6 = 0, s7 = 0,
+           s8 = 0, s9 = 0, s10 = 0, s11 = 0;
+    for (unsigned int i = 0; i < n; ++i) {
+      s0 += x[i] * dx[i];
+      s1 += x[i] * dy[i];
+      s2 += x[i] * dz[i];
+      s3 += y[i] * dx[i];
+      s4 += y[i] * dy[i];
+      s5 += y[i] * dz[i];
+      s6 += z[i] * dx[i];
+      s7 += z[i] * dy[i];
+      s8 += z[i] * dz[i];
+      s9 += dx[i];
+      s10 += dy[i];
+      s11 += dz[i];
+    }
+    s[0] += s0; s[1] += s1; s[2] += s2; s[3] += s3; s[4] += s4; s[5] += s5;
+    s[6] += s6; s[7] += s7; s[8] += s8; s[9] += s9; s[10] += s10;
+    s[11] += s11;
+  }
+  for (unsigned int i = 0; i < 3; ++i) {
+    for (unsigned int j = 0; j < 3; ++j) {
+      M[i][j] = s[3 * i + j];
+    }
+    Dt[i] = s[9 + i];
+  }
+}
+
+void get_rotation_matrix(const algebra::Rotation3D &rot, double R[3][3]) {
+  for (unsigned int i = 0; i < 3; ++i) {
+    algebra::Vector3D row = rot.get_rotation_matrix_row(i);
+    for (unsigned int j = 0; j < 3; ++j) {
+      R[i][j] = row[j];
+    }
+  }
+}
+}
+
 void RigidBody::update_members() {
   algebra::Transformation3D tr = get_reference_frame().get_transformation_to();
   {
     const ParticleIndexes &members = get_member_particle_indexes();
     Model *m = get_model();
-    algebra::Vector3D const *ic = m->access_internal_coordinates_data();
-    for (unsigned int i = 0; i < members.size(); ++i) {
-      XYZ rm(m, members[i]);
-      rm.set_coordinates(tr.get_transformed(ic[members[i].get_index()]));
-    }
+    const Model *cm = m;
+    double R[3][3];
+    get_rotation_matrix(tr.get_rotation(), R);
+    // only the member coordinates are written
+    transform_members(R, tr.get_translation(), members,
+                      cm->access_internal_coordinates_data(),
+                      m->access_spheres_data(members));
   }
   {
     const ParticleIndexes &members = get_body_member_particle_indexes();
@@ -675,18 +776,70 @@ void RigidBody::update_members() {
   }
 }
 
+void RigidBody::pull_back_points_adjoints(const algebra::Transformation3D &T,
+                                          DerivativeAccumulator &da) {
+  const ParticleIndexes &mis = get_member_particle_indexes();
+  if (mis.empty()) return;
+  Model *m = get_model();
+  const Model *cm = m;
+  double M[3][3], Dt[3], R[3][3];
+  // only reads the model, so no snapshot pages are marked
+  reduce_member_adjoints(mis, cm->access_internal_coordinates_data(),
+                         cm->access_sphere_derivatives_data(), M, Dt);
+  get_rotation_matrix(T.get_rotation(), R);
+
+  // sum_i x_i x Dy_i and sum_i x_i . Dy_i
+  algebra::Vector3D xcrossDy(M[1][2] - M[2][1], M[2][0] - M[0][2],
+                             M[0][1] - M[1][0]);
+  double xDy = M[0][0] + M[1][1] + M[2][2];
+
+  // adjoint on the quaternion, summed over members
+  // (see Rotation3D::get_rotated_adjoint())
+  const algebra::Vector4D &Q = T.get_rotation().get_quaternion();
+  double q0 = Q[0];
+  algebra::Vector3D q(Q[1], Q[2], Q[3]), Mq, MTq;
+  for (unsigned int i = 0; i < 3; ++i) {
+    Mq[i] = M[i][0] * q[0] + M[i][1] * q[1] + M[i][2] * q[2];
+    MTq[i] = M[0][i] * q[0] + M[1][i] * q[1] + M[2][i] * q[2];
+  }
+  algebra::Vector3D Dq = 2 * (-xDy * q + q0 * xcrossDy + MTq + Mq);
+  algebra::Vector4D DQ(2 * (q0 * xDy + q * xcrossDy), Dq[0], Dq[1], Dq[2]);
+  add_to_rotational_derivatives(DQ, da);
+  XYZ::add_to_derivatives(algebra::Vector3D(Dt[0], Dt[1], Dt[2]), da);
+
+  // sum_i x_i x (R^T Dy_i) is the antisymmetric part of M R
+  double N[3][3];
+  for (unsigned int i = 0; i < 3; ++i) {
+    for (unsigned int j = 0; j < 3; ++j) {
+      N[i][j] = M[i][0] * R[0][j] + M[i][1] * R[1][j] + M[i][2] * R[2][j];
+    }
+  }
+  add_to_torque(algebra::Vector3D(N[1][2] - N[2][1], N[2][0] - N[0][2],
+                                  N[0][1] - N[1][0]),
+                da);
+
+  // non-rigid members also need the adjoint of their internal coordinates
+  for (unsigned int i = 0; i < mis.size(); ++i) {
+    if (m->get_attribute(internal::rigid_body_data().is_rigid_key_, mis[i])
+        != 1) {
+      const algebra::Vector3D &Dy = m->get_coordinate_derivatives(mis[i]);
+      algebra::Vector3D Dx;
+      for (unsigned int j = 0; j < 3; ++j) {
+        Dx[j] = R[0][j] * Dy[0] + R[1][j] * Dy[1] + R[2][j] * Dy[2];
+      }
+      NonRigidMember(m, mis[i]).add_to_internal_derivatives(Dx, da);
+    }
+  }
+}
+
 void RigidBody::pull_back_members_adjoints(DerivativeAccumulator &da) {
   algebra::Transformation3D TA = get_reference_frame().get_transformation_to();
   algebra::Transformation3D TB;
   algebra::Transformation3DAdjoint DTA, DTB, DTC;
-  algebra::Vector3D beta, betatorque;
+  algebra::Vector3D betatorque;
 
-  const ParticleIndexes &mis = get_member_particle_indexes();
-  for (unsigned int i = 0; i < mis.size(); ++i) {
-    // y = T(A, alpha) * beta = A * beta + alpha
-    pull_back_member_adjoints(mis[i], TA, beta,
-                              DTC.second, DTB.second, DTA, betatorque, da);
-  }
+  // y = T(A, alpha) * beta = A * beta + alpha, summed over point members
+  pull_back_points_adjoints(TA, da);
 
   const ParticleIndexes &bmis = get_body_member_particle_indexes();
   for (unsigned int i = 0; i < bmis.size(); ++i) {
@@ -137,6 +137,10 @@ class Tests(IMP.test.TestCase):
         # IMP.set_log_level(IMP.VERBOSE)
         self.do_test_one(IMP.core.GridClosePairsFinder())
 
+    def test_spatial_hash(self):
+        """Testing SpatialHashClosePairsFinder"""
+        self.do_test_one(IMP.core.SpatialHashClosePairsFinder())
+
     def test_rigid(self):
         "Testing RigidClosePairsFinder"""
         IMP.set_log_level(IMP.VERBOSE)
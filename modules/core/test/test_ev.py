@@ -46,5 +46,89 @@ class Tests(IMP.test.TestCase):
         print("pairs are", ppi)
         self.assertAlmostEqual(r.evaluate(False), cr.evaluate(False),
                                delta=.1)
+
+    def _create_rigid_body(self, m, center):
+        bb = IMP.algebra.BoundingBox3D(center - IMP.algebra.Vector3D(3, 3, 3),
+                                       center + IMP.algebra.Vector3D(3, 3, 3))
+        ps = []
+        for i in range(20):
+            d = IMP.core.XYZR.setup_particle(
+                IMP.Particle(m), IMP.algebra.Sphere3D(
+                    IMP.algebra.get_random_vector_in(bb), 1.))
+            ps.append(d)
+        return IMP.core.RigidBody.setup_particle(IMP.Particle(m), ps), ps
+
+    def test_incremental(self):
+        """Test incremental evaluation of excluded volume"""
+        m = IMP.Model()
+        bb = IMP.algebra.BoundingBox3D(IMP.algebra.Vector3D(0, 0, 0),
+                                       IMP.algebra.Vector3D(15, 15, 15))
+        rbs = []
+        members = []
+        for i in range(8):
+            rb, ps = self._create_rigid_body(
+                m, IMP.algebra.get_random_vector_in(bb))
+            rbs.append(rb)
+            members.extend(ps)
+        free = [IMP.core.XYZR.setup_particle(
+                    IMP.Particle(m), IMP.algebra.Sphere3D(
+                        IMP.algebra.get_random_vector_in(bb), 1.))
+                for i in range(10)]
+        r = IMP.core.ExcludedVolumeRestraint(members + free, 1, 2)
+        r.set_use_incremental_evaluation(True)
+        self.assertTrue(r.get_use_incremental_evaluation())
+        ref = IMP.core.ExcludedVolumeRestraint(members + free, 1, 2)
+        sf = IMP.core.RestraintsScoringFunction([r])
+        ref_sf = IMP.core.RestraintsScoringFunction([ref])
+        self.assertAlmostEqual(sf.evaluate(False), ref_sf.evaluate(False),
+                               delta=1e-4)
+        for i in range(20):
+            if i % 3 == 0:
+                moved = free[i % len(free)]
+                moved.set_coordinates(IMP.algebra.get_random_vector_in(bb))
+            else:
+                moved = rbs[i % len(rbs)]
+                tr = IMP.algebra.Transformation3D(
+                    IMP.algebra.get_random_rotation_3d(),
+                    IMP.algebra.get_random_vector_in(bb)
+                    - moved.get_coordinates())
+                IMP.core.transform(moved, tr)
+            score = sf.evaluate_moved(False, [moved], [])
+            self.assertAlmostEqual(score, ref_sf.evaluate(False), delta=1e-4)
+
+    def test_incremental_radius(self):
+        """Test incremental excluded volume after a member radius change"""
+        m = IMP.Model()
+        bb = IMP.algebra.BoundingBox3D(IMP.algebra.Vector3D(0, 0, 0),
+                                       IMP.algebra.Vector3D(15, 15, 15))
+        rbs = []
+        members = []
+        for i in range(6):
+            rb, ps = self._create_rigid_body(
+                m, IMP.algebra.get_random_vector_in(bb))
+            rbs.append(rb)
+            members.append(ps)
+        allps = sum(members, [])
+        r = IMP.core.ExcludedVolumeRestraint(allps, 1, 2)
+        r.set_use_incremental_evaluation(True)
+        ref = IMP.core.ExcludedVolumeRestraint(allps, 1, 2)
+        sf = IMP.core.RestraintsScoringFunction([r])
+        ref_sf = IMP.core.RestraintsScoringFunction([ref])
+        sf.evaluate(False)
+        for i in range(5):
+            # grow members of a body that is not reported as moved
+            for p in members[i]:
+                p.set_radius(p.get_radius() + 1.)
+            rbs[i].on_change()
+            moved = rbs[(i + 1) % len(rbs)]
+            tr = IMP.algebra.Transformation3D(
+                IMP.algebra.get_random_rotation_3d(),
+                IMP.algebra.get_random_vector_in(bb)
+                - moved.get_coordinates())
+            IMP.core.transform(moved, tr)
+            score = sf.evaluate_moved(False, [moved], [])
+            self.assertAlmostEqual(score, ref_sf.evaluate(False), delta=1e-4)
+
+
 if __name__ == '__main__':
     IMP.test.main()
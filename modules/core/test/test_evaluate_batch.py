@@ -0,0 +1,107 @@
+import IMP
+import IMP.test
+import IMP.core
+import IMP.algebra
+
+
+class Tests(IMP.test.TestCase):
+
+    def _make_system(self):
+        m = IMP.Model()
+        bb = IMP.algebra.get_unit_bounding_box_3d()
+        ps = []
+        for i in range(3):
+            p = IMP.core.XYZ.setup_particle(
+                IMP.Particle(m),
+                IMP.algebra.get_random_vector_in(bb) * 5.)
+            ps.append(p)
+        # scored in one call per batch
+        dr = IMP.core.DistanceRestraint(m, IMP.core.Harmonic(1.0, 1.0),
+                                        ps[0], ps[1])
+        rs = IMP.RestraintSet(m, 2.0)
+        rs.add_restraint(dr)
+        # scored one configuration at a time
+        pr = IMP.core.PairRestraint(
+            m, IMP.core.HarmonicDistancePairScore(2.0, 3.0), (ps[1], ps[2]))
+        sf = IMP.core.RestraintsScoringFunction([rs, pr])
+        return m, ps, sf
+
+    def _get_batch(self, n, nparticles):
+        bb = IMP.algebra.get_unit_bounding_box_3d()
+        batch = []
+        for k in range(n):
+            coords = []
+            for i in range(nparticles):
+                coords.extend(IMP.algebra.get_random_vector_in(bb) * 5.)
+            batch.append(coords)
+        return batch
+
+    def _set_configuration(self, ps, coords):
+        for i, p in enumerate(ps):
+            p.set_coordinates(IMP.algebra.Vector3D(coords[3 * i:3 * i + 3]))
+
+    def test_scores(self):
+        """Test batch scores match one-at-a-time evaluation"""
+        m, ps, sf = self._make_system()
+        # only move the first two particles
+        pis = [p.get_particle_index() for p in ps[:2]]
+        batch = self._get_batch(10, 2)
+        old = [p.get_coordinates() for p in ps]
+        scores = sf.evaluate_batch(pis, batch)
+        self.assertEqual(len(scores), 10)
+        self.assertEqual(len(sf.get_batch_derivatives()), 0)
+        # the model is unchanged
+        for p, o in zip(ps, old):
+            self.assertLess(IMP.algebra.get_distance(p.get_coordinates(), o),
+                            1e-6)
+        for coords, score in zip(batch, scores):
+            self._set_configuration(ps[:2], coords)
+            self.assertAlmostEqual(sf.evaluate(False), score, delta=1e-6)
+
+    def test_derivatives(self):
+        """Test batch derivatives match one-at-a-time evaluation"""
+        m, ps, sf = self._make_system()
+        pis = [p.get_particle_index() for p in ps]
+        batch = self._get_batch(4, 3)
+        scores = sf.evaluate_batch(pis, batch, True)
+        derivs = sf.get_batch_derivatives()
+        self.assertEqual(len(derivs), 4)
+        for coords, score, deriv in zip(batch, scores, derivs):
+            self._set_configuration(ps, coords)
+            self.assertAlmostEqual(sf.evaluate(True), score, delta=1e-6)
+            for i, p in enumerate(ps):
+                d = p.get_derivatives()
+                for j in range(3):
+                    self.assertAlmostEqual(d[j], deriv[3 * i + j],
+                                           delta=1e-6)
+
+    def test_weights(self):
+        """Test batch scores of weighted restraints match evaluate"""
+        m, ps, sf = self._make_system()
+        dr = IMP.core.DistanceRestraint(m, IMP.core.Harmonic(1.0, 1.0),
+                                        ps[0], ps[2])
+        dr.set_weight(3.0)
+        pr = IMP.core.PairRestraint(
+            m, IMP.core.HarmonicDistancePairScore(2.0, 3.0), (ps[0], ps[1]))
+        pr.set_weight(0.5)
+        inner = IMP.RestraintSet(m, 0.25)
+        inner.add_restraints([dr, pr])
+        inner.set_maximum_score(1e6)
+        outer = IMP.RestraintSet(m, 4.0)
+        outer.add_restraint(inner)
+        sf = IMP.core.RestraintsScoringFunction([outer], 1.5)
+        pis = [p.get_particle_index() for p in ps]
+        batch = self._get_batch(6, 3)
+        scores = sf.evaluate_batch(pis, batch)
+        for coords, score in zip(batch, scores):
+            self._set_configuration(ps, coords)
+            self.assertAlmostEqual(sf.evaluate(False), score, delta=1e-6)
+
+    def test_empty(self):
+        """Test batch evaluation of no configurations"""
+        m, ps, sf = self._make_system()
+        self.assertEqual(len(sf.evaluate_batch([], [])), 0)
+
+
+if __name__ == '__main__':
+    IMP.test.main()
@@ -0,0 +1,55 @@
+#include <IMP/Model.h>
+#include <IMP/flags.h>
+#include <IMP/core/XYZR.h>
+#include <IMP/core/GridClosePairsFinder.h>
+#include <IMP/algebra/vector_generators.h>
+#include <IMP/test/test_macros.h>
+
+namespace {
+std::string get_module_name() { return "anon"; }
+std::string get_module_version() { return "anon"; }
+
+IMP::ParticleIndexes create_particles(IMP::Model *m, unsigned int n) {
+  IMP::algebra::BoundingBox3D bb(IMP::algebra::Vector3D(0, 0, 0),
+                                 IMP::algebra::Vector3D(60, 60, 60));
+  IMP::ParticleIndexes ret;
+  for (unsigned int i = 0; i < n; ++i) {
+    IMP::ParticleIndex pi = m->add_particle("p");
+    IMP::core::XYZR::setup_particle(
+        m, pi, IMP::algebra::Sphere3D(IMP::algebra::get_random_vector_in(bb),
+                                      .1 + .01 * (i % 50)));
+    ret.push_back(pi);
+  }
+  return ret;
+}
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    IMP::setup_from_argv(argc, argv,
+                         "Test that threaded grid searches match serial ones.");
+    IMP_NEW(IMP::Model, m, ());
+    IMP::ParticleIndexes pa = create_particles(m, 20000);
+    IMP::ParticleIndexes pb = create_particles(m, 5000);
+    IMP_NEW(IMP::core::GridClosePairsFinder, cpf, ());
+    cpf->set_distance(.5);
+
+    cpf->set_number_of_threads(1);
+    IMP::ParticleIndexPairs serial = cpf->get_close_pairs(m, pa);
+    IMP::ParticleIndexPairs serial_bi = cpf->get_close_pairs(m, pa, pb);
+    IMP_TEST_GREATER_THAN(serial.size(), 0U);
+    IMP_TEST_GREATER_THAN(serial_bi.size(), 0U);
+
+    // the pairs, and their order, must not depend on the number of threads
+    cpf->set_number_of_threads(4);
+    IMP::ParticleIndexPairs threaded = cpf->get_close_pairs(m, pa);
+    IMP::ParticleIndexPairs threaded_bi = cpf->get_close_pairs(m, pa, pb);
+    IMP_TEST_TRUE(serial == threaded);
+    IMP_TEST_TRUE(serial_bi == threaded_bi);
+  }
+  catch (const IMP::Exception &e) {
+    std::cerr << "Failed with exception " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
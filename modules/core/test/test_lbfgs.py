@@ -0,0 +1,81 @@
+import IMP
+import IMP.test
+import IMP.core
+import IMP.algebra
+
+
+class WoodsFunc(IMP.Restraint):
+
+    """Woods function for four input values, defined as an IMP restraint"""
+
+    def __init__(self, model, particles):
+        IMP.Restraint.__init__(self, model, "WoodsFunc %1%")
+        self.particles = particles
+        self.index = IMP.FloatKey("x")
+
+    def unprotected_evaluate(self, accum):
+        m = self.get_model()
+        (x1, x2, x3, x4) = [m.get_attribute(self.index, p)
+                            for p in self.particles]
+        a = x2 - x1 * x1
+        b = x4 - x3 * x3
+        e = 100.0 * a * a + (1.0 - x1) ** 2 + 90.0 * b * b + (1.0 - x3) ** 2 \
+            + 10.1 * ((x2 - 1.0) ** 2 + (x4 - 1.0) ** 2) \
+            + 19.8 * (x2 - 1.0) * (x4 - 1.0)
+        if accum:
+            dx = [-2.0 * (200.0 * x1 * a + 1.0 - x1),
+                  2.0 * (100.0 * a + 10.1 * (x2 - 1.0) + 9.9 * (x4 - 1.0)),
+                  -2.0 * (180.0 * x3 * b + 1.0 - x3),
+                  2.0 * (90.0 * b + 10.1 * (x4 - 1.0) + 9.9 * (x2 - 1.0))]
+            for (p, d) in zip(self.particles, dx):
+                m.add_to_derivative(self.index, p, d, accum)
+        return e
+
+    def do_get_inputs(self):
+        m = self.get_model()
+        return IMP.get_particles(m, self.particles)
+
+
+class Tests(IMP.test.TestCase):
+
+    def test_woods_func(self):
+        """Check that we can optimize the Woods function with L-BFGS"""
+        for start in ((-3.0, -1.0, -3.0, -1.0), (2.0, 3.0, 8.0, -5.0)):
+            model = IMP.Model()
+            xkey = IMP.FloatKey("x")
+            particles = []
+            for value in start:
+                p = model.add_particle("p")
+                particles.append(p)
+                model.add_attribute(xkey, p, value)
+                model.set_is_optimized(xkey, p, True)
+            opt = IMP.core.LBFGS(model)
+            self.assertEqual(opt.get_number_of_corrections(), 7)
+            opt.set_scoring_function([WoodsFunc(model, particles)])
+            opt.set_gradient_threshold(1e-8)
+            e = opt.optimize(500)
+            for p in particles:
+                self.assertAlmostEqual(model.get_attribute(xkey, p), 1.0,
+                                       places=1)
+            self.assertAlmostEqual(e, 0.0, places=2)
+
+    def test_coordinates(self):
+        """Check that L-BFGS moves optimized coordinates"""
+        m = IMP.Model()
+        d1 = IMP.core.XYZ.setup_particle(IMP.Particle(m),
+                                         IMP.algebra.Vector3D(0, 0, 0))
+        d2 = IMP.core.XYZ.setup_particle(IMP.Particle(m),
+                                         IMP.algebra.Vector3D(3, 4, 5))
+        d2.set_coordinates_are_optimized(True)
+        dr = IMP.core.DistanceRestraint(m, IMP.core.Harmonic(1, 1), d1, d2)
+        opt = IMP.core.LBFGS(m)
+        opt.set_scoring_function([dr])
+        for i in range(3):
+            # repeated calls reuse the optimizer's buffers
+            e = opt.optimize(50)
+        self.assertAlmostEqual(e, 0.0, places=4)
+        self.assertAlmostEqual(IMP.core.get_distance(d1, d2), 1.0, places=2)
+
+
+if __name__ == '__main__':
+    IMP.test.main()
@@ -141,6 +141,101 @@ class Tests(IMP.test.TestCase):
                              mc.get_number_of_downward_steps())
             self.assertEqual(mc.get_number_of_proposed_steps(), 100)
 
+    def test_multiple_try(self):
+        """Test multiple-try MonteCarlo"""
+        bb = IMP.algebra.get_unit_bounding_box_3d()
+        coords = [IMP.algebra.get_random_vector_in(bb) for _ in range(10)]
+        m, mc = setup_system(coords, use_container='pair')
+        self.assertEqual(mc.get_number_of_trials(), 1)
+        mc.set_number_of_trials(4)
+        self.assertEqual(mc.get_number_of_trials(), 4)
+        mc.set_kt(.1)
+        sf = mc.get_scoring_function()
+        start = sf.evaluate(False)
+        score = mc.optimize(100)
+        self.assertEqual(mc.get_number_of_proposed_steps(), 100)
+        self.assertGreater(mc.get_number_of_accepted_steps(), 0)
+        self.assertAlmostEqual(score, sf.evaluate(False), delta=1e-6)
+        self.assertLess(score, start)
+        # each step proposes 4 trial and 3 reference moves, and rolls
+        # each of them back
+        mover = mc.get_mover(0)
+        self.assertEqual(mover.get_number_of_proposed(), 700)
+        self.assertEqual(mover.get_number_of_accepted(), 0)
+
+    def test_multiple_try_rigid_bodies(self):
+        """Test multiple-try MonteCarlo with rigid body moves"""
+        m = IMP.Model()
+        bb = IMP.algebra.get_unit_bounding_box_3d()
+        rbs = []
+        for i in range(3):
+            ps = [IMP.core.XYZR.setup_particle(
+                      IMP.Particle(m), IMP.algebra.Sphere3D(
+                          IMP.algebra.get_random_vector_in(bb), .1))
+                  for j in range(3)]
+            rbs.append(IMP.core.RigidBody.setup_particle(IMP.Particle(m), ps))
+        hps = IMP.core.HarmonicDistancePairScore(1, 100)
+        members = [rb.get_member_particle_indexes()[0] for rb in rbs]
+        rs = [IMP.core.PairRestraint(m, hps, (members[i], members[i + 1]))
+              for i in range(2)]
+        mc = IMP.core.MonteCarlo(m)
+        mc.set_scoring_function(rs)
+        mc.set_return_best(False)
+        mc.add_mover(IMP.core.SerialMover(
+            [IMP.core.RigidBodyMover(m, rb.get_particle_index(), .1, .1)
+             for rb in rbs]))
+        mc.set_number_of_trials(3)
+        mc.set_kt(.1)
+        score = mc.optimize(50)
+        self.assertGreater(mc.get_number_of_accepted_steps(), 0)
+        self.assertAlmostEqual(score,
+                               mc.get_scoring_function().evaluate(False),
+                               delta=1e-6)
+
+    def test_multiple_try_exact(self):
+        """Multiple-try MonteCarlo should ignore the maximum difference"""
+        bb = IMP.algebra.get_unit_bounding_box_3d()
+        coords = [IMP.algebra.get_random_vector_in(bb) for _ in range(10)]
+        m1, mc1 = setup_system(coords, use_container=False)
+        m2, mc2 = setup_system(coords, use_container=False)
+        for mc in mc1, mc2:
+            mc.set_number_of_trials(3)
+            mc.set_kt(.1)
+        mc2.set_maximum_difference(1e-3)
+
+        IMP.random_number_generator.seed(99)
+        mc1_score = mc1.optimize(50)
+        IMP.random_number_generator.seed(99)
+        mc2_score = mc2.optimize(50)
+
+        self.assertAlmostEqual(mc1_score, mc2_score, delta=1e-6)
+        self.assertEqual(mc2.get_maximum_difference(), 1e-3)
+
+    def test_multiple_try_moved_same_trajectory(self):
+        """Multiple-try MonteCarlo should not be changed by
+           set_score_moved()"""
+        bb = IMP.algebra.get_unit_bounding_box_3d()
+        coords = [IMP.algebra.get_random_vector_in(bb) for _ in range(10)]
+        m1, mc1 = setup_system(coords, use_container=False)
+        m2, mc2 = setup_system(coords, use_container=False)
+        for mc in mc1, mc2:
+            mc.set_number_of_trials(3)
+            mc.set_kt(.1)
+
+        IMP.random_number_generator.seed(99)
+        mc1_score = mc1.optimize(50)
+
+        mc2.set_score_moved(True)
+        IMP.random_number_generator.seed(99)
+        mc2_score = mc2.optimize(50)
+
+        self.assertAlmostEqual(mc1_score, mc2_score, delta=1e-6)
+        self.assertEqual(mc1.get_number_of_accepted_steps(),
+                         mc2.get_number_of_accepted_steps())
+        self.assertAlmostEqual(mc2_score,
+                               mc2.get_scoring_function().evaluate(False),
+                               delta=1e-6)
+
     def test_restraint_set_moved_same_trajectory(self):
         """MonteCarlo trajectory should not be changed by set_score_moved()
            when using RestraintSet"""
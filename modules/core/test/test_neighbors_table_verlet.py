@@ -0,0 +1,78 @@
+import IMP
+import IMP.test
+import IMP.algebra
+import IMP.core
+import IMP.container
+
+
+def setup_system(n):
+    m = IMP.Model()
+    bb = IMP.algebra.get_unit_bounding_box_3d()
+    pis = [m.add_particle("P%1%") for i in range(n)]
+    for p in pis:
+        IMP.core.XYZR.setup_particle(
+            m, p,
+            IMP.algebra.Sphere3D(IMP.algebra.get_random_vector_in(bb), .05))
+    return m, pis
+
+
+class Tests(IMP.test.TestCase):
+
+    def assert_all_close_pairs(self, m, pis, nt, distance):
+        for i, a in enumerate(pis):
+            na = nt.get_neighbors(a)
+            self.assertEqual(len(na), nt.get_number_of_neighbors(a))
+            for b in pis[i + 1:]:
+                if IMP.core.get_distance(IMP.core.XYZR(m, a),
+                                         IMP.core.XYZR(m, b)) < distance:
+                    self.assertIn(b, na)
+                    self.assertIn(a, nt.get_neighbors(b))
+
+    def test_verlet(self):
+        """Test NeighborsTable Verlet list"""
+        m, pis = setup_system(40)
+        distance = .1
+        nt = IMP.core.NeighborsTable(
+            IMP.container.ListSingletonContainer(m, pis), distance, .1)
+        m.update()
+        self.assertEqual(nt.get_number_of_rebuilds(), 1)
+        self.assert_all_close_pairs(m, pis, nt, distance)
+        # Small moves should not trigger a rebuild
+        for i in range(20):
+            for p in pis:
+                d = IMP.core.XYZ(m, p)
+                d.set_coordinates(d.get_coordinates()
+                                  + IMP.algebra.get_random_vector_in(
+                                      IMP.algebra.Sphere3D(
+                                          IMP.algebra.Vector3D(0, 0, 0),
+                                          .002)))
+            m.update()
+            self.assert_all_close_pairs(m, pis, nt, distance)
+        self.assertLess(nt.get_number_of_rebuilds(), 21)
+        # A large move of one particle must
+        rebuilds = nt.get_number_of_rebuilds()
+        IMP.core.XYZ(m, pis[0]).set_coordinates(
+            IMP.algebra.Vector3D(.5, .5, .5))
+        m.update()
+        self.assertEqual(nt.get_number_of_rebuilds(), rebuilds + 1)
+        self.assert_all_close_pairs(m, pis, nt, distance)
+
+    def test_pair_container(self):
+        """Test NeighborsTable built from an already-filled container"""
+        m, pis = setup_system(10)
+        lpc = IMP.container.ListPairContainer(m, [(pis[0], pis[1]),
+                                                  (pis[1], pis[2])])
+        nt = IMP.core.NeighborsTable(lpc)
+        m.update()
+        n1 = nt.get_neighbors(pis[1])
+        self.assertEqual(len(n1), 2)
+        self.assertIn(pis[0], n1)
+        self.assertIn(pis[2], n1)
+        self.assertEqual(nt.get_neighbors(pis[0]), [pis[1]])
+        self.assertEqual(nt.get_number_of_neighbors(pis[5]), 0)
+        m.update()
+        self.assertEqual(nt.get_number_of_rebuilds(), 1)
+
+
+if __name__ == '__main__':
+    IMP.test.main()
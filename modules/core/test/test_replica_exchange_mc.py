@@ -0,0 +1,71 @@
+import IMP
+import IMP.test
+import IMP.core
+import IMP.algebra
+
+
+def setup_replica():
+    m = IMP.Model()
+    ps = []
+    for i in range(6):
+        d = IMP.core.XYZR.setup_particle(IMP.Particle(m))
+        d.set_coordinates(IMP.algebra.Vector3D(i, 0, 0))
+        d.set_radius(.1)
+        d.set_coordinates_are_optimized(True)
+        ps.append(d)
+    hps = IMP.core.HarmonicDistancePairScore(1, 10)
+    rs = [IMP.core.PairRestraint(m, hps, (ps[i], ps[i + 1]))
+          for i in range(len(ps) - 1)]
+    mc = IMP.core.MonteCarlo(m)
+    mc.set_scoring_function(rs)
+    mc.add_mover(IMP.core.SerialMover(
+        [IMP.core.BallMover(m, p, 0.5) for p in ps]))
+    return mc, ps
+
+
+class Tests(IMP.test.TestCase):
+
+    def run_exchange(self, num_threads):
+        replicas = [setup_replica() for i in range(4)]
+        rem = IMP.core.ReplicaExchangeMonteCarlo(
+            [r[0] for r in replicas], [1., 2., 4., 8.])
+        rem.set_seed(42)
+        rem.set_number_of_threads(num_threads)
+        rem.optimize(10, 20)
+        return rem, [[p.get_coordinates() for p in r[1]] for r in replicas]
+
+    def test_exchange(self):
+        """Test in-process replica exchange Monte Carlo"""
+        rem, coords = self.run_exchange(4)
+        self.assertEqual(rem.get_number_of_replicas(), 4)
+        temps = sorted(rem.get_temperature_index(i) for i in range(4))
+        self.assertEqual(temps, [0, 1, 2, 3])
+        for t in range(4):
+            r = rem.get_replica_at_temperature(t)
+            self.assertEqual(rem.get_temperature_index(r), t)
+            self.assertAlmostEqual(rem.get_replica(r).get_kt(),
+                                   rem.get_temperature(t), delta=1e-6)
+        for i in range(4):
+            self.assertEqual(rem.get_number_of_proposed_steps(i), 200)
+            self.assertGreater(rem.get_number_of_accepted_steps(i), 0)
+        # pairs are tried alternately, starting with the even ones
+        self.assertEqual([rem.get_number_of_exchanges_tried(t)
+                          for t in range(3)], [5, 5, 5])
+        for t in range(3):
+            self.assertLessEqual(rem.get_number_of_exchanges_accepted(t), 5)
+        rem.reset_statistics()
+        self.assertEqual(rem.get_number_of_proposed_steps(0), 0)
+
+    def test_deterministic(self):
+        """Test that replica exchange does not depend on the thread count"""
+        rem1, coords1 = self.run_exchange(1)
+        rem4, coords4 = self.run_exchange(4)
+        for r1, r4 in zip(coords1, coords4):
+            for c1, c4 in zip(r1, r4):
+                self.assertLess(IMP.algebra.get_distance(c1, c4), 1e-6)
+        self.assertEqual([rem1.get_temperature_index(i) for i in range(4)],
+                         [rem4.get_temperature_index(i) for i in range(4)])
+
+
+if __name__ == '__main__':
+    IMP.test.main()
@@ -24,6 +24,26 @@ class TestMovedRestraint(IMP.Restraint):
         return self.ps
 
 
+class LogRestraint(IMP.Restraint):
+    """Record whether the restraint was evaluated"""
+    def __init__(self, m, ps, value):
+        IMP.Restraint.__init__(self, m, "LogRestraint %1%")
+        self.ps = ps
+        self.value = value
+        self.evaluated = False
+
+    def unprotected_evaluate(self, accum):
+        self.evaluated = True
+        return self.value
+
+    def unprotected_evaluate_moved(self, accum, moved_pis, reset_pis):
+        self.evaluated = True
+        return self.value
+
+    def do_get_inputs(self):
+        return self.ps
+
+
 class Tests(IMP.test.TestCase):
 
     """Test RestraintSets"""
@@ -91,6 +111,68 @@ class Tests(IMP.test.TestCase):
         self.assertEqual(r1.moved_pis, IMP.get_indexes([p]))
         self.assertEqual(len(r1.reset_pis), 0)
 
+    def test_evaluate_moved_skip(self):
+        """Test that evaluate_moved skips unaffected restraints"""
+        def assert_restraint_skipped(r):
+            # In debug mode restraints aren't actually skipped; they are
+            # evaluated and the score is checked against the cached score
+            if IMP.get_check_level() >= IMP.USAGE_AND_INTERNAL:
+                self.assertTrue(r.evaluated)
+            else:
+                self.assertFalse(r.evaluated)
+        m = IMP.Model()
+        p1 = IMP.Particle(m)
+        p2 = IMP.Particle(m)
+        p3 = IMP.Particle(m)
+        r1 = LogRestraint(m, [p1], 100.0)
+        r2 = LogRestraint(m, [p2], 10.0)
+        r2.set_weight(2.0)
+        sf = IMP.core.RestraintsScoringFunction([r1, r2])
+        def clear_restraints():
+            r1.evaluated = r2.evaluated = False
+        # With no cached scores, everything is evaluated
+        self.assertAlmostEqual(sf.evaluate_moved(False, [p1], []),
+                               120.0, delta=1e-6)
+        self.assertTrue(r1.evaluated)
+        self.assertTrue(r2.evaluated)
+
+        clear_restraints()
+        self.assertAlmostEqual(sf.evaluate_moved(False, [p1], []),
+                               120.0, delta=1e-6)
+        self.assertTrue(r1.evaluated)
+        assert_restraint_skipped(r2)
+
+        # No restraints depend on p3
+        clear_restraints()
+        self.assertAlmostEqual(sf.evaluate_moved(False, [p3], []),
+                               120.0, delta=1e-6)
+        assert_restraint_skipped(r1)
+        assert_restraint_skipped(r2)
+
+        # Reset particles use the last-but-one score
+        clear_restraints()
+        self.assertAlmostEqual(sf.evaluate_moved(False, [p3], [p2]),
+                               120.0, delta=1e-6)
+        assert_restraint_skipped(r1)
+        assert_restraint_skipped(r2)
+
+        # Derivatives always need a full evaluation
+        clear_restraints()
+        self.assertAlmostEqual(sf.evaluate_moved(True, [p3], []),
+                               120.0, delta=1e-6)
+        self.assertTrue(r1.evaluated)
+        self.assertTrue(r2.evaluated)
+
+        # Changing the restraints invalidates the cache
+        r3 = LogRestraint(m, [p3], 1.0)
+        sf.add_restraint(r3)
+        clear_restraints()
+        self.assertAlmostEqual(sf.evaluate_moved(False, [p3], []),
+                               121.0, delta=1e-6)
+        self.assertTrue(r1.evaluated)
+        self.assertTrue(r2.evaluated)
+        self.assertTrue(r3.evaluated)
+
     def test_python_list(self):
         """Test Python list-like access to restraints"""
         m = IMP.Model()
@@ -0,0 +1,110 @@
+#include <IMP/Model.h>
+#include <IMP/flags.h>
+#include <IMP/core/rigid_bodies.h>
+#include <IMP/algebra/vector_generators.h>
+#include <IMP/algebra/Rotation3D.h>
+#include <IMP/test/test_macros.h>
+
+namespace {
+std::string get_module_name() { return "anon"; }
+std::string get_module_version() { return "anon"; }
+
+// create a rigid body with n point members, every fifth one non-rigid
+IMP::core::RigidBody create_rigid_body(IMP::Model *m, unsigned int n) {
+  IMP::algebra::BoundingBox3D bb(IMP::algebra::Vector3D(-10, -10, -10),
+                                 IMP::algebra::Vector3D(10, 10, 10));
+  IMP::ParticleIndexes pis;
+  for (unsigned int i = 0; i < n; ++i) {
+    IMP::ParticleIndex pi = m->add_particle("member");
+    IMP::core::XYZ::setup_particle(m, pi,
+                                   IMP::algebra::get_random_vector_in(bb));
+    pis.push_back(pi);
+  }
+  IMP::core::RigidBody rb = IMP::core::RigidBody::setup_particle(
+      m, m->add_particle("rb"), IMP::algebra::ReferenceFrame3D());
+  for (unsigned int i = 0; i < n; ++i) {
+    if (i % 5 == 0) {
+      rb.add_non_rigid_member(pis[i]);
+    } else {
+      rb.add_member(pis[i]);
+    }
+  }
+  IMP::algebra::Transformation3D tr(IMP::algebra::get_random_rotation_3d(),
+                                    IMP::algebra::get_random_vector_in(bb));
+  rb.set_reference_frame(IMP::algebra::ReferenceFrame3D(tr));
+  return rb;
+}
+
+void check_close(const IMP::algebra::Vector3D &a,
+                 const IMP::algebra::Vector3D &b) {
+  IMP_TEST_LESS_THAN(IMP::algebra::get_distance(a, b),
+                     1e-6 * (1. + a.get_magnitude()));
+}
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    IMP::setup_from_argv(argc, argv,
+                         "Test batched updates of rigid body members.");
+    IMP_NEW(IMP::Model, m, ());
+    // more members than are processed in one block
+    IMP::core::RigidBody rb = create_rigid_body(m, 300);
+    IMP::algebra::Transformation3D tr =
+        rb.get_reference_frame().get_transformation_to();
+    IMP::ParticleIndexes members = rb.get_member_particle_indexes();
+
+    rb.update_members();
+    for (unsigned int i = 0; i < members.size(); ++i) {
+      IMP::core::RigidBodyMember rbm(m, members[i]);
+      check_close(rbm.get_coordinates(),
+                  tr.get_transformed(rbm.get_internal_coordinates()));
+    }
+
+    IMP::algebra::Sphere3D s(IMP::algebra::get_zero_vector_d<3>(), 1.);
+    IMP::DerivativeAccumulator da(.5);
+    IMP::algebra::Vector3Ds dy;
+    for (unsigned int i = 0; i < members.size(); ++i) {
+      dy.push_back(IMP::algebra::get_random_vector_in(s));
+      IMP::core::XYZ(m, members[i]).add_to_derivatives(dy.back(), da);
+    }
+
+    rb.pull_back_members_adjoints(da);
+    IMP::algebra::Vector3D d = rb.get_derivatives(), t = rb.get_torque();
+    IMP::algebra::Vector4D q = rb.get_rotational_derivatives();
+    IMP::algebra::Vector3Ds id;
+    for (unsigned int i = 0; i < members.size(); ++i) {
+      if (IMP::core::NonRigidMember::get_is_setup(m, members[i])) {
+        id.push_back(
+            IMP::core::NonRigidMember(m, members[i]).get_internal_derivatives());
+      }
+    }
+
+    // compare with the non-batched pull back of each member
+    m->zero_derivatives();
+    for (unsigned int i = 0; i < members.size(); ++i) {
+      IMP::core::XYZ(m, members[i]).add_to_derivatives(dy[i], da);
+    }
+    for (unsigned int i = 0; i < members.size(); ++i) {
+      rb.pull_back_member_adjoints(members[i], da);
+    }
+    check_close(d, rb.get_derivatives());
+    check_close(t, rb.get_torque());
+    IMP_TEST_LESS_THAN(
+        IMP::algebra::get_distance(q, rb.get_rotational_derivatives()),
+        1e-6 * (1. + q.get_magnitude()));
+    unsigned int j = 0;
+    for (unsigned int i = 0; i < members.size(); ++i) {
+      if (IMP::core::NonRigidMember::get_is_setup(m, members[i])) {
+        check_close(
+            id[j++],
+            IMP::core::NonRigidMember(m, members[i]).get_internal_derivatives());
+      }
+    }
+    IMP_TEST_EQUAL(j, id.size());
+  }
+  catch (const IMP::Exception &e) {
+    std::cerr << "Failed with exception " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,70 @@
+#include <IMP/Model.h>
+#include <IMP/flags.h>
+#include <IMP/core/XYZR.h>
+#include <IMP/core/rigid_bodies.h>
+#include <IMP/core/RigidClosePairsFinder.h>
+#include <IMP/algebra/vector_generators.h>
+#include <IMP/test/test_macros.h>
+#include <algorithm>
+
+namespace {
+std::string get_module_name() { return "anon"; }
+std::string get_module_version() { return "anon"; }
+
+IMP::ParticleIndex create_body(IMP::Model *m, unsigned int n,
+                               IMP::ParticleIndexes &members) {
+  IMP::algebra::BoundingBox3D bb(IMP::algebra::Vector3D(0, 0, 0),
+                                 IMP::algebra::Vector3D(30, 30, 30));
+  IMP::ParticleIndexes ps;
+  for (unsigned int i = 0; i < n; ++i) {
+    IMP::ParticleIndex pi = m->add_particle("p");
+    IMP::core::XYZR::setup_particle(
+        m, pi, IMP::algebra::Sphere3D(IMP::algebra::get_random_vector_in(bb),
+                                      .5 + .01 * (i % 50)));
+    ps.push_back(pi);
+  }
+  members.insert(members.end(), ps.begin(), ps.end());
+  IMP::ParticleIndex rb = m->add_particle("rb");
+  IMP::core::RigidBody::setup_particle(m, rb, ps);
+  return rb;
+}
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    IMP::setup_from_argv(
+        argc, argv, "Test that threaded rigid body searches match serial ones.");
+    IMP_NEW(IMP::Model, m, ());
+    IMP::ParticleIndexes ma, mb;
+    IMP::ParticleIndex a = create_body(m, 2000, ma);
+    IMP::ParticleIndex b = create_body(m, 2000, mb);
+    IMP_NEW(IMP::core::RigidClosePairsFinder, cpf, ());
+    cpf->set_distance(.5);
+
+    cpf->set_number_of_threads(1);
+    IMP::ParticleIndexPairs serial = cpf->get_close_pairs(m, a, b, ma, mb);
+    IMP_TEST_GREATER_THAN(serial.size(), 0U);
+
+    // check against all pairs of members
+    unsigned int expected = 0;
+    for (unsigned int i = 0; i < ma.size(); ++i) {
+      IMP::core::XYZR da(m, ma[i]);
+      for (unsigned int j = 0; j < mb.size(); ++j) {
+        if (IMP::core::get_distance(da, IMP::core::XYZR(m, mb[j])) < .5) {
+          ++expected;
+        }
+      }
+    }
+    IMP_TEST_EQUAL(serial.size(), expected);
+
+    // the pairs, and their order, must not depend on the number of threads
+    cpf->set_number_of_threads(4);
+    IMP::ParticleIndexPairs threaded = cpf->get_close_pairs(m, a, b, ma, mb);
+    IMP_TEST_TRUE(serial == threaded);
+  }
+  catch (const IMP::Exception &e) {
+    std::cerr << "Failed with exception " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -5,7 +5,13 @@ else()
 string(TOUPPER "${CMAKE_BUILD_TYPE}" build)
 endif()
 
-set(IMP_kernel_CONFIG IMP_BUILD=IMP_${build}:IMP_HAS_LOG=IMP_${IMP_MAX_LOG}:IMP_HAS_CHECKS=IMP_${IMP_MAX_CHECKS}:IMP_DEBUG=0:IMP_RELEASE=1:IMP_SILENT=0:IMP_PROGRESS=2:IMP_TERSE=3:IMP_VERBOSE=4:IMP_MEMORY=5:IMP_NONE=0:IMP_USAGE=1:IMP_INTERNAL=2:IMP_KERNEL_HAS_LOG4CXX=0)
+if(IMP_EVALUATION_STATISTICS)
+set(evaluation_statistics 1)
+else()
+set(evaluation_statistics 0)
+endif()
+
+set(IMP_kernel_CONFIG IMP_BUILD=IMP_${build}:IMP_HAS_LOG=IMP_${IMP_MAX_LOG}:IMP_HAS_CHECKS=IMP_${IMP_MAX_CHECKS}:IMP_DEBUG=0:IMP_RELEASE=1:IMP_SILENT=0:IMP_PROGRESS=2:IMP_TERSE=3:IMP_VERBOSE=4:IMP_MEMORY=5:IMP_NONE=0:IMP_USAGE=1:IMP_INTERNAL=2:IMP_KERNEL_HAS_LOG4CXX=0:IMP_KERNEL_HAS_EVALUATION_STATISTICS=${evaluation_statistics})
 
 
 imp_execute_process("generate paths.cpp"
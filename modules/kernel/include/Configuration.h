@@ -13,34 +13,31 @@
 #include <IMP/Object.h>
 #include <IMP/Pointer.h>
 #include "Model.h"
+#include "ModelSnapshot.h"
 
 IMPKERNEL_BEGIN_NAMESPACE
 
 //! A class to store a configuration of a model
+/** The configuration is stored as a ModelSnapshot, so pages of attribute
+    data that are unchanged from the previous configuration are shared
+    with it rather than copied.
+ */
 class IMPKERNELEXPORT Configuration : public IMP::Object {
   mutable Pointer<Model> model_;
-  Pointer<Object> base_;
-  internal::FloatAttributeTable floats_;
-  internal::FloatsAttributeTable float_lists_;
-  internal::StringAttributeTable strings_;
-  internal::IntAttributeTable ints_;
-  internal::ObjectAttributeTable objects_;
-  internal::WeakObjectAttributeTable weak_objects_;
-  internal::IntsAttributeTable int_lists_;
-  internal::ObjectsAttributeTable object_lists_;
-  internal::ParticleAttributeTable particles_;
-  internal::ParticlesAttributeTable particle_lists_;
+  PointerMember<ModelSnapshot> snapshot_;
 
  public:
   Configuration(Model *m, std::string name = "Configuration %1%");
-  //! Only store parts of the configuration that have changed from base
-  /** At the moment, this does not play well with adding and removing
-      attributes.*/
+  //! Share storage for the parts of the configuration unchanged from base
   Configuration(Model *m, Configuration *base,
                 std::string name = "Configuration %1%");
   void load_configuration() const;
   //! Swap the current configuration with that in the Model
-  /** This should be faster than loading (or at least not slower.
+  /** The current configuration is saved as a snapshot sharing pages with
+      the last one the Model took or restored, and the two snapshots are
+      then exchanged. Only pages written since then, or that differ
+      between the two configurations, are visited, so swapping back and
+      forth after moving a few particles is cheap.
    */
   void swap_configuration();
   IMP_OBJECT_METHODS(Configuration);
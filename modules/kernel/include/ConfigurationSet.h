@@ -33,6 +33,9 @@ class IMPKERNELEXPORT ConfigurationSet : public IMP::Object {
  public:
   ConfigurationSet(Model *m, std::string name = "ConfigurationSet %1%");
   //! Save the current configuration of the Model
+  /** Pages of attribute data unchanged from the base configuration
+      (the one the Model had when the set was created) are shared with
+      it rather than copied. */
   void save_configuration();
   unsigned int get_number_of_configurations() const;
   //! Load the ith configuration into the Model
@@ -15,6 +15,9 @@
 #include <IMP/value_macros.h>
 #include <IMP/math.h>
 #include <IMP/exception.h>
+#if IMP_KERNEL_HAS_EVALUATION_STATISTICS
+#include "internal/evaluation_statistics.h"
+#endif
 
 IMPKERNEL_BEGIN_NAMESPACE
 
@@ -36,6 +39,9 @@ class IMPKERNELEXPORT DerivativeAccumulator {
    */
   double operator()(const double value) const {
     IMP_INTERNAL_CHECK(!isnan(value), "Can't set derivative to NaN.");
+#if IMP_KERNEL_HAS_EVALUATION_STATISTICS
+    internal::add_derivative_write();
+#endif
     return value * weight_;
   }
   double get_weight() const { return weight_; }
@@ -0,0 +1,78 @@
+/**
+ *  \file IMP/EvaluationStatistics.h
+ *  \brief Time spent evaluating a Restraint or updating a ScoreState.
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ *
+ */
+
+#ifndef IMPKERNEL_EVALUATION_STATISTICS_H
+#define IMPKERNEL_EVALUATION_STATISTICS_H
+
+#include <IMP/kernel_config.h>
+#include "ModelObject.h"
+#include "Pointer.h"
+#include <IMP/Value.h>
+#include <IMP/showable_macros.h>
+#include <IMP/value_macros.h>
+
+IMPKERNEL_BEGIN_NAMESPACE
+
+//! Totals for one Restraint or ScoreState over a series of evaluations
+/** These are returned by Model::get_evaluation_statistics().
+
+    For a Restraint, each call is one evaluation of that restraint
+    (the time for a RestraintSet includes that of its children). For a
+    ScoreState, both ScoreState::before_evaluate() and
+    ScoreState::after_evaluate() count as calls.
+
+    The number of derivative writes is the number of derivative values
+    passed through the DerivativeAccumulator given to the object (each
+    component of a coordinate derivative counts once). Writes made by
+    tasks that the object spawns on other threads are not counted.
+ */
+class IMPKERNELEXPORT EvaluationStatistics : public Value {
+  WeakPointer<ModelObject> object_;
+  unsigned long calls_;
+  double time_;
+  double cycles_;
+  unsigned long derivative_writes_;
+
+ public:
+  EvaluationStatistics(ModelObject *object, unsigned long calls, double time,
+                       double cycles, unsigned long derivative_writes)
+      : object_(object), calls_(calls), time_(time), cycles_(cycles),
+        derivative_writes_(derivative_writes) {}
+
+  EvaluationStatistics()
+      : calls_(0), time_(0.), cycles_(0.), derivative_writes_(0) {}
+
+  //! Get the Restraint or ScoreState
+  ModelObject *get_model_object() const { return object_; }
+
+  unsigned long get_number_of_calls() const { return calls_; }
+
+  //! Get the total wall clock time in seconds
+  double get_time() const { return time_; }
+
+  //! Get the total number of CPU cycles
+  /** This is read from the processor's timestamp counter, and is zero on
+      platforms that do not have one. */
+  double get_number_of_cycles() const { return cycles_; }
+
+  unsigned long get_number_of_derivative_writes() const {
+    return derivative_writes_;
+  }
+
+  IMP_SHOWABLE_INLINE(EvaluationStatistics, {
+    out << (object_ ? object_->get_name() : std::string("(none)")) << ": "
+        << calls_ << " calls, " << time_ << "s, " << cycles_ << " cycles, "
+        << derivative_writes_ << " derivative writes";
+  });
+};
+
+IMP_VALUES(EvaluationStatistics, EvaluationStatisticsList);
+
+IMPKERNEL_END_NAMESPACE
+
+#endif /* IMPKERNEL_EVALUATION_STATISTICS_H */
@@ -52,7 +52,10 @@ class Key : public Value {
     static internal::KeyData static_key_data_(ID);
     return static_key_data_;
 #else
-    return IMP::internal::get_key_data(ID);
+    // cache the lookup; even if this is initialized more than once, the
+    // same table is returned each time
+    static internal::KeyData *key_data = &IMP::internal::get_key_data(ID);
+    return *key_data;
 #endif
   }
 
@@ -73,39 +76,21 @@ class Key : public Value {
     }
   }
 
-  static const internal::KeyData::Map& get_map() {
-    return get_key_data().get_map();
-  }
-  static const internal::KeyData::RMap& get_rmap() {
-    IMP::internal::KeyData const& kd=get_key_data();
-    IMP::internal::KeyData::RMap const& ret=kd.get_rmap();
-    return ret;
-  }
-
   //! returns the index of sc, adds it if it's not there
   static unsigned int find_or_add_index(std::string const& sc) {
     IMP_USAGE_CHECK(!sc.empty(), "Can't create a key with an empty name");
-    unsigned int val;
-    IMP_OMP_PRAGMA(critical(imp_key)) {
-      if (get_map().find(sc) == get_map().end()) {
-        val = get_key_data().add_key(sc);
-      } else {
-        val = get_map().find(sc)->second;
-      }
-    }
-    return val;
+    int val = get_key_data().find(sc);
+    if (val >= 0) return val;
+    return get_key_data().find_or_add_key(sc);
   }
 
 
   static unsigned int find_index(std::string const& sc) {
     IMP_USAGE_CHECK(!sc.empty(), "Can't create a key with an empty name");
-    unsigned int val;
-    IMP_OMP_PRAGMA(critical(imp_key)) {
-      IMP_USAGE_CHECK( get_key_exists(sc), "Key<" << ID << ">::find_index():"
-		       << " You must explicitly create the type first: "
-		       << sc);
-      val = get_map().find(sc)->second;
-    }
+    int val = get_key_data().find(sc);
+    IMP_USAGE_CHECK(val >= 0, "Key<" << ID << ">::find_index():"
+                    << " You must explicitly create the type first: "
+                    << sc);
     return val;
   }
 
@@ -117,17 +102,13 @@ class Key : public Value {
   static unsigned int get_ID() { return ID; }
 
   static const std::string get_string(int i) {
-    std::string val;
-    IMP_OMP_PRAGMA(critical(imp_key)) {
-      if (static_cast<unsigned int>(i) < get_rmap().size()) {
-        val = get_rmap()[i];
-      }
-    }
-    if (val.empty()) {
+    internal::KeyData const& kd = get_key_data();
+    if (static_cast<unsigned int>(i) >= kd.get_number_of_keys()) {
       IMP_FAILURE("Corrupted Key Table asking for key "
-                  << i << " with a table of size " << get_rmap().size());
+                  << i << " with a table of size "
+                  << kd.get_number_of_keys());
     }
-    return val;
+    return kd.get_string(i);
   }
 
 #endif
@@ -162,19 +143,13 @@ class Key : public Value {
 
   static unsigned int add_key(std::string sc) {
     IMP_USAGE_CHECK(!sc.empty(), "Can't create a key with an empty name");
-    unsigned int val;
-    IMP_OMP_PRAGMA(critical(imp_key))
     IMP_LOG_PROGRESS("Key::add_key " << sc  << " ID " << ID << std::endl);
-    val = get_key_data().add_key(sc);
-    return val;
+    return get_key_data().add_key(sc);
   }
 
   //! Return true if there already is a key with that string
   static bool get_key_exists(std::string sc) {
-    bool val;
-    IMP_OMP_PRAGMA(critical(imp_key))
-    val = get_map().find(sc) != get_map().end();
-    return val;
+    return get_key_data().find(sc) >= 0;
   }
 
   //! Turn a key into a pretty string
@@ -199,14 +174,14 @@ class Key : public Value {
    */
   static Key<ID> add_alias(Key<ID> old_key,
 			   std::string new_name) {
-    IMP_INTERNAL_CHECK( get_map().find(new_name) == get_map().end(),
+    IMP_INTERNAL_CHECK(!get_key_exists(new_name),
 			"The name is already taken with an existing key or alias");
     get_key_data().add_alias(new_name, old_key.get_index());
     return Key<ID>(new_name.c_str());
   }
 
   static unsigned int get_number_of_keys() {
-    return get_rmap().size();
+    return get_key_data().get_number_of_keys();
   }
 
 #ifndef DOXYGEN
@@ -231,7 +206,9 @@ class Key : public Value {
      This is mostly for debugging to make sure that there are no extra
      keys created.
    */
-  static unsigned int get_number_unique() { return get_rmap().size(); }
+  static unsigned int get_number_unique() {
+    return get_key_data().get_number_of_keys();
+  }
 
 #ifndef SWIG
   /** \todo These should be protected, I'll try to work how
@@ -268,19 +245,12 @@ inline bool Key<ID>::is_default() const {
 
 template <unsigned int ID>
   inline void Key<ID>::show_all(std::ostream& out) {
-  IMP_OMP_PRAGMA(critical(imp_key))
-    get_key_data().show(out);
+  get_key_data().show(out);
 }
 
 template <unsigned int ID>
 Vector<std::string> Key<ID>::get_all_strings() {
-  Vector<std::string> str;
-  IMP_OMP_PRAGMA(critical(imp_key))
-  for (internal::KeyData::Map::const_iterator it = get_map().begin();
-       it != get_map().end(); ++it) {
-    str.push_back(it->first);
-  }
-  return str;
+  return get_key_data().get_all_strings();
 }
 #endif
 
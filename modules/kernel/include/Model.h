@@ -19,9 +19,12 @@
 #include "base_types.h"
 //#include "Particle.h"
 #include "Undecorator.h"
+#include "EvaluationStatistics.h"
+#include "file.h"
 #include "internal/AttributeTable.h"
 #include "internal/attribute_tables.h"
 #include "internal/moved_particles_cache.h"
+#include "internal/score_state_schedule.h"
 #include "internal/KeyVector.h"
 #include <IMP/Object.h>
 #include <IMP/Pointer.h>
@@ -34,13 +37,16 @@
 #include <cereal/access.hpp>
 #include <cereal/types/polymorphic.hpp>
 
+#include <atomic>
 #include <limits>
+#include <memory>
 
 IMPKERNEL_BEGIN_NAMESPACE
 
 class ModelObject;
 class Undecorator;
 class Particle;
+class ModelSnapshot;
 
 #if !defined(SWIG) && !defined(IMP_DOXYGEN)
 namespace internal {
@@ -51,6 +57,7 @@ enum Stage {
   AFTER_EVALUATING,
   COMPUTING_DEPENDENCIES
 };
+struct ModelSnapshotData;
 }
 #endif
 
@@ -173,6 +180,18 @@ class IMPKERNELEXPORT Model : public Object
   // time when moved_particles_*_cache_ were last updated, or 0
   unsigned moved_particles_cache_age_;
 
+  // order in which to update ScoreStates in before/after_evaluate, for
+  // each list of ScoreStates that has been updated
+  internal::ScoreStateSchedules score_state_schedules_;
+  // statistics from the last ScoreState update
+  std::atomic<unsigned> score_state_critical_path_length_;
+  std::atomic<double> score_state_critical_path_time_;
+  std::atomic<double> score_state_update_time_;
+  bool score_state_timing_;
+
+  // most recent snapshot, to share unchanged pages with the next one
+  std::weak_ptr<const internal::ModelSnapshotData> last_snapshot_;
+
   void register_unique_id();
 
   friend class cereal::access;
@@ -241,6 +260,8 @@ class IMPKERNELEXPORT Model : public Object
       saved_dependencies_age_ = 0;
       dependencies_saved_ = false;
       moved_particles_cache_age_ = 0;
+      score_state_schedules_.clear();
+      last_snapshot_.reset();
     }
   }
 
@@ -509,6 +530,22 @@ class IMPKERNELEXPORT Model : public Object
    */
   void remove_particle(ParticleIndex pi);
 
+  //! Save the attribute values of all particles.
+  /** Pages of attribute data that are unchanged since the previous
+      snapshot (or since base, if given) are shared with it rather than
+      copied, so taking a snapshot after only a few particles have moved
+      is cheap. If the base is the last snapshot taken or restored, only
+      the pages written since then are compared.
+      \see ModelSnapshot
+   */
+  ModelSnapshot *create_snapshot(ModelSnapshot *base = nullptr);
+
+  //! Restore the attribute values saved by create_snapshot().
+  /** Only pages that differ from the current values are written; pages
+      that are shared with the last snapshot and were not written since
+      are skipped without being compared. */
+  void restore_snapshot(ModelSnapshot *s);
+
   /** \name Storing data in the model
 
       One can store data associated with the model. This is used, for example,
@@ -581,6 +618,62 @@ class IMPKERNELEXPORT Model : public Object
       help maintain caches that depend on the model's dependency graph. */
   unsigned get_dependencies_updated() { return dependencies_age_; }
 
+  /** \name ScoreState scheduling
+      ScoreStates are updated as soon as all of the ScoreStates they depend
+      on have been updated, so with multiple threads independent
+      ScoreStates run concurrently even if they have a different update
+      order. The longest chain of ScoreStates that must be updated one
+      after another (the critical path) limits the speedup that more
+      threads can give; compare get_score_state_critical_path_time() with
+      get_score_state_update_time() to see how much parallelism is
+      available.
+      @{
+  */
+  //! Get the number of ScoreStates on the critical path of the last update
+  unsigned get_score_state_critical_path_length() const {
+    return score_state_critical_path_length_.load();
+  }
+
+  //! Time each ScoreState update, for the methods below
+  /** This is off by default, in which case the times are zero. */
+  void set_score_state_timing(bool tf) { score_state_timing_ = tf; }
+
+  bool get_score_state_timing() const { return score_state_timing_; }
+
+  //! Get the time in seconds taken by the critical path of the last update
+  double get_score_state_critical_path_time() const {
+    return score_state_critical_path_time_.load();
+  }
+
+  //! Get the total time in seconds taken by all ScoreStates in the last update
+  /** This is the sum over all ScoreStates updated in the last call to
+      before_evaluate(), so with multiple threads it may be more than the
+      elapsed time. */
+  double get_score_state_update_time() const {
+    return score_state_update_time_.load();
+  }
+  /** @} */
+
+  /** \name Evaluation statistics
+      The number of calls, the time taken and the number of derivatives
+      written are recorded for every Restraint and ScoreState that is
+      evaluated, and accumulate until clear_evaluation_statistics() is
+      called. Recording is off by default, since it adds to the cost of
+      every evaluation; switch it on when \imp is built by setting the
+      CMake variable IMP_EVALUATION_STATISTICS to on. Otherwise no
+      statistics are returned.
+      @{
+  */
+  //! Get statistics for each Restraint and ScoreState, slowest first
+  EvaluationStatisticsList get_evaluation_statistics() const;
+
+  //! Reset all evaluation statistics to zero
+  void clear_evaluation_statistics();
+
+  //! Write the evaluation statistics in JSON format
+  void write_evaluation_statistics(TextOutput out) const;
+  /** @} */
+
   //! Mark a 'restore point' for ModelObject dependencies.
   /** \see restore_dependencies() */
   void save_dependencies() {
@@ -12,6 +12,7 @@
 #include "base_types.h"
 #include <IMP/ref_counted_macros.h>
 #include <IMP/utility_macros.h>
+#include "internal/evaluation_statistics.h"
 #include <cereal/access.hpp>
 #include <cereal/types/base_class.hpp>
 
@@ -28,6 +29,9 @@ class Model;
 class IMPKERNELEXPORT ModelObject : public Object {
   friend class Model;
   WeakPointer<Model> model_;
+#if IMP_KERNEL_HAS_EVALUATION_STATISTICS
+  mutable internal::EvaluationCounters evaluation_counters_;
+#endif
 
 #ifndef SWIG
   friend class cereal::access;
@@ -55,6 +59,12 @@ class IMPKERNELEXPORT ModelObject : public Object {
 #if !defined(IMP_DOXYGEN) && !defined(SWIG)
   void validate_inputs() const;
   void validate_outputs() const;
+#if IMP_KERNEL_HAS_EVALUATION_STATISTICS
+  //! Get the counters used for Model::get_evaluation_statistics()
+  internal::EvaluationCounters &access_evaluation_counters() const {
+    return evaluation_counters_;
+  }
+#endif
 #endif
 
   ModelObject(Model *m, std::string name);
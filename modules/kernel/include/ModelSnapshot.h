@@ -0,0 +1,69 @@
+/**
+ *  \file IMP/ModelSnapshot.h
+ *  \brief A saved copy of the attributes of a Model.
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ *
+ */
+
+#ifndef IMPKERNEL_MODEL_SNAPSHOT_H
+#define IMPKERNEL_MODEL_SNAPSHOT_H
+
+#include <IMP/kernel_config.h>
+#include <IMP/Object.h>
+#include <IMP/Pointer.h>
+#include "Model.h"
+#include <memory>
+
+IMPKERNEL_BEGIN_NAMESPACE
+
+//! A saved copy of the attributes of all particles in a Model.
+/** Snapshots are created with Model::create_snapshot() and loaded back
+    with Model::restore_snapshot(). The attribute data are stored in
+    pages of a fixed number of particles. Each page is shared with the
+    previous snapshot unless its contents have changed, so a series of
+    snapshots of a large model in which only a few particles move
+    between snapshots takes little extra memory. Restoring a snapshot
+    only writes the pages that differ from the Model's current values.
+
+    The Model tracks which pages are written after each snapshot is
+    taken or restored, so only those are compared against it next time.
+    Writes through raw data pointers (such as
+    Model::access_spheres_data()) cannot be tracked, so asking for a
+    non-const pointer marks the whole array as written.
+
+    Only attribute values are saved; derivatives are not, and particles
+    added or removed after the snapshot was taken are not tracked.
+
+    \see Configuration
+ */
+class IMPKERNELEXPORT ModelSnapshot : public Object {
+  WeakPointer<Model> model_;
+  std::shared_ptr<const internal::ModelSnapshotData> data_;
+  unsigned copied_pages_;
+  friend class Model;
+
+ public:
+#ifndef SWIG
+  ModelSnapshot(Model *m,
+                std::shared_ptr<const internal::ModelSnapshotData> data,
+                unsigned copied_pages,
+                std::string name = "ModelSnapshot%1%")
+      : Object(name), model_(m), data_(data), copied_pages_(copied_pages) {}
+#endif
+
+  Model *get_model() const { return model_; }
+
+  //! Get the number of pages that were copied rather than shared
+  /** This is the number of pages that had changed since the snapshot
+      they were shared with. */
+  unsigned get_number_of_copied_pages() const { return copied_pages_; }
+
+  IMP_OBJECT_METHODS(ModelSnapshot);
+};
+
+IMP_OBJECTS(ModelSnapshot, ModelSnapshots);
+
+IMPKERNEL_END_NAMESPACE
+
+#endif /* IMPKERNEL_MODEL_SNAPSHOT_H */
@@ -290,11 +290,37 @@ class IMPKERNELEXPORT Restraint : public ModelObject {
   //! Return whether this restraint wraps a number of other restraints
   bool get_is_aggregate() const { return is_aggregate_; }
 
+  //! Set an estimate of the cost of evaluating this restraint
+  /** The cost is relative to a typical restraint, which has cost 1.
+      It is passed to the TaskExecutor during multithreaded evaluation,
+      which may use it to decide whether evaluation is worth running as
+      a separate task.
+   */
+  void set_task_cost(double cost) { task_cost_ = cost; }
+
+  //! Get the estimated cost of evaluating this restraint
+  /** \see set_task_cost() */
+  double get_task_cost() const { return task_cost_; }
+
   /** Return whether this restraint violated its maximum last time it was
       evaluated.
    */
   bool get_was_good() const { return get_last_score() < max_; }
 
+#ifndef SWIG
+  //! Return whether this restraint can score a batch of configurations
+  /** \see do_evaluate_batch(), ScoringFunction::evaluate_batch() */
+  virtual bool get_has_batch_evaluation() const { return false; }
+
+  //! Score configurations [begin, end) of a batch
+  /** \see do_evaluate_batch() */
+  void evaluate_batch(const ParticleIndexes &pis,
+                      const FloatsList &coordinates_batch, unsigned int begin,
+                      unsigned int end, Floats &scores) const {
+    do_evaluate_batch(pis, coordinates_batch, begin, end, scores);
+  }
+#endif
+
   IMP_REF_COUNTED_DESTRUCTOR(Restraint);
 
  protected:
@@ -322,6 +348,25 @@ class IMPKERNELEXPORT Restraint : public ModelObject {
                   ScoreAccumulator sa, const ParticleIndexes &moved_pis,
                   const ParticleIndexes &reset_pis) const;
 
+#ifndef SWIG
+  //! Score several configurations without changing the Model.
+  /** Restraints that return true from get_has_batch_evaluation() must
+      implement this; it is used by ScoringFunction::evaluate_batch() for
+      restraints that do not depend on any ScoreState.
+
+      coordinates_batch[k] holds the x, y and z coordinates of each
+      particle in pis for configuration k; any other attributes (and the
+      coordinates of other particles) should be read from the Model.
+      The unweighted score of each configuration k in [begin, end) should
+      be stored in scores[k]. Different ranges of the same batch may be
+      scored at the same time from different threads.
+   */
+  virtual void do_evaluate_batch(const ParticleIndexes &pis,
+                                 const FloatsList &coordinates_batch,
+                                 unsigned int begin, unsigned int end,
+                                 Floats &scores) const;
+#endif
+
   /** No outputs. */
   ModelObjectsTemp do_get_outputs() const override {
     return ModelObjectsTemp();
@@ -333,8 +378,16 @@ class IMPKERNELEXPORT Restraint : public ModelObject {
  private:
   ScoringFunction *create_internal_scoring_function() const;
 
+  // call do_add_score_and_derivatives*() from a task, recording
+  // evaluation statistics
+  void run_add_score_and_derivatives(ScoreAccumulator sa) const;
+  void run_add_score_and_derivatives_moved(
+      ScoreAccumulator sa, const ParticleIndexes &moved_pis,
+      const ParticleIndexes &reset_pis) const;
+
   double weight_;
   double max_;
+  double task_cost_;
   mutable double last_score_;
   mutable double last_last_score_;
   // cannot be released outside the class
@@ -25,12 +25,27 @@ IMPKERNEL_BEGIN_NAMESPACE
 
 class Restraint;
 
+#ifndef SWIG
+//! Spacing of the per-thread partial scores, so each is on its own line
+const unsigned IMP_THREAD_SCORE_STRIDE = 8;
+#endif
+
 /** A class for storing evaluation state.*/
 struct EvaluationState {
   double score;
   bool good;
-  EvaluationState(double oscore, bool ogood) : score(oscore), good(ogood) {}
-  EvaluationState() : score(BAD_SCORE), good(false) {}
+#ifndef SWIG
+  /* Per-thread partial scores, IMP_THREAD_SCORE_STRIDE doubles apart,
+     used instead of atomic updates of score during threaded evaluation */
+  double *thread_scores;
+  unsigned num_thread_scores;
+#endif
+  EvaluationState(double oscore, bool ogood)
+      : score(oscore), good(ogood), thread_scores(nullptr),
+        num_thread_scores(0) {}
+  EvaluationState()
+      : score(BAD_SCORE), good(false), thread_scores(nullptr),
+        num_thread_scores(0) {}
   IMP_SHOWABLE_INLINE(EvaluationState, out << score << " " << good;);
 
 private:
@@ -59,6 +74,18 @@ class IMPKERNELEXPORT ScoreAccumulator : public Value {
   bool abort_on_bad_;
   friend class ScoringFunction;
   friend class Restraint;
+#ifndef SWIG
+  // The calling thread's partial score, or nullptr to update score_->score.
+  // Partial sums are not seen by get_abort_evaluation(), so are only used
+  // if there is no maximum score.
+  double *get_thread_score() const {
+    if (!score_->thread_scores || global_max_ != NO_MAX) return nullptr;
+    unsigned t = internal::get_task_thread_index();
+    return t < score_->num_thread_scores
+               ? score_->thread_scores + t * IMP_THREAD_SCORE_STRIDE
+               : nullptr;
+  }
+#endif
   ScoreAccumulator(EvaluationState *s, double weight, bool deriv,
                    double global_max, double local_max, bool abort_on_bad)
       : score_(s),
@@ -86,8 +113,13 @@ class IMPKERNELEXPORT ScoreAccumulator : public Value {
       internally. */
   void add_score(double score) {
     double wscore = weight_.get_weight() * score;
-    IMP_OMP_PRAGMA(atomic)
-    score_->score += wscore;
+    double *partial = get_thread_score();
+    if (partial) {
+      *partial += wscore;
+    } else {
+      IMP_OMP_PRAGMA(atomic)
+      score_->score += wscore;
+    }
     if (score > local_max_) {
       IMP_OMP_PRAGMA(critical(imp_abort))
       score_->good = false;
@@ -130,6 +162,31 @@ class IMPKERNELEXPORT ScoreAccumulator : public Value {
       Restraint::do_add_score_and_derivatives() call. */
   double get_maximum() const { return std::min(global_max_, local_max_); }
 
+#ifndef SWIG
+  //! Add scores on each thread to the given per-thread slots
+  /** This is used by the evaluation code to avoid atomic updates; the
+      slots are IMP_THREAD_SCORE_STRIDE doubles apart and must be zero.
+      \return false if slots are already in use by an enclosing
+              evaluation, in which case they are not changed. */
+  bool begin_thread_scores(double *scores, unsigned num_threads) {
+    if (score_->thread_scores) return false;
+    score_->thread_scores = scores;
+    score_->num_thread_scores = num_threads;
+    return true;
+  }
+
+  //! Add the per-thread scores to the total and stop using them
+  void end_thread_scores() {
+    double total = 0.;
+    for (unsigned i = 0; i < score_->num_thread_scores; ++i) {
+      total += score_->thread_scores[i * IMP_THREAD_SCORE_STRIDE];
+    }
+    score_->score += total;
+    score_->thread_scores = nullptr;
+    score_->num_thread_scores = 0;
+  }
+#endif
+
   DerivativeAccumulator *get_derivative_accumulator() {
     if (deriv_) {
       return &weight_;
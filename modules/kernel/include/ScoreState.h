@@ -56,6 +56,7 @@ IMPKERNEL_BEGIN_NAMESPACE
 class IMPKERNELEXPORT ScoreState : public ModelObject {
   int update_order_;
   bool can_skip_;
+  double task_cost_;
 
   friend class cereal::access;
 
@@ -78,7 +79,7 @@ class IMPKERNELEXPORT ScoreState : public ModelObject {
 
  public:
   ScoreState(Model *m, std::string name);
-  ScoreState() {}
+  ScoreState() : task_cost_(1.) {}
   //! Force update of the structure.
   void before_evaluate();
 
@@ -93,6 +94,15 @@ class IMPKERNELEXPORT ScoreState : public ModelObject {
    */
   bool get_can_skip() const { return can_skip_; }
 
+  //! Set an estimate of the cost of updating this state
+  /** The cost is relative to a typical Restraint, which has cost 1.
+      \see Restraint::set_task_cost()
+   */
+  void set_task_cost(double cost) { task_cost_ = cost; }
+
+  //! Get the estimated cost of updating this state
+  double get_task_cost() const { return task_cost_; }
+
 #ifndef IMP_DOXYGEN
   bool get_has_update_order() const { return update_order_ != -1; }
   unsigned int get_update_order() const { return update_order_; }
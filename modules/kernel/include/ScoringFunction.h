@@ -46,6 +46,8 @@ class IMPKERNELEXPORT ScoringFunction : public ModelObject {
   internal::MovedParticlesScoreStateCache moved_particles_cache_;
   // time when moved_particles_cache_ was last updated, or 0
   unsigned moved_particles_cache_age_;
+  // derivatives from the last evaluate_batch(), if requested
+  FloatsList batch_derivatives_;
 
   friend class cereal::access;
 
@@ -145,6 +147,37 @@ class IMPKERNELEXPORT ScoringFunction : public ModelObject {
              bool derivatives, const ParticleIndexes &moved_pis,
              const ParticleIndexes &reset_pis);
 
+  //! Score many configurations of the same particles.
+  /** Each element of coordinates_batch is one configuration: the x, y and
+      z coordinates of each particle in pis, in order. The score of each
+      configuration, as evaluate() would return it, is returned. Attribute
+      values in the Model are restored afterwards, even if evaluation
+      fails (derivatives are not).
+
+      This is faster than setting each configuration in turn and calling
+      evaluate(), as the ScoreStates and Restraints to use are only worked
+      out once. In addition, restraints that implement a batch kernel
+      (Restraint::get_has_batch_evaluation()) and do not depend on any
+      ScoreState score all configurations directly, split across threads
+      if more than one is in use. Other restraints are evaluated one
+      configuration at a time.
+
+      \param pis The particles whose coordinates are given.
+      \param coordinates_batch The coordinates for each configuration.
+      \param derivatives If true, also calculate derivatives, which can be
+             retrieved with get_batch_derivatives(). All restraints are then
+             evaluated one configuration at a time.
+   */
+  Floats evaluate_batch(const ParticleIndexes &pis,
+                        const FloatsList &coordinates_batch,
+                        bool derivatives = false);
+
+  //! Get the derivatives calculated by the last call to evaluate_batch()
+  /** For each configuration, these are the x, y and z derivatives of each
+      particle, laid out like the coordinates. The list is empty if
+      derivatives were not requested. */
+  FloatsList get_batch_derivatives() const { return batch_derivatives_; }
+
   /** Return true if the last evaluate satisfied all the restraint
       thresholds.*/
   bool get_had_good_score() const { return es_.good; }
@@ -0,0 +1,150 @@
+/**
+ *  \file IMP/TaskExecutor.h
+ *  \brief Control how tasks created by IMP_TASK are run.
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ *
+ */
+
+#ifndef IMPKERNEL_TASK_EXECUTOR_H
+#define IMPKERNEL_TASK_EXECUTOR_H
+
+#include <IMP/kernel_config.h>
+#include "Object.h"
+#include "object_macros.h"
+#include "internal/executor.h"
+#include <functional>
+#include <memory>
+#include <mutex>
+
+IMPKERNEL_BEGIN_NAMESPACE
+
+//! Run the tasks that IMP creates during multithreaded evaluation.
+/** All parallelism in \imp is expressed via the IMP_THREADS() macro,
+    which starts a parallel region, the IMP_TASK() family, which
+    creates tasks inside that region (e.g. one per Restraint or
+    ScoreState), and IMP_TASKWAIT, which waits for them to finish.
+    By default these map directly to OpenMP pragmas (see
+    OpenMPTaskExecutor). Set a different executor with set_task_executor()
+    to run tasks with a different scheduler, for example one provided by
+    an application that embeds \imp and already owns a thread pool.
+
+    Multithreaded evaluation is only done if get_number_of_threads()
+    is greater than one, which requires \imp to be built with OpenMP.
+
+    \see WorkStealingTaskExecutor
+ */
+class IMPKERNELEXPORT TaskExecutor : public Object {
+ public:
+  TaskExecutor(std::string name) : Object(name) {}
+
+#ifndef SWIG
+  //! Run action in a new parallel region with the given number of threads
+  /** The action itself is run by a single thread, and tasks it adds
+      may be run by any thread in the region. All tasks have completed
+      by the time this function returns. */
+  virtual void run_parallel(const std::function<void()> &action,
+                            unsigned int num_threads) = 0;
+
+  //! Add a task that may be run asynchronously
+  /** \param[in] task The function to run.
+      \param[in] cost An estimate of the cost of the task, in arbitrary
+                 units (1 is a typical Restraint); executors may run
+                 cheap tasks immediately rather than scheduling them.
+   */
+  virtual void add_task(std::function<void()> task, double cost) = 0;
+#endif
+
+  //! Wait until all tasks added by the calling task have completed
+  virtual void wait_for_tasks() = 0;
+
+  //! Get the index of the calling thread in the current parallel region
+  virtual unsigned int get_thread_index() const = 0;
+
+  //! Return true if called from inside a parallel region
+  virtual bool get_is_parallel() const = 0;
+
+  IMP_REF_COUNTED_DESTRUCTOR(TaskExecutor);
+};
+
+IMP_OBJECTS(TaskExecutor, TaskExecutors);
+
+//! Run tasks using OpenMP.
+/** This is the default executor. IMP_TASK() and friends use the OpenMP
+    task pragmas directly when it is active, so it adds no overhead.
+ */
+class IMPKERNELEXPORT OpenMPTaskExecutor : public TaskExecutor {
+ public:
+  OpenMPTaskExecutor(std::string name = "OpenMPTaskExecutor%1%")
+      : TaskExecutor(name) {}
+#ifndef SWIG
+  void run_parallel(const std::function<void()> &action,
+                    unsigned int num_threads) override;
+  void add_task(std::function<void()> task, double cost) override;
+#endif
+  void wait_for_tasks() override;
+  unsigned int get_thread_index() const override;
+  bool get_is_parallel() const override;
+  IMP_OBJECT_METHODS(OpenMPTaskExecutor);
+};
+
+IMP_OBJECTS(OpenMPTaskExecutor, OpenMPTaskExecutors);
+
+//! Run tasks on a pool of threads with per-thread work-stealing queues.
+/** Each thread pushes the tasks it creates onto its own queue and runs
+    them newest-first; idle threads steal the oldest tasks from other
+    queues. Threads waiting for their tasks help run queued work, and
+    only sleep when there is none, so nested tasks (e.g. the restraints
+    in a RestraintSet) do not starve the pool.
+
+    Tasks with a cost hint below get_minimum_task_cost() are run
+    immediately by the thread that creates them, which avoids the
+    scheduling overhead for very cheap restraints or score states.
+
+    The threads are created on first use and reused for subsequent
+    parallel regions. The pool grows to the largest number of threads
+    requested; regions with fewer threads leave the rest idle.
+
+    Only one parallel region runs on the pool at a time. If several
+    application threads call run_parallel() at once, the later ones wait
+    for the running region to finish.
+ */
+class IMPKERNELEXPORT WorkStealingTaskExecutor : public TaskExecutor {
+  class Pool;
+  // shared_ptr so that the destructor does not need the full Pool type
+  std::shared_ptr<Pool> pool_;
+  // held by the thread running a parallel region on pool_
+  std::mutex region_mutex_;
+  double minimum_task_cost_;
+
+ public:
+  WorkStealingTaskExecutor(std::string name = "WorkStealingTaskExecutor%1%");
+
+  //! Set the cost below which tasks are run immediately
+  void set_minimum_task_cost(double cost) { minimum_task_cost_ = cost; }
+  double get_minimum_task_cost() const { return minimum_task_cost_; }
+
+#ifndef SWIG
+  void run_parallel(const std::function<void()> &action,
+                    unsigned int num_threads) override;
+  void add_task(std::function<void()> task, double cost) override;
+#endif
+  void wait_for_tasks() override;
+  unsigned int get_thread_index() const override;
+  bool get_is_parallel() const override;
+  IMP_OBJECT_METHODS(WorkStealingTaskExecutor);
+};
+
+IMP_OBJECTS(WorkStealingTaskExecutor, WorkStealingTaskExecutors);
+
+//! Get the executor used to run tasks
+IMPKERNELEXPORT TaskExecutor *get_task_executor();
+
+//! Set the executor used to run tasks
+/** This should not be called from inside a parallel region. Passing
+    nullptr restores the default OpenMPTaskExecutor. */
+IMPKERNELEXPORT void set_task_executor(TaskExecutor *e);
+
+IMPKERNEL_END_NAMESPACE
+
+#endif /* IMPKERNEL_TASK_EXECUTOR_H */
@@ -0,0 +1,165 @@
+/**
+ *  \file IMP/kernel/internal/ArenaAllocator.h
+ *  \brief Allocator for short-lived temporaries created during evaluation
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ *
+ */
+
+#ifndef IMPKERNEL_INTERNAL_ARENA_ALLOCATOR_H
+#define IMPKERNEL_INTERNAL_ARENA_ALLOCATOR_H
+
+#include <IMP/kernel_config.h>
+#include "../Vector.h"
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+IMPKERNEL_BEGIN_INTERNAL_NAMESPACE
+
+//! Alignment (in bytes) of every block handed out by an Arena
+const std::size_t IMP_ARENA_ALIGNMENT = 16;
+
+//! A monotonic per-thread memory pool
+/** Memory is handed out by bumping a pointer through a list of blocks
+    and is otherwise freed all at once, when the outermost ArenaScope on
+    its thread ends. After that reset the blocks are merged into one, so
+    that a steady-state evaluation needs no calls to the system
+    allocator at all.
+
+    Freeing the most recent allocation gives its space back, as does
+    freeing a buffer that was left just below it when a vector grew, so
+    short-lived temporaries created one after another reuse the same
+    memory.
+
+    Only the owning thread allocates from or frees into an arena; other
+    threads only ask whether it owns a pointer, under a global lock that
+    is also held while the block list changes.
+ */
+class IMPKERNELEXPORT Arena {
+  std::vector<std::pair<char *, std::size_t> > blocks_;
+  // free space in the last block is [top_, end_)
+  char *top_, *end_;
+  // a freed range in the last block that will be given back when
+  // everything above it is freed; empty if free_begin_ == free_end_
+  char *free_begin_, *free_end_;
+  // allocations since the last reset, added to the totals on reset
+  unsigned long allocations_;
+
+  void add_block(std::size_t size);
+
+ public:
+  Arena();
+  ~Arena();
+
+  void *allocate(std::size_t size) {
+    // never empty, so each allocation has a distinct address in a block
+    size = (std::max<std::size_t>(size, 1) + IMP_ARENA_ALIGNMENT - 1)
+           & ~(IMP_ARENA_ALIGNMENT - 1);
+    ++allocations_;
+    if (size > static_cast<std::size_t>(end_ - top_)) add_block(size);
+    void *ret = top_;
+    top_ += size;
+    return ret;
+  }
+
+  //! Give back memory, if it is at the top of the arena
+  void deallocate(void *p, std::size_t size);
+
+  //! Return true if p was allocated from this arena
+  /** This is only safe to call from another thread while holding the
+      lock, as get_is_arena_memory() does. */
+  bool get_owns(const void *p) const;
+
+  //! Release everything allocated since the last reset
+  void reset();
+
+  //! Total size in bytes of the blocks owned by the arena
+  std::size_t get_capacity() const;
+};
+
+//! Get the Arena of the calling thread
+IMPKERNELEXPORT Arena &get_thread_arena();
+
+//! Return true if an ArenaScope is active on the calling thread
+IMPKERNELEXPORT bool get_is_arena_active();
+
+//! Let ArenaAllocator use the calling thread's Arena while in scope
+/** Scopes can be nested; the thread's Arena is reset when the outermost
+    scope ends, so anything allocated from it must not outlive that
+    scope. ScoringFunction::evaluate() and related functions open a
+    scope, as do the tasks that update ScoreStates or evaluate
+    Restraints on other threads.
+ */
+class IMPKERNELEXPORT ArenaScope {
+ public:
+  ArenaScope();
+  ~ArenaScope();
+};
+
+//! Number of allocations made through ArenaAllocator
+/** The counts are cumulative over all threads; heap allocations are those
+    made when no ArenaScope was active. Each thread counts its arena
+    allocations itself and adds them to the totals when its outermost
+    scope ends, so allocations in scopes that are still open are not
+    included. */
+struct ArenaStatistics {
+  unsigned long arena_allocations;
+  unsigned long heap_allocations;
+};
+
+IMPKERNELEXPORT ArenaStatistics get_arena_statistics();
+
+IMPKERNELEXPORT void reset_arena_statistics();
+
+IMPKERNELEXPORT void *arena_allocate(std::size_t size);
+
+IMPKERNELEXPORT void arena_deallocate(void *p, std::size_t size);
+
+//! Allocate memory from the calling thread's Arena
+/** If no ArenaScope is active the memory comes from the heap instead.
+    Memory may be deallocated from any thread; the address says which
+    arena, if any, it came from.
+    Containers using this allocator should only be used for temporaries
+    local to a function called during evaluation; see ArenaScope.
+ */
+template <typename T>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+  typedef T *pointer;
+  typedef std::size_t size_type;
+
+  template <class U> struct rebind {
+    typedef ArenaAllocator<U> other;
+  };
+
+  ArenaAllocator() noexcept = default;
+  template <class U>
+  ArenaAllocator(const ArenaAllocator<U> &) noexcept {}
+
+  T *allocate(std::size_t n, const void * = 0) {
+    return static_cast<T *>(arena_allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T *p, std::size_t n) { arena_deallocate(p, n * sizeof(T)); }
+};
+
+template <class T, class U>
+bool operator==(ArenaAllocator<T> const &, ArenaAllocator<U> const &) {
+  return true;
+}
+
+template <class T, class U>
+bool operator!=(ArenaAllocator<T> const &, ArenaAllocator<U> const &) {
+  return false;
+}
+
+//! A Vector whose storage comes from the calling thread's Arena
+template <class T>
+using ArenaVector = Vector<T, ArenaAllocator<T> >;
+
+IMPKERNEL_END_INTERNAL_NAMESPACE
+
+#endif /* IMPKERNEL_INTERNAL_ARENA_ALLOCATOR_H */
@@ -62,13 +62,15 @@ class ListLikeContainer : public Base {
       unsigned int chunk_size =
           std::max<unsigned int>(1U, data_.size() / tasks) + 1;
       Model *m = Base::get_model();
+      const typename Base::ContainedIndexTypes *data = &data_;
       for (unsigned int i = 0; i < tasks; ++i) {
         unsigned int lb = i * chunk_size;
         unsigned int ub =
             std::min<unsigned int>(data_.size(), (i + 1) * chunk_size);
-        IMP_TASK((lb, ub, m, f), f->apply_indexes(m, data_, lb, ub), "apply");
+        IMP_TASK((lb, ub, m, f, data), f->apply_indexes(m, *data, lb, ub),
+                 "apply");
       }
-      IMP_OMP_PRAGMA(taskwait)
+      IMP_TASKWAIT
     } else {
       f->apply_indexes(Base::get_model(), data_, 0, data_.size());
     }
@@ -91,7 +93,7 @@ class ListLikeContainer : public Base {
                  f->apply_indexes_moved(m, data_, lb, ub, moved_pis, reset_pis),
                  "apply");
       }
-      IMP_OMP_PRAGMA(taskwait)
+      IMP_TASKWAIT
     } else {
       f->apply_indexes_moved(Base::get_model(), data_, 0, data_.size(),
                              moved_pis, reset_pis);
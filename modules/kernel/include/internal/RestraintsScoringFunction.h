@@ -29,6 +29,9 @@ class GenericRestraintsScoringFunction : public ScoringFunction {
   double weight_;
   double max_;
   Storage restraints_;
+  // scores of each restraint, so that evaluate_moved() can skip those
+  // that don't depend on the moved particles
+  RestraintScoreCache score_cache_;
 
   friend class cereal::access;
 
@@ -58,7 +61,7 @@ class GenericRestraintsScoringFunction : public ScoringFunction {
   void do_add_score_and_derivatives(IMP::ScoreAccumulator sa,
                                     const ScoreStatesTemp &ss) override {
     IMP_OBJECT_LOG;
-    protected_evaluate(sa, restraints_, ss, get_model());
+    protected_evaluate(sa, restraints_, ss, get_model(), &score_cache_);
   }
 
   void do_add_score_and_derivatives_moved(IMP::ScoreAccumulator sa,
@@ -67,7 +70,7 @@ class GenericRestraintsScoringFunction : public ScoringFunction {
                                     const ScoreStatesTemp &ss) override {
     IMP_OBJECT_LOG;
     protected_evaluate_moved(sa, restraints_, moved_pis, reset_pis,
-                             ss, get_model());
+                             ss, get_model(), &score_cache_);
   }
 
   Restraints create_restraints() const override {
@@ -86,6 +89,7 @@ class GenericRestraintsScoringFunction : public ScoringFunction {
 
   void set_restraints(const RestraintsTemp &s) {
     set_has_dependencies(false);
+    score_cache_.clear();
     restraints_ = s;
   }
 
@@ -95,6 +99,7 @@ class GenericRestraintsScoringFunction : public ScoringFunction {
 
   void clear_restraints() {
     set_has_dependencies(false);
+    score_cache_.clear();
     restraints_.clear();
   }
 
@@ -104,11 +109,13 @@ class GenericRestraintsScoringFunction : public ScoringFunction {
 
   void erase_restraint(unsigned int i) {
     set_has_dependencies(false);
+    score_cache_.clear();
     restraints_.erase(restraints_.begin() + i);
   }
 
   unsigned int add_restraint(Restraint *r) {
     set_has_dependencies(false);
+    score_cache_.clear();
     unsigned int index = restraints_.size();
     restraints_.push_back(r);
     return index;
@@ -116,6 +123,7 @@ class GenericRestraintsScoringFunction : public ScoringFunction {
 
   void add_restraints(const Storage &r) {
     set_has_dependencies(false);
+    score_cache_.clear();
     restraints_.insert(restraints_.end(), r.begin(), r.end());
   }
 
@@ -13,6 +13,8 @@
 #include <boost/dynamic_bitset.hpp>
 #include <cereal/access.hpp>
 #include <algorithm>
+#include <atomic>
+#include <memory>
 #include "../Key.h"
 #include "../utility.h"
 #include "../FloatIndex.h"
@@ -23,6 +25,8 @@
 #include <IMP/log.h>
 #include <IMP/set_map_macros.h>
 #include <IMP/algebra/Sphere3D.h>
+#include <IMP/thread_macros.h>
+#include "executor.h"
 
 #define IMP_ATTRIBUTE_CHECKED_PARAM checked
 #if IMP_HAS_CHECKS >= IMP_INTERNAL
@@ -60,6 +64,187 @@ IMPKERNEL_BEGIN_INTERNAL_NAMESPACE
 
 typedef boost::dynamic_bitset<> Mask;
 
+//! Number of particles in each page of an attribute snapshot
+const unsigned IMP_SNAPSHOT_PAGE_SIZE = 256;
+
+//! Pages of one attribute array written since the last snapshot
+/** The attribute tables mark pages here when they are written, so that
+    the next snapshot (or restore) only needs to look at those pages.
+    Writers on different threads may mark pages at the same time; each
+    flag is only stored if it is not already set, so marking an already
+    dirty page is a plain read. Writes through raw data pointers cannot
+    be tracked, so handing one out marks the whole array.
+
+    The flags are relative to the snapshot the Model last captured or
+    restored, and are cleared by reset() when that changes. A new or
+    copied object is not related to any snapshot, so is all dirty. */
+class DirtyPages {
+  std::unique_ptr<std::atomic<bool>[]> pages_;
+  unsigned num_pages_;
+  std::atomic<bool> all_;
+
+  static void mark(std::atomic<bool> &flag) {
+    if (!flag.load(std::memory_order_relaxed)) {
+      flag.store(true, std::memory_order_relaxed);
+    }
+  }
+
+ public:
+  DirtyPages() : num_pages_(0), all_(true) {}
+  DirtyPages(const DirtyPages &) : num_pages_(0), all_(true) {}
+  DirtyPages &operator=(const DirtyPages &) {
+    set_all();
+    return *this;
+  }
+
+  //! Mark the page holding element i
+  void set(unsigned i) {
+    unsigned page = i / IMP_SNAPSHOT_PAGE_SIZE;
+    // the array grew since the last reset
+    mark(page < num_pages_ ? pages_[page] : all_);
+  }
+
+  void set_all() { mark(all_); }
+
+  bool get(unsigned page) const {
+    return all_.load(std::memory_order_relaxed) || page >= num_pages_
+           || pages_[page].load(std::memory_order_relaxed);
+  }
+
+  bool get_any() const {
+    for (unsigned i = 0; i < num_pages_; ++i) {
+      if (pages_[i].load(std::memory_order_relaxed)) return true;
+    }
+    return all_.load(std::memory_order_relaxed);
+  }
+
+  //! Mark all pages of an array of num_elements as clean
+  void reset(std::size_t num_elements) {
+    unsigned npages = (num_elements + IMP_SNAPSHOT_PAGE_SIZE - 1)
+                      / IMP_SNAPSHOT_PAGE_SIZE;
+    if (npages != num_pages_) {
+      pages_.reset(npages > 0 ? new std::atomic<bool>[npages] : nullptr);
+      num_pages_ = npages;
+    }
+    for (unsigned i = 0; i < num_pages_; ++i) {
+      pages_[i].store(false, std::memory_order_relaxed);
+    }
+    all_.store(false, std::memory_order_relaxed);
+  }
+};
+
+/* In the snapshots below, dirty is the array's DirtyPages if base (or
+   last) is the snapshot the Model last matched, or nullptr if the
+   flags cannot be used and pages must be compared instead. */
+
+//! Copy-on-write copy of one attribute array
+/** This stores the whole container and is used for containers that are
+    not indexed by particle (e.g. sparse tables). If the container is
+    unchanged from the base snapshot, its copy is shared rather than
+    duplicated. */
+template <class Container>
+class ArraySnapshot {
+  std::shared_ptr<const Container> data_;
+
+ public:
+  //! Save c, sharing storage with base if unchanged; return pages copied
+  unsigned capture(const Container &c, const ArraySnapshot *base,
+                   const DirtyPages *dirty) {
+    if (base && base->data_
+        && ((dirty && !dirty->get_any()) || *base->data_ == c)) {
+      data_ = base->data_;
+      return 0;
+    }
+    data_ = std::make_shared<const Container>(c);
+    return 1;
+  }
+
+  //! Copy the saved container back to c, if it differs
+  /** c is left alone if it is unchanged since last, which it shares. */
+  void restore(Container &c, const ArraySnapshot *last,
+               const DirtyPages *dirty) const {
+    if (last && dirty && last->data_ == data_ && !dirty->get_any()) {
+      return;
+    }
+    if (!data_) {
+      c = Container();
+    } else if (!(c == *data_)) {
+      c = *data_;
+    }
+  }
+
+  unsigned get_number_of_pages() const { return data_ ? 1 : 0; }
+};
+
+//! Copy-on-write copy of a per-particle attribute array
+/** The array is split into pages of IMP_SNAPSHOT_PAGE_SIZE particles.
+    Pages that are unchanged from the base snapshot are shared with it,
+    so a snapshot of a model in which only a few particles moved since
+    the last snapshot only duplicates the pages holding those particles.
+    Restoring only writes pages that differ from the saved ones. Pages
+    that were not written since the last snapshot are shared or skipped
+    without being compared. The array itself stays contiguous, so direct
+    access to the attribute data is unaffected. */
+template <class Tag, class T, class Allocator, class Equal>
+class ArraySnapshot<IndexVector<Tag, T, Allocator, Equal> > {
+  typedef IndexVector<Tag, T, Allocator, Equal> Container;
+  typedef std::vector<T> Page;
+  std::vector<std::shared_ptr<const Page> > pages_;
+  std::size_t size_;
+
+  static bool get_is_equal(const T *begin, const T *end, const Page &page) {
+    return static_cast<std::size_t>(end - begin) == page.size() &&
+           std::equal(begin, end, page.begin(), Equal());
+  }
+
+ public:
+  ArraySnapshot() : size_(0) {}
+
+  unsigned capture(const Container &c, const ArraySnapshot *base,
+                   const DirtyPages *dirty) {
+    size_ = c.size();
+    unsigned npages = (size_ + IMP_SNAPSHOT_PAGE_SIZE - 1)
+                      / IMP_SNAPSHOT_PAGE_SIZE;
+    pages_.resize(npages);
+    unsigned copied = 0;
+    for (unsigned i = 0; i < npages; ++i) {
+      const T *begin = c.data() + i * IMP_SNAPSHOT_PAGE_SIZE;
+      const T *end = c.data() + std::min<std::size_t>(
+                                    size_, (i + 1) * IMP_SNAPSHOT_PAGE_SIZE);
+      if (base && i < base->pages_.size()
+          && ((dirty && !dirty->get(i)
+               && base->pages_[i]->size()
+                      == static_cast<std::size_t>(end - begin))
+              || get_is_equal(begin, end, *base->pages_[i]))) {
+        pages_[i] = base->pages_[i];
+      } else {
+        pages_[i] = std::make_shared<const Page>(begin, end);
+        ++copied;
+      }
+    }
+    return copied;
+  }
+
+  void restore(Container &c, const ArraySnapshot *last,
+               const DirtyPages *dirty) const {
+    // pages that c still shares with last are already right
+    bool use_last = last && dirty && c.size() == size_ && last->size_ == size_;
+    c.resize(size_);
+    for (unsigned i = 0; i < pages_.size(); ++i) {
+      if (use_last && last->pages_[i] == pages_[i] && !dirty->get(i)) {
+        continue;
+      }
+      T *begin = c.data() + i * IMP_SNAPSHOT_PAGE_SIZE;
+      const Page &page = *pages_[i];
+      if (!get_is_equal(begin, begin + page.size(), page)) {
+        std::copy(page.begin(), page.end(), begin);
+      }
+    }
+  }
+
+  unsigned get_number_of_pages() const { return pages_.size(); }
+};
+
 /** a template for storing a table that holds the values of multiple attributes
     for multiple particles, following
 
@@ -74,6 +259,8 @@ class BasicAttributeTable {
 
  private:
   KeyVector<typename Traits::Key, typename Traits::Container> data_;
+  // pages of each key written since the last snapshot
+  Vector<DirtyPages> dirty_;
 #if IMP_HAS_CHECKS >= IMP_INTERNAL
   Mask *read_mask_, *write_mask_, *add_remove_mask_;
 #endif
@@ -96,12 +283,38 @@ class BasicAttributeTable {
     }
     resize_to_fit(data_[k.get_index()], particle, Traits::get_invalid());
     data_[k.get_index()][particle] = value;
+    set_is_dirty(k, particle);
   }
 
  public:
   void swap_with(BasicAttributeTable<Traits> &o) {
     IMP_SWAP_MEMBER(data_);
     IMP_SWAP_MEMBER(caches_);
+    set_is_dirty();
+    o.set_is_dirty();
+  }
+
+  //! Note that attribute k of the particle may have changed
+  /** Keys added since the last snapshot have no flags yet; they are
+      treated as dirty when the snapshot is taken. */
+  void set_is_dirty(Key k, ParticleIndex particle) {
+    if (k.get_index() < dirty_.size()) {
+      dirty_[k.get_index()].set(get_as_unsigned_int(particle));
+    }
+  }
+
+  //! Note that any attribute of k may have changed
+  void set_is_dirty(Key k) {
+    if (k.get_index() < dirty_.size()) {
+      dirty_[k.get_index()].set_all();
+    }
+  }
+
+  //! Note that any attribute may have changed
+  void set_is_dirty() {
+    for (unsigned int i = 0; i < dirty_.size(); ++i) {
+      dirty_[i].set_all();
+    }
   }
 
 #if IMP_HAS_CHECKS >= IMP_INTERNAL
@@ -141,6 +354,7 @@ class BasicAttributeTable {
       if (data_.size() > it->get_index() &&
           data_[it->get_index()].size() > get_as_unsigned_int(particle)) {
         data_[it->get_index()][particle] = Traits::get_invalid();
+        set_is_dirty(*it, particle);
       }
     }
   }
@@ -149,6 +363,7 @@ class BasicAttributeTable {
     IMP_USAGE_CHECK(get_has_attribute(k, particle),
                     "Can't remove attribute if it isn't there");
     data_[k.get_index()][particle] = Traits::get_invalid();
+    set_is_dirty(k, particle);
   }
 
   //! Get the size of the attribute table for the given key.
@@ -184,6 +399,7 @@ class BasicAttributeTable {
                         << Traits::get_invalid()
                         << " as it is reserved for a null value.");
     data_[k.get_index()][particle] = value;
+    set_is_dirty(k, particle);
   }
 
   typename Traits::PassValue get_attribute(Key k, ParticleIndex particle
@@ -202,6 +418,7 @@ class BasicAttributeTable {
 
     //! access to internally stored data table
   Vector<typename Traits::Container>& access_data(){
+    set_is_dirty();
     return data_;
   }
 
@@ -222,12 +439,14 @@ class BasicAttributeTable {
     unsigned int ki= k.get_index();
     IMP_USAGE_CHECK(ki < data_.size(),
                     "trying to access an attribute that was not added to this model");
+    set_is_dirty(k);
     return Traits::access_container_data(data_[ki]);
   }
 
   typename Traits::Container::reference access_attribute(
       Key k, ParticleIndex particle) {
     IMP_CHECK_MASK(write_mask_, particle, k, SET, ATTRIBUTE);
+    set_is_dirty(k, particle);
     return data_[k.get_index()][particle];
   }
   std::pair<typename Traits::Value, typename Traits::Value> get_range_internal(
@@ -258,6 +477,7 @@ class BasicAttributeTable {
     for (unsigned int i = 0; i < data_.size(); ++i) {
       if (data_[i].size() > get_as_unsigned_int(particle)) {
         data_[i][particle] = Traits::get_invalid();
+        set_is_dirty(Key(i), particle);
       }
     }
   }
@@ -276,9 +496,54 @@ class BasicAttributeTable {
     for (unsigned int i = 0; i < data_.size(); ++i) {
       std::fill(data_[i].begin(), data_[i].end(), value);
     }
+    set_is_dirty();
   }
   unsigned int size() const { return data_.size(); }
   unsigned int size(unsigned int i) const { return data_[i].size(); }
+
+  typedef std::vector<ArraySnapshot<typename Traits::Container> > Snapshot;
+
+  //! Save all attributes to s, sharing unchanged pages with base
+  /** If use_dirty is true, base is the last snapshot captured or
+      restored, so pages not marked dirty since then are shared without
+      being compared. All pages are clean afterwards.
+      \return the number of pages that were copied */
+  unsigned capture_snapshot(Snapshot &s, const Snapshot *base,
+                            bool use_dirty) {
+    unsigned copied = 0;
+    s.resize(data_.size());
+    for (unsigned int i = 0; i < data_.size(); ++i) {
+      copied += s[i].capture(data_[i],
+                             base && base->size() > i ? &(*base)[i] : nullptr,
+                             get_dirty_pages(i, use_dirty));
+    }
+    reset_dirty_pages();
+    return copied;
+  }
+
+  //! Restore all attributes saved by capture_snapshot()
+  /** last, if given, is the last snapshot captured or restored. */
+  void restore_snapshot(const Snapshot &s, const Snapshot *last) {
+    data_.resize(s.size());
+    for (unsigned int i = 0; i < s.size(); ++i) {
+      s[i].restore(data_[i],
+                   last && last->size() > i ? &(*last)[i] : nullptr,
+                   get_dirty_pages(i, last != nullptr));
+    }
+    reset_dirty_pages();
+  }
+
+ private:
+  const DirtyPages *get_dirty_pages(unsigned int i, bool use_dirty) const {
+    return use_dirty && i < dirty_.size() ? &dirty_[i] : nullptr;
+  }
+
+  void reset_dirty_pages() {
+    dirty_.resize(data_.size());
+    for (unsigned int i = 0; i < data_.size(); ++i) {
+      dirty_[i].reset(data_[i].size());
+    }
+  }
 };
 IMP_SWAP_1(BasicAttributeTable);
 
@@ -292,6 +557,8 @@ class SparseBasicAttributeTable {
 
  private:
   KeyVector<typename Traits::Key, typename Traits::Container> data_;
+  // keys written since the last snapshot; each key is one page
+  Vector<DirtyPages> dirty_;
 #if IMP_HAS_CHECKS >= IMP_INTERNAL
   Mask *read_mask_, *write_mask_, *add_remove_mask_;
 #endif
@@ -309,11 +576,20 @@ class SparseBasicAttributeTable {
       data_.resize(k.get_index() + 1);
     }
     data_[k.get_index()][particle] = value;
+    set_is_dirty(k);
+  }
+
+  void set_is_dirty(Key k) {
+    if (k.get_index() < dirty_.size()) {
+      dirty_[k.get_index()].set_all();
+    }
   }
 
  public:
   void swap_with(SparseBasicAttributeTable<Traits> &o) {
     IMP_SWAP_MEMBER(data_);
+    dirty_.clear();
+    o.dirty_.clear();
   }
 
 #if IMP_HAS_CHECKS >= IMP_INTERNAL
@@ -343,6 +619,7 @@ class SparseBasicAttributeTable {
     IMP_USAGE_CHECK(get_has_attribute(k, particle),
                     "Can't remove attribute if it isn't there");
     data_[k.get_index()].erase(particle);
+    set_is_dirty(k);
   }
 
   //! Get the size of the attribute table for the given key.
@@ -368,6 +645,7 @@ class SparseBasicAttributeTable {
                     "Setting invalid attribute: " << k << " of particle "
                                                   << particle);
     data_[k.get_index()][particle] = value;
+    set_is_dirty(k);
   }
 
   typename Traits::PassValue get_attribute(Key k, ParticleIndex particle
@@ -381,12 +659,55 @@ class SparseBasicAttributeTable {
   void clear_attributes(ParticleIndex particle) {
     IMP_CHECK_MASK(add_remove_mask_, particle, Key(0), REMOVE, ATTRIBUTE);
     for (unsigned int i = 0; i < data_.size(); ++i) {
-      data_[i].erase(particle);
+      if (data_[i].erase(particle) > 0) {
+        set_is_dirty(Key(i));
+      }
     }
   }
 
   unsigned int size() const { return data_.size(); }
   unsigned int size(unsigned int i) const { return data_[i].size(); }
+
+  typedef std::vector<ArraySnapshot<typename Traits::Container> > Snapshot;
+
+  //! Save all attributes to s, sharing unchanged tables with base
+  /** Keys that were not written since the last snapshot are shared
+      without being compared if use_dirty is true. */
+  unsigned capture_snapshot(Snapshot &s, const Snapshot *base,
+                            bool use_dirty) {
+    unsigned copied = 0;
+    s.resize(data_.size());
+    for (unsigned int i = 0; i < data_.size(); ++i) {
+      copied += s[i].capture(data_[i],
+                             base && base->size() > i ? &(*base)[i] : nullptr,
+                             get_dirty_pages(i, use_dirty));
+    }
+    reset_dirty_pages();
+    return copied;
+  }
+
+  //! Restore all attributes saved by capture_snapshot()
+  void restore_snapshot(const Snapshot &s, const Snapshot *last) {
+    data_.resize(s.size());
+    for (unsigned int i = 0; i < s.size(); ++i) {
+      s[i].restore(data_[i],
+                   last && last->size() > i ? &(*last)[i] : nullptr,
+                   get_dirty_pages(i, last != nullptr));
+    }
+    reset_dirty_pages();
+  }
+
+ private:
+  const DirtyPages *get_dirty_pages(unsigned int i, bool use_dirty) const {
+    return use_dirty && i < dirty_.size() ? &dirty_[i] : nullptr;
+  }
+
+  void reset_dirty_pages() {
+    dirty_.resize(data_.size());
+    for (unsigned int i = 0; i < data_.size(); ++i) {
+      dirty_[i].reset(0);
+    }
+  }
 };
 IMP_SWAP_1(SparseBasicAttributeTable);
 
@@ -404,27 +725,152 @@ template<class T> struct sphere_equal {
   }
 };
 
+//! Number of particles in each page of a thread derivative buffer
+const unsigned IMP_DERIVATIVE_PAGE_SIZE = 256;
+
+//! Per-thread derivative buffers for one evaluation
+/** While attached to a Model (see
+    FloatAttributeTable::attach_thread_derivatives()), each thread adds
+    derivatives to its own buffer without synchronization, and the buffers
+    are added to the Model's derivatives when they are detached. A buffer
+    holds one slot per FloatKey index, split into pages of
+    IMP_DERIVATIVE_PAGE_SIZE particles that are only allocated when the
+    thread first writes to them, so a thread only pays for the particles
+    it touches.
+
+    Each evaluation that wants buffering creates its own object, so the
+    buffers never outlive or are shared between evaluations.
+*/
+class ThreadDerivativeBuffers {
+  struct ThreadBuffer {
+    // pages[slot][page], or nullptr if the thread has not written there
+    std::vector<std::vector<double *> > pages;
+    std::vector<std::unique_ptr<double[]> > storage;
+  };
+  std::vector<std::unique_ptr<ThreadBuffer> > threads_;
+
+  // Add page (slot, page) of every thread other than the first that has it
+  // to that first page; return the first page, or nullptr
+  double *sum_page(unsigned slot, unsigned page) {
+    double *total = nullptr;
+    for (unsigned t = 0; t < threads_.size(); ++t) {
+      double *values = get_page(t, slot, page);
+      if (!values) continue;
+      if (!total) {
+        total = values;
+      } else {
+        for (unsigned i = 0; i < IMP_DERIVATIVE_PAGE_SIZE; ++i) {
+          total[i] += values[i];
+        }
+      }
+    }
+    return total;
+  }
+
+  static void sum_pages(ThreadDerivativeBuffers *b,
+                        const std::vector<std::pair<unsigned, unsigned> > *ps,
+                        unsigned begin, unsigned end,
+                        std::vector<double *> *totals) {
+    for (unsigned i = begin; i < end; ++i) {
+      (*totals)[i] = b->sum_page((*ps)[i].first, (*ps)[i].second);
+    }
+  }
+
+  double *get_page(unsigned t, unsigned slot, unsigned page) const {
+    const ThreadBuffer &b = *threads_[t];
+    if (slot >= b.pages.size() || page >= b.pages[slot].size()) {
+      return nullptr;
+    }
+    return b.pages[slot][page];
+  }
+
+ public:
+  ThreadDerivativeBuffers(unsigned num_threads) {
+    for (unsigned t = 0; t < num_threads; ++t) {
+      threads_.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer()));
+    }
+  }
+
+  //! Get where the calling thread should add to slot of a particle
+  /** \return nullptr if the calling thread has no buffer. */
+  double *get_thread_value(unsigned slot, unsigned particle) {
+    unsigned t = get_task_thread_index();
+    if (t >= threads_.size()) return nullptr;
+    ThreadBuffer &b = *threads_[t];
+    if (b.pages.size() <= slot) b.pages.resize(slot + 1);
+    std::vector<double *> &pages = b.pages[slot];
+    unsigned page = particle / IMP_DERIVATIVE_PAGE_SIZE;
+    if (pages.size() <= page) pages.resize(page + 1, nullptr);
+    if (!pages[page]) {
+      b.storage.push_back(
+          std::unique_ptr<double[]>(new double[IMP_DERIVATIVE_PAGE_SIZE]()));
+      pages[page] = b.storage.back().get();
+    }
+    return pages[page] + particle % IMP_DERIVATIVE_PAGE_SIZE;
+  }
+
+  //! Sum the threads' buffers and call f(slot, first particle, values)
+  /** f is called once for each page any thread wrote to, from the
+      calling thread; the summing itself is split into tasks. */
+  template <class F>
+  void reduce(F f) {
+    std::vector<std::pair<unsigned, unsigned> > touched;
+    for (unsigned t = 0; t < threads_.size(); ++t) {
+      const ThreadBuffer &b = *threads_[t];
+      for (unsigned slot = 0; slot < b.pages.size(); ++slot) {
+        for (unsigned page = 0; page < b.pages[slot].size(); ++page) {
+          if (b.pages[slot][page]) {
+            touched.push_back(std::make_pair(slot, page));
+          }
+        }
+      }
+    }
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()),
+                  touched.end());
+    std::vector<double *> totals(touched.size(), nullptr);
+    ThreadDerivativeBuffers *b = this;
+    const std::vector<std::pair<unsigned, unsigned> > *ps = &touched;
+    std::vector<double *> *ts = &totals;
+    const unsigned chunk = 16;
+    for (unsigned begin = 0; begin < touched.size(); begin += chunk) {
+      unsigned end = std::min<unsigned>(begin + chunk, touched.size());
+      IMP_TASK((b, ps, begin, end, ts), sum_pages(b, ps, begin, end, ts),
+               "reduce derivatives");
+    }
+    IMP_TASKWAIT
+    for (unsigned i = 0; i < touched.size(); ++i) {
+      f(touched[i].first, touched[i].second * IMP_DERIVATIVE_PAGE_SIZE,
+        totals[i]);
+    }
+  }
+};
+
 class FloatAttributeTable {
+  typedef IndexVector<ParticleIndexTag, algebra::Sphere3D,
+                      IMP_VECTOR_ALLOCATOR<algebra::Sphere3D>,
+                      sphere_equal<algebra::Sphere3D> > Spheres;
+  typedef IndexVector<ParticleIndexTag, algebra::Vector3D,
+                      std::allocator<algebra::Vector3D>,
+                      vector_equal<algebra::Vector3D> > Vectors;
+  typedef BasicAttributeTable<internal::FloatAttributeTableTraits> FloatTable;
+  typedef BasicAttributeTable<internal::BoolAttributeTableTraits> BoolTable;
   // vector<algebra::Sphere3D> spheres_;
   // vector<algebra::Sphere3D> sphere_derivatives_;
-  IndexVector<ParticleIndexTag, algebra::Sphere3D,
-              IMP_VECTOR_ALLOCATOR<algebra::Sphere3D>,
-              sphere_equal<algebra::Sphere3D> > spheres_;
-  IndexVector<ParticleIndexTag, algebra::Sphere3D,
-              IMP_VECTOR_ALLOCATOR<algebra::Sphere3D>,
-              sphere_equal<algebra::Sphere3D> > sphere_derivatives_;
-  IndexVector<ParticleIndexTag, algebra::Vector3D,
-              std::allocator<algebra::Vector3D>,
-              vector_equal<algebra::Vector3D> > internal_coordinates_;
-  IndexVector<ParticleIndexTag, algebra::Vector3D,
-              std::allocator<algebra::Vector3D>,
-              vector_equal<algebra::Vector3D> >
-      internal_coordinate_derivatives_;
-  BasicAttributeTable<internal::FloatAttributeTableTraits> data_;
-  BasicAttributeTable<internal::FloatAttributeTableTraits> derivatives_;
+  Spheres spheres_;
+  Spheres sphere_derivatives_;
+  Vectors internal_coordinates_;
+  Vectors internal_coordinate_derivatives_;
+  FloatTable data_;
+  FloatTable derivatives_;
   // make use bitset
-  BasicAttributeTable<internal::BoolAttributeTableTraits> optimizeds_;
+  BoolTable optimizeds_;
   FloatRanges ranges_;
+  // pages written since the last snapshot
+  DirtyPages spheres_dirty_, internal_coordinates_dirty_, ranges_dirty_;
+  // per-thread derivatives of the evaluation currently running, if any
+  bool use_thread_local_derivatives_;
+  std::atomic<ThreadDerivativeBuffers *> thread_derivatives_;
 #if IMP_HAS_CHECKS >= IMP_INTERNAL
   Mask *read_mask_, *write_mask_, *add_remove_mask_, *read_derivatives_mask_,
       *write_derivatives_mask_;
@@ -444,6 +890,66 @@ class FloatAttributeTable {
     return ivs;
   }
 
+  // Where the calling thread should add to slot (the FloatKey index) of
+  // the particle, or nullptr to add to the table itself
+  double *get_thread_derivative(unsigned slot, ParticleIndex particle) {
+    ThreadDerivativeBuffers *b =
+        thread_derivatives_.load(std::memory_order_relaxed);
+    return b ? b->get_thread_value(slot, get_as_unsigned_int(particle))
+             : nullptr;
+  }
+
+  // Note that attribute k of the particle may have changed
+  void set_is_dirty(FloatKey k, ParticleIndex particle) {
+    if (k.get_index() < 4) {
+      spheres_dirty_.set(get_as_unsigned_int(particle));
+    } else if (k.get_index() < 7) {
+      internal_coordinates_dirty_.set(get_as_unsigned_int(particle));
+    }
+  }
+
+  void reset_dirty_pages() {
+    spheres_dirty_.reset(spheres_.size());
+    internal_coordinates_dirty_.reset(internal_coordinates_.size());
+    ranges_dirty_.reset(0);
+  }
+
+  template <class Vector>
+  void add_to_vector_derivative(unsigned slot, Vector &dest,
+                                ParticleIndex particle,
+                                const algebra::Vector3D &v,
+                                const DerivativeAccumulator &da) {
+    double *buf = get_thread_derivative(slot, particle);
+    if (buf) {
+      // the three slots are in separate pages
+      buf[0] += da(v[0]);
+      *get_thread_derivative(slot + 1, particle) += da(v[1]);
+      *get_thread_derivative(slot + 2, particle) += da(v[2]);
+    } else {
+      IMP_ACCUMULATE(dest[0], da(v[0]));
+      IMP_ACCUMULATE(dest[1], da(v[1]));
+      IMP_ACCUMULATE(dest[2], da(v[2]));
+    }
+  }
+
+  // Add a page of buffered derivatives of slot, starting at particle first
+  void add_derivative_page(unsigned slot, unsigned first,
+                           const double *values) {
+    for (unsigned i = 0; i < IMP_DERIVATIVE_PAGE_SIZE; ++i) {
+      // entries that were never written are zero; this also skips
+      // particles that do not have the attribute
+      if (values[i] == 0.) continue;
+      ParticleIndex pi(first + i);
+      if (slot < 4) {
+        sphere_derivatives_[pi][slot] += values[i];
+      } else if (slot < 7) {
+        internal_coordinate_derivatives_[pi][slot - 4] += values[i];
+      } else {
+        derivatives_.access_attribute(FloatKey(slot - 7), pi) += values[i];
+      }
+    }
+  }
+
  public:
   void swap_with(FloatAttributeTable &o) {
     using std::swap;
@@ -454,10 +960,16 @@ class FloatAttributeTable {
     IMP_SWAP_MEMBER(optimizeds_);
     IMP_SWAP_MEMBER(internal_coordinates_);
     IMP_SWAP_MEMBER(internal_coordinate_derivatives_);
+    spheres_dirty_.set_all();
+    internal_coordinates_dirty_.set_all();
+    o.spheres_dirty_.set_all();
+    o.internal_coordinates_dirty_.set_all();
   }
   FloatAttributeTable()
+      : use_thread_local_derivatives_(false),
+        thread_derivatives_(nullptr)
 #if IMP_HAS_CHECKS >= IMP_INTERNAL
-      : read_mask_(nullptr),
+      , read_mask_(nullptr),
         write_mask_(nullptr),
         add_remove_mask_(nullptr),
         read_derivatives_mask_(nullptr),
@@ -481,12 +993,29 @@ class FloatAttributeTable {
 #endif
 
   // make sure you know what you are doing
+  /* The non-const accessors hand out a writable reference, so they mark
+     the particle as changed for the next snapshot; use the const ones
+     to only read. */
   algebra::Sphere3D &get_sphere(ParticleIndex particle) {
+    IMP_CHECK_MASK(read_mask_, particle, FloatKey(0), GET, ATTRIBUTE);
+    spheres_dirty_.set(get_as_unsigned_int(particle));
+    return spheres_[particle];
+  }
+
+  const algebra::Sphere3D &get_sphere(ParticleIndex particle) const {
     IMP_CHECK_MASK(read_mask_, particle, FloatKey(0), GET, ATTRIBUTE);
     return spheres_[particle];
   }
 
   algebra::Vector3D &get_internal_coordinates(ParticleIndex particle) {
+    internal_coordinates_dirty_.set(get_as_unsigned_int(particle));
+    return const_cast<algebra::Vector3D &>(
+        static_cast<const FloatAttributeTable *>(this)
+            ->get_internal_coordinates(particle));
+  }
+
+  const algebra::Vector3D &get_internal_coordinates(
+      ParticleIndex particle) const {
     IMP_CHECK_MASK(read_mask_, particle, FloatKey(5), GET, ATTRIBUTE);
     IMP_USAGE_CHECK(internal_coordinates_[particle][0] !=
                         internal::FloatAttributeTableTraits::get_invalid(),
@@ -517,6 +1046,27 @@ class FloatAttributeTable {
     IMP_ACCUMULATE(xyzr_deriv[2], da(v[2]));
   }
 
+  //! Like the static add_to_coordinate_derivatives(), but buffered
+  /** If xyzr_deriv is one of this table's sphere derivatives and an
+      evaluation has attached per-thread derivative buffers, the
+      derivatives are added to the calling thread's buffer instead. */
+  void add_to_table_coordinate_derivatives(algebra::Sphere3D& xyzr_deriv,
+                                           const algebra::Vector3D &v,
+                                           const DerivativeAccumulator &da) {
+    if (thread_derivatives_.load(std::memory_order_relaxed)) {
+      std::ptrdiff_t i = &xyzr_deriv - sphere_derivatives_.data();
+      if (i >= 0
+          && i < static_cast<std::ptrdiff_t>(sphere_derivatives_.size())) {
+        add_to_coordinate_derivatives(ParticleIndex(static_cast<int>(i)), v,
+                                      da);
+        return;
+      }
+    }
+    IMP_ACCUMULATE(xyzr_deriv[0], da(v[0]));
+    IMP_ACCUMULATE(xyzr_deriv[1], da(v[1]));
+    IMP_ACCUMULATE(xyzr_deriv[2], da(v[2]));
+  }
+
   //! add derivatives in v to xyz derivative of particle, after
   //! transforming the derivative using da
   void add_to_coordinate_derivatives(ParticleIndex particle,
@@ -526,7 +1076,8 @@ class FloatAttributeTable {
                    DERIVATIVE);
     IMP_USAGE_CHECK(get_has_attribute(FloatKey(0), particle),
                     "Particle does not have coordinates: " << particle);
-    add_to_coordinate_derivatives(sphere_derivatives_[particle], v, da);
+    add_to_vector_derivative(0, sphere_derivatives_[particle], particle, v,
+                             da);
   }
 
   void add_to_internal_coordinate_derivatives(ParticleIndex particle,
@@ -536,9 +1087,8 @@ class FloatAttributeTable {
                    DERIVATIVE);
     IMP_USAGE_CHECK(get_has_attribute(FloatKey(0), particle),
                     "Particle does not have coordinates");
-    IMP_ACCUMULATE(internal_coordinate_derivatives_[particle][0], da(v[0]));
-    IMP_ACCUMULATE(internal_coordinate_derivatives_[particle][1], da(v[1]));
-    IMP_ACCUMULATE(internal_coordinate_derivatives_[particle][2], da(v[2]));
+    add_to_vector_derivative(4, internal_coordinate_derivatives_[particle],
+                             particle, v, da);
   }
 
   const algebra::Vector3D &get_coordinate_derivatives(ParticleIndex particle)
@@ -572,12 +1122,14 @@ class FloatAttributeTable {
           internal::FloatAttributeTableTraits::get_invalid();
       sphere_derivatives_[particle][k.get_index()] =
           internal::FloatAttributeTableTraits::get_invalid();
+      set_is_dirty(k, particle);
     } else if (k.get_index() < 7) {
       IMP_CHECK_MASK(add_remove_mask_, particle, k, REMOVE, ATTRIBUTE);
       internal_coordinates_[particle][k.get_index() - 4] =
           internal::FloatAttributeTableTraits::get_invalid();
       internal_coordinate_derivatives_[particle][k.get_index() - 4] =
           internal::FloatAttributeTableTraits::get_invalid();
+      set_is_dirty(k, particle);
     } else {
       data_.remove_attribute(FloatKey(k.get_index() - 7), particle);
       derivatives_.remove_attribute(FloatKey(k.get_index() - 7), particle);
@@ -622,17 +1174,22 @@ class FloatAttributeTable {
     IMP_USAGE_CHECK(get_has_attribute(k, particle),
                     "Can't get derivative that isn't there: "
                         << k.get_string() << " on particle " << particle);
+    double *dest;
     if (k.get_index() < 4) {
       IMP_CHECK_MASK(write_derivatives_mask_, particle, k, SET, DERIVATIVE);
-      sphere_derivatives_[particle][k.get_index()] += da(v);
-      ;
+      dest = &sphere_derivatives_[particle][k.get_index()];
     } else if (k.get_index() < 7) {
       IMP_CHECK_MASK(write_derivatives_mask_, particle, k, SET, DERIVATIVE);
-      internal_coordinate_derivatives_[particle][k.get_index() - 4] += da(v);
-      ;
+      dest = &internal_coordinate_derivatives_[particle][k.get_index() - 4];
     } else {
-      FloatKey nk(k.get_index() - 7);
-      IMP_ACCUMULATE(derivatives_.access_attribute(nk, particle), da(v));
+      dest = &derivatives_.access_attribute(FloatKey(k.get_index() - 7),
+                                            particle);
+    }
+    double *buf = get_thread_derivative(k.get_index(), particle);
+    if (buf) {
+      *buf += da(v);
+    } else {
+      IMP_ACCUMULATE(*dest, da(v));
     }
   }
 
@@ -667,11 +1224,14 @@ class FloatAttributeTable {
       data_.add_attribute(nk, particle, v);
       derivatives_.add_attribute(nk, particle, 0);
     }
+    set_is_dirty(k, particle);
     if (opt) optimizeds_.add_attribute(k, particle, true);
-    ranges_.resize(
-        std::max(ranges_.size(), static_cast<size_t>(k.get_index() + 1)),
-        FloatRange(-std::numeric_limits<double>::max(),
-                   std::numeric_limits<double>::max()));
+    if (ranges_.size() <= k.get_index()) {
+      ranges_.resize(k.get_index() + 1,
+                     FloatRange(-std::numeric_limits<double>::max(),
+                                std::numeric_limits<double>::max()));
+      ranges_dirty_.set_all();
+    }
     IMP_USAGE_CHECK(get_has_attribute(k, particle),
                     "Can't attribute was not added");
   }
@@ -712,6 +1272,7 @@ class FloatAttributeTable {
     } else {
       data_.set_attribute(FloatKey(k.get_index() - 7), particle, v);
     }
+    set_is_dirty(k, particle);
   }
 
   //! return attribute k of specified particle
@@ -737,6 +1298,7 @@ class FloatAttributeTable {
     IMP_USAGE_CHECK(get_has_attribute(k, particle),
                     "Can't get attribute that is not there: "
                         << k.get_string() << " on particle " << particle);
+    set_is_dirty(k, particle);
     if (k.get_index() < 4) {
       return spheres_[particle][k.get_index()];
     } else if (k.get_index() < 7) {
@@ -745,6 +1307,39 @@ class FloatAttributeTable {
       return data_.access_attribute(FloatKey(k.get_index() - 7), particle);
     }
   }
+  /** \name Copying many attributes at once
+      Expert methods for optimizers, which copy the values or derivatives
+      of a list of attributes to or from a flat vector, each scaled by
+      its width. Each attribute is looked up on every call, so the list
+      stays valid as particles and attributes are added or removed, and
+      only the particles that are written are marked as changed.
+      @{
+  */
+  void get_scaled_attributes(const FloatIndexes &fis, const Floats &widths,
+                             Floats &x) const {
+    x.resize(fis.size());
+    for (unsigned int i = 0; i < fis.size(); ++i) {
+      x[i] = get_attribute(fis[i].get_key(), fis[i].get_particle())
+             / widths[i];
+    }
+  }
+  void set_scaled_attributes(const FloatIndexes &fis, const Floats &widths,
+                             const Floats &x) {
+    IMP_USAGE_CHECK(x.size() == fis.size(), "Wrong number of values");
+    for (unsigned int i = 0; i < fis.size(); ++i) {
+      set_attribute(fis[i].get_key(), fis[i].get_particle(),
+                    x[i] * widths[i]);
+    }
+  }
+  void get_scaled_derivatives(const FloatIndexes &fis, const Floats &widths,
+                              Floats &dx) const {
+    dx.resize(fis.size());
+    for (unsigned int i = 0; i < fis.size(); ++i) {
+      dx[i] = get_derivative(fis[i].get_key(), fis[i].get_particle())
+              * widths[i];
+    }
+  }
+  /** @} */
   FloatIndexes get_optimized_attributes() const {
     FloatIndexes ret;
     for (unsigned int i = 0; i < optimizeds_.size(); ++i) {
@@ -784,6 +1379,17 @@ class FloatAttributeTable {
     return spheres_.data();
   }
   algebra::Sphere3D* access_spheres_data(){
+    spheres_dirty_.set_all();
+    return spheres_.data();
+  }
+  //! Get the spheres for writing only those of the written particles
+  /** Unlike access_spheres_data(), only the snapshot pages holding
+      these particles are marked as written. */
+  template <class Indexes>
+  algebra::Sphere3D* access_spheres_data(const Indexes &written){
+    for (ParticleIndex particle : written) {
+      spheres_dirty_.set(get_as_unsigned_int(particle));
+    }
     return spheres_.data();
   }
   unsigned get_sphere_derivatives_size() const {
@@ -799,6 +1405,7 @@ class FloatAttributeTable {
     return internal_coordinates_.data();
   }
   algebra::Vector3D * access_internal_coordinates_data() {
+    internal_coordinates_dirty_.set_all();
     return internal_coordinates_.data();
   }
   algebra::Vector3D const* access_internal_coordinates_derivatives_data() const{
@@ -807,6 +1414,100 @@ class FloatAttributeTable {
   algebra::Vector3D * access_internal_coordinates_derivatives_data() {
     return internal_coordinate_derivatives_.data();
   }
+
+  //! Accumulate derivatives in per-thread buffers
+  /** By default, each derivative written by a restraint during
+      multithreaded evaluation is an atomic update of the shared derivative
+      tables. When this is enabled, each evaluation that runs with more
+      than one thread gives every thread a private, sparsely allocated
+      buffer, and the buffers are added to the derivative tables once
+      all restraints have been evaluated. This removes the contention at
+      the cost of memory proportional to the particles each thread touches.
+
+      All derivative writes (add_to_coordinate_derivatives(),
+      add_to_internal_coordinate_derivatives() and add_to_derivative())
+      are buffered, so derivatives are not complete until evaluation
+      finishes and restraints must not read them. */
+  void set_use_thread_local_derivatives(bool tf) {
+    use_thread_local_derivatives_ = tf;
+  }
+  bool get_use_thread_local_derivatives() const {
+    return use_thread_local_derivatives_;
+  }
+
+  //! Route derivative writes to b until detach_thread_derivatives()
+  /** Derivatives belong to the Model, so only one evaluation at a time
+      can buffer them; this returns false (and derivatives are added
+      atomically as usual) if another evaluation already has buffers
+      attached. */
+  bool attach_thread_derivatives(ThreadDerivativeBuffers *b) {
+    ThreadDerivativeBuffers *expected = nullptr;
+    return thread_derivatives_.compare_exchange_strong(expected, b);
+  }
+
+  //! Stop routing writes to b and add its contents to the derivatives
+  void detach_thread_derivatives(ThreadDerivativeBuffers *b) {
+    thread_derivatives_.store(nullptr);
+    b->reduce([this](unsigned slot, unsigned first, const double *values) {
+      add_derivative_page(slot, first, values);
+    });
+  }
+
+  //! Saved attribute values; derivatives are not saved
+  struct Snapshot {
+    ArraySnapshot<Spheres> spheres;
+    ArraySnapshot<Vectors> internal_coordinates;
+    FloatTable::Snapshot data;
+    BoolTable::Snapshot optimizeds;
+    ArraySnapshot<FloatRanges> ranges;
+  };
+
+  //! Save all attributes to s, sharing unchanged pages with base
+  /** See BasicAttributeTable::capture_snapshot().
+      \return the number of pages that were copied */
+  unsigned capture_snapshot(Snapshot &s, const Snapshot *base,
+                            bool use_dirty) {
+    unsigned copied = s.spheres.capture(
+        spheres_, base ? &base->spheres : nullptr,
+        use_dirty ? &spheres_dirty_ : nullptr);
+    copied += s.internal_coordinates.capture(
+        internal_coordinates_, base ? &base->internal_coordinates : nullptr,
+        use_dirty ? &internal_coordinates_dirty_ : nullptr);
+    copied += data_.capture_snapshot(s.data, base ? &base->data : nullptr,
+                                     use_dirty);
+    copied += optimizeds_.capture_snapshot(
+        s.optimizeds, base ? &base->optimizeds : nullptr, use_dirty);
+    copied += s.ranges.capture(ranges_, base ? &base->ranges : nullptr,
+                               use_dirty ? &ranges_dirty_ : nullptr);
+    reset_dirty_pages();
+    return copied;
+  }
+
+  //! Restore all attributes saved by capture_snapshot()
+  /** The derivative tables are resized to match, but their values are
+      left as they are; they are recalculated on the next evaluation. */
+  void restore_snapshot(const Snapshot &s, const Snapshot *last) {
+    s.spheres.restore(spheres_, last ? &last->spheres : nullptr,
+                      &spheres_dirty_);
+    s.internal_coordinates.restore(
+        internal_coordinates_, last ? &last->internal_coordinates : nullptr,
+        &internal_coordinates_dirty_);
+    data_.restore_snapshot(s.data, last ? &last->data : nullptr);
+    optimizeds_.restore_snapshot(s.optimizeds,
+                                 last ? &last->optimizeds : nullptr);
+    s.ranges.restore(ranges_, last ? &last->ranges : nullptr, &ranges_dirty_);
+    reset_dirty_pages();
+    sphere_derivatives_.resize(spheres_.size(), get_invalid_sphere());
+    internal_coordinate_derivatives_.resize(internal_coordinates_.size(),
+                                            get_invalid_sphere().get_center());
+    Vector<FloatAttributeTableTraits::Container> &derivs =
+        derivatives_.access_data();
+    derivs.resize(data_.size());
+    for (unsigned int i = 0; i < data_.size(); ++i) {
+      derivs[i].resize(data_.size(i), 0.);
+    }
+  }
+
   //! Get the size of the attribute table for the given key.
   //! 0 is returned if the attribute does not exist in the model.
   unsigned get_attribute_size(FloatKey k) const {
@@ -832,10 +1533,10 @@ class FloatAttributeTable {
     IMP_USAGE_CHECK(k.get_index()>=7,
 		    "coordinates and radius should be accessed by specialized methods");
     unsigned int ki= k.get_index()-7;
-    IMP_USAGE_CHECK(ki < (data_.access_data()).size(),
+    IMP_USAGE_CHECK(ki < data_.size(),
                     "trying to access an attribute that was not added to this model");
-    return internal::FloatAttributeTableTraits::access_container_data
-      ((data_.access_data())[ki]);
+    // only marks this attribute as changed for the next snapshot
+    return data_.access_attribute_data(FloatKey(ki));
   }
   //! Get the size of the derivative table for the given key.
   //! 0 is returned if the derivative does not exist in the model.
@@ -911,7 +1612,10 @@ class FloatAttributeTable {
   }
   /** @} */
 
-  void set_range(FloatKey k, FloatRange fr) { ranges_[k.get_index()] = fr; }
+  void set_range(FloatKey k, FloatRange fr) {
+    ranges_[k.get_index()] = fr;
+    ranges_dirty_.set_all();
+  }
   FloatRange get_range(FloatKey k) {
     FloatRange ret = ranges_[k.get_index()];
     if (ret.first == -std::numeric_limits<double>::max()) {
@@ -953,8 +1657,10 @@ class FloatAttributeTable {
     if (spheres_.size() > get_as_unsigned_int(particle)) {
       spheres_[particle] = get_invalid_sphere();
       sphere_derivatives_[particle] = get_invalid_sphere();
+      spheres_dirty_.set(get_as_unsigned_int(particle));
     }
     if (internal_coordinates_.size() > get_as_unsigned_int(particle)) {
+      internal_coordinates_dirty_.set(get_as_unsigned_int(particle));
       internal_coordinates_[particle] = get_invalid_sphere().get_center();
       internal_coordinate_derivatives_[particle] =
           get_invalid_sphere().get_center();
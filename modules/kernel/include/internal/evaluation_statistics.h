@@ -0,0 +1,66 @@
+/**
+ *  \file internal/evaluation_statistics.h
+ *  \brief Counters for the time spent in each Restraint and ScoreState
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ */
+
+#ifndef IMPKERNEL_INTERNAL_EVALUATION_STATISTICS_H
+#define IMPKERNEL_INTERNAL_EVALUATION_STATISTICS_H
+
+#include <IMP/kernel_config.h>
+#include "SimpleTimer.h"
+#include <atomic>
+#include <cstdint>
+
+IMPKERNEL_BEGIN_INTERNAL_NAMESPACE
+
+//! Running totals for one Restraint or ScoreState
+/** Each evaluation adds to these once, when its EvaluationTimer ends. */
+struct EvaluationCounters {
+  unsigned long calls;
+  double time;
+  std::uint64_t cycles;
+  std::atomic<unsigned long> derivative_writes;
+  EvaluationCounters() { clear(); }
+  void clear() {
+    calls = 0;
+    time = 0.;
+    cycles = 0;
+    derivative_writes = 0;
+  }
+};
+
+//! Add the time until the end of the current scope to a set of counters
+/** Derivative writes made on this thread while the timer is the
+    innermost one are counted locally and added to the counters when
+    it ends. */
+class IMPKERNELEXPORT EvaluationTimer {
+  EvaluationCounters &counters_;
+  SimpleTimer timer_;
+  std::uint64_t start_cycles_;
+  unsigned long derivative_writes_;
+  unsigned long *outer_derivative_writes_;
+
+ public:
+  EvaluationTimer(EvaluationCounters &counters);
+  ~EvaluationTimer();
+};
+
+//! Count a derivative write against the innermost timer on this thread
+/** Writes made outside of any EvaluationTimer, such as by tasks a
+    restraint spawns on other threads, are not counted. */
+IMPKERNELEXPORT void add_derivative_write();
+
+IMPKERNEL_END_INTERNAL_NAMESPACE
+
+/* Record the time spent in the rest of the enclosing scope in counters.
+   Compiled out if IMP is configured with IMP_EVALUATION_STATISTICS off. */
+#if IMP_KERNEL_HAS_EVALUATION_STATISTICS
+#define IMP_EVALUATION_TIMER(counters) \
+  IMP::internal::EvaluationTimer imp_evaluation_timer(counters)
+#else
+#define IMP_EVALUATION_TIMER(counters)
+#endif
+
+#endif /* IMPKERNEL_INTERNAL_EVALUATION_STATISTICS_H */
@@ -0,0 +1,80 @@
+/**
+ *  \file internal/executor.h
+ *  \brief Dispatch of IMP_TASK and friends to a TaskExecutor
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ *
+ */
+
+#ifndef IMPKERNEL_INTERNAL_EXECUTOR_H
+#define IMPKERNEL_INTERNAL_EXECUTOR_H
+
+#include <IMP/kernel_config.h>
+#include <atomic>
+#include <functional>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+IMPKERNEL_BEGIN_INTERNAL_NAMESPACE
+
+// True if tasks are run by a TaskExecutor rather than by OpenMP pragmas
+IMPKERNELEXPORT extern std::atomic<bool> use_task_executor;
+
+inline bool get_use_task_executor() {
+  return use_task_executor.load(std::memory_order_relaxed);
+}
+
+IMPKERNELEXPORT void run_executor_parallel(const std::function<void()> &action,
+                                           unsigned int num_threads);
+
+IMPKERNELEXPORT void add_executor_task(std::function<void()> task,
+                                       double cost);
+
+IMPKERNELEXPORT void wait_for_executor_tasks();
+
+IMPKERNELEXPORT unsigned int get_executor_thread_index();
+
+IMPKERNELEXPORT bool get_executor_is_parallel();
+
+//! Get the index of the calling thread in the current parallel region
+inline unsigned int get_task_thread_index() {
+  if (get_use_task_executor()) return get_executor_thread_index();
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
+//! Return true if we are running inside a parallel region
+inline bool get_is_in_parallel_region() {
+  if (get_use_task_executor()) return get_executor_is_parallel();
+#ifdef _OPENMP
+  return omp_in_parallel();
+#else
+  return false;
+#endif
+}
+
+//! Call f(i) for each i in [0, n) as tasks on up to num_threads threads
+/** If already in a parallel region, the tasks are added to it instead.
+    Otherwise, with fewer than two threads f is simply called in order,
+    and with more a parallel region is opened for the tasks. The global
+    number of threads is only changed (and restored once all tasks have
+    finished) if num_threads differs from it. */
+IMPKERNELEXPORT void run_tasks(unsigned int n, unsigned int num_threads,
+                               const std::function<void(unsigned int)> &f,
+                               const char *name = "tasks");
+
+//! Call f() in a parallel region of up to num_threads threads
+/** Calls to run_tasks() from f then add their tasks to this region,
+    rather than each opening a region of its own. */
+inline void run_in_parallel_region(unsigned int num_threads,
+                                   const std::function<void()> &f) {
+  run_tasks(1, num_threads, [&f](unsigned int) { f(); }, "parallel");
+}
+
+IMPKERNEL_END_INTERNAL_NAMESPACE
+
+#endif /* IMPKERNEL_INTERNAL_EXECUTOR_H */
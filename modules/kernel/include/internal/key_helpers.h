@@ -13,8 +13,13 @@
 #include <IMP/exception.h>
 #include <IMP/check_macros.h>
 #include <IMP/log_macros.h>
-#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
 #include <IMP/Vector.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 IMPKERNEL_BEGIN_INTERNAL_NAMESPACE
 
@@ -25,60 +30,115 @@ IMPKERNEL_BEGIN_INTERNAL_NAMESPACE
 #define IMPKERNEL_INTERNAL_OLD_COMPILER
 
 /** \internal The data concerning keys (strings and corresponding numbers).
-  */
-struct IMPKERNELEXPORT KeyData {
-  //! map from key string to key number (many:1)
-  typedef boost::unordered_map<std::string, int> Map;
-
-  //! reverse map - from key number to one representative of the key
-  //! strings that map to it (1:1)
-  typedef IMP::Vector<std::string> RMap;
-
-  void show(std::ostream &out = std::cout) const;
 
+    Keys are often looked up from several threads at once (e.g. by
+    decorators constructing keys inside restraints), while new keys are
+    rarely added. So lookups never lock: entries are never modified or
+    freed once published, the string-to-index table is replaced (rather
+    than resized) when it fills up, and the index-to-string table grows
+    by adding chunks. Only adding keys or aliases takes a lock.
+  */
+class IMPKERNELEXPORT KeyData {
+ public:
   //! ID - the key ID (as in the template of Key)
   KeyData(
 #ifndef IMPKERNEL_INTERNAL_OLD_COMPILER
 	  unsigned int ID
 #endif
 );
+  ~KeyData();
+
+  void show(std::ostream &out = std::cout) const;
 
   void assert_is_initialized() const;
 
+  //! Return the number of the key (or alias) with string "str", or -1
+  int find(const std::string &str) const {
+    const Table *t = table_.load(std::memory_order_acquire);
+    for (std::size_t i = get_hash(str) & t->mask;;
+         i = (i + 1) & t->mask) {
+      const Entry *e = t->slots[i].load(std::memory_order_acquire);
+      if (!e) return -1;
+      if (e->name == str) return e->index;
+    }
+  }
+
+  //! Return the number of keys (not counting aliases)
+  unsigned int get_number_of_keys() const {
+    return size_.load(std::memory_order_acquire);
+  }
+
+  //! Return the string for key number i < get_number_of_keys()
+  const std::string &get_string(unsigned int i) const {
+    unsigned int chunk, offset;
+    get_chunk(i, chunk, offset);
+    return chunks_[chunk].load(std::memory_order_acquire)[offset]
+        .load(std::memory_order_acquire)->name;
+  }
+
+  //! Return all key strings, including aliases
+  Vector<std::string> get_all_strings() const;
+
   //! Add key with string "str", return its number
   //! Note is is assumed that str wasn't a key already
   //! and this would override the old "str" key in a way that's not completely expected
   //! (TODO: add checks if str is already in map, to fix rmap or to use the old number?)
-  unsigned int add_key(std::string str) {
-    IMP_LOG_PROGRESS("KeyData::add_key " << str << std::endl);
-    unsigned int i = rmap_.size();
-    map_[str] = i;
-    rmap_.push_back(str);
-    return i;
-  }
-
-  //! add alias "str" to existing key number i (the alias is kept
-  //! in map but not in the reverse map rmap)
-  unsigned int add_alias(std::string str, unsigned int i) {
-    IMP_INTERNAL_CHECK(rmap_.size() > i, "The aliased key doesn't exist");
-    map_[str] = i;
-    return i;
-  }
+  unsigned int add_key(std::string str);
 
-  //! return a map from key string to key number (many:1)
-  const Map &get_map() const { return map_; }
+  //! Return the number of the key with string "str", adding it if needed
+  unsigned int find_or_add_key(const std::string &str);
 
-  //! return a reverse-map from key number to one representative of
-  //! the key strings that map to it (1:1)
-  const RMap &get_rmap() const { return rmap_; }
+  //! add alias "str" to existing key number i (the alias can be looked
+  //! up by string, but get_string(i) still returns the original)
+  unsigned int add_alias(std::string str, unsigned int i);
 
  private:
+  struct Entry {
+    std::string name;
+    unsigned int index;
+  };
+  // open addressing hash table from string to entry, at most half full
+  struct Table {
+    std::size_t mask;
+    std::unique_ptr<std::atomic<const Entry *>[]> slots;
+  };
+  typedef std::atomic<const Entry *> Chunk;
+  // index-to-string chunk k holds chunk_size << k entries
+  static const unsigned int chunk_size = 64;
+  static const unsigned int max_chunks = 26;
+
+  static std::size_t get_hash(const std::string &str) {
+    return boost::hash<std::string>()(str);
+  }
+  static void get_chunk(unsigned int i, unsigned int &chunk,
+                        unsigned int &offset) {
+    unsigned int p = i + chunk_size;
+    chunk = 0;
+    while (p >= (2 * chunk_size << chunk)) ++chunk;
+    offset = p - (chunk_size << chunk);
+  }
+  // size must be a power of two
+  static std::unique_ptr<Table> create_table(std::size_t size);
+  // all of these must be called with the lock held
+  unsigned int do_add_key(const std::string &str);
+  void insert(const Entry *e);
+  // returns false if e replaced an entry with the same name
+  bool insert_into(Table *t, const Entry *e);
+
   double heuristic_;
-  Map map_;
-  RMap rmap_;
+  std::atomic<const Table *> table_;
+  std::atomic<unsigned int> size_;
+  std::atomic<Chunk *> chunks_[max_chunks];
+
+  // Everything below is only touched by writers; old tables and entries
+  // are kept until destruction as readers may still be using them.
+  std::mutex mutex_;
+  unsigned int table_count_;
+  std::vector<std::unique_ptr<Table> > tables_;
+  std::vector<std::unique_ptr<Entry> > entries_;
+  std::vector<std::unique_ptr<Chunk[]> > chunk_storage_;
 };
 
-
 #ifdef IMPKERNEL_INTERNAL_OLD_COMPILER
 IMPKERNELEXPORT KeyData &get_key_data(unsigned int index);
 #endif
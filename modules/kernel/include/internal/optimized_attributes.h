@@ -0,0 +1,57 @@
+/**
+ *  \file internal/optimized_attributes.h
+ *  \brief A flat view of the optimized attributes of a Model.
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ */
+
+#ifndef IMPKERNEL_INTERNAL_OPTIMIZED_ATTRIBUTES_H
+#define IMPKERNEL_INTERNAL_OPTIMIZED_ATTRIBUTES_H
+
+#include <IMP/kernel_config.h>
+#include <IMP/Model.h>
+
+IMPKERNEL_BEGIN_INTERNAL_NAMESPACE
+
+//! A flat view of the optimized attributes of a Model
+/** The attributes and the widths used to scale them (see
+    AttributeOptimizer::get_scaled_value()) are given once, in set(). All
+    values or derivatives can then be copied to or from a contiguous
+    vector in one call. The Model's attribute tables are read on each
+    call, so the view stays valid if particles or attributes are added.
+ */
+class OptimizedAttributes {
+  WeakPointer<Model> m_;
+  FloatIndexes attributes_;
+  Floats widths_;
+
+ public:
+  void set(Model *m, const FloatIndexes &fis, const Floats &widths) {
+    IMP_USAGE_CHECK(fis.size() == widths.size(),
+                    "Need one width per attribute");
+    m_ = m;
+    attributes_ = fis;
+    widths_ = widths;
+  }
+
+  unsigned int size() const { return attributes_.size(); }
+
+  //! Copy the scaled values of all attributes into x
+  void get_values(Floats &x) const {
+    m_->get_scaled_attributes(attributes_, widths_, x);
+  }
+
+  //! Set all attributes from the scaled values in x
+  void set_values(const Floats &x) const {
+    m_->set_scaled_attributes(attributes_, widths_, x);
+  }
+
+  //! Copy the scaled derivatives of all attributes into dx
+  void get_derivatives(Floats &dx) const {
+    m_->get_scaled_derivatives(attributes_, widths_, dx);
+  }
+};
+
+IMPKERNEL_END_INTERNAL_NAMESPACE
+
+#endif /* IMPKERNEL_INTERNAL_OPTIMIZED_ATTRIBUTES_H */
@@ -11,29 +11,92 @@
 #include <IMP/kernel_config.h>
 #include "../base_types.h"
 #include "../ScoreAccumulator.h"
+#include "ArenaAllocator.h"
+#include <vector>
 
 IMPKERNEL_BEGIN_INTERNAL_NAMESPACE
 
+//! Per-restraint scores from the last evaluations by a scoring function
+/** This allows protected_evaluate_moved() to evaluate only those restraints
+    that depend on the moved or reset particles, and to reuse the cached
+    scores for the rest. Scores are unweighted, and are stored by the index
+    of the restraint in the list passed to protected_evaluate(). The cache
+    is invalidated whenever the Model dependency graph changes.
+ */
+class IMPKERNELEXPORT RestraintScoreCache {
+  std::vector<double> last_scores_, last_last_scores_;
+  // number of complete evaluations stored, capped at 2
+  unsigned num_evaluations_;
+  unsigned dependencies_age_;
+
+ public:
+  RestraintScoreCache() : num_evaluations_(0), dependencies_age_(0) {}
+
+  //! Return true if the scores can be used for the given evaluation
+  /** If any reset particles are given, we need the scores from the
+      last-but-one evaluation too. */
+  bool get_is_valid(Model *m, unsigned num_restraints,
+                    bool need_last_last) const;
+
+  //! Get the score of the ith restraint from the last evaluation
+  double get_last_score(unsigned i) const { return last_scores_[i]; }
+
+  //! Get the score of the ith restraint from the last-but-one evaluation
+  double get_last_last_score(unsigned i) const {
+    return last_last_scores_[i];
+  }
+
+  //! Record the scores from the most recent evaluation
+  /** If keep_last_last is non-empty, restraints for which it is true
+      keep their last-but-one score, rather than having it replaced by
+      their last score (as is done by RestraintSet). */
+  void set_scores(Model *m, const ArenaVector<double> &scores,
+                  const ArenaVector<char> &keep_last_last
+                      = ArenaVector<char>());
+
+  //! Forget all stored scores
+  void clear() {
+    num_evaluations_ = 0;
+    last_scores_.clear();
+    last_last_scores_.clear();
+  }
+};
+
 IMPKERNELEXPORT void protected_evaluate(IMP::ScoreAccumulator sa,
                                         Restraint *restraint,
                                         const ScoreStatesTemp &states,
                                         Model *m);
 
+/** If a cache is given, the scores of all restraints are stored in it
+    for use by subsequent calls to protected_evaluate_moved(). */
 IMPKERNELEXPORT void protected_evaluate(IMP::ScoreAccumulator sa,
                                         const RestraintsTemp &restraints,
                                         const ScoreStatesTemp &states,
-                                        Model *m);
+                                        Model *m,
+                                        RestraintScoreCache *cache = nullptr);
 IMPKERNELEXPORT void protected_evaluate(IMP::ScoreAccumulator sa,
                                         const Restraints &restraints,
                                         const ScoreStatesTemp &states,
-                                        Model *m);
+                                        Model *m,
+                                        RestraintScoreCache *cache = nullptr);
 
+/** If a cache is given and only the score is requested, restraints
+    that do not depend on any of the moved or reset particles are not
+    evaluated; their score is taken from the cache instead. */
 IMPKERNELEXPORT void protected_evaluate_moved(IMP::ScoreAccumulator sa,
                                         const RestraintsTemp &restraints,
                                         const ParticleIndexes &moved_pis,
                                         const ParticleIndexes &reset_pis,
                                         const ScoreStatesTemp &states,
-                                        Model *m);
+                                        Model *m,
+                                        RestraintScoreCache *cache = nullptr);
+IMPKERNELEXPORT void protected_evaluate_moved(IMP::ScoreAccumulator sa,
+                                        const Restraints &restraints,
+                                        const ParticleIndexes &moved_pis,
+                                        const ParticleIndexes &reset_pis,
+                                        const ScoreStatesTemp &states,
+                                        Model *m,
+                                        RestraintScoreCache *cache = nullptr);
 
 IMPKERNELEXPORT void protected_evaluate_moved(IMP::ScoreAccumulator sa,
                                         Restraint *restraint,
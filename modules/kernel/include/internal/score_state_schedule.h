@@ -0,0 +1,93 @@
+/**
+ *  \file internal/score_state_schedule.h
+ *  \brief Update ScoreStates in dependency order
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ */
+
+#ifndef IMPKERNEL_INTERNAL_SCORE_STATE_SCHEDULE_H
+#define IMPKERNEL_INTERNAL_SCORE_STATE_SCHEDULE_H
+
+#include <IMP/kernel_config.h>
+#include <IMP/base_types.h>
+#include <boost/unordered_map.hpp>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+IMPKERNEL_BEGIN_INTERNAL_NAMESPACE
+
+//! Times taken by one run of a ScoreStateSchedule
+struct ScoreStateScheduleTimes {
+  //! Time in seconds taken by the longest chain of states
+  double critical_path_time;
+  //! Sum of the time in seconds taken by all states
+  double total_time;
+  ScoreStateScheduleTimes() : critical_path_time(0.), total_time(0.) {}
+};
+
+//! Update a list of ScoreStates as a DAG rather than in update_order batches
+/** Each ScoreState is started as soon as the ScoreStates it depends on
+    (its required score states) have finished, rather than waiting for
+    every ScoreState with a lower update order.
+
+    The graph does not change once built, so one schedule can be run by
+    several evaluations at once; all state for a run is local to run().
+ */
+class IMPKERNELEXPORT ScoreStateSchedule {
+  ScoreStatesTemp states_;
+  // indexes of the states that each state directly depends on
+  std::vector<std::vector<unsigned> > predecessors_;
+  // indexes of the states that directly depend on each state
+  std::vector<std::vector<unsigned> > successors_;
+  unsigned critical_path_length_;
+
+  struct Run;
+  static void run_node(Run *run, unsigned int i, bool spawn);
+
+ public:
+  //! Build the graph for the given states, which must be in update order
+  ScoreStateSchedule(const ScoreStatesTemp &states);
+
+  //! Call update on every state, in dependency order
+  /** If reverse is true, each state is run after the states that depend
+      on it instead (as for ScoreState::after_evaluate()). States are run
+      as tasks if parallel is true, otherwise one at a time. If times is
+      not null, each state is timed and the totals stored there. */
+  void run(const std::function<void(ScoreState *)> &update, bool reverse,
+           bool parallel, ScoreStateScheduleTimes *times = nullptr) const;
+
+  //! Number of states on the longest dependency chain
+  unsigned get_critical_path_length() const { return critical_path_length_; }
+};
+
+//! Cache of ScoreStateSchedules, one per list of ScoreStates
+/** Each ScoringFunction updates its own list of required score states,
+    so alternating between scoring functions reuses their schedules
+    rather than rebuilding one. All schedules are dropped when the model
+    dependencies change. This is safe to call from several threads. */
+class IMPKERNELEXPORT ScoreStateSchedules {
+  struct Hash {
+    std::size_t operator()(const ScoreStatesTemp &states) const;
+  };
+  typedef boost::unordered_map<ScoreStatesTemp,
+                               std::shared_ptr<const ScoreStateSchedule>,
+                               Hash> Map;
+  std::mutex mutex_;
+  Map schedules_;
+  unsigned dependencies_age_;
+
+ public:
+  ScoreStateSchedules() : dependencies_age_(0) {}
+
+  //! Get the schedule for the given states, building it if needed
+  std::shared_ptr<const ScoreStateSchedule> get(const ScoreStatesTemp &states,
+                                                unsigned dependencies_age);
+
+  void clear();
+};
+
+IMPKERNEL_END_INTERNAL_NAMESPACE
+
+#endif /* IMPKERNEL_INTERNAL_SCORE_STATE_SCHEDULE_H */
@@ -10,12 +10,23 @@
 
 #include <IMP/kernel_config.h>
 #include <IMP/Vector.h>
+#include <atomic>
 #include <random>
 
 IMPKERNEL_BEGIN_NAMESPACE
 
 #ifndef SWIG // the RNG is defined explicitly in pyext/IMP_kernel.random.i
 
+class RandomNumberGenerator;
+
+namespace internal {
+//! Number of RandomNumberGeneratorScopes active on any thread
+extern IMPKERNELEXPORT std::atomic<int> random_number_generator_scopes;
+
+//! Get the generator set for the calling thread, or nullptr
+IMPKERNELEXPORT RandomNumberGenerator *get_thread_random_number_generator();
+}
+
 class RandomNumberGenerator : public std::mt19937 {
   typedef std::mt19937 T;
   T::result_type last_seed_;
@@ -48,6 +59,28 @@ public:
   // will never be zero. This can be used to determine if the seed was
   // changed since the last use.
   unsigned get_seed_counter() const { return seed_counter_; }
+
+  // Get a random number; for random_number_generator, this comes from the
+  // calling thread's generator if one has been set with
+  // RandomNumberGeneratorScope
+  inline T::result_type operator()();
+};
+
+//! Draw random numbers from another generator on the calling thread
+/** While the scope is active, numbers taken from random_number_generator
+    on the calling thread come from the passed generator instead. This
+    lets tasks running on several threads each use their own,
+    reproducibly seeded, generator, without changing the code that uses
+    random_number_generator. Other RandomNumberGenerator objects,
+    including copies of random_number_generator, are not affected.
+    Scopes can be nested.
+ */
+class IMPKERNELEXPORT RandomNumberGeneratorScope {
+  RandomNumberGenerator *old_;
+
+ public:
+  RandomNumberGeneratorScope(RandomNumberGenerator &gen);
+  ~RandomNumberGeneratorScope();
 };
 
 //! A shared non-GPU random number generator
@@ -65,6 +98,19 @@ This generator can be used by the
 distributions.
  */
 extern IMPKERNELEXPORT RandomNumberGenerator random_number_generator;
+
+inline RandomNumberGenerator::T::result_type
+RandomNumberGenerator::operator()() {
+  // only look up the thread's generator while some scope is active
+  if (this == &random_number_generator
+      && internal::random_number_generator_scopes.load(
+             std::memory_order_relaxed) != 0) {
+    RandomNumberGenerator *thread_gen =
+        internal::get_thread_random_number_generator();
+    if (thread_gen) return thread_gen->T::operator()();
+  }
+  return T::operator()();
+}
 #endif
 
 //! Return the initial random seed.
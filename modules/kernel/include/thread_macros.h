@@ -12,6 +12,7 @@
 #include "threads.h"
 #include "utility_macros.h"
 #include "log_macros.h"
+#include "internal/executor.h"
 #ifdef _OPENMP
 #include <IMP/CreateLogContext.h>
 #include <omp.h>
@@ -27,6 +28,17 @@
     list of passed variables.*/
 #define IMP_TASK_SHARED(privatev, sharedv, action, name) action
 
+/** Like IMP_TASK(), but pass an estimate of the cost of the task to
+    the TaskExecutor, if one is in use.*/
+#define IMP_TASK_WITH_COST(privatev, action, name, cost) action
+
+/** Like IMP_TASK_SHARED(), but pass an estimate of the cost of the task to
+    the TaskExecutor, if one is in use.*/
+#define IMP_TASK_SHARED_WITH_COST(privatev, sharedv, action, name, cost) action
+
+/** Wait for all tasks started by the current task to finish.*/
+#define IMP_TASKWAIT
+
 /** Start a parallel section if one is not already started.
  */
 #define IMP_THREADS(variables, action) action
@@ -38,35 +50,78 @@
 
 #define IMP_OMP_PRAGMA(x) IMP_PRAGMA(omp x)
 
-#define IMP_TASK(privatev, action, name)                                   \
-  if (IMP::get_number_of_threads() > 1) {                            \
-    IMP_OMP_PRAGMA(                                                        \
-        task default(none) firstprivate privatev if (omp_in_parallel())) { \
-      IMP::CreateLogContext task_context(name);                      \
-      action;                                                              \
+#define IMP_TASK_UNPAREN(...) __VA_ARGS__
+
+/* If a TaskExecutor is in use, variables that would be firstprivate
+   are captured by value, and shared variables by reference. Only the
+   listed variables are captured (not this), as with default(none). */
+#define IMP_TASK_WITH_COST(privatev, action, name, cost)                   \
+  if (IMP::get_number_of_threads() > 1) {                                  \
+    if (IMP::internal::get_use_task_executor()) {                          \
+      IMP::internal::add_executor_task(                                    \
+          [IMP_TASK_UNPAREN privatev]() mutable {                          \
+        IMP::CreateLogContext task_context(name);                          \
+        action;                                                            \
+      }, cost);                                                            \
+    } else {                                                               \
+      IMP_OMP_PRAGMA(                                                      \
+          task default(none) firstprivate privatev if (omp_in_parallel())) \
+      {                                                                    \
+        IMP::CreateLogContext task_context(name);                          \
+        action;                                                            \
+      }                                                                    \
     }                                                                      \
   } else {                                                                 \
     action;                                                                \
   }
 
-#define IMP_TASK_SHARED(privatev, sharedv, action, name)           \
-  if (IMP::get_number_of_threads() > 1) {                    \
-    IMP_OMP_PRAGMA(task default(none) firstprivate privatev shared \
-                       sharedv if (omp_in_parallel())) {           \
-      IMP::CreateLogContext task_context(name);              \
-      action;                                                      \
-    }                                                              \
-  } else {                                                         \
-    action;                                                        \
+#define IMP_TASK_SHARED_WITH_COST(privatev, sharedv, action, name, cost)   \
+  if (IMP::get_number_of_threads() > 1) {                                  \
+    if (IMP::internal::get_use_task_executor()) {                          \
+      IMP::internal::add_executor_task(                                    \
+          [&, IMP_TASK_UNPAREN privatev]() mutable {                       \
+        IMP::CreateLogContext task_context(name);                          \
+        action;                                                            \
+      }, cost);                                                            \
+    } else {                                                               \
+      IMP_OMP_PRAGMA(task default(none) firstprivate privatev shared       \
+                         sharedv if (omp_in_parallel()))                   \
+      {                                                                    \
+        IMP::CreateLogContext task_context(name);                          \
+        action;                                                            \
+      }                                                                    \
+    }                                                                      \
+  } else {                                                                 \
+    action;                                                                \
+  }
+
+#define IMP_TASK(privatev, action, name) \
+  IMP_TASK_WITH_COST(privatev, action, name, 1.0)
+
+#define IMP_TASK_SHARED(privatev, sharedv, action, name) \
+  IMP_TASK_SHARED_WITH_COST(privatev, sharedv, action, name, 1.0)
+
+#define IMP_TASKWAIT                            \
+  if (IMP::internal::get_use_task_executor()) { \
+    IMP::internal::wait_for_executor_tasks();   \
+  } else {                                      \
+    IMP_OMP_PRAGMA(taskwait)                    \
   }
 
 #define IMP_THREADS(variables, action)                                    \
-  if (IMP::get_number_of_threads() > 1) {                           \
-    IMP_OMP_PRAGMA(parallel shared variables                              \
-                       num_threads(IMP::get_number_of_threads())) { \
-      IMP_PRAGMA(omp single) {                                            \
-        IMP::CreateLogContext parallel_context("parallel");         \
+  if (IMP::get_number_of_threads() > 1) {                                 \
+    if (IMP::internal::get_use_task_executor()) {                         \
+      IMP::internal::run_executor_parallel([&]() {                        \
+        IMP::CreateLogContext parallel_context("parallel");               \
         action;                                                           \
+      }, IMP::get_number_of_threads());                                   \
+    } else {                                                              \
+      IMP_OMP_PRAGMA(parallel shared variables                            \
+                         num_threads(IMP::get_number_of_threads())) {     \
+        IMP_PRAGMA(omp single) {                                          \
+          IMP::CreateLogContext parallel_context("parallel");             \
+          action;                                                         \
+        }                                                                 \
       }                                                                   \
     }                                                                     \
   } else {                                                                \
@@ -206,7 +206,10 @@ PyObject *_get_sphere_derivatives_numpy(IMP::Model *m, PyObject *m_pyobj)
            any changes to values in this list will be reflected in the Model.
            Also, if the Model attribute array moves in memory (e.g. if particles
            or attributes are added) this array will be invalidated, so it is
-           unsafe to keep it around long term.
+           unsafe to keep it around long term. Similarly, changes made
+           through the array after a ModelSnapshot or Configuration is
+           taken or restored may not be seen by the next one; get the
+           array again after that.
         """
         return _get_ints_numpy(self, k, self)
 
@@ -24,6 +24,10 @@ Model::Model(std::string name)
   saved_dependencies_age_ = 0;
   dependencies_saved_ = false;
   moved_particles_cache_age_ = 0;
+  score_state_critical_path_length_ = 0;
+  score_state_critical_path_time_ = 0.;
+  score_state_update_time_ = 0.;
+  score_state_timing_ = false;
   unique_id_ = model_map_.add_new_model(this);
 #if IMP_HAS_CHECKS >= IMP_INTERNAL
   internal::FloatAttributeTable::set_masks(
@@ -0,0 +1,79 @@
+/**
+ *  \file ModelSnapshot.cpp
+ *  \brief A saved copy of the attributes of a Model.
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ *
+ */
+
+#include "IMP/ModelSnapshot.h"
+
+IMPKERNEL_BEGIN_NAMESPACE
+
+#define IMP_SNAPSHOT_FOREACH(OPERATION)     \
+  OPERATION(floats, Float);                 \
+  OPERATION(float_lists, Floats);           \
+  OPERATION(strings, String);               \
+  OPERATION(ints, Int);                     \
+  OPERATION(objects, Object);               \
+  OPERATION(weak_objects, WeakObject);      \
+  OPERATION(int_lists, Ints);               \
+  OPERATION(object_lists, Objects);         \
+  OPERATION(particles, Particle);           \
+  OPERATION(particle_lists, Particles);     \
+  OPERATION(sparse_strings, SparseString);  \
+  OPERATION(sparse_ints, SparseInt);        \
+  OPERATION(sparse_floats, SparseFloat);    \
+  OPERATION(sparse_particles, SparseParticle)
+
+namespace internal {
+struct ModelSnapshotData {
+#define IMP_SNAPSHOT_MEMBER(name, Name) Name##AttributeTable::Snapshot name
+  IMP_SNAPSHOT_FOREACH(IMP_SNAPSHOT_MEMBER);
+};
+}
+
+ModelSnapshot *Model::create_snapshot(ModelSnapshot *base) {
+  IMP_OBJECT_LOG;
+  std::shared_ptr<const internal::ModelSnapshotData> base_data;
+  if (base) {
+    IMP_USAGE_CHECK(base->get_model() == this,
+                    "Base snapshot is of a different model");
+    base_data = base->data_;
+  } else {
+    base_data = last_snapshot_.lock();
+  }
+  // the tables know which pages were written since the model last
+  // matched a snapshot, so only those need comparing against it
+  bool use_dirty = base_data && base_data == last_snapshot_.lock();
+  std::shared_ptr<internal::ModelSnapshotData> data =
+      std::make_shared<internal::ModelSnapshotData>();
+  unsigned copied = 0;
+#define IMP_SNAPSHOT_CAPTURE(name, Name)                             \
+  copied += internal::Name##AttributeTable::capture_snapshot(        \
+      data->name, base_data ? &base_data->name : nullptr, use_dirty)
+  IMP_SNAPSHOT_FOREACH(IMP_SNAPSHOT_CAPTURE);
+  IMP_LOG_VERBOSE("Snapshot copied " << copied << " pages" << std::endl);
+  last_snapshot_ = data;
+  return new ModelSnapshot(this, data, copied);
+}
+
+void Model::restore_snapshot(ModelSnapshot *s) {
+  IMP_OBJECT_LOG;
+  IMP_USAGE_CHECK(s->get_model() == this,
+                  "Snapshot is of a different model");
+  IMP_USAGE_CHECK(cur_stage_ == internal::NOT_EVALUATING,
+                  "Cannot restore a snapshot during evaluation");
+  // pages that were not written since the model matched last are
+  // skipped if s shares them with last
+  std::shared_ptr<const internal::ModelSnapshotData> last =
+      last_snapshot_.lock();
+#define IMP_SNAPSHOT_RESTORE(name, Name)                 \
+  internal::Name##AttributeTable::restore_snapshot(      \
+      s->data_->name, last ? &last->name : nullptr)
+  IMP_SNAPSHOT_FOREACH(IMP_SNAPSHOT_RESTORE);
+  // the model now matches s, so share pages with it next time
+  last_snapshot_ = s->data_;
+}
+
+IMPKERNEL_END_NAMESPACE
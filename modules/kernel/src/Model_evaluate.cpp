@@ -19,11 +19,44 @@
 #include <IMP/CreateLogContext.h>
 #include <IMP/thread_macros.h>
 #include <IMP/internal/static.h>
+#include <algorithm>
 #include <numeric>
 
 IMPKERNEL_BEGIN_NAMESPACE
 
 namespace {
+struct SlowerStatistics {
+  bool operator()(const EvaluationStatistics &a,
+                  const EvaluationStatistics &b) const {
+    return a.get_time() > b.get_time();
+  }
+};
+
+void write_json_string(std::ostream &out, const std::string &str) {
+  out << '"';
+  for (char c : str) {
+    switch (c) {
+      case '"':
+        out << "\\\"";
+        break;
+      case '\\':
+        out << "\\\\";
+        break;
+      case '\n':
+        out << "\\n";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          out << "\\u00" << "0123456789abcdef"[c >> 4]
+              << "0123456789abcdef"[c & 0xf];
+        } else {
+          out << c;
+        }
+    }
+  }
+  out << '"';
+}
+
 void check_order(const ScoreStatesTemp &ss) {
   for (unsigned int i = 1; i < ss.size(); ++i) {
     IMP_USAGE_CHECK(ss[i - 1]->get_update_order() <= ss[i]->get_update_order(),
@@ -63,47 +96,54 @@ void Model::before_evaluate(const ScoreStatesTemp &states) {
   }
   internal::SFSetIt<IMP::internal::Stage> reset(
       &cur_stage_, internal::BEFORE_EVALUATING);
-  unsigned int cur_begin = 0;
-  while (cur_begin < states.size()) {
-    unsigned int cur_end = cur_begin + 1;
-    while (cur_end < states.size() && states[cur_begin]->get_update_order() ==
-                                          states[cur_end]->get_update_order()) {
-      ++cur_end;
-    }
-    for (unsigned int i = cur_begin; i < cur_end; ++i) {
-      ScoreState *ss = states[i];
+  if (first_call_) {
+    for (ScoreState *ss : states) {
       IMP_CHECK_OBJECT(ss);
       IMP_LOG_TERSE("Updating \"" << ss->get_name() << "\"" << std::endl);
-      if (first_call_) {
-        try {
+      try {
 #if IMP_HAS_CHECKS >= IMP_INTERNAL
-          internal::SFResetBitset rbr(Masks::read_mask_, true);
-          internal::SFResetBitset rbw(Masks::write_mask_, true);
-          internal::SFResetBitset rbar(Masks::add_remove_mask_, true);
-          internal::SFResetBitset rbrd(Masks::read_derivatives_mask_, true);
-          internal::SFResetBitset rbwd(Masks::write_derivatives_mask_, true);
-          ModelObjects inputs = ss->get_inputs();
-          ModelObjects outputs = ss->get_outputs();
-          Masks::read_derivatives_mask_.reset();
-          Masks::write_derivatives_mask_.reset();
-          IMP_SF_SET_ONLY_2(Masks::read_mask_, inputs, outputs);
-          IMP_SF_SET_ONLY(Masks::write_mask_, outputs);
-          IMP_SF_SET_ONLY(Masks::add_remove_mask_, outputs);
-          SetNumberOfThreads nt(1);
+        internal::SFResetBitset rbr(Masks::read_mask_, true);
+        internal::SFResetBitset rbw(Masks::write_mask_, true);
+        internal::SFResetBitset rbar(Masks::add_remove_mask_, true);
+        internal::SFResetBitset rbrd(Masks::read_derivatives_mask_, true);
+        internal::SFResetBitset rbwd(Masks::write_derivatives_mask_, true);
+        ModelObjects inputs = ss->get_inputs();
+        ModelObjects outputs = ss->get_outputs();
+        Masks::read_derivatives_mask_.reset();
+        Masks::write_derivatives_mask_.reset();
+        IMP_SF_SET_ONLY_2(Masks::read_mask_, inputs, outputs);
+        IMP_SF_SET_ONLY(Masks::write_mask_, outputs);
+        IMP_SF_SET_ONLY(Masks::add_remove_mask_, outputs);
+        SetNumberOfThreads nt(1);
 #endif
-          ss->before_evaluate();
-        }
-        catch (const internal::InputOutputException &d) {
-          IMP_FAILURE(d.get_message(ss));
-        }
-      } else {
-        IMP_TASK((ss), ss->before_evaluate(), "before evaluate");
+        ss->before_evaluate();
+      }
+      catch (const internal::InputOutputException &d) {
+        IMP_FAILURE(d.get_message(ss));
       }
     }
-    IMP_OMP_PRAGMA(taskwait)
+  } else {
+    // Rather than waiting for all states of one update order before
+    // starting the next, start each state once its inputs are ready
+    std::shared_ptr<const internal::ScoreStateSchedule> schedule =
+        score_state_schedules_.get(states, dependencies_age_);
+    // states are only timed on request
+    internal::ScoreStateScheduleTimes times;
+    internal::ScoreStateScheduleTimes *ptimes =
+        score_state_timing_ ? &times : nullptr;
+    schedule->run([](ScoreState *ss) {
+      IMP_LOG_TERSE("Updating \"" << ss->get_name() << "\"" << std::endl);
+      ss->before_evaluate();
+    }, false, get_number_of_threads() > 1, ptimes);
     IMP_OMP_PRAGMA(flush)
-    cur_begin = cur_end;
-    // IMP_LOG_VERBOSE( "." << std::flush);
+    score_state_critical_path_length_ = schedule->get_critical_path_length();
+    score_state_critical_path_time_ = times.critical_path_time;
+    score_state_update_time_ = times.total_time;
+    IMP_LOG_TERSE("Score state critical path is "
+                  << schedule->get_critical_path_length()
+                  << " of " << states.size() << " states, "
+                  << times.critical_path_time << "s of "
+                  << times.total_time << "s" << std::endl);
   }
 }
 
@@ -115,71 +155,87 @@ void Model::after_evaluate(const ScoreStatesTemp &istates,
   DerivativeAccumulator accum;
   internal::SFSetIt<IMP::internal::Stage> reset(
       &cur_stage_, internal::AFTER_EVALUATING);
-  unsigned int cur_begin = 0;
-  ScoreStatesTemp states = istates;
-  std::reverse(states.begin(), states.end());
-  while (cur_begin < states.size()) {
-    unsigned int cur_end = cur_begin + 1;
-    while (cur_end < states.size() && states[cur_begin]->get_update_order() ==
-                                          states[cur_end]->get_update_order()) {
-      IMP_CHECK_OBJECT(states[cur_end]);
-      ++cur_end;
-    }
-    for (unsigned int i = cur_begin; i < cur_end; ++i) {
-      ScoreState *ss = states[i];
+  if (first_call_) {
+    for (auto it = istates.rbegin(); it != istates.rend(); ++it) {
+      ScoreState *ss = *it;
       IMP_CHECK_OBJECT(ss);
-      if (first_call_) {
-        try {
+      try {
 #if IMP_HAS_CHECKS >= IMP_INTERNAL
-          internal::SFResetBitset rbr(Masks::read_mask_, true);
-          internal::SFResetBitset rbw(Masks::write_mask_, true);
-          internal::SFResetBitset rbar(Masks::add_remove_mask_, true);
-          internal::SFResetBitset rbrd(Masks::read_derivatives_mask_, true);
-          internal::SFResetBitset rbwd(Masks::write_derivatives_mask_, true);
-          ModelObjects inputs = ss->get_inputs();
-          ModelObjects outputs = ss->get_outputs();
-          Masks::write_mask_.reset();
-          IMP_SF_SET_ONLY_2(Masks::read_mask_, inputs, outputs);
-          IMP_SF_SET_ONLY_2(Masks::read_derivatives_mask_, inputs, outputs);
-          IMP_SF_SET_ONLY_2(Masks::write_derivatives_mask_, inputs, outputs);
-          SetNumberOfThreads nt(1);
-#endif
-          ss->after_evaluate(calc_derivs ? &accum : nullptr);
-        }
-        catch (const internal::InputOutputException &d) {
-          IMP_FAILURE(d.get_message(ss));
-        }
-      } else {
-/* gcc 9 requires that we make calc_derivs a shared variable so each task
-   can see it. gcc 8 automatically shares const variables and reports an error
-   if we try to explicitly share one. The same is true for clang 10 vs 9. */
-#if defined(__clang__)
-#if __clang_major__ >= 10
-        IMP_TASK_SHARED((ss, accum), (calc_derivs),
-                 ss->after_evaluate(calc_derivs ? &accum : nullptr),
-                 "after evaluate");
-#else
-        IMP_TASK((ss, accum),
-                 ss->after_evaluate(calc_derivs ? &accum : nullptr),
-                 "after evaluate");
-#endif
-#else
-#if defined(__GNUC__) && __GNUC__ >= 9
-        IMP_TASK_SHARED((ss, accum), (calc_derivs),
-                 ss->after_evaluate(calc_derivs ? &accum : nullptr),
-                 "after evaluate");
-#else
-        IMP_TASK((ss, accum),
-                 ss->after_evaluate(calc_derivs ? &accum : nullptr),
-                 "after evaluate");
-#endif
+        internal::SFResetBitset rbr(Masks::read_mask_, true);
+        internal::SFResetBitset rbw(Masks::write_mask_, true);
+        internal::SFResetBitset rbar(Masks::add_remove_mask_, true);
+        internal::SFResetBitset rbrd(Masks::read_derivatives_mask_, true);
+        internal::SFResetBitset rbwd(Masks::write_derivatives_mask_, true);
+        ModelObjects inputs = ss->get_inputs();
+        ModelObjects outputs = ss->get_outputs();
+        Masks::write_mask_.reset();
+        IMP_SF_SET_ONLY_2(Masks::read_mask_, inputs, outputs);
+        IMP_SF_SET_ONLY_2(Masks::read_derivatives_mask_, inputs, outputs);
+        IMP_SF_SET_ONLY_2(Masks::write_derivatives_mask_, inputs, outputs);
+        SetNumberOfThreads nt(1);
 #endif
+        ss->after_evaluate(calc_derivs ? &accum : nullptr);
+      }
+      catch (const internal::InputOutputException &d) {
+        IMP_FAILURE(d.get_message(ss));
       }
     }
-    IMP_OMP_PRAGMA(taskwait)
+  } else {
+    // each state runs after all of the states that depend on it
+    std::shared_ptr<const internal::ScoreStateSchedule> schedule =
+        score_state_schedules_.get(istates, dependencies_age_);
+    DerivativeAccumulator *da = calc_derivs ? &accum : nullptr;
+    schedule->run([da](ScoreState *ss) {
+      ss->after_evaluate(da);
+    }, true, get_number_of_threads() > 1);
     IMP_OMP_PRAGMA(flush)
-    cur_begin = cur_end;
   }
 }
 
+EvaluationStatisticsList Model::get_evaluation_statistics() const {
+  EvaluationStatisticsList ret;
+#if IMP_KERNEL_HAS_EVALUATION_STATISTICS
+  for (const auto &node : dependency_graph_) {
+    const internal::EvaluationCounters &c =
+        node.first->access_evaluation_counters();
+    if (c.calls > 0) {
+      ret.push_back(EvaluationStatistics(
+          const_cast<ModelObject *>(node.first), c.calls, c.time,
+          static_cast<double>(c.cycles), c.derivative_writes));
+    }
+  }
+  std::sort(ret.begin(), ret.end(), SlowerStatistics());
+#endif
+  return ret;
+}
+
+void Model::clear_evaluation_statistics() {
+#if IMP_KERNEL_HAS_EVALUATION_STATISTICS
+  for (const auto &node : dependency_graph_) {
+    node.first->access_evaluation_counters().clear();
+  }
+#endif
+}
+
+void Model::write_evaluation_statistics(TextOutput out) const {
+  std::ostream &os = out;
+  EvaluationStatisticsList stats = get_evaluation_statistics();
+  os << "[";
+  for (unsigned int i = 0; i < stats.size(); ++i) {
+    ModelObject *mo = stats[i].get_model_object();
+    os << (i > 0 ? ",\n " : "\n ") << "{\"name\": ";
+    write_json_string(os, mo->get_name());
+    os << ", \"type\": ";
+    write_json_string(os, mo->get_type_name());
+    os << ", \"kind\": \""
+       << (dynamic_cast<ScoreState *>(mo) ? "ScoreState" : "Restraint")
+       << "\", \"calls\": " << stats[i].get_number_of_calls()
+       << ", \"time\": " << stats[i].get_time()
+       << ", \"cycles\": " << stats[i].get_number_of_cycles()
+       << ", \"derivative_writes\": "
+       << stats[i].get_number_of_derivative_writes() << "}";
+  }
+  os << "\n]\n";
+}
+
 IMPKERNEL_END_NAMESPACE
@@ -14,6 +14,7 @@
 #include "IMP/container_base.h"
 #include "IMP/ScoringFunction.h"
 #include "IMP/internal/utility.h"
+#include "IMP/internal/ArenaAllocator.h"
 #include "IMP/warning_macros.h"
 #include <IMP/thread_macros.h>
 #include "IMP/input_output.h"
@@ -28,11 +29,11 @@ const double BAD_SCORE = NO_MAX;
 
 Restraint::Restraint(Model *m, std::string name)
     : ModelObject(m, name), is_aggregate_(false), weight_(1), max_(NO_MAX),
-      last_score_(BAD_SCORE), last_last_score_(BAD_SCORE) {}
+      task_cost_(1.), last_score_(BAD_SCORE), last_last_score_(BAD_SCORE) {}
 
 Restraint::Restraint()
     : ModelObject(), is_aggregate_(false), weight_(1), max_(NO_MAX),
-      last_score_(BAD_SCORE), last_last_score_(BAD_SCORE) {}
+      task_cost_(1.), last_score_(BAD_SCORE), last_last_score_(BAD_SCORE) {}
 
 double Restraint::evaluate(bool calc_derivs) const {
   IMP_OBJECT_LOG;
@@ -270,6 +271,13 @@ void Restraint::do_add_score_and_derivatives_moved(
   }
 }
 
+void Restraint::do_evaluate_batch(const ParticleIndexes &,
+                                  const FloatsList &, unsigned int,
+                                  unsigned int, Floats &) const {
+  IMP_FAILURE("Restraint " << get_name()
+                           << " does not support batch evaluation");
+}
+
 double Restraint::get_score() const { return evaluate(false); }
 
 void Restraint::add_score_and_derivatives(ScoreAccumulator sa) const {
@@ -278,8 +286,9 @@ void Restraint::add_score_and_derivatives(ScoreAccumulator sa) const {
   ScoreAccumulator nsa(sa, this);
   validate_inputs();
   validate_outputs();
-  IMP_TASK((nsa), do_add_score_and_derivatives(nsa),
-           "add score and derivatives");
+  const Restraint *self = this;
+  IMP_TASK_WITH_COST((nsa, self), self->run_add_score_and_derivatives(nsa),
+                     "add score and derivatives", task_cost_);
   set_was_used(true);
 }
 
@@ -291,10 +300,26 @@ void Restraint::add_score_and_derivatives_moved(
   ScoreAccumulator nsa(sa, this);
   validate_inputs();
   validate_outputs();
-  IMP_TASK_SHARED((nsa), (moved_pis, reset_pis),
-                  do_add_score_and_derivatives_moved(nsa, moved_pis, reset_pis),
-                  "add score and derivatives");
+  IMP_TASK_SHARED_WITH_COST(
+      (nsa), (moved_pis, reset_pis),
+      run_add_score_and_derivatives_moved(nsa, moved_pis, reset_pis),
+      "add score and derivatives", task_cost_);
   set_was_used(true);
 }
 
+// These are usually run as tasks, possibly on another thread
+void Restraint::run_add_score_and_derivatives(ScoreAccumulator sa) const {
+  internal::ArenaScope arena;
+  IMP_EVALUATION_TIMER(access_evaluation_counters());
+  do_add_score_and_derivatives(sa);
+}
+
+void Restraint::run_add_score_and_derivatives_moved(
+                ScoreAccumulator sa, const ParticleIndexes &moved_pis,
+                const ParticleIndexes &reset_pis) const {
+  internal::ArenaScope arena;
+  IMP_EVALUATION_TIMER(access_evaluation_counters());
+  do_add_score_and_derivatives_moved(sa, moved_pis, reset_pis);
+}
+
 IMPKERNEL_END_NAMESPACE
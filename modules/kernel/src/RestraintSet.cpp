@@ -58,7 +58,7 @@ void RestraintSet::do_add_score_and_derivatives(ScoreAccumulator sa) const {
     get_restraint(i)->add_score_and_derivatives(sa);
   }
   // for child tasks
-  IMP_OMP_PRAGMA(taskwait)
+  IMP_TASKWAIT
 }
 
 namespace {
@@ -157,7 +157,7 @@ void RestraintSet::do_add_score_and_derivatives_moved(
     }
   }
   // for child tasks
-  IMP_OMP_PRAGMA(taskwait)
+  IMP_TASKWAIT
 }
 
 double RestraintSet::get_last_score() const {
@@ -21,12 +21,14 @@ static const std::string str_before_evaluate("before_evaluate");
 static const std::string str_after_evaluate("after_evaluate");
 
 ScoreState::ScoreState(Model *m, std::string name)
-    : ModelObject(m, name), update_order_(-1), can_skip_(false) {}
+    : ModelObject(m, name), update_order_(-1), can_skip_(false),
+      task_cost_(1.) {}
 
 void ScoreState::before_evaluate() {
   IMP_OBJECT_LOG;
   validate_inputs();
   validate_outputs();
+  IMP_EVALUATION_TIMER(access_evaluation_counters());
   do_before_evaluate();
 }
 
@@ -34,6 +36,7 @@ void ScoreState::after_evaluate(DerivativeAccumulator *da) {
   IMP_OBJECT_LOG;
   validate_inputs();
   validate_outputs();
+  IMP_EVALUATION_TIMER(access_evaluation_counters());
   do_after_evaluate(da);
 }
 
@@ -8,11 +8,17 @@
 
 #include "IMP/ScoringFunction.h"
 #include "IMP/Model.h"
+#include "IMP/ModelSnapshot.h"
+#include "IMP/RestraintSet.h"
 #include "IMP/internal/evaluate_utility.h"
 #include "IMP/internal/scoring_functions.h"
 #include "IMP/internal/utility.h"
+#include "IMP/internal/ArenaAllocator.h"
 #include "IMP/generic.h"
 #include "IMP/utility.h"
+#include "IMP/thread_macros.h"
+#include "IMP/threads.h"
+#include <algorithm>
 
 IMPKERNEL_BEGIN_NAMESPACE
 
@@ -52,6 +58,7 @@ ScoringFunction::ScoringFunction() : moved_particles_cache_(nullptr) {
 
 double ScoringFunction::evaluate_if_good(bool derivatives) {
   IMP_OBJECT_LOG;
+  internal::ArenaScope arena;
   set_was_used(true);
   set_has_required_score_states(true);
   es_.score = 0;
@@ -63,6 +70,8 @@ double ScoringFunction::evaluate_if_good(bool derivatives) {
 
 double ScoringFunction::evaluate(bool derivatives) {
   IMP_OBJECT_LOG;
+  // temporaries created while evaluating are freed on return
+  internal::ArenaScope arena;
   set_was_used(true);
   set_has_required_score_states(true);
   es_.score = 0;
@@ -73,10 +82,13 @@ double ScoringFunction::evaluate(bool derivatives) {
 }
 
 namespace {
+typedef std::set<ScoreState *, std::less<ScoreState *>,
+                 internal::ArenaAllocator<ScoreState *> > ScoreStateSet;
+
 class should_skip_score_state {
-  const std::set<ScoreState *> &needed_ss_;
+  const ScoreStateSet &needed_ss_;
 public:
-  should_skip_score_state(const std::set<ScoreState *> &needed_ss)
+  should_skip_score_state(const ScoreStateSet &needed_ss)
        : needed_ss_(needed_ss) {}
 
   bool operator()(const ScoreState *ss) {
@@ -98,7 +110,7 @@ ScoreStatesTemp ScoringFunction::get_moved_required_score_states(
     }
     set_has_required_score_states(true);
     ScoreStatesTemp allss = get_required_score_states();
-    std::set<ScoreState *> sset;
+    ScoreStateSet sset;
     if (moved_pis.size() == 1) {
       const std::set<ScoreState *> &moved_set =
             moved_particles_cache_.get_affected_score_states(moved_pis[0]);
@@ -125,6 +137,7 @@ double ScoringFunction::evaluate_moved(bool derivatives,
                                        const ParticleIndexes &moved_pis,
                                        const ParticleIndexes &reset_pis) {
   IMP_OBJECT_LOG;
+  internal::ArenaScope arena;
   set_was_used(true);
   es_.score = 0;
   es_.good = true;
@@ -140,6 +153,7 @@ double ScoringFunction::evaluate_moved_if_below(bool derivatives,
                                        const ParticleIndexes &reset_pis,
                                        double max) {
   IMP_OBJECT_LOG;
+  internal::ArenaScope arena;
   set_was_used(true);
   es_.score = 0;
   es_.good = true;
@@ -154,6 +168,7 @@ double ScoringFunction::evaluate_moved_if_good(bool derivatives,
                                        const ParticleIndexes &moved_pis,
                                        const ParticleIndexes &reset_pis) {
   IMP_OBJECT_LOG;
+  internal::ArenaScope arena;
   set_was_used(true);
   es_.score = 0;
   es_.good = true;
@@ -166,6 +181,7 @@ double ScoringFunction::evaluate_moved_if_good(bool derivatives,
 
 double ScoringFunction::evaluate_if_below(bool derivatives, double max) {
   IMP_OBJECT_LOG;
+  internal::ArenaScope arena;
   set_was_used(true);
   set_has_required_score_states(true);
   es_.score = 0;
@@ -175,6 +191,169 @@ double ScoringFunction::evaluate_if_below(bool derivatives, double max) {
   return es_.score;
 }
 
+namespace {
+/* Split r into restraints that can score a whole batch themselves (with
+   the total weight of each) and the rest, which are wrapped in
+   RestraintSets to keep the weights and maximum scores of any sets they
+   were in. weight and max are those a ScoreAccumulator would have on
+   reaching r. */
+void get_batch_restraints(Restraint *r, double weight, double max,
+                          RestraintsTemp &batched, Floats &batched_weights,
+                          Restraints &others) {
+  RestraintSet *rs = dynamic_cast<RestraintSet *>(r);
+  if (rs) {
+    double rs_weight = weight * rs->get_weight();
+    double rs_max = rs_weight == 0 ? NO_MAX
+                        : std::min(max / rs_weight, rs->get_maximum_score());
+    for (RestraintSet::RestraintIterator it = rs->restraints_begin();
+         it != rs->restraints_end(); ++it) {
+      get_batch_restraints(*it, rs_weight, rs_max, batched, batched_weights,
+                           others);
+    }
+    return;
+  }
+  r->set_has_required_score_states(true);
+  if (r->get_has_batch_evaluation() &&
+      r->get_required_score_states().empty()) {
+    batched.push_back(r);
+    batched_weights.push_back(weight * r->get_weight());
+  } else if (weight == 1.0 && max == NO_MAX) {
+    others.push_back(r);
+  } else {
+    IMP_NEW(RestraintSet, wrapper, (RestraintsTemp(1, r), weight,
+                                    r->get_name() + " batch weight"));
+    wrapper->set_maximum_score(max);
+    others.push_back(wrapper);
+  }
+}
+
+// Restore the Model's attributes on leaving the scope, even on error
+class SFRestoreSnapshot {
+  Model *m_;
+  Pointer<ModelSnapshot> saved_;
+
+ public:
+  SFRestoreSnapshot(Model *m) : m_(m), saved_(m->create_snapshot()) {}
+  ~SFRestoreSnapshot() { m_->restore_snapshot(saved_); }
+};
+
+void evaluate_batch_range(const Restraint *r, const ParticleIndexes *pis,
+                          const FloatsList *coordinates_batch,
+                          unsigned int begin, unsigned int end,
+                          Floats *scores) {
+  r->evaluate_batch(*pis, *coordinates_batch, begin, end, *scores);
+}
+
+// Score each batch restraint on chunks of the configurations as tasks
+void evaluate_batch_restraints(const RestraintsTemp *batched,
+                               const ParticleIndexes *pis,
+                               const FloatsList *coordinates_batch,
+                               Vector<Floats> *scores) {
+  unsigned int num = coordinates_batch->size();
+  unsigned int chunk =
+      std::max(1U, num / (4 * IMP::get_number_of_threads()));
+  for (unsigned int i = 0; i < batched->size(); ++i) {
+    const Restraint *r = (*batched)[i];
+    Floats *rscores = &(*scores)[i];
+    for (unsigned int begin = 0; begin < num; begin += chunk) {
+      unsigned int end = std::min(num, begin + chunk);
+      IMP_TASK((r, pis, coordinates_batch, begin, end, rscores),
+               evaluate_batch_range(r, pis, coordinates_batch, begin, end,
+                                    rscores),
+               "evaluate batch");
+    }
+  }
+  IMP_TASKWAIT;
+}
+}
+
+Floats ScoringFunction::evaluate_batch(const ParticleIndexes &pis,
+                                       const FloatsList &coordinates_batch,
+                                       bool derivatives) {
+  IMP_OBJECT_LOG;
+  set_was_used(true);
+  set_has_required_score_states(true);
+  Model *m = get_model();
+  unsigned int num = coordinates_batch.size();
+  IMP_IF_CHECK(USAGE) {
+    for (unsigned int k = 0; k < num; ++k) {
+      IMP_USAGE_CHECK(coordinates_batch[k].size() == 3 * pis.size(),
+                      "Configuration " << k << " has "
+                          << coordinates_batch[k].size()
+                          << " coordinates but there are " << pis.size()
+                          << " particles");
+    }
+  }
+  Floats scores(num, 0.);
+  batch_derivatives_.clear();
+  if (num == 0) return scores;
+
+  // keep the restraints alive while they are used
+  Restraints rs;
+  RestraintsTemp batched;
+  Floats batched_weights;
+  Restraints others;
+  if (!derivatives) {
+    rs = create_restraints();
+    for (unsigned int i = 0; i < rs.size(); ++i) {
+      get_batch_restraints(rs[i], 1.0, NO_MAX, batched, batched_weights,
+                           others);
+    }
+  }
+
+  if (!batched.empty()) {
+    Vector<Floats> batched_scores(batched.size(), Floats(num, 0.));
+    const RestraintsTemp *batchedp = &batched;
+    const ParticleIndexes *pisp = &pis;
+    const FloatsList *coordinatesp = &coordinates_batch;
+    Vector<Floats> *scoresp = &batched_scores;
+    if (internal::get_is_in_parallel_region()) {
+      evaluate_batch_restraints(batchedp, pisp, coordinatesp, scoresp);
+    } else {
+      IMP_THREADS((batchedp, pisp, coordinatesp, scoresp),
+                  evaluate_batch_restraints(batchedp, pisp, coordinatesp,
+                                            scoresp));
+    }
+    for (unsigned int i = 0; i < batched.size(); ++i) {
+      for (unsigned int k = 0; k < num; ++k) {
+        scores[k] += batched_weights[i] * batched_scores[i][k];
+      }
+    }
+    if (others.empty()) return scores;
+  }
+
+  // Everything else is scored by setting each configuration in turn
+  PointerMember<ScoringFunction> sf;
+  if (batched.empty()) {
+    sf = this;
+  } else {
+    sf = new internal::RestraintsScoringFunction(
+        RestraintsTemp(others.begin(), others.end()), 1.0, NO_MAX,
+        get_name() + " batch");
+  }
+  SFRestoreSnapshot restore(m);
+  if (derivatives) {
+    batch_derivatives_.resize(num, Floats(3 * pis.size()));
+  }
+  for (unsigned int k = 0; k < num; ++k) {
+    for (unsigned int i = 0; i < pis.size(); ++i) {
+      for (unsigned int j = 0; j < 3; ++j) {
+        m->set_attribute(FloatKey(j), pis[i], coordinates_batch[k][3 * i + j]);
+      }
+    }
+    scores[k] += sf->evaluate(derivatives);
+    if (derivatives) {
+      for (unsigned int i = 0; i < pis.size(); ++i) {
+        for (unsigned int j = 0; j < 3; ++j) {
+          batch_derivatives_[k][3 * i + j] =
+              m->get_derivative(FloatKey(j), pis[i]);
+        }
+      }
+    }
+  }
+  return scores;
+}
+
 ScoringFunction *ScoringFunctionAdaptor::get(const RestraintsTemp &sf) {
   if (!sf.empty()) {
     return new internal::RestraintsScoringFunction(sf);
@@ -0,0 +1,390 @@
+/**
+ *  \file TaskExecutor.cpp
+ *  \brief Control how tasks created by IMP_TASK are run.
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ *
+ */
+
+#include "IMP/TaskExecutor.h"
+#include "IMP/Pointer.h"
+#include "IMP/check_macros.h"
+#include "IMP/thread_macros.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+IMPKERNEL_BEGIN_NAMESPACE
+
+/* Queue i belongs to thread i of the pool; queue 0 is used by the
+   thread that called run_parallel(), which holds the executor's region
+   mutex so that no other application thread uses it at the same time.
+   The pool is only ever grown; a
+   parallel region with fewer threads leaves the extra workers idle, so
+   thread indexes are always less than the requested number of threads. */
+class WorkStealingTaskExecutor::Pool {
+ public:
+  // Count of the outstanding child tasks of a task
+  struct TaskGroup {
+    std::atomic<int> pending;
+    TaskGroup() : pending(0) {}
+  };
+
+  struct Task {
+    std::function<void()> function;
+    TaskGroup *group;
+  };
+
+ private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+  std::vector<std::unique_ptr<Queue> > queues_;
+  std::vector<std::thread> threads_;
+  // total number of tasks in all queues
+  std::atomic<int> num_queued_;
+  // number of threads taking part in the current parallel region
+  std::atomic<unsigned int> num_active_;
+  std::mutex sleep_mutex_;
+  // signalled when a task is queued or a task group finishes
+  std::condition_variable wake_;
+  // signalled when the number of active threads changes
+  std::condition_variable activate_;
+  bool stop_;
+  std::mutex error_mutex_;
+  std::exception_ptr error_;
+
+  // Get the next task for thread i; our own newest task if we have one,
+  // otherwise the oldest task of another thread
+  bool get_task(unsigned int i, Task &task) {
+    if (num_queued_.load() == 0) return false;
+    {
+      Queue &q = *queues_[i];
+      std::lock_guard<std::mutex> lock(q.mutex);
+      if (!q.tasks.empty()) {
+        task = std::move(q.tasks.back());
+        q.tasks.pop_back();
+        --num_queued_;
+        return true;
+      }
+    }
+    unsigned int num_active = num_active_.load();
+    for (unsigned int j = 1; j < num_active; ++j) {
+      Queue &q = *queues_[(i + j) % num_active];
+      std::lock_guard<std::mutex> lock(q.mutex);
+      if (!q.tasks.empty()) {
+        task = std::move(q.tasks.front());
+        q.tasks.pop_front();
+        --num_queued_;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void run_worker(unsigned int i) {
+    current_pool = this;
+    current_index = i;
+    while (true) {
+      Task task;
+      if (i < num_active_.load() && get_task(i, task)) {
+        execute(i, task);
+      } else {
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        if (i >= num_active_.load()) {
+          activate_.wait(lock,
+                         [this, i] { return stop_ || i < num_active_.load(); });
+        } else {
+          wake_.wait(lock, [this, i] {
+            return stop_ || num_queued_.load() > 0 || i >= num_active_.load();
+          });
+        }
+        if (stop_) break;
+      }
+    }
+    current_pool = nullptr;
+  }
+
+ public:
+  // The pool, thread index and task group of the calling thread
+  static thread_local Pool *current_pool;
+  static thread_local unsigned int current_index;
+  static thread_local TaskGroup *current_group;
+
+  Pool(unsigned int num_threads)
+      : num_queued_(0), num_active_(num_threads), stop_(false) {
+    for (unsigned int i = 0; i < num_threads; ++i) {
+      queues_.push_back(std::unique_ptr<Queue>(new Queue()));
+    }
+    for (unsigned int i = 1; i < num_threads; ++i) {
+      threads_.push_back(std::thread(&Pool::run_worker, this, i));
+    }
+  }
+
+  ~Pool() {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    activate_.notify_all();
+    for (unsigned int i = 0; i < threads_.size(); ++i) {
+      threads_[i].join();
+    }
+  }
+
+  unsigned int get_number_of_threads() const { return queues_.size(); }
+
+  //! Use only the first num_threads threads until the next call
+  void set_number_of_active_threads(unsigned int num_threads) {
+    if (num_threads == num_active_.load()) return;
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      num_active_ = num_threads;
+    }
+    // workers that are no longer active move from wake_ to activate_
+    wake_.notify_all();
+    activate_.notify_all();
+  }
+
+  void push(unsigned int i, Task task) {
+    {
+      Queue &q = *queues_[i];
+      std::lock_guard<std::mutex> lock(q.mutex);
+      q.tasks.push_back(std::move(task));
+    }
+    ++num_queued_;
+    {
+      // make sure a worker going to sleep sees the new task
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+    }
+    wake_.notify_one();
+  }
+
+  //! Run the task, then wait for any tasks it created
+  void execute(unsigned int i, Task &task) {
+    TaskGroup children;
+    TaskGroup *parent = current_group;
+    current_group = &children;
+    try {
+      task.function();
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(error_mutex_);
+      if (!error_) error_ = std::current_exception();
+    }
+    wait(i, &children);
+    current_group = parent;
+    // the group may be destroyed as soon as pending reaches zero
+    if (--task.group->pending == 0) {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      wake_.notify_all();
+    }
+  }
+
+  //! Help run queued tasks until all tasks in the group have finished
+  /** If there is nothing to run, sleep until a task is queued or the
+      last task in the group finishes. */
+  void wait(unsigned int i, TaskGroup *group) {
+    while (group->pending.load() > 0) {
+      Task task;
+      if (get_task(i, task)) {
+        execute(i, task);
+      } else {
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        wake_.wait(lock, [this, group] {
+          return group->pending.load() == 0 || num_queued_.load() > 0;
+        });
+      }
+    }
+  }
+
+  //! Rethrow the first exception thrown by any task
+  void rethrow_error() {
+    std::exception_ptr error;
+    {
+      std::lock_guard<std::mutex> lock(error_mutex_);
+      std::swap(error, error_);
+    }
+    if (error) std::rethrow_exception(error);
+  }
+};
+
+thread_local WorkStealingTaskExecutor::Pool
+    *WorkStealingTaskExecutor::Pool::current_pool = nullptr;
+thread_local unsigned int WorkStealingTaskExecutor::Pool::current_index = 0;
+thread_local WorkStealingTaskExecutor::Pool::TaskGroup
+    *WorkStealingTaskExecutor::Pool::current_group = nullptr;
+
+WorkStealingTaskExecutor::WorkStealingTaskExecutor(std::string name)
+    : TaskExecutor(name), minimum_task_cost_(0.) {}
+
+void WorkStealingTaskExecutor::run_parallel(
+    const std::function<void()> &action, unsigned int num_threads) {
+  if (Pool::current_pool) {
+    // no nested parallelism
+    action();
+    return;
+  }
+  std::lock_guard<std::mutex> lock(region_mutex_);
+  if (!pool_ || pool_->get_number_of_threads() < num_threads) {
+    pool_.reset();
+    pool_ = std::make_shared<Pool>(num_threads);
+  } else {
+    pool_->set_number_of_active_threads(num_threads);
+  }
+  Pool::TaskGroup root;
+  Pool::Task task;
+  task.function = action;
+  task.group = &root;
+  ++root.pending;
+  Pool::current_pool = pool_.get();
+  Pool::current_index = 0;
+  pool_->execute(0, task);
+  Pool::current_pool = nullptr;
+  pool_->rethrow_error();
+}
+
+void WorkStealingTaskExecutor::add_task(std::function<void()> task,
+                                        double cost) {
+  Pool *pool = Pool::current_pool;
+  if (pool != pool_.get() || cost < minimum_task_cost_) {
+    task();
+  } else {
+    Pool::Task t;
+    t.function = std::move(task);
+    t.group = Pool::current_group;
+    ++t.group->pending;
+    pool->push(Pool::current_index, std::move(t));
+  }
+}
+
+void WorkStealingTaskExecutor::wait_for_tasks() {
+  Pool *pool = Pool::current_pool;
+  if (pool && pool == pool_.get()) {
+    pool->wait(Pool::current_index, Pool::current_group);
+  }
+}
+
+unsigned int WorkStealingTaskExecutor::get_thread_index() const {
+  return Pool::current_pool ? Pool::current_index : 0;
+}
+
+bool WorkStealingTaskExecutor::get_is_parallel() const {
+  return Pool::current_pool != nullptr;
+}
+
+void OpenMPTaskExecutor::run_parallel(const std::function<void()> &action,
+                                      unsigned int num_threads) {
+  IMP_OMP_PRAGMA(parallel num_threads(num_threads)) {
+    IMP_OMP_PRAGMA(single) { action(); }
+  }
+  IMP_UNUSED(num_threads);
+}
+
+void OpenMPTaskExecutor::add_task(std::function<void()> task, double) {
+  IMP_OMP_PRAGMA(task firstprivate(task) if (omp_in_parallel())) { task(); }
+}
+
+void OpenMPTaskExecutor::wait_for_tasks() {
+  IMP_OMP_PRAGMA(taskwait)
+}
+
+unsigned int OpenMPTaskExecutor::get_thread_index() const {
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
+bool OpenMPTaskExecutor::get_is_parallel() const {
+#ifdef _OPENMP
+  return omp_in_parallel();
+#else
+  return false;
+#endif
+}
+
+namespace {
+Pointer<TaskExecutor> &get_executor_pointer() {
+  static Pointer<TaskExecutor> executor;
+  return executor;
+}
+
+// Cached for use by the IMP_TASK macros
+TaskExecutor *current_executor = nullptr;
+}
+
+TaskExecutor *get_task_executor() {
+  Pointer<TaskExecutor> &executor = get_executor_pointer();
+  if (!executor) {
+    executor = new OpenMPTaskExecutor();
+  }
+  return executor;
+}
+
+void set_task_executor(TaskExecutor *e) {
+  IMP_USAGE_CHECK(!internal::get_is_in_parallel_region(),
+                  "Cannot change the task executor inside a parallel region");
+  if (!e) {
+    e = new OpenMPTaskExecutor();
+  }
+  get_executor_pointer() = e;
+  current_executor = e;
+  internal::use_task_executor.store(!dynamic_cast<OpenMPTaskExecutor *>(e));
+}
+
+namespace internal {
+std::atomic<bool> use_task_executor(false);
+
+void run_executor_parallel(const std::function<void()> &action,
+                           unsigned int num_threads) {
+  current_executor->run_parallel(action, num_threads);
+}
+
+void add_executor_task(std::function<void()> task, double cost) {
+  current_executor->add_task(std::move(task), cost);
+}
+
+void wait_for_executor_tasks() { current_executor->wait_for_tasks(); }
+
+unsigned int get_executor_thread_index() {
+  return current_executor->get_thread_index();
+}
+
+bool get_executor_is_parallel() { return current_executor->get_is_parallel(); }
+
+namespace {
+void add_indexed_tasks(unsigned int n,
+                       const std::function<void(unsigned int)> *f,
+                       const char *name) {
+  for (unsigned int i = 0; i < n; ++i) {
+    IMP_TASK((f, i, name), (*f)(i), name);
+  }
+  IMP_TASKWAIT;
+}
+}
+
+void run_tasks(unsigned int n, unsigned int num_threads,
+               const std::function<void(unsigned int)> &f,
+               const char *name) {
+  const std::function<void(unsigned int)> *fp = &f;
+  if (get_is_in_parallel_region()) {
+    add_indexed_tasks(n, fp, name);
+  } else if (num_threads < 2) {
+    for (unsigned int i = 0; i < n; ++i) f(i);
+  } else if (num_threads == get_number_of_threads()) {
+    IMP_THREADS((n, fp, name), add_indexed_tasks(n, fp, name));
+  } else {
+    SetNumberOfThreads snt(num_threads);
+    IMP_THREADS((n, fp, name), add_indexed_tasks(n, fp, name));
+  }
+}
+}
+
+IMPKERNEL_END_NAMESPACE
@@ -0,0 +1,184 @@
+/**
+ *  \file internal/ArenaAllocator.cpp
+ *  \brief Allocator for short-lived temporaries created during evaluation
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ *
+ */
+
+#include <IMP/internal/ArenaAllocator.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+
+IMPKERNEL_BEGIN_INTERNAL_NAMESPACE
+
+namespace {
+// size of the first block in each thread's arena
+const std::size_t arena_initial_block_size = 64 * 1024;
+
+// the size Arena::allocate() took for a request of size bytes
+std::size_t arena_round_up(std::size_t size) {
+  return (std::max<std::size_t>(size, 1) + IMP_ARENA_ALIGNMENT - 1)
+         & ~(IMP_ARENA_ALIGNMENT - 1);
+}
+
+thread_local unsigned int arena_scope_depth = 0;
+
+std::atomic<unsigned long> arena_allocation_count(0);
+std::atomic<unsigned long> arena_heap_allocation_count(0);
+
+// every live Arena; guards their block lists against lookups from other
+// threads
+std::mutex &get_arenas_mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::vector<const Arena *> &get_arenas() {
+  static std::vector<const Arena *> arenas;
+  return arenas;
+}
+
+// Return true if p came from the arena of some other thread
+bool get_is_other_arena_memory(const void *p) {
+  std::lock_guard<std::mutex> lock(get_arenas_mutex());
+  for (const Arena *a : get_arenas()) {
+    if (a->get_owns(p)) return true;
+  }
+  return false;
+}
+}
+
+Arena::Arena()
+    : top_(nullptr), end_(nullptr), free_begin_(nullptr),
+      free_end_(nullptr), allocations_(0) {
+  std::lock_guard<std::mutex> lock(get_arenas_mutex());
+  get_arenas().push_back(this);
+}
+
+Arena::~Arena() {
+  std::lock_guard<std::mutex> lock(get_arenas_mutex());
+  std::vector<const Arena *> &arenas = get_arenas();
+  arenas.erase(std::find(arenas.begin(), arenas.end(), this));
+  for (const auto &b : blocks_) std::free(b.first);
+}
+
+void Arena::add_block(std::size_t size) {
+  std::size_t next = blocks_.empty() ? arena_initial_block_size
+                                     : 2 * blocks_.back().second;
+  size = std::max(next, size);
+  char *data = static_cast<char *>(std::malloc(size));
+  if (!data) throw std::bad_alloc();
+  std::lock_guard<std::mutex> lock(get_arenas_mutex());
+  blocks_.push_back(std::make_pair(data, size));
+  top_ = data;
+  end_ = data + size;
+  free_begin_ = free_end_ = nullptr;
+}
+
+void Arena::deallocate(void *p, std::size_t size) {
+  char *begin = static_cast<char *>(p);
+  char *end = begin + arena_round_up(size);
+  if (end == top_) {
+    top_ = begin;
+    // the freed range just below is now at the top too
+    if (free_end_ == top_ && free_begin_ != free_end_) {
+      top_ = free_begin_;
+      free_begin_ = free_end_ = nullptr;
+    }
+  } else if (blocks_.empty() || begin < blocks_.back().first || end > top_) {
+    // in an earlier block; dropped until the reset
+  } else if (end == free_begin_) {
+    free_begin_ = begin;
+  } else if (begin == free_end_) {
+    // the old buffer of a vector that grew into the space above it
+    free_end_ = end;
+  } else {
+    // any previous free range is dropped until the reset
+    free_begin_ = begin;
+    free_end_ = end;
+  }
+}
+
+bool Arena::get_owns(const void *p) const {
+  const char *c = static_cast<const char *>(p);
+  for (const auto &b : blocks_) {
+    if (c >= b.first && c < b.first + b.second) return true;
+  }
+  return false;
+}
+
+void Arena::reset() {
+  if (blocks_.size() > 1) {
+    // replace the chain with a single block big enough for all of it
+    std::size_t capacity = get_capacity();
+    {
+      std::lock_guard<std::mutex> lock(get_arenas_mutex());
+      for (const auto &b : blocks_) std::free(b.first);
+      blocks_.clear();
+    }
+    add_block(capacity);
+  } else if (!blocks_.empty()) {
+    top_ = blocks_.back().first;
+    free_begin_ = free_end_ = nullptr;
+  }
+  arena_allocation_count.fetch_add(allocations_, std::memory_order_relaxed);
+  allocations_ = 0;
+}
+
+std::size_t Arena::get_capacity() const {
+  std::size_t ret = 0;
+  for (const auto &b : blocks_) ret += b.second;
+  return ret;
+}
+
+Arena &get_thread_arena() {
+  static thread_local Arena arena;
+  return arena;
+}
+
+bool get_is_arena_active() { return arena_scope_depth > 0; }
+
+ArenaScope::ArenaScope() { ++arena_scope_depth; }
+
+ArenaScope::~ArenaScope() {
+  if (--arena_scope_depth == 0) {
+    get_thread_arena().reset();
+  }
+}
+
+ArenaStatistics get_arena_statistics() {
+  ArenaStatistics ret;
+  ret.arena_allocations = arena_allocation_count;
+  ret.heap_allocations = arena_heap_allocation_count;
+  return ret;
+}
+
+void reset_arena_statistics() {
+  arena_allocation_count = 0;
+  arena_heap_allocation_count = 0;
+}
+
+void *arena_allocate(std::size_t size) {
+  if (arena_scope_depth > 0) {
+    return get_thread_arena().allocate(size);
+  } else {
+    arena_heap_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return ::operator new(size);
+  }
+}
+
+void arena_deallocate(void *p, std::size_t size) {
+  if (!p) return;
+  Arena &arena = get_thread_arena();
+  if (arena.get_owns(p)) {
+    arena.deallocate(p, size);
+  } else if (!get_is_other_arena_memory(p)) {
+    ::operator delete(p);
+  }
+  // memory from another thread's arena is released when it is reset
+}
+
+IMPKERNEL_END_INTERNAL_NAMESPACE
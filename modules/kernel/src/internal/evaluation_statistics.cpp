@@ -0,0 +1,56 @@
+/**
+ *  \file internal/evaluation_statistics.cpp
+ *  \brief Counters for the time spent in each Restraint and ScoreState
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ */
+
+#include <IMP/internal/evaluation_statistics.h>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define IMP_HAS_CYCLE_COUNTER 1
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define IMP_HAS_CYCLE_COUNTER 1
+#else
+#define IMP_HAS_CYCLE_COUNTER 0
+#endif
+
+IMPKERNEL_BEGIN_INTERNAL_NAMESPACE
+
+namespace {
+// derivative writes of the innermost timer on this thread
+thread_local unsigned long *current_derivative_writes = nullptr;
+
+// Read the CPU timestamp counter, or return 0 if there isn't one
+std::uint64_t get_cycle_count() {
+#if IMP_HAS_CYCLE_COUNTER
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+}  // namespace
+
+EvaluationTimer::EvaluationTimer(EvaluationCounters &counters)
+    : counters_(counters), start_cycles_(get_cycle_count()),
+      derivative_writes_(0),
+      outer_derivative_writes_(current_derivative_writes) {
+  current_derivative_writes = &derivative_writes_;
+}
+
+EvaluationTimer::~EvaluationTimer() {
+  current_derivative_writes = outer_derivative_writes_;
+  counters_.cycles += get_cycle_count() - start_cycles_;
+  counters_.time += timer_.elapsed();
+  ++counters_.calls;
+  counters_.derivative_writes.fetch_add(derivative_writes_,
+                                        std::memory_order_relaxed);
+}
+
+void add_derivative_write() {
+  if (current_derivative_writes) ++*current_derivative_writes;
+}
+
+IMPKERNEL_END_INTERNAL_NAMESPACE
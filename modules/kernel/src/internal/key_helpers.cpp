@@ -12,6 +12,7 @@
 #include "IMP/check_macros.h"
 #include "IMP/Particle.h"
 #include "IMP/internal/AttributeTable.h"
+#include <boost/unordered_map.hpp>
 
 IMPKERNEL_BEGIN_INTERNAL_NAMESPACE
 
@@ -23,8 +24,13 @@ KeyData::KeyData(
 #ifndef IMPKERNEL_INTERNAL_OLD_COMPILER
 		 unsigned int ID
 #endif
-) : heuristic_(heuristic_value)
+) : heuristic_(heuristic_value), size_(0), table_count_(0)
 {
+  for (unsigned int i = 0; i < max_chunks; ++i) {
+    chunks_[i].store(nullptr, std::memory_order_relaxed);
+  }
+  tables_.push_back(create_table(16));
+  table_.store(tables_.back().get(), std::memory_order_release);
 #ifndef IMPKERNEL_INTERNAL_OLD_COMPILER
   //  IMP_LOG_PROGRESS("KeyData::KeyData ID " << ID << std::endl);
   // Float keys are special-cased for historical reasons
@@ -74,6 +80,10 @@ namespace {
 
 KeyData& get_key_data(unsigned int index) {
   static  KeyTable key_data;
+  // Key caches the returned reference, so this is only called once per
+  // type of key; the lock protects against types being added concurrently
+  static std::mutex key_table_mutex;
+  std::lock_guard<std::mutex> lock(key_table_mutex);
   return key_data[index];
 }
 #endif
@@ -87,9 +97,115 @@ void KeyData::assert_is_initialized() const {
       "Uninitialized KeyData. Do not initialize Keys statically.");
 }
 
+KeyData::~KeyData() {}
+
+std::unique_ptr<KeyData::Table> KeyData::create_table(std::size_t size) {
+  std::unique_ptr<Table> ret(new Table);
+  ret->mask = size - 1;
+  ret->slots.reset(new std::atomic<const Entry *>[size]);
+  for (std::size_t i = 0; i < size; ++i) {
+    ret->slots[i].store(nullptr, std::memory_order_relaxed);
+  }
+  return ret;
+}
+
+bool KeyData::insert_into(Table *t, const Entry *e) {
+  std::size_t i = get_hash(e->name) & t->mask;
+  while (true) {
+    const Entry *cur = t->slots[i].load(std::memory_order_relaxed);
+    if (!cur) break;
+    // replacing an existing name overrides it
+    if (cur->name == e->name) {
+      t->slots[i].store(e, std::memory_order_release);
+      return false;
+    }
+    i = (i + 1) & t->mask;
+  }
+  t->slots[i].store(e, std::memory_order_release);
+  return true;
+}
+
+void KeyData::insert(const Entry *e) {
+  Table *t = tables_.back().get();
+  if (2 * (table_count_ + 1) > t->mask + 1) {
+    // build a bigger table off to the side, then publish it
+    std::unique_ptr<Table> nt = create_table(2 * (t->mask + 1));
+    for (std::size_t i = 0; i <= t->mask; ++i) {
+      const Entry *cur = t->slots[i].load(std::memory_order_relaxed);
+      if (cur) insert_into(nt.get(), cur);
+    }
+    t = nt.get();
+    tables_.push_back(std::move(nt));
+    if (insert_into(t, e)) ++table_count_;
+    table_.store(t, std::memory_order_release);
+  } else if (insert_into(t, e)) {
+    ++table_count_;
+  }
+}
+
+unsigned int KeyData::do_add_key(const std::string &str) {
+  IMP_LOG_PROGRESS("KeyData::add_key " << str << std::endl);
+  unsigned int index = size_.load(std::memory_order_relaxed);
+  unsigned int chunk, offset;
+  get_chunk(index, chunk, offset);
+  IMP_USAGE_CHECK(chunk < max_chunks, "Too many keys");
+  if (!chunks_[chunk].load(std::memory_order_relaxed)) {
+    std::size_t size = chunk_size << chunk;
+    chunk_storage_.push_back(std::unique_ptr<Chunk[]>(new Chunk[size]));
+    chunks_[chunk].store(chunk_storage_.back().get(),
+                         std::memory_order_release);
+  }
+  entries_.push_back(std::unique_ptr<Entry>(new Entry));
+  Entry *e = entries_.back().get();
+  e->name = str;
+  e->index = index;
+  chunks_[chunk].load(std::memory_order_relaxed)[offset].store(
+      e, std::memory_order_release);
+  // publish the string before the index can be seen by readers
+  size_.store(index + 1, std::memory_order_release);
+  insert(e);
+  return index;
+}
+
+unsigned int KeyData::add_key(std::string str) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return do_add_key(str);
+}
+
+unsigned int KeyData::find_or_add_key(const std::string &str) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // another thread may have added it since the caller looked
+  int index = find(str);
+  if (index >= 0) return index;
+  return do_add_key(str);
+}
+
+unsigned int KeyData::add_alias(std::string str, unsigned int i) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  IMP_INTERNAL_CHECK(get_number_of_keys() > i,
+                     "The aliased key doesn't exist");
+  entries_.push_back(std::unique_ptr<Entry>(new Entry));
+  Entry *e = entries_.back().get();
+  e->name = str;
+  e->index = i;
+  insert(e);
+  return i;
+}
+
+Vector<std::string> KeyData::get_all_strings() const {
+  Vector<std::string> ret;
+  const Table *t = table_.load(std::memory_order_acquire);
+  for (std::size_t i = 0; i <= t->mask; ++i) {
+    const Entry *e = t->slots[i].load(std::memory_order_acquire);
+    if (e) ret.push_back(e->name);
+  }
+  return ret;
+}
+
 void KeyData::show(std::ostream& out) const {
-  for (unsigned int i = 0; i < rmap_.size(); ++i) {
-    out << "\"" << rmap_[i] << "\" ";
+  unsigned int size = get_number_of_keys();
+  for (unsigned int i = 0; i < size; ++i) {
+    out << "\"" << get_string(i) << "\" ";
   }
 }
 
@@ -18,10 +18,42 @@
 
 #include "IMP/internal/evaluate_utility.h"
 #include "IMP/internal/utility.h"
+#include <memory>
 #include <numeric>
+#include <algorithm>
 
 IMPKERNEL_BEGIN_INTERNAL_NAMESPACE
 
+bool RestraintScoreCache::get_is_valid(Model *m, unsigned num_restraints,
+                                       bool need_last_last) const {
+  return num_evaluations_ >= (need_last_last ? 2U : 1U)
+         && last_scores_.size() == num_restraints
+         && dependencies_age_ == m->get_dependencies_updated();
+}
+
+void RestraintScoreCache::set_scores(Model *m,
+                                     const ArenaVector<double> &scores,
+                                     const ArenaVector<char> &keep_last_last) {
+  unsigned age = m->get_dependencies_updated();
+  if (age != dependencies_age_ || scores.size() != last_scores_.size()) {
+    // scores from before the change can no longer be trusted
+    num_evaluations_ = 0;
+    dependencies_age_ = age;
+  }
+  if (num_evaluations_ == 0) {
+    last_scores_.assign(scores.begin(), scores.end());
+    last_last_scores_.assign(scores.begin(), scores.end());
+  } else {
+    for (unsigned int i = 0; i < scores.size(); ++i) {
+      if (keep_last_last.empty() || !keep_last_last[i]) {
+        last_last_scores_[i] = last_scores_[i];
+      }
+      last_scores_[i] = scores[i];
+    }
+  }
+  num_evaluations_ = std::min(num_evaluations_ + 1, 2U);
+}
+
 namespace {
 
 void before_protected_evaluate(Model *m, const ScoreStatesTemp &states,
@@ -47,6 +79,49 @@ void after_protected_evaluate(Model *m, const ScoreStatesTemp &states,
   m->first_call_ = false;
 }
 
+/* Per-thread buffers for the score and derivatives of one evaluation,
+   used instead of atomic updates if the Model asks for them and the
+   evaluation runs on several threads. finish() must be called once all
+   restraint tasks have completed. */
+class ThreadBuffers {
+  Model *m_;
+  IMP::ScoreAccumulator sa_;
+  std::unique_ptr<ThreadDerivativeBuffers> derivatives_;
+  Vector<double> scores_;
+  bool use_scores_;
+
+ public:
+  ThreadBuffers(Model *m, IMP::ScoreAccumulator sa)
+      : m_(m), sa_(sa), use_scores_(false) {
+    unsigned num_threads = get_number_of_threads();
+    if (!m->get_use_thread_local_derivatives() || num_threads <= 1
+        || !get_is_in_parallel_region()) {
+      return;
+    }
+    scores_.resize(num_threads * IMP_THREAD_SCORE_STRIDE, 0.);
+    use_scores_ = sa_.begin_thread_scores(scores_.data(), num_threads);
+    if (sa_.get_derivative_accumulator()) {
+      derivatives_.reset(new ThreadDerivativeBuffers(num_threads));
+      if (!m->attach_thread_derivatives(derivatives_.get())) {
+        derivatives_.reset();
+      }
+    }
+  }
+
+  void finish() {
+    if (use_scores_) {
+      sa_.end_thread_scores();
+      use_scores_ = false;
+    }
+    if (derivatives_) {
+      m_->detach_thread_derivatives(derivatives_.get());
+      derivatives_.reset();
+    }
+  }
+
+  ~ThreadBuffers() { finish(); }
+};
+
 #if IMP_HAS_CHECKS >= IMP_INTERNAL
 template <class RS>
 void check_restraint_and_masks(RS *restraint, Model *m) {
@@ -114,42 +189,167 @@ void do_evaluate_one_moved(IMP::ScoreAccumulator sa, RS *restraint,
 #endif
 }
 
+template <class RS>
+void store_scores(const RS &restraints, IMP::ScoreAccumulator sa, Model *m,
+                  RestraintScoreCache *cache) {
+  if (!cache) return;
+  if (sa.get_abort_evaluation()) {
+    // not all restraints were evaluated
+    cache->clear();
+    return;
+  }
+  ArenaVector<double> scores(restraints.size());
+  for (unsigned int i = 0; i < restraints.size(); ++i) {
+    scores[i] = restraints[i]->get_last_score();
+  }
+  cache->set_scores(m, scores);
+}
+
 template <class RS>
 void protected_evaluate_many(IMP::ScoreAccumulator sa,
                              const RS &restraints,
-                             const ScoreStatesTemp &states, Model *m) {
+                             const ScoreStatesTemp &states, Model *m,
+                             RestraintScoreCache *cache) {
   before_protected_evaluate(m, states, sa.get_derivative_accumulator());
   internal::SFSetIt<IMP::internal::Stage> reset(&m->cur_stage_,
                                                         internal::EVALUATING);
   {
+    ThreadBuffers buffers(m, sa);
     for (unsigned int i = 0; i < restraints.size(); ++i) {
       IMP_CHECK_OBJECT(restraints[i].get());
       do_evaluate_one(sa, restraints[i].get(), m);
     }
-    IMP_OMP_PRAGMA(taskwait)
+    IMP_TASKWAIT
     IMP_OMP_PRAGMA(flush)
+    buffers.finish();
   }
+  store_scores(restraints, sa, m, cache);
   after_protected_evaluate(m, states, sa.get_derivative_accumulator());
 }
 
+// Return true if r is in any of the given sets
+typedef ArenaVector<const std::set<Restraint *> *> DependentSets;
+
+bool get_is_dependent(Restraint *r, const DependentSets &sets) {
+  for (unsigned int i = 0; i < sets.size(); ++i) {
+    if (sets[i]->find(r) != sets[i]->end()) return true;
+  }
+  return false;
+}
+
+// How each restraint was handled by evaluate_dependent_restraints()
+enum DependentRestraintStatus { UNCHANGED, MOVED, RESET, MOVED_AND_RESET };
+
+// Evaluate only those restraints that depend on moved or reset particles,
+// and use the cached scores for the rest
+template <class RS>
+void evaluate_dependent_restraints(IMP::ScoreAccumulator sa,
+                                   const RS &restraints,
+                                   const ParticleIndexes &moved_pis,
+                                   const ParticleIndexes &reset_pis, Model *m,
+                                   RestraintScoreCache *cache) {
+  DependentSets moved_sets, reset_sets;
+  for (unsigned int i = 0; i < moved_pis.size(); ++i) {
+    moved_sets.push_back(&m->get_dependent_restraints(moved_pis[i]));
+  }
+  for (unsigned int i = 0; i < reset_pis.size(); ++i) {
+    reset_sets.push_back(&m->get_dependent_restraints(reset_pis[i]));
+  }
+  ArenaVector<DependentRestraintStatus> status(restraints.size());
+  for (unsigned int i = 0; i < restraints.size(); ++i) {
+    Restraint *r = restraints[i].get();
+    IMP_CHECK_OBJECT(r);
+    bool is_reset = get_is_dependent(r, reset_sets);
+    // aggregate restraints (e.g. RestraintSets) do their own skipping
+    if (r->get_is_aggregate() || get_is_dependent(r, moved_sets)) {
+      status[i] = is_reset ? MOVED_AND_RESET : MOVED;
+    } else {
+      status[i] = is_reset ? RESET : UNCHANGED;
+    }
+    if (status[i] == MOVED || status[i] == MOVED_AND_RESET) {
+      do_evaluate_one_moved(sa, r, moved_pis, reset_pis, m);
+    } else {
+      double score = status[i] == RESET ? cache->get_last_last_score(i)
+                                        : cache->get_last_score(i);
+      // If the restraint was never scored, get the full score
+      if (score == BAD_SCORE) {
+        status[i] = is_reset ? MOVED_AND_RESET : MOVED;
+        do_evaluate_one_moved(sa, r, moved_pis, reset_pis, m);
+      } else {
+#if IMP_HAS_CHECKS >= IMP_INTERNAL
+        // evaluate anyway, and check the score against the cache below
+        do_evaluate_one_moved(sa, r, moved_pis, reset_pis, m);
+#else
+        ScoreAccumulator(sa, r).add_score(score);
+        if (status[i] == RESET) {
+          r->set_last_score(score);
+        }
+#endif
+      }
+    }
+  }
+  IMP_TASKWAIT
+  IMP_OMP_PRAGMA(flush)
+  if (sa.get_abort_evaluation()) {
+    cache->clear();
+    return;
+  }
+  ArenaVector<double> scores(restraints.size());
+  ArenaVector<char> keep_last_last(restraints.size(), false);
+  for (unsigned int i = 0; i < restraints.size(); ++i) {
+    switch (status[i]) {
+      case UNCHANGED:
+        scores[i] = cache->get_last_score(i);
+        break;
+      case RESET:
+        scores[i] = cache->get_last_last_score(i);
+        break;
+      case MOVED:
+      case MOVED_AND_RESET:
+        scores[i] = restraints[i]->get_last_score();
+        keep_last_last[i] = status[i] == MOVED_AND_RESET;
+        break;
+    }
+  }
+#if IMP_HAS_CHECKS >= IMP_INTERNAL
+  for (unsigned int i = 0; i < restraints.size(); ++i) {
+    IMP_INTERNAL_CHECK_FLOAT_EQUAL(
+        restraints[i]->get_last_score(), scores[i],
+        "Restraint " << *restraints[i]
+        << " changed score even though particles didn't move");
+  }
+#endif
+  cache->set_scores(m, scores, keep_last_last);
+}
+
 template <class RS>
 void protected_evaluate_many_moved(IMP::ScoreAccumulator sa,
                              const RS &restraints,
                              const ParticleIndexes &moved_pis,
                              const ParticleIndexes &reset_pis,
-                             const ScoreStatesTemp &states, Model *m) {
+                             const ScoreStatesTemp &states, Model *m,
+                             RestraintScoreCache *cache) {
   before_protected_evaluate(m, states, sa.get_derivative_accumulator());
   internal::SFSetIt<IMP::internal::Stage> reset(&m->cur_stage_,
                                                         internal::EVALUATING);
-  {
-    // todo: skip restraints that don't take moved_pis as input
+  ThreadBuffers buffers(m, sa);
+  // If we only want the score, we need only evaluate the restraints that
+  // depend on the moved or reset particles
+  if (cache && !sa.get_derivative_accumulator()
+      && cache->get_is_valid(m, restraints.size(), !reset_pis.empty())) {
+    evaluate_dependent_restraints(sa, restraints, moved_pis, reset_pis, m,
+                                  cache);
+  } else {
     for (unsigned int i = 0; i < restraints.size(); ++i) {
       IMP_CHECK_OBJECT(restraints[i].get());
       do_evaluate_one_moved(sa, restraints[i].get(), moved_pis, reset_pis, m);
     }
-    IMP_OMP_PRAGMA(taskwait)
+    IMP_TASKWAIT
     IMP_OMP_PRAGMA(flush)
+    buffers.finish();
+    store_scores(restraints, sa, m, cache);
   }
+  buffers.finish();
   after_protected_evaluate(m, states, sa.get_derivative_accumulator());
 }
 
@@ -178,9 +378,11 @@ void protected_evaluate_one(IMP::ScoreAccumulator sa, RS *restraint,
                             const ScoreStatesTemp &states, Model *m) {
   before_protected_evaluate(m, states, sa.get_derivative_accumulator());
   {
+    ThreadBuffers buffers(m, sa);
     unprotected_evaluate_one(sa, restraint, m);
-    IMP_OMP_PRAGMA(taskwait)
+    IMP_TASKWAIT
     IMP_OMP_PRAGMA(flush)
+    buffers.finish();
   }
   after_protected_evaluate(m, states, sa.get_derivative_accumulator());
 }
@@ -192,9 +394,11 @@ void protected_evaluate_one_moved(IMP::ScoreAccumulator sa, RS *restraint,
                                   const ScoreStatesTemp &states, Model *m) {
   before_protected_evaluate(m, states, sa.get_derivative_accumulator());
   {
+    ThreadBuffers buffers(m, sa);
     unprotected_evaluate_one_moved(sa, restraint, moved_pis, reset_pis, m);
-    IMP_OMP_PRAGMA(taskwait)
+    IMP_TASKWAIT
     IMP_OMP_PRAGMA(flush)
+    buffers.finish();
   }
   after_protected_evaluate(m, states, sa.get_derivative_accumulator());
 }
@@ -208,23 +412,36 @@ void protected_evaluate(IMP::ScoreAccumulator sa, Restraint *restraint,
 
 void protected_evaluate(IMP::ScoreAccumulator sa,
                         const RestraintsTemp &restraints,
-                        const ScoreStatesTemp &states, Model *m) {
-  protected_evaluate_many<RestraintsTemp>(sa, restraints, states, m);
+                        const ScoreStatesTemp &states, Model *m,
+                        RestraintScoreCache *cache) {
+  protected_evaluate_many<RestraintsTemp>(sa, restraints, states, m, cache);
 }
 
 void protected_evaluate(IMP::ScoreAccumulator sa,
                         const Restraints &restraints,
-                        const ScoreStatesTemp &states, Model *m) {
-  protected_evaluate_many<Restraints>(sa, restraints, states, m);
+                        const ScoreStatesTemp &states, Model *m,
+                        RestraintScoreCache *cache) {
+  protected_evaluate_many<Restraints>(sa, restraints, states, m, cache);
 }
 
 void protected_evaluate_moved(IMP::ScoreAccumulator sa,
                         const RestraintsTemp &restraints,
                         const ParticleIndexes &moved_pis,
                         const ParticleIndexes &reset_pis,
-                        const ScoreStatesTemp &states, Model *m) {
+                        const ScoreStatesTemp &states, Model *m,
+                        RestraintScoreCache *cache) {
   protected_evaluate_many_moved<RestraintsTemp>(sa, restraints, moved_pis,
-                                                reset_pis, states, m);
+                                                reset_pis, states, m, cache);
+}
+
+void protected_evaluate_moved(IMP::ScoreAccumulator sa,
+                        const Restraints &restraints,
+                        const ParticleIndexes &moved_pis,
+                        const ParticleIndexes &reset_pis,
+                        const ScoreStatesTemp &states, Model *m,
+                        RestraintScoreCache *cache) {
+  protected_evaluate_many_moved<Restraints>(sa, restraints, moved_pis,
+                                            reset_pis, states, m, cache);
 }
 
 void protected_evaluate_moved(IMP::ScoreAccumulator sa,
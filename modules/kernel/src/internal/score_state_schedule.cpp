@@ -0,0 +1,182 @@
+/**
+ *  \file internal/score_state_schedule.cpp
+ *  \brief Update ScoreStates in dependency order
+ *
+ *  Copyright 2007-2022 IMP Inventors. All rights reserved.
+ */
+
+#include <IMP/internal/score_state_schedule.h>
+#include <IMP/internal/SimpleTimer.h>
+#include <IMP/internal/ArenaAllocator.h>
+#include <IMP/ScoreState.h>
+#include <IMP/thread_macros.h>
+#include <boost/functional/hash.hpp>
+#include <algorithm>
+#include <atomic>
+
+IMPKERNEL_BEGIN_INTERNAL_NAMESPACE
+
+// Everything that changes during one call to run()
+struct ScoreStateSchedule::Run {
+  const ScoreStateSchedule *schedule;
+  const std::function<void(ScoreState *)> *update;
+  const std::vector<std::vector<unsigned> > *previous, *next;
+  std::unique_ptr<std::atomic<int>[]> remaining;
+  // only filled in if the states are timed
+  std::vector<double> times, path_times;
+};
+
+ScoreStateSchedule::ScoreStateSchedule(const ScoreStatesTemp &states)
+    : states_(states), critical_path_length_(0) {
+  unsigned int n = states_.size();
+  boost::unordered_map<ScoreState *, unsigned> index;
+  for (unsigned int i = 0; i < n; ++i) {
+    index[states_[i]] = i;
+  }
+  predecessors_.assign(n, std::vector<unsigned>());
+  successors_.assign(n, std::vector<unsigned>());
+  // The required score states are all ancestors of each state, so drop
+  // those that are also ancestors of another ancestor to keep only the
+  // direct dependencies
+  std::vector<std::vector<unsigned> > ancestors(n);
+  for (unsigned int i = 0; i < n; ++i) {
+    for (ScoreState *req : states_[i]->get_required_score_states()) {
+      auto it = index.find(req);
+      if (it != index.end()) {
+        IMP_INTERNAL_CHECK(it->second < i, "Score state "
+                           << req->get_name() << " is not ordered before "
+                           << states_[i]->get_name());
+        ancestors[i].push_back(it->second);
+      }
+    }
+  }
+  // covered[j] == i + 1 if j is an ancestor of an ancestor of i
+  std::vector<unsigned> covered(n, 0);
+  for (unsigned int i = 0; i < n; ++i) {
+    for (unsigned a : ancestors[i]) {
+      for (unsigned aa : ancestors[a]) covered[aa] = i + 1;
+    }
+    for (unsigned a : ancestors[i]) {
+      if (covered[a] != i + 1) {
+        predecessors_[i].push_back(a);
+        successors_[a].push_back(i);
+      }
+    }
+  }
+  // states are in update order, so predecessors come first
+  std::vector<unsigned> depth(n, 1);
+  for (unsigned int i = 0; i < n; ++i) {
+    for (unsigned p : predecessors_[i]) {
+      depth[i] = std::max(depth[i], depth[p] + 1);
+    }
+    critical_path_length_ = std::max(critical_path_length_, depth[i]);
+  }
+}
+
+void ScoreStateSchedule::run_node(Run *run, unsigned int i, bool spawn) {
+  const ScoreStateSchedule *schedule = run->schedule;
+  ScoreState *ss = schedule->states_[i];
+  // may be running on a worker thread outside the evaluate call's scope
+  ArenaScope arena;
+  if (run->times.empty()) {
+    (*run->update)(ss);
+  } else {
+    SimpleTimer timer;
+    (*run->update)(ss);
+    double time = timer.elapsed();
+    // all previous states have finished, so their path times are final
+    double path_time = 0.;
+    for (unsigned p : (*run->previous)[i]) {
+      path_time = std::max(path_time, run->path_times[p]);
+    }
+    run->times[i] = time;
+    run->path_times[i] = path_time + time;
+  }
+  if (!spawn) return;
+  for (unsigned j : (*run->next)[i]) {
+    if (--run->remaining[j] == 0) {
+      IMP_TASK_WITH_COST((run, j), run_node(run, j, true),
+                         "update score state",
+                         run->schedule->states_[j]->get_task_cost());
+    }
+  }
+  IMP_TASKWAIT
+}
+
+void ScoreStateSchedule::run(const std::function<void(ScoreState *)> &update,
+                             bool reverse, bool parallel,
+                             ScoreStateScheduleTimes *times) const {
+  unsigned int n = states_.size();
+  Run run;
+  run.schedule = this;
+  run.update = &update;
+  run.previous = reverse ? &successors_ : &predecessors_;
+  run.next = reverse ? &predecessors_ : &successors_;
+  if (times) {
+    run.times.resize(n, 0.);
+    run.path_times.resize(n, 0.);
+  }
+  if (parallel) {
+    run.remaining.reset(new std::atomic<int>[n]);
+    for (unsigned int i = 0; i < n; ++i) {
+      run.remaining[i] = (*run.previous)[i].size();
+    }
+    Run *prun = &run;
+    for (unsigned int i = 0; i < n; ++i) {
+      if ((*run.previous)[i].empty()) {
+        IMP_TASK_WITH_COST((prun, i), run_node(prun, i, true),
+                           "update score state",
+                           states_[i]->get_task_cost());
+      }
+    }
+    IMP_TASKWAIT
+  } else {
+    for (unsigned int k = 0; k < n; ++k) {
+      run_node(&run, reverse ? n - 1 - k : k, false);
+    }
+  }
+  if (times) {
+    times->total_time = 0.;
+    times->critical_path_time = 0.;
+    for (unsigned int i = 0; i < n; ++i) {
+      times->total_time += run.times[i];
+      times->critical_path_time =
+          std::max(times->critical_path_time, run.path_times[i]);
+    }
+  }
+}
+
+std::size_t ScoreStateSchedules::Hash::operator()(
+    const ScoreStatesTemp &states) const {
+  std::size_t seed = 0;
+  for (ScoreState *ss : states) {
+    boost::hash_combine(seed, ss);
+  }
+  return seed;
+}
+
+std::shared_ptr<const ScoreStateSchedule> ScoreStateSchedules::get(
+    const ScoreStatesTemp &states, unsigned dependencies_age) {
+  // an age of zero means the dependencies are not known
+  if (dependencies_age == 0) {
+    return std::make_shared<ScoreStateSchedule>(states);
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (dependencies_age != dependencies_age_) {
+    schedules_.clear();
+    dependencies_age_ = dependencies_age;
+  }
+  std::shared_ptr<const ScoreStateSchedule> &schedule = schedules_[states];
+  if (!schedule) {
+    schedule = std::make_shared<ScoreStateSchedule>(states);
+  }
+  return schedule;
+}
+
+void ScoreStateSchedules::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  schedules_.clear();
+  dependencies_age_ = 0;
+}
+
+IMPKERNEL_END_INTERNAL_NAMESPACE
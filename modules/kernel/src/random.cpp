@@ -10,9 +10,32 @@
 #include <IMP/Vector.h>
 
 IMPKERNEL_BEGIN_NAMESPACE
+
+namespace {
+thread_local RandomNumberGenerator *thread_generator = nullptr;
+}
+
 boost::uint64_t get_random_seed()
 {
   return static_cast<boost::uint64_t>(internal::random_seed);
 }
 
+std::atomic<int> internal::random_number_generator_scopes(0);
+
+RandomNumberGenerator *internal::get_thread_random_number_generator() {
+  return thread_generator;
+}
+
+RandomNumberGeneratorScope::RandomNumberGeneratorScope(
+    RandomNumberGenerator &gen)
+    : old_(thread_generator) {
+  thread_generator = &gen;
+  ++internal::random_number_generator_scopes;
+}
+
+RandomNumberGeneratorScope::~RandomNumberGeneratorScope() {
+  --internal::random_number_generator_scopes;
+  thread_generator = old_;
+}
+
 IMPKERNEL_END_NAMESPACE
@@ -0,0 +1,80 @@
+/**
+ *   Copyright 2007-2022 IMP Inventors. All rights reserved
+ */
+#include <IMP/internal/ArenaAllocator.h>
+#include <IMP/exception.h>
+#include <IMP/flags.h>
+#include <IMP/check_macros.h>
+
+namespace {
+
+std::string get_module_version() { return std::string(); }
+
+std::string get_module_name() { return std::string(); }
+
+void check_count(unsigned long count, unsigned long expected,
+                 std::string name) {
+  if (count != expected) {
+    IMP_THROW("Number of " << name << " allocations " << count
+                           << " does not match " << expected,
+              IMP::ValueException);
+  }
+}
+}
+
+int main(int argc, char *argv[]) {
+  IMP::setup_from_argv(argc, argv, "Test the evaluation arena.");
+  IMP::internal::reset_arena_statistics();
+  // outside of a scope, memory comes from the heap
+  IMP::internal::ArenaVector<int> heap(10, 1);
+  check_count(IMP::internal::get_arena_statistics().heap_allocations, 1,
+              "heap");
+  {
+    IMP::internal::ArenaScope outer;
+    IMP::internal::ArenaVector<double> v;
+    for (unsigned int i = 0; i < 100000; ++i) {
+      v.push_back(i);
+    }
+    {
+      // nested scopes do not reset the arena
+      IMP::internal::ArenaScope inner;
+      IMP::internal::ArenaVector<int> w(1000, 2);
+    }
+    for (unsigned int i = 0; i < v.size(); ++i) {
+      if (v[i] != i) {
+        IMP_THROW("Arena vector was overwritten at " << i,
+                  IMP::ValueException);
+      }
+    }
+  }
+  std::size_t capacity = IMP::internal::get_thread_arena().get_capacity();
+  {
+    // after the reset, the same amount of memory fits in one block
+    IMP::internal::ArenaScope outer;
+    IMP::internal::ArenaVector<double> v(100000, 1.);
+    if (IMP::internal::get_thread_arena().get_capacity() != capacity) {
+      IMP_THROW("Arena grew after reset", IMP::ValueException);
+    }
+  }
+  {
+    // temporaries freed in turn, including the buffers a vector left
+    // behind as it grew, give their memory back
+    IMP::internal::ArenaScope outer;
+    const int *first = nullptr;
+    for (unsigned int k = 0; k < 10; ++k) {
+      IMP::internal::ArenaVector<int> v;
+      for (unsigned int i = 0; i < 1000; ++i) {
+        v.push_back(i);
+      }
+      if (!first) {
+        first = v.data();
+      } else if (v.data() != first) {
+        IMP_THROW("Arena memory was not reused", IMP::ValueException);
+      }
+    }
+  }
+  if (IMP::internal::get_arena_statistics().arena_allocations == 0) {
+    IMP_THROW("No arena allocations recorded", IMP::ValueException);
+  }
+  return 0;
+}
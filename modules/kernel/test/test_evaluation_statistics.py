@@ -0,0 +1,105 @@
+import json
+import io
+import IMP
+import IMP.test
+
+xk = IMP.FloatKey("x")
+
+
+class DerivativeRestraint(IMP.Restraint):
+
+    """Restraint that adds a unit derivative to each particle"""
+
+    def __init__(self, m, pis):
+        IMP.Restraint.__init__(self, m, "DerivativeRestraint%1%")
+        self.pis = pis
+
+    def unprotected_evaluate(self, accum):
+        if accum:
+            for pi in self.pis:
+                self.get_model().add_to_derivative(xk, pi, 1.0, accum)
+        return 1.0
+
+    def do_get_inputs(self):
+        m = self.get_model()
+        return [m.get_particle(pi) for pi in self.pis]
+
+
+class NullScoreState(IMP.ScoreState):
+
+    """ScoreState that claims to update some particles but does nothing"""
+
+    def __init__(self, m, pis):
+        IMP.ScoreState.__init__(self, m, "NullScoreState%1%")
+        self.pis = pis
+
+    def do_before_evaluate(self):
+        pass
+
+    def do_after_evaluate(self, accum):
+        pass
+
+    def do_get_inputs(self):
+        return []
+
+    def do_get_outputs(self):
+        m = self.get_model()
+        return [m.get_particle(pi) for pi in self.pis]
+
+
+class Tests(IMP.test.TestCase):
+
+    def _make_system(self):
+        m = IMP.Model()
+        pis = []
+        for i in range(3):
+            pi = m.add_particle("P%d" % i)
+            m.add_attribute(xk, pi, 0.)
+            pis.append(pi)
+        r = DerivativeRestraint(m, pis)
+        ss = NullScoreState(m, pis)
+        m.add_score_state(ss)
+        return m, r, ss
+
+    @IMP.test.skipIf(not IMP.IMP_KERNEL_HAS_EVALUATION_STATISTICS,
+                     "Evaluation statistics are disabled")
+    def test_statistics(self):
+        """Test per-object evaluation statistics"""
+        m, r, ss = self._make_system()
+        sf = r.create_scoring_function()
+        for i in range(4):
+            sf.evaluate(True)
+        sf.evaluate(False)
+        stats = dict((s.get_model_object().get_name(), s)
+                     for s in m.get_evaluation_statistics())
+        rs = stats[r.get_name()]
+        self.assertEqual(rs.get_number_of_calls(), 5)
+        self.assertEqual(rs.get_number_of_derivative_writes(), 12)
+        self.assertGreaterEqual(rs.get_time(), 0.)
+        # before_evaluate is called 5 times, after_evaluate 5 times
+        self.assertEqual(stats[ss.get_name()].get_number_of_calls(), 10)
+
+        m.clear_evaluation_statistics()
+        self.assertEqual(len(m.get_evaluation_statistics()), 0)
+
+    @IMP.test.skipIf(not IMP.IMP_KERNEL_HAS_EVALUATION_STATISTICS,
+                     "Evaluation statistics are disabled")
+    def test_json(self):
+        """Test writing evaluation statistics as JSON"""
+        m, r, ss = self._make_system()
+        sf = r.create_scoring_function()
+        sf.evaluate(True)
+        sio = io.StringIO()
+        m.write_evaluation_statistics(sio)
+        stats = json.loads(sio.getvalue())
+        kinds = sorted(s['kind'] for s in stats)
+        self.assertEqual(kinds, ['Restraint', 'ScoreState'])
+        for s in stats:
+            if s['kind'] == 'Restraint':
+                self.assertEqual(s['name'], r.get_name())
+                self.assertEqual(s['calls'], 1)
+                self.assertEqual(s['derivative_writes'], 3)
+
+
+if __name__ == '__main__':
+    IMP.test.main()
@@ -0,0 +1,69 @@
+/**
+ *   Copyright 2007-2022 IMP Inventors. All rights reserved
+ */
+#include <IMP/base_types.h>
+#include <IMP/exception.h>
+#include <IMP/flags.h>
+#include <IMP/check_macros.h>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+std::string get_module_version() { return std::string(); }
+
+std::string get_module_name() { return std::string(); }
+
+const unsigned int num_key_threads = 8;
+const unsigned int num_thread_keys = 2000;
+
+std::string get_key_name(unsigned int i) {
+  std::ostringstream oss;
+  oss << "threaded key " << i;
+  return oss.str();
+}
+
+// Each thread creates the same keys, in a different order, and looks up
+// the strings of keys made by the others while they are being added
+void create_keys(unsigned int thread, std::vector<int> *indexes) {
+  for (unsigned int j = 0; j < num_thread_keys; ++j) {
+    unsigned int i = (j * 7 + thread * 251) % num_thread_keys;
+    IMP::IntKey k(get_key_name(i));
+    (*indexes)[i] = k.get_index();
+    if (k.get_string() != get_key_name(i)) {
+      IMP_THROW("Key " << i << " has the wrong name " << k.get_string(),
+                IMP::ValueException);
+    }
+  }
+}
+}
+
+int main(int argc, char *argv[]) {
+  IMP::setup_from_argv(argc, argv, "Test creating keys from many threads.");
+  unsigned int start = IMP::IntKey::get_number_of_keys();
+  std::vector<std::vector<int> > indexes(num_key_threads,
+                                         std::vector<int>(num_thread_keys));
+  std::vector<std::thread> threads;
+  for (unsigned int t = 0; t < num_key_threads; ++t) {
+    threads.push_back(std::thread(create_keys, t, &indexes[t]));
+  }
+  for (unsigned int t = 0; t < num_key_threads; ++t) {
+    threads[t].join();
+  }
+  if (IMP::IntKey::get_number_of_keys() != start + num_thread_keys) {
+    IMP_THROW("Expected " << num_thread_keys << " new keys, got "
+                          << IMP::IntKey::get_number_of_keys() - start,
+              IMP::ValueException);
+  }
+  for (unsigned int t = 1; t < num_key_threads; ++t) {
+    if (indexes[t] != indexes[0]) {
+      IMP_THROW("Threads disagree on key indexes", IMP::ValueException);
+    }
+  }
+  for (unsigned int i = 0; i < num_thread_keys; ++i) {
+    if (!IMP::IntKey::get_key_exists(get_key_name(i))) {
+      IMP_THROW("Missing key " << i, IMP::ValueException);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,108 @@
+import IMP
+import IMP.test
+
+xk = IMP.FloatKey("x")
+fk = IMP.FloatKey("snapshot f")
+ik = IMP.IntKey("snapshot i")
+sk = IMP.StringKey("snapshot s")
+
+
+class Tests(IMP.test.TestCase):
+
+    def _make_model(self, n):
+        m = IMP.Model()
+        pis = []
+        for i in range(n):
+            pi = m.add_particle("P%d" % i)
+            m.add_attribute(xk, pi, float(i))
+            m.add_attribute(ik, pi, i)
+            pis.append(pi)
+        return m, pis
+
+    def test_restore(self):
+        """Test restoring a Model snapshot"""
+        m, pis = self._make_model(10)
+        s = m.create_snapshot()
+        self.assertEqual(s.get_model(), m)
+        m.set_attribute(xk, pis[3], -1.)
+        m.set_attribute(ik, pis[4], -1)
+        m.add_attribute(fk, pis[5], 42.)
+        m.add_attribute(sk, pis[6], "added")
+        m.remove_attribute(ik, pis[7])
+        m.restore_snapshot(s)
+        for i, pi in enumerate(pis):
+            self.assertAlmostEqual(m.get_attribute(xk, pi), float(i),
+                                   delta=1e-6)
+            self.assertEqual(m.get_attribute(ik, pi), i)
+        self.assertFalse(m.get_has_attribute(fk, pis[5]))
+        self.assertFalse(m.get_has_attribute(sk, pis[6]))
+
+    def test_shared_pages(self):
+        """Test that unchanged pages are shared between snapshots"""
+        m, pis = self._make_model(2000)
+        s0 = m.create_snapshot()
+        self.assertGreater(s0.get_number_of_copied_pages(), 1)
+        s1 = m.create_snapshot()
+        self.assertEqual(s1.get_number_of_copied_pages(), 0)
+        m.set_attribute(xk, pis[1500], -1.)
+        s2 = m.create_snapshot()
+        self.assertEqual(s2.get_number_of_copied_pages(), 1)
+        m.restore_snapshot(s0)
+        self.assertAlmostEqual(m.get_attribute(xk, pis[1500]), 1500.,
+                               delta=1e-6)
+        m.restore_snapshot(s2)
+        self.assertAlmostEqual(m.get_attribute(xk, pis[1500]), -1.,
+                               delta=1e-6)
+
+    def test_written_pages(self):
+        """Test that only pages written since the last snapshot are saved"""
+        m, pis = self._make_model(2000)
+        m.add_attribute(sk, pis[0], "sparse")
+        s0 = m.create_snapshot()
+        m.set_attribute(xk, pis[10], -1.)
+        m.set_attribute(sk, pis[0], "changed")
+        s1 = m.create_snapshot()
+        # one page each of x and of the strings
+        self.assertEqual(s1.get_number_of_copied_pages(), 2)
+        m.restore_snapshot(s0)
+        self.assertAlmostEqual(m.get_attribute(xk, pis[10]), 10.,
+                               delta=1e-6)
+        self.assertEqual(m.get_attribute(sk, pis[0]), "sparse")
+        # a write after the restore is relative to s0, not s1
+        m.set_attribute(ik, pis[1999], -1)
+        s2 = m.create_snapshot()
+        self.assertEqual(s2.get_number_of_copied_pages(), 1)
+        m.restore_snapshot(s1)
+        self.assertAlmostEqual(m.get_attribute(xk, pis[10]), -1.,
+                               delta=1e-6)
+        self.assertEqual(m.get_attribute(ik, pis[1999]), 1999)
+        m.restore_snapshot(s2)
+        self.assertAlmostEqual(m.get_attribute(xk, pis[10]), 10.,
+                               delta=1e-6)
+        self.assertEqual(m.get_attribute(ik, pis[1999]), -1)
+
+    @IMP.test.skipIf(not IMP.IMP_KERNEL_HAS_NUMPY, "No numpy support")
+    def test_numpy_written_pages(self):
+        """Test that writes through NumPy arrays are saved"""
+        m, pis = self._make_model(10)
+        s0 = m.create_snapshot()
+        ints = m.get_ints_numpy(ik)
+        ints[3] = -1
+        s1 = m.create_snapshot()
+        self.assertEqual(s1.get_number_of_copied_pages(), 1)
+        m.restore_snapshot(s0)
+        self.assertEqual(m.get_attribute(ik, pis[3]), 3)
+
+    def test_configuration_swap(self):
+        """Test swapping a Configuration with the Model"""
+        m, pis = self._make_model(10)
+        c = IMP.Configuration(m)
+        m.set_attribute(xk, pis[2], -1.)
+        c.swap_configuration()
+        self.assertAlmostEqual(m.get_attribute(xk, pis[2]), 2., delta=1e-6)
+        c.swap_configuration()
+        self.assertAlmostEqual(m.get_attribute(xk, pis[2]), -1., delta=1e-6)
+
+
+if __name__ == '__main__':
+    IMP.test.main()
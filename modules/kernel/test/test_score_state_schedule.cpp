@@ -0,0 +1,159 @@
+/**
+ *   Copyright 2007-2022 IMP Inventors. All rights reserved
+ */
+#include <IMP/base_types.h>
+#include <IMP/Model.h>
+#include <IMP/Particle.h>
+#include <IMP/Restraint.h>
+#include <IMP/ScoreState.h>
+#include <IMP/ScoringFunction.h>
+#include <IMP/TaskExecutor.h>
+#include <IMP/particle_index.h>
+#include <IMP/threads.h>
+#include <IMP/thread_macros.h>
+#include <IMP/utility_macros.h>
+#include <IMP/flags.h>
+
+namespace {
+
+std::string get_module_version() { return std::string(); }
+
+std::string get_module_name() { return std::string(); }
+
+const IMP::FloatKey xk(0);
+
+// Set the output x to the input x plus one, and pass derivatives back
+class AddOneScoreState : public IMP::ScoreState {
+  IMP::ParticleIndex in_, out_;
+
+ public:
+  AddOneScoreState(IMP::Model *m, IMP::ParticleIndex in,
+                   IMP::ParticleIndex out)
+      : IMP::ScoreState(m, "AddOneScoreState%1%"), in_(in), out_(out) {}
+  virtual void do_before_evaluate() override {
+    IMP::Model *m = get_model();
+    m->set_attribute(xk, out_, m->get_attribute(xk, in_) + 1.);
+  }
+  virtual void do_after_evaluate(IMP::DerivativeAccumulator *da) override {
+    if (da) {
+      IMP::Model *m = get_model();
+      m->add_to_derivative(xk, in_, m->get_derivative(xk, out_), *da);
+    }
+  }
+  IMP::ModelObjectsTemp do_get_inputs() const override {
+    return IMP::ModelObjectsTemp(1, get_model()->get_particle(in_));
+  }
+  IMP::ModelObjectsTemp do_get_outputs() const override {
+    return IMP::ModelObjectsTemp(1, get_model()->get_particle(out_));
+  }
+  IMP_OBJECT_METHODS(AddOneScoreState);
+};
+
+// Score is the sum of x, with a unit derivative on each particle
+class SumRestraint : public IMP::Restraint {
+  IMP::ParticleIndexes pis_;
+
+ public:
+  SumRestraint(IMP::Model *m, const IMP::ParticleIndexes &pis)
+      : IMP::Restraint(m, "SumRestraint%1%"), pis_(pis) {}
+  virtual double unprotected_evaluate(IMP::DerivativeAccumulator *accum)
+      const override {
+    double score = 0.;
+    for (IMP::ParticleIndex pi : pis_) {
+      score += get_model()->get_attribute(xk, pi);
+      if (accum) {
+        get_model()->add_to_derivative(xk, pi, 1., *accum);
+      }
+    }
+    return score;
+  }
+  IMP::ModelObjectsTemp do_get_inputs() const override {
+    return IMP::get_particles(get_model(), pis_);
+  }
+  IMP_OBJECT_METHODS(SumRestraint);
+};
+
+void check_evaluate(IMP::Model *m, IMP::ScoringFunction *sf,
+                    const IMP::ParticleIndexes &starts, double expected) {
+  double score = 0.;
+  IMP_THREADS((sf, score), score = sf->evaluate(true));
+  if (score != expected) {
+    IMP_THROW("Score " << score << " does not match " << expected,
+              IMP::ValueException);
+  }
+  // derivatives only reach the start of each chain if after_evaluate
+  // was called in reverse dependency order
+  for (IMP::ParticleIndex pi : starts) {
+    double d = m->get_derivative(xk, pi);
+    if (d != 1.) {
+      IMP_THROW("Derivative " << d << " does not match 1",
+                IMP::ValueException);
+    }
+  }
+}
+}
+
+int main(int argc, char *argv[]) {
+  IMP::setup_from_argv(argc, argv, "Test scheduling of score states.");
+  IMP::set_number_of_threads(4);
+
+  IMP_NEW(IMP::Model, m, ());
+  const unsigned int num_chains = 8, chain_length = 3;
+  IMP::ParticleIndexes starts, ends;
+  double expected = 0.;
+  for (unsigned int i = 0; i < num_chains; ++i) {
+    IMP::ParticleIndex prev = m->add_particle("P");
+    m->add_attribute(xk, prev, i);
+    starts.push_back(prev);
+    for (unsigned int j = 0; j < chain_length; ++j) {
+      IMP::ParticleIndex cur = m->add_particle("P");
+      m->add_attribute(xk, cur, 0.);
+      m->add_score_state(new AddOneScoreState(m, prev, cur));
+      prev = cur;
+    }
+    ends.push_back(prev);
+    expected += i + chain_length;
+  }
+  IMP_NEW(SumRestraint, r, (m, ends));
+  IMP::ScoringFunctionAdaptor sf(r);
+
+  // first call updates states one at a time
+  check_evaluate(m, sf, starts, expected);
+  m->set_score_state_timing(true);
+  check_evaluate(m, sf, starts, expected);
+  if (m->get_score_state_critical_path_length() != chain_length) {
+    IMP_THROW("Critical path length "
+              << m->get_score_state_critical_path_length()
+              << " does not match " << chain_length, IMP::ValueException);
+  }
+  if (m->get_score_state_critical_path_time()
+      > m->get_score_state_update_time()) {
+    IMP_THROW("Critical path takes longer than all score states",
+              IMP::ValueException);
+  }
+
+  // a scoring function that needs only some of the states gets its own
+  // schedule, so alternating between the two gives the right results
+  const unsigned int num_half = num_chains / 2;
+  IMP::ParticleIndexes half_starts(starts.begin(), starts.begin() + num_half);
+  IMP::ParticleIndexes half_ends(ends.begin(), ends.begin() + num_half);
+  double half_expected = 0.;
+  for (unsigned int i = 0; i < num_half; ++i) {
+    half_expected += i + chain_length;
+  }
+  IMP_NEW(SumRestraint, half_r, (m, half_ends));
+  IMP::ScoringFunctionAdaptor half_sf(half_r);
+  for (unsigned int i = 0; i < 3; ++i) {
+    check_evaluate(m, half_sf, half_starts, half_expected);
+    check_evaluate(m, sf, starts, expected);
+  }
+
+  IMP_NEW(IMP::WorkStealingTaskExecutor, ws, ());
+  IMP::set_task_executor(ws);
+  check_evaluate(m, sf, starts, expected);
+  IMP::set_task_executor(nullptr);
+
+  IMP::set_number_of_threads(1);
+  check_evaluate(m, sf, starts, expected);
+  return 0;
+}
@@ -0,0 +1,175 @@
+/**
+ *   Copyright 2007-2022 IMP Inventors. All rights reserved
+ */
+#include <IMP/base_types.h>
+#include <IMP/Model.h>
+#include <IMP/Particle.h>
+#include <IMP/Restraint.h>
+#include <IMP/RestraintSet.h>
+#include <IMP/ScoringFunction.h>
+#include <IMP/TaskExecutor.h>
+#include <IMP/particle_index.h>
+#include <IMP/threads.h>
+#include <IMP/thread_macros.h>
+#include <IMP/utility_macros.h>
+#include <IMP/flags.h>
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Without OpenMP, IMP_TASK and friends never reach the executor
+#ifndef _OPENMP
+int main(int, char * []) {
+  std::cout << "Skipped since IMP was built without OpenMP" << std::endl;
+  return 0;
+}
+
+#else
+
+namespace {
+
+std::string get_module_version() { return std::string(); }
+
+std::string get_module_name() { return std::string(); }
+
+// Add a unit x derivative to every particle
+class UnitDerivativeRestraint : public IMP::Restraint {
+  IMP::ParticleIndexes pis_;
+
+ public:
+  UnitDerivativeRestraint(IMP::Model *m, const IMP::ParticleIndexes &pis)
+      : IMP::Restraint(m, "UnitDerivativeRestraint%1%"), pis_(pis) {}
+  virtual double unprotected_evaluate(IMP::DerivativeAccumulator *accum)
+      const override {
+    if (accum) {
+      for (IMP::ParticleIndex pi : pis_) {
+        get_model()->add_to_coordinate_derivatives(
+            pi, IMP::algebra::Vector3D(1., 0., 0.), *accum);
+      }
+    }
+    return 1.;
+  }
+  IMP::ModelObjectsTemp do_get_inputs() const override {
+    return IMP::get_particles(get_model(), pis_);
+  }
+  IMP_OBJECT_METHODS(UnitDerivativeRestraint);
+};
+
+void check_evaluate(IMP::Model *m, IMP::ScoringFunction *sf,
+                    const IMP::ParticleIndexes &pis, double expected) {
+  double score = 0.;
+  IMP_THREADS((sf, score), score = sf->evaluate(true));
+  if (score != expected) {
+    IMP_THROW("Score " << score << " does not match " << expected,
+              IMP::ValueException);
+  }
+  for (IMP::ParticleIndex pi : pis) {
+    double d = m->get_derivative(IMP::FloatKey(0), pi);
+    if (d != expected) {
+      IMP_THROW("Derivative " << d << " does not match " << expected,
+                IMP::ValueException);
+    }
+  }
+}
+
+// Spawn a tree of nested tasks, and count the leaves
+void count_leaves(unsigned int depth, std::atomic<int> *count) {
+  if (depth == 0) {
+    ++*count;
+    return;
+  }
+  for (unsigned int i = 0; i < 2; ++i) {
+    IMP_TASK((depth, count), count_leaves(depth - 1, count), "count");
+  }
+  IMP_TASKWAIT
+}
+}
+
+int main(int argc, char *argv[]) {
+  IMP::setup_from_argv(argc, argv, "Test pluggable task executors.");
+  IMP::set_number_of_threads(4);
+
+  IMP_NEW(IMP::Model, m, ());
+  IMP::ParticleIndexes pis;
+  for (unsigned int i = 0; i < 100; ++i) {
+    IMP::ParticleIndex pi = m->add_particle("P");
+    for (unsigned int k = 0; k < 4; ++k) {
+      m->add_attribute(IMP::FloatKey(k), pi, 0.);
+    }
+    pis.push_back(pi);
+  }
+  // Nest half of the restraints in a RestraintSet to get nested tasks
+  IMP::Restraints rs;
+  IMP_NEW(IMP::RestraintSet, rset, (m, 1.0, "set"));
+  const unsigned int num_restraints = 16;
+  for (unsigned int i = 0; i < num_restraints; ++i) {
+    IMP::Restraint *r = new UnitDerivativeRestraint(m, pis);
+    if (i % 2 == 0) {
+      rs.push_back(r);
+    } else {
+      rset->add_restraint(r);
+    }
+  }
+  rs.push_back(rset);
+  IMP::ScoringFunctionAdaptor sf(rs);
+
+  check_evaluate(m, sf, pis, num_restraints);
+
+  IMP_NEW(IMP::WorkStealingTaskExecutor, ws, ());
+  IMP::set_task_executor(ws);
+  IMP_INTERNAL_CHECK(IMP::get_task_executor() == ws, "Executor not set");
+  check_evaluate(m, sf, pis, num_restraints);
+  // thread-local derivatives should use the executor's thread indexes
+  m->set_use_thread_local_derivatives(true);
+  check_evaluate(m, sf, pis, num_restraints);
+  m->set_use_thread_local_derivatives(false);
+  // cheap tasks are run immediately
+  ws->set_minimum_task_cost(2.);
+  check_evaluate(m, sf, pis, num_restraints);
+
+  std::atomic<int> count(0);
+  IMP_THREADS((count), count_leaves(8, &count));
+  if (count.load() != 256) {
+    IMP_THROW("Ran " << count.load() << " tasks rather than 256",
+              IMP::ValueException);
+  }
+
+  // a smaller region reuses the pool, with thread indexes in range
+  IMP::set_number_of_threads(2);
+  m->set_use_thread_local_derivatives(true);
+  check_evaluate(m, sf, pis, num_restraints);
+  m->set_use_thread_local_derivatives(false);
+  IMP::set_number_of_threads(4);
+  check_evaluate(m, sf, pis, num_restraints);
+
+  // regions started by several application threads at once
+  std::atomic<int> counts[4];
+  std::vector<std::thread> callers;
+  IMP::WorkStealingTaskExecutor *wsp = ws;
+  for (unsigned int i = 0; i < 4; ++i) {
+    counts[i] = 0;
+    std::atomic<int> *c = &counts[i];
+    callers.push_back(std::thread([wsp, c] {
+      for (unsigned int j = 0; j < 10; ++j) {
+        wsp->run_parallel([c] { count_leaves(6, c); }, 4);
+      }
+    }));
+  }
+  for (std::thread &t : callers) {
+    t.join();
+  }
+  for (unsigned int i = 0; i < 4; ++i) {
+    if (counts[i].load() != 640) {
+      IMP_THROW("Caller " << i << " ran " << counts[i].load()
+                          << " tasks rather than 640",
+                IMP::ValueException);
+    }
+  }
+
+  IMP::set_task_executor(nullptr);
+  check_evaluate(m, sf, pis, num_restraints);
+  return 0;
+}
+
+#endif
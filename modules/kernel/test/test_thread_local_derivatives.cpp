@@ -0,0 +1,106 @@
+/**
+ *   Copyright 2007-2022 IMP Inventors. All rights reserved
+ */
+#include <IMP/base_types.h>
+#include <IMP/Model.h>
+#include <IMP/Particle.h>
+#include <IMP/Restraint.h>
+#include <IMP/ScoringFunction.h>
+#include <IMP/particle_index.h>
+#include <IMP/threads.h>
+#include <IMP/thread_macros.h>
+#include <IMP/utility_macros.h>
+#include <IMP/flags.h>
+
+namespace {
+
+std::string get_module_version() { return std::string(); }
+
+std::string get_module_name() { return std::string(); }
+
+IMP::FloatKey get_extra_key() {
+  static IMP::FloatKey k("extra");
+  return k;
+}
+
+// Add a unit derivative to the x coordinate, the radius and an
+// extra attribute of every particle
+class UnitDerivativeRestraint : public IMP::Restraint {
+  IMP::ParticleIndexes pis_;
+
+ public:
+  UnitDerivativeRestraint(IMP::Model *m, const IMP::ParticleIndexes &pis)
+      : IMP::Restraint(m, "UnitDerivativeRestraint%1%"), pis_(pis) {}
+  virtual double unprotected_evaluate(IMP::DerivativeAccumulator *accum)
+      const override {
+    if (accum) {
+      for (IMP::ParticleIndex pi : pis_) {
+        get_model()->add_to_coordinate_derivatives(
+            pi, IMP::algebra::Vector3D(1., 0., 0.), *accum);
+        get_model()->add_to_derivative(IMP::FloatKey(3), pi, 1., *accum);
+        get_model()->add_to_derivative(get_extra_key(), pi, 1., *accum);
+      }
+    }
+    return 1.;
+  }
+  IMP::ModelObjectsTemp do_get_inputs() const override {
+    return IMP::get_particles(get_model(), pis_);
+  }
+  IMP_OBJECT_METHODS(UnitDerivativeRestraint);
+};
+
+void check_derivatives(IMP::Model *m, IMP::ScoringFunction *sf,
+                       const IMP::ParticleIndexes &pis, double expected) {
+  double score = 0.;
+  IMP_THREADS((sf, score), score = sf->evaluate(true));
+  if (score != expected) {
+    IMP_THROW("Score " << score << " does not match " << expected,
+              IMP::ValueException);
+  }
+  IMP::FloatKeys keys;
+  keys.push_back(IMP::FloatKey(0));
+  keys.push_back(IMP::FloatKey(3));
+  keys.push_back(get_extra_key());
+  for (IMP::ParticleIndex pi : pis) {
+    for (IMP::FloatKey k : keys) {
+      double d = m->get_derivative(k, pi);
+      if (d != expected) {
+        IMP_THROW("Derivative " << d << " of " << k << " does not match "
+                                << expected,
+                  IMP::ValueException);
+      }
+    }
+  }
+}
+}
+
+int main(int argc, char *argv[]) {
+  IMP::setup_from_argv(argc, argv, "Test thread-local derivative buffers.");
+  IMP::set_number_of_threads(4);
+
+  IMP_NEW(IMP::Model, m, ());
+  IMP::ParticleIndexes pis;
+  for (unsigned int i = 0; i < 100; ++i) {
+    IMP::ParticleIndex pi = m->add_particle("P");
+    for (unsigned int k = 0; k < 4; ++k) {
+      m->add_attribute(IMP::FloatKey(k), pi, 0.);
+    }
+    m->add_attribute(get_extra_key(), pi, 0.);
+    pis.push_back(pi);
+  }
+  IMP::Restraints rs;
+  const unsigned int num_restraints = 16;
+  for (unsigned int i = 0; i < num_restraints; ++i) {
+    rs.push_back(new UnitDerivativeRestraint(m, pis));
+  }
+  IMP::ScoringFunctionAdaptor sf(rs);
+
+  check_derivatives(m, sf, pis, num_restraints);
+  m->set_use_thread_local_derivatives(true);
+  check_derivatives(m, sf, pis, num_restraints);
+  // buffers must be left clean for the next evaluation
+  check_derivatives(m, sf, pis, num_restraints);
+  m->set_use_thread_local_derivatives(false);
+  check_derivatives(m, sf, pis, num_restraints);
+  return 0;
+}